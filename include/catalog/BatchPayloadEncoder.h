@@ -0,0 +1,179 @@
+// catalog/BatchPayloadEncoder.h
+#ifndef CATALOG_BATCHPAYLOADENCODER_H
+#define CATALOG_BATCHPAYLOADENCODER_H
+
+#include "tdb.h"
+
+#include "catalog/Schema.h"
+
+namespace taco {
+
+/*!
+ * The values of one column of a batch of rows passed to
+ * BatchPayloadEncoder::Append(), in the same layout as a decoded
+ * ColumnarTable::ColumnVector. None of the arrays is owned.
+ */
+struct BatchColumn {
+    /*!
+     * The values of a fixed-length column as a dense array, where the value
+     * of row \p i is at `i * typlen'; or the concatenated bytes of the
+     * values of a variable-length column. The value of a null row of a
+     * fixed-length column is ignored.
+     */
+    const char      *m_values;
+
+    /*!
+     * The end offsets of the values of a variable-length column in
+     * \p m_values, where the value of row \p i begins at the end of row
+     * `i - 1' (or 0 for row 0). Not used for a fixed-length column.
+     */
+    const uint32_t  *m_ends;
+
+    /*!
+     * The null bitmap of the column, where bit `i & 7' of byte `i >> 3' is
+     * set iff row \p i is null, or null if no row is null.
+     */
+    const uint8_t   *m_nulls;
+};
+
+/*!
+ * A BatchPayloadEncoder encodes batches of rows given as column arrays into
+ * record payloads of a schema, which are the same as the ones
+ * Schema::WritePayloadToBuffer() produces, and stores them contiguously in
+ * one arena buffer owned by the encoder. Each payload begins at a
+ * max-aligned offset of the arena and is a multiple of MAXALIGN bytes long.
+ *
+ * Append() computes the lengths of all the rows of a batch first, and then
+ * grows the arena and the row index at most once before writing the rows in
+ * place, so there's no heap allocation for each row, nor for each batch
+ * once the arena has grown large enough if the encoder is Clear()'ed
+ * between the batches. Note that growing the arena moves the payloads, so
+ * a payload pointer is only valid until the next call to Append().
+ */
+class BatchPayloadEncoder {
+public:
+    /*!
+     * Creates an encoder for the schema \p schema, whose layout must have
+     * been computed. The schema must outlive the encoder.
+     */
+    BatchPayloadEncoder(const Schema *schema);
+
+    /*!
+     * Encodes the \p nrows rows in \p columns, which has one column for each
+     * field of the schema, and appends them to the arena. Returns the index
+     * of the first appended row.
+     *
+     * It is an error if a non-nullable field has a null value, or if a row
+     * is too long for a payload, in which case none of the rows is
+     * appended.
+     */
+    size_t Append(const BatchColumn *columns, uint32_t nrows);
+
+    /*!
+     * Reserves the space for \p nbytes bytes of payloads and \p nrows rows,
+     * so that the arena does not grow until they are exceeded.
+     */
+    void Reserve(size_t nbytes, size_t nrows);
+
+    /*!
+     * Removes all the rows but keeps the space allocated for them.
+     */
+    void
+    Clear() {
+        m_buf.clear();
+        m_rows.clear();
+    }
+
+    size_t
+    GetNumRows() const {
+        return m_rows.size();
+    }
+
+    /*!
+     * Returns the offset of the payload of row \p i in the arena.
+     */
+    size_t
+    GetRowOffset(size_t i) const {
+        return m_rows[i].first;
+    }
+
+    /*!
+     * Returns the length of the payload of row \p i.
+     */
+    FieldOffset
+    GetRowLength(size_t i) const {
+        return m_rows[i].second;
+    }
+
+    /*!
+     * Returns the payload of row \p i.
+     */
+    const char*
+    GetPayload(size_t i) const {
+        return m_buf.data() + m_rows[i].first;
+    }
+
+    /*!
+     * Returns the arena with the payloads of all the rows.
+     */
+    const maxaligned_char_buf&
+    GetBuffer() const {
+        return m_buf;
+    }
+
+private:
+    /*!
+     * How to encode a field, which is extracted from the schema layout.
+     */
+    struct FieldPlan {
+        FieldId         m_field_id;
+
+        int16_t         m_typlen;
+
+        uint8_t         m_typalign;
+
+        //! the offset of a non-nullable fixed-length field, or the index of
+        //! a variable-length field in the varlen end array
+        FieldOffset     m_offset;
+
+        //! the null bit ID, or -1 if the field is not nullable
+        FieldId         m_nullbit_id;
+    };
+
+    /*!
+     * Returns the length of the payload of row \p row of \p columns, or
+     * throws an error if it can't be encoded.
+     */
+    FieldOffset ComputeRowLength(const BatchColumn *columns,
+                                 uint32_t row) const;
+
+    /*!
+     * Writes the payload of row \p row of \p columns into \p payload, which
+     * is zeroed and long enough for it.
+     */
+    void WriteRow(const BatchColumn *columns, uint32_t row,
+                  char *payload) const;
+
+    FieldOffset     m_null_bitmap_begin;
+
+    FieldOffset     m_varlen_end_array_begin;
+
+    FieldOffset     m_varlen_payload_begin;
+
+    //! the non-nullable fixed-length fields
+    std::vector<FieldPlan> m_fixed_fields;
+
+    //! the variable-length and the nullable fixed-length fields in the
+    //! payload order, which are stored after the fixed-length part
+    std::vector<FieldPlan> m_trailing_fields;
+
+    //! the arena
+    maxaligned_char_buf m_buf;
+
+    //! the offsets and the lengths of the payloads of the rows
+    std::vector<std::pair<size_t, FieldOffset>> m_rows;
+};
+
+}   // namespace taco
+
+#endif      // CATALOG_BATCHPAYLOADENCODER_H
@@ -368,7 +368,8 @@ public:
                  std::vector<std::string> field_names,
                  std::vector<bool> colisnullable,
                  std::vector<bool> colisarray,
-                 FileId tabfid);
+                 FileId tabfid,
+                 uint8_t tablayout = TABLAYOUT_ROW);
 
     /*!
      * Adds an index into the catalog.
@@ -0,0 +1,85 @@
+// catalog/PayloadCodec.h
+#ifndef CATALOG_PAYLOADCODEC_H
+#define CATALOG_PAYLOADCODEC_H
+
+#include "tdb.h"
+
+#include "catalog/Schema.h"
+
+namespace taco {
+
+/*!
+ * A PayloadCodec encodes and deforms the record payloads of a schema of a
+ * common shape with code specialized at compile time for the types of its
+ * fields, producing exactly the same payloads as Schema. Unlike the generic
+ * code in Schema, which decides on the length, the passing convention and
+ * the nullability of every field of every record, the specialized code
+ * copies each fixed-length field with a single load and store of its type
+ * and computes the length of the payload before writing it. The only
+ * data-dependent branches of the encoder are on nulls: it rejects a null
+ * value of a non-nullable field and skips copying a null variable-length
+ * value.
+ *
+ * The specialized shapes are the schemas with up to MaxNumFixedlenFields
+ * non-nullable pass-by-value fixed-length fields, followed by up to
+ * MaxNumVarlenFields variable-length fields which may be nullable, and no
+ * other field. In particular, that includes all-fixed-length schemas and
+ * fixed-then-varlen schemas. The catalog picks the codec of a table when
+ * its TableDesc is created, and TableDesc routes the encoding and the
+ * deforming of the payloads of the table through it.
+ */
+class PayloadCodec {
+public:
+    //! the max number of fixed-length fields in a specialized schema
+    static constexpr FieldId MaxNumFixedlenFields = 3;
+
+    //! the max number of variable-length fields in a specialized schema
+    static constexpr FieldId MaxNumVarlenFields = 2;
+
+    //! the max number of fields in a specialized schema
+    static constexpr FieldId MaxNumFields =
+        MaxNumFixedlenFields + MaxNumVarlenFields;
+
+    /*!
+     * Returns a codec specialized for the shape of \p schema, whose layout
+     * must have been computed, or null if its shape is not specialized.
+     */
+    static std::unique_ptr<PayloadCodec> Create(const Schema *schema);
+
+    virtual ~PayloadCodec() {}
+
+    /*!
+     * See Schema::WritePayloadToBuffer(). The buffer is resized at most
+     * once, and is not changed if -1 is returned.
+     */
+    virtual FieldOffset WritePayloadToBuffer(
+        const std::vector<Datum> &data,
+        maxaligned_char_buf &buf) const = 0;
+
+    /*!
+     * See Schema::WritePayloadToBuffer().
+     */
+    virtual FieldOffset WritePayloadToBuffer(
+        const std::vector<DatumRef> &data,
+        maxaligned_char_buf &buf) const = 0;
+
+    /*!
+     * See Schema::WritePayloadToBuffer().
+     */
+    virtual FieldOffset WritePayloadToBuffer(
+        const std::vector<NullableDatumRef> &data,
+        maxaligned_char_buf &buf) const = 0;
+
+    /*!
+     * Computes the offsets and the lengths of all the fields of \p payload
+     * into \p offlen as Schema::DeformPayload() does. The fields may be read
+     * with Schema::GetDeformedField().
+     */
+    virtual void DeformPayload(
+        const char *payload,
+        std::pair<FieldOffset, FieldOffset> *offlen) const = 0;
+};
+
+}   // namespace taco
+
+#endif      // CATALOG_PAYLOADCODEC_H
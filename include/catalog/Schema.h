@@ -8,7 +8,9 @@
 
 namespace taco {
 
+class BatchPayloadEncoder;
 class BootstrapCatCache;
+class PayloadCodec;
 
 /*!
  * A Schema object stores the information for accessing an ordered set of typed
@@ -35,8 +37,19 @@ class BootstrapCatCache;
  * | nullable fixed-len fields |
  *
  * The entire payload is always maximum aligned to 8-byte boundary at the end.
+ *
+ * As a FieldOffset never has its most significant bit set, that bit of a
+ * varlen field end array entry marks a value stored out of line (see
+ * Table::GetField()), in which case the bytes of the field in the payload
+ * are a pointer to the value rather than the value itself. Schema never
+ * interprets those bytes.
  */
 class Schema {
+public:
+    //! the bit of a varlen field end array entry that is set if the field is
+    //! stored out of line
+    static constexpr uint16_t VarlenEndExternalBit = 0x8000;
+
 private:
     struct FieldInfo {
         /*! The type ID of this field */
@@ -194,6 +207,24 @@ public:
         return m_field[field_id].m_typbyref;
     }
 
+    /*!
+     * Returns the length of a fixed-length field, or -1 if it is a
+     * variable-length field. It is undefined unless the layout is computed.
+     */
+    inline int16_t
+    GetFieldLength(FieldId field_id) const {
+        return m_field[field_id].m_typlen;
+    }
+
+    /*!
+     * Returns the alignment of a field. It is undefined unless the layout is
+     * computed.
+     */
+    inline int8_t
+    GetFieldAlignment(FieldId field_id) const {
+        return m_field[field_id].m_typalign;
+    }
+
     /*!
      * Returns the total number of fields.
      */
@@ -202,6 +233,28 @@ public:
         return (FieldId) m_field.size();
     }
 
+    /*!
+     * Returns whether all the fields are non-nullable and fixed-length, in
+     * which case all the records of this schema have the same length
+     * GetFixedRecordLength().
+     */
+    inline bool
+    HasOnlyNonnullableFixedlenFields() const {
+        EnsureLayoutComputed();
+        return m_has_only_nonnullable_fixedlen_fields;
+    }
+
+    /*!
+     * Returns the length of every record of this schema, which is a
+     * multiple of MAXALIGN_OF. It is undefined unless
+     * HasOnlyNonnullableFixedlenFields() is true.
+     */
+    inline FieldOffset
+    GetFixedRecordLength() const {
+        EnsureLayoutComputed();
+        return m_varlen_payload_begin;
+    }
+
     /*!
      * Returns the field ID of the field with the ``field_name''.
      *
@@ -243,14 +296,59 @@ public:
      */
     bool FieldIsNull(FieldId field_id, const char *payload) const;
 
+    /*!
+     * Returns whether the value of a non-null variable-length field in a
+     * record payload is stored out of line.
+     */
+    bool FieldIsExternal(FieldId field_id, const char *payload) const;
+
+    /*!
+     * Marks the value of a non-null variable-length field in a record payload
+     * as stored out of line. The bytes of the field must have already been
+     * replaced with the pointer to the value.
+     */
+    void SetFieldExternal(FieldId field_id, char *payload) const;
+
     /*!
      * Returns a field in the payload as a Datum. The returned datum references
      * the payload so the payload must be alive when the return value is use.
      * However, any in-place change to payload may or may not be reflected in
-     * the returned datum.
+     * the returned datum. It is an error if the field is stored out of line,
+     * which only Table::GetField() can read.
      */
     Datum GetField(FieldId field_id, const char *payload) const;
 
+    /*!
+     * Computes the offsets and the lengths of the fields of a record payload
+     * in a single pass over the payload, and stores those of field `i' in
+     * \p offlen[i] as GetOffsetAndLength() would return them, except that
+     * the length of a null field is -1. Hence, reading k fields of a record
+     * takes O(n) time in total rather than O(k * n) with
+     * GetOffsetAndLength().
+     *
+     * The pass stops as soon as all the fields up to \p max_field_id have
+     * been computed, so the entries of the fields after it may or may not
+     * be set. \p offlen must have GetNumFields() entries, and may be reused
+     * across the calls, which never allocate memory.
+     */
+    void DeformPayload(const char *payload, FieldId max_field_id,
+                       std::pair<FieldOffset, FieldOffset> *offlen) const;
+
+    /*!
+     * Returns a field in the payload as a Datum, using the offsets and
+     * lengths \p offlen computed by DeformPayload() for the payload. The
+     * returned datum references the payload as in GetField().
+     */
+    Datum
+    GetDeformedField(FieldId field_id, const char *payload,
+                     const std::pair<FieldOffset, FieldOffset> *offlen) const {
+        if (offlen[field_id].second < 0) {
+            return Datum::FromNull();
+        }
+        return MakeFieldDatum(field_id, payload + offlen[field_id].first,
+                              offlen[field_id].second);
+    }
+
     /*!
      * Dissemble the payload into a vector of Datums in field order as defined
      * in the schema. The data in the returned vector are a reference into the
@@ -282,6 +380,38 @@ private:
     FieldOffset WritePayloadToBufferImpl(const std::vector<SomeDatum> &data,
                                          maxaligned_char_buf &buf) const;
 
+    /*!
+     * Returns the non-null field \p field_id with \p len bytes at \p bytes
+     * as a Datum that references them.
+     */
+    Datum
+    MakeFieldDatum(FieldId field_id, const char *bytes,
+                   FieldOffset len) const {
+        if (m_field[field_id].m_typbyref) {
+            // varlen or pass-by-reference fixed-len field
+            return Datum::FromVarlenBytes(bytes, len);
+        }
+        return Datum::FromFixedlenBytes(bytes, len);
+    }
+
+    /*!
+     * Computes m_deform_end after the payload layout is computed.
+     */
+    void ComputeDeformEnds();
+
+    /*!
+     * Returns the \p varlen_idx-th entry of the varlen field end array of
+     * \p payload without the external bit.
+     */
+    FieldOffset
+    GetVarlenEnd(const char *payload, FieldId varlen_idx) const {
+        const FieldOffset *varlen_end =
+            reinterpret_cast<const FieldOffset*>(payload +
+                                                 m_varlen_end_array_begin);
+        return (FieldOffset)((uint16_t) varlen_end[varlen_idx] &
+                             ~VarlenEndExternalBit);
+    }
+
     /*! whether the layout has been computed */
     bool m_layout_computed;
 
@@ -324,11 +454,21 @@ private:
      */
     std::vector<FieldId> m_field_reorder_idx;
 
+    /*!
+     * The number of fields in the payload order that DeformPayload() has to
+     * go through for each max field ID, i.e., m_deform_end[i] is one past
+     * the last position of the fields 0 to i in m_field_reorder_idx.
+     */
+    std::vector<FieldId> m_deform_end;
+
     /*! information about the individual fields */
     std::vector<FieldInfo> m_field;
 
     /*! optional field names (may be empty or of the same length as m_field) */
     std::vector<std::string> m_field_names;
+
+    friend class BatchPayloadEncoder;
+    friend class PayloadCodec;
 };
 
 }   // namespace taco
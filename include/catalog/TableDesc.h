@@ -3,6 +3,7 @@
 
 #include "tdb.h"
 
+#include "catalog/PayloadCodec.h"
 #include "catalog/Schema.h"
 #include "catalog/systables.h"
 
@@ -42,14 +43,61 @@ public:
         return m_schema.get();
     }
 
+    /*!
+     * Returns the payload codec specialized for the shape of the table
+     * schema, which is picked when the table descriptor is created, or null
+     * if the shape is not specialized. See PayloadCodec.
+     */
+    const PayloadCodec*
+    GetPayloadCodec() const {
+        return m_codec.get();
+    }
+
+    /*!
+     * Encodes \p data into \p buf as Schema::WritePayloadToBuffer() does,
+     * using the specialized payload codec if there's one.
+     */
+    template<class SomeDatum>
+    FieldOffset
+    WritePayloadToBuffer(const std::vector<SomeDatum> &data,
+                         maxaligned_char_buf &buf) const {
+        if (m_codec)
+            return m_codec->WritePayloadToBuffer(data, buf);
+        return m_schema->WritePayloadToBuffer(data, buf);
+    }
+
+    /*!
+     * Computes the offsets and the lengths of all the fields of \p payload
+     * into \p offlen as Schema::DeformPayload() does, using the specialized
+     * payload codec if there's one.
+     */
+    void
+    DeformPayload(const char *payload,
+                  std::pair<FieldOffset, FieldOffset> *offlen) const {
+        if (m_codec) {
+            m_codec->DeformPayload(payload, offlen);
+            return ;
+        }
+        m_schema->DeformPayload(payload, m_schema->GetNumFields() - 1,
+                                offlen);
+    }
+
+    /*!
+     * Dissembles \p payload as Schema::DissemblePayload() does, using the
+     * specialized payload codec if there's one.
+     */
+    std::vector<Datum> DissemblePayload(const char *payload) const;
+
 private:
     TableDesc(std::shared_ptr<const SysTable_Table> table,
               std::unique_ptr<Schema> schema):
         m_table(std::move(table)),
-        m_schema(std::move(schema)) {}
+        m_schema(std::move(schema)),
+        m_codec(PayloadCodec::Create(m_schema.get())) {}
 
     std::shared_ptr<const SysTable_Table> m_table;
     std::unique_ptr<Schema> m_schema;
+    std::unique_ptr<PayloadCodec> m_codec;
 };
 
 }   // namespace taco
@@ -28,6 +28,18 @@ namespace taco {
  */
 constexpr Oid max_sys_oid = 19999;
 
+/*!
+ * The storage layouts of a table, stored in Table.tablayout. A row-wise
+ * heap file stores each record contiguously in a VarlenDataPage or a
+ * FixedlenDataPage (see Table.tabisvarlen), while a PAX heap file groups
+ * the values of each column together in a PaxDataPage. A columnar table
+ * is not a heap file but a ColumnarTable, which stores each column in its
+ * own file.
+ */
+constexpr uint8_t TABLAYOUT_ROW = 0;
+constexpr uint8_t TABLAYOUT_PAX = 1;
+constexpr uint8_t TABLAYOUT_COLUMNAR = 2;
+
 }   // namespace taco
 
 #endif      // CATALOG_SYSTABLES_H
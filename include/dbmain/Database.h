@@ -125,14 +125,17 @@ public:
      * parameters if they are empty. More specifically, the default type
      * parameter is 0. The default field name for the ith column (starting from
      * 0) is ``col_i''. By default, none of the field is nullable or is an
-     * array.
+     * array. The table uses the storage layout \p tablayout, which is one of
+     * TABLAYOUT_ROW, TABLAYOUT_PAX and TABLAYOUT_COLUMNAR (see
+     * catalog/systables.h).
      */
     void CreateTable(absl::string_view tabname,
                      std::vector<Oid> coltypid,
                      std::vector<uint64_t> coltypparam = {},
                      const std::vector<absl::string_view> &field_names = {},
                      std::vector<bool> colisnullable = {},
-                     std::vector<bool> colisarray = {});
+                     std::vector<bool> colisarray = {},
+                     uint8_t tablayout = 0 /* TABLAYOUT_ROW */);
 
     /*!
      * Createa an index named ``idxname'' and inserts into the catalog.
@@ -0,0 +1,1013 @@
+#ifndef STORAGE_BUFFERMANAGER_H
+#define STORAGE_BUFFERMANAGER_H
+
+#include "tdb.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <absl/container/flat_hash_map.h>
+
+#include "storage/CompressedPageCache.h"
+#include "storage/FileManager.h"
+#include "utils/Latch.h"
+#include "utils/ResourceGuard.h"
+
+namespace taco {
+
+/*!
+ * The types of buffer access strategies. See \p BufferAccessStrategy.
+ */
+enum class BufferAccessStrategyType {
+    //! Large sequential scans. Uses a 256 KB ring by default.
+    BULKREAD,
+    //! Bulk loads and index builds. Uses a 16 MB ring by default.
+    BULKWRITE,
+    //! Vacuum. Uses a 256 KB ring by default.
+    VACUUM,
+};
+
+/*!
+ * A \p BufferAccessStrategy is a small private ring of buffer frames that a
+ * bulk operation (a sequential scan, a bulk load, an index build, ...)
+ * recycles for its page misses, instead of evicting pages from the shared
+ * buffer pool. This is modeled after the buffer access strategies in
+ * PostgreSQL.
+ *
+ * A frame in the ring is reused only if no one else has pinned it or accessed
+ * it since the strategy loaded a page into it. Otherwise, it is left in the
+ * shared buffer pool and replaced in the ring by a victim chosen by the clock
+ * replacement policy.
+ *
+ * A strategy object is not thread-safe and should be used by one thread at a
+ * time. It does not hold any pin, so it may be destructed at any time.
+ */
+class BufferAccessStrategy {
+public:
+    /*!
+     * Creates a strategy with the default ring size of the \p type.
+     */
+    static std::unique_ptr<BufferAccessStrategy>
+    Create(BufferAccessStrategyType type);
+
+    /*!
+     * Creates a strategy with a ring of \p ring_size bytes. The ring size is
+     * capped at 1/8 of the buffer pool and is at least one frame.
+     */
+    static std::unique_ptr<BufferAccessStrategy>
+    Create(BufferAccessStrategyType type, size_t ring_size);
+
+    constexpr BufferAccessStrategyType
+    GetType() const {
+        return m_type;
+    }
+
+    /*!
+     * Returns the number of frames in the ring.
+     */
+    size_t
+    GetRingSize() const {
+        return m_ring.size();
+    }
+
+private:
+    BufferAccessStrategy(BufferAccessStrategyType type, size_t nframes):
+        m_type(type),
+        m_current(0),
+        m_ring(nframes, INVALID_BUFID) {}
+
+    BufferAccessStrategyType    m_type;
+
+    //! the next slot in the ring to use
+    size_t                      m_current;
+
+    //! the buffer frames in the ring, or INVALID_BUFID for an empty slot
+    std::vector<BufferId>       m_ring;
+
+    friend class BufferManager;
+};
+
+/*!
+ * The event counters of the buffer manager, either over the whole buffer
+ * pool or over the pages of a single file. See BufferManager::GetStats().
+ */
+struct BufferCounters {
+    //! the number of pins that found the page in the buffer pool
+    uint64_t    m_hits = 0;
+
+    //! the number of pins that had to read the page
+    uint64_t    m_misses = 0;
+
+    //! the number of pages evicted from the buffer pool
+    uint64_t    m_evictions = 0;
+
+    //! the number of dirty pages written back when they were evicted
+    uint64_t    m_eviction_writebacks = 0;
+
+    //! the number of dirty pages written back by the background writer, a
+    //! checkpoint or a flush
+    uint64_t    m_background_writebacks = 0;
+
+    //! the number of times a pin had to wait for a read in progress or for
+    //! a frame to become available
+    uint64_t    m_pin_waits = 0;
+
+    //! the number of times BufferManager::AcquireFrameLatch() had to wait
+    uint64_t    m_latch_waits = 0;
+
+    //! the number of pages read by the prefetcher
+    uint64_t    m_readahead_pages = 0;
+
+    //! the number of pages read by the prefetcher that were later pinned
+    uint64_t    m_readahead_hits = 0;
+
+    //! the number of pages read by the prefetcher that were evicted before
+    //! being pinned
+    uint64_t    m_readahead_wasted = 0;
+
+    //! the number of pages read by the prewarm threads
+    uint64_t    m_prewarm_pages = 0;
+
+    //! the number of misses and pages read ahead or prewarmed that were
+    //! served by the compressed page cache instead of the disk
+    uint64_t    m_compressed_hits = 0;
+
+    /*!
+     * Returns the fraction of the pins that found the page in the buffer
+     * pool, or 0 if there's none.
+     */
+    double
+    GetHitRatio() const {
+        uint64_t npins = m_hits + m_misses;
+        return npins ? (double) m_hits / npins : 0.0;
+    }
+};
+
+/*!
+ * A snapshot of the buffer manager statistics returned by
+ * BufferManager::GetStats(). The counters are cumulative since
+ * BufferManager::Init() and they are not taken atomically with respect to
+ * each other.
+ */
+struct BufferManagerStats {
+    //! the current number of frames
+    size_t          m_pool_size = 0;
+
+    //! the number of frames with a page in them
+    size_t          m_nresident = 0;
+
+    //! the number of frames with a dirty page in them
+    size_t          m_ndirty = 0;
+
+    //! the number of frames that are pinned
+    size_t          m_npinned = 0;
+
+    //! the number of pages in the compressed page cache
+    size_t          m_ncompressed = 0;
+
+    //! the memory used by the compressed page cache in bytes
+    size_t          m_compressed_size = 0;
+
+    //! the counters over the whole buffer pool
+    BufferCounters  m_pool;
+
+    //! the counters of each file that has been read, in the order of FileId
+    std::vector<std::pair<FileId, BufferCounters>> m_files;
+
+    /*!
+     * Returns a human-readable multi-line text of the statistics.
+     */
+    std::string ToString() const;
+};
+
+/*!
+ * The read-ahead state of one sequential reader of a virtual file, e.g., a
+ * table scan, which is passed to the pins of the pages it follows. See
+ * BufferManager for the read-ahead policy. Interleaved readers of the same
+ * file, even on the same thread, each have their own window.
+ *
+ * A state is not thread-safe and does not hold any pin.
+ */
+class ReadAheadState {
+public:
+    ReadAheadState():
+        m_fid(INVALID_FID),
+        m_next_pid(INVALID_PID),
+        m_window(0),
+        m_ahead(0) {}
+
+    /*!
+     * Returns the current read-ahead window in pages, which is 0 if the
+     * reader is not known to be sequential.
+     */
+    uint32_t
+    GetWindow() const {
+        return m_window;
+    }
+
+private:
+    //! the file being read
+    FileId      m_fid;
+
+    //! the next page to be pinned if the reader is sequential
+    PageNumber  m_next_pid;
+
+    //! the current read-ahead window
+    uint32_t    m_window;
+
+    //! the number of pages we have asked to prefetch ahead of the reader
+    uint32_t    m_ahead;
+
+    friend class BufferManager;
+};
+
+/*!
+ * A \p SwizzledPageRef is an in-memory reference to a page that may be
+ * swizzled, i.e., it also remembers the buffer frame where the page was
+ * found the last time it was pinned through the reference. Pinning a page
+ * through a swizzled reference (see BufferManager::PinPage(SwizzledPageRef&,
+ * char**)) only validates that the page is still in that frame, without
+ * looking it up in the page table or taking the buffer manager mutex.
+ *
+ * A reference is never eagerly unswizzled when the page is evicted. Instead,
+ * the stale frame is detected at the next pin, and the reference is
+ * unswizzled and then swizzled again to the new frame. Hence, the owner of
+ * a reference (e.g., a parent in-memory node) does not need to be tracked
+ * by the buffer manager.
+ *
+ * All the functions are thread-safe.
+ */
+class SwizzledPageRef {
+public:
+    SwizzledPageRef():
+        m_word(0) {}
+
+    explicit SwizzledPageRef(PageNumber pid):
+        m_word(MakeUnswizzled(pid)) {}
+
+    SwizzledPageRef(const SwizzledPageRef &other):
+        m_word(other.m_word.load(memory_order_relaxed)) {}
+
+    SwizzledPageRef&
+    operator=(const SwizzledPageRef &other) {
+        m_word.store(other.m_word.load(memory_order_relaxed),
+                     memory_order_relaxed);
+        return *this;
+    }
+
+    /*!
+     * Returns the page number of the referenced page, or \p INVALID_PID if
+     * it does not reference any page.
+     */
+    PageNumber
+    GetPageNumber() const {
+        return GetPageNumber(m_word.load(memory_order_relaxed));
+    }
+
+    /*!
+     * Returns whether the reference is currently swizzled.
+     */
+    bool
+    IsSwizzled() const {
+        return IsSwizzled(m_word.load(memory_order_relaxed));
+    }
+
+    /*!
+     * Makes this an unswizzled reference to page \p pid.
+     */
+    void
+    Set(PageNumber pid) {
+        m_word.store(MakeUnswizzled(pid), memory_order_relaxed);
+    }
+
+    /*!
+     * Makes this a reference to no page.
+     */
+    void
+    Reset() {
+        m_word.store(0, memory_order_relaxed);
+    }
+
+private:
+    // The page number is in the high 32 bits. The low 32 bits are the
+    // buffer ID + 1 if it is swizzled, or 0 otherwise.
+    static constexpr uint64_t
+    MakeUnswizzled(PageNumber pid) {
+        return ((uint64_t) pid) << 32;
+    }
+
+    static constexpr uint64_t
+    MakeSwizzled(PageNumber pid, BufferId bufid) {
+        return (((uint64_t) pid) << 32) | (uint64_t)(uint32_t)(bufid + 1);
+    }
+
+    static constexpr PageNumber
+    GetPageNumber(uint64_t word) {
+        return (PageNumber)(word >> 32);
+    }
+
+    static constexpr bool
+    IsSwizzled(uint64_t word) {
+        return (uint32_t) word != 0;
+    }
+
+    static constexpr BufferId
+    GetBufferId(uint64_t word) {
+        return (BufferId)(uint32_t) word - 1;
+    }
+
+    atomic<uint64_t>    m_word;
+
+    friend class BufferManager;
+};
+
+/*!
+ * The buffer manager caches the pages of the file manager in a pool of
+ * fixed number of buffer frames, using the clock replacement policy. A page
+ * must be pinned before it is accessed in a buffer frame and unpinned
+ * afterwards. A pinned page is never evicted.
+ *
+ * Dirty pages are written back by a background writer thread, which cleans
+ * the frames just ahead of the clock hand so that a page miss can usually
+ * find a clean victim. A page miss never writes a dirty page by itself while
+ * the background writer is running: a dirty frame in the ring of a buffer
+ * access strategy is handed to the background writer, and the strategy
+ * moves on to the next frame in its ring. The background writer is disabled
+ * if --bufman_bgwriter_delay_ms is 0, in which case a page miss writes back a
+ * dirty victim by itself, but never while holding the buffer pool mutex.
+ *
+ * The buffer manager also detects when a reader follows the next page links
+ * of a virtual file and asynchronously reads ahead the next few pages on a
+ * prefetcher thread. A reader (e.g., a table scan) owns a \p ReadAheadState
+ * and passes it to the pins of the pages it follows, so the pattern is
+ * tracked per reader. The read-ahead window doubles while the pattern
+ * holds, up to --bufman_readahead_max_pages pages (0 disables read-ahead),
+ * and is reset when the reader pins a page other than the next one. Pins
+ * through a buffer access strategy never trigger read-ahead, as the pages
+ * read ahead would not fit in its small ring.
+ *
+ * The buffer pool may be resized online with Resize(). The address space for
+ * the largest allowed pool is reserved in Init(), so a frame never moves and
+ * GetBuffer() needs no lock. Memory is only committed when a frame is first
+ * used, and it is returned to the OS in huge-page-sized segments when the
+ * pool shrinks.
+ *
+ * To avoid a cold cache after a restart, the set of resident pages may be
+ * saved with SaveResidentPages() on a clean shutdown and read back in the
+ * background with StartPrewarm() when the database is opened again.
+ *
+ * The buffer manager counts the hits, misses, evictions, write-backs and
+ * waits over the whole buffer pool and for each file. See GetStats(). The
+ * pool counters are striped over a few cache lines to keep the pins from
+ * contending on them.
+ *
+ * If --bufman_compressed_cache_size is positive, the clean pages evicted
+ * from the buffer pool by the clock policy are kept compressed in a \p
+ * CompressedPageCache of that many bytes, which serves the later misses on
+ * them without a disk read.
+ *
+ * For a working set that fits in memory, page hops may avoid the page table
+ * by pinning through a \p SwizzledPageRef. Each frame also caches a
+ * swizzled reference to the next page of the page in it, which is used by
+ * PinNextPage() to follow the page links of a virtual file.
+ *
+ * All the functions are thread-safe.
+ */
+class BufferManager {
+public:
+    BufferManager();
+
+    /*!
+     * Destructs the buffer manager. It calls Destroy() if it has not been
+     * called.
+     */
+    ~BufferManager();
+
+    /*!
+     * Allocates a buffer pool of \p pool_size frames, which may later be
+     * resized up to \p max_pool_size frames. If \p max_pool_size is 0, it
+     * is --bufman_max_pool_size if that is set, or 4 times \p pool_size
+     * otherwise.
+     */
+    void Init(size_t pool_size, size_t max_pool_size = 0);
+
+    /*!
+     * Flushes all the dirty pages and frees the buffer pool.
+     */
+    void Destroy();
+
+    /*!
+     * Pins the page \p pid in the buffer pool and returns its buffer ID. The
+     * frame address of the page is returned in \p *frame. If the page is not
+     * in the buffer pool, it is read into a frame chosen by the replacement
+     * policy, or from the private ring of \p strategy if it is not null.
+     * If \p readahead is not null, the pin is a step of that reader and may
+     * trigger read-ahead.
+     *
+     * It is an error if all the frames in the buffer pool are pinned.
+     */
+    BufferId PinPage(PageNumber pid, char **frame,
+                     BufferAccessStrategy *strategy = nullptr,
+                     ReadAheadState *readahead = nullptr);
+
+    /*!
+     * Pins the page referenced by \p ref. If \p ref is swizzled and the
+     * page is still in the same frame, the page is pinned with a few atomic
+     * operations on the frame. Otherwise, this is the same as PinPage(pid,
+     * frame) and \p ref is swizzled to the frame the page is pinned in.
+     *
+     * \p ref must reference a page. See PinPage(PageNumber, char**,
+     * BufferAccessStrategy*, ReadAheadState*) for \p readahead.
+     */
+    BufferId PinPage(SwizzledPageRef &ref, char **frame,
+                     ReadAheadState *readahead = nullptr);
+
+    /*!
+     * Pins the next page of the page in the frame \p bufid, through the
+     * swizzled reference cached in the frame. Returns \p INVALID_BUFID if
+     * there's no next page. The caller must hold a pin on \p bufid. See
+     * PinPage(PageNumber, char**, BufferAccessStrategy*, ReadAheadState*)
+     * for \p readahead.
+     */
+    BufferId PinNextPage(BufferId bufid, char **frame,
+                         ReadAheadState *readahead = nullptr);
+
+    /*!
+     * Releases one pin on the buffer frame \p bufid.
+     */
+    void UnpinPage(BufferId bufid);
+
+    /*!
+     * Marks the page in buffer frame \p bufid as dirty. The caller must hold
+     * a pin on it.
+     */
+    void MarkDirty(BufferId bufid);
+
+    /*!
+     * Returns the page number of the page in the buffer frame \p bufid. The
+     * caller must hold a pin on it.
+     */
+    PageNumber
+    GetPageNumber(BufferId bufid) const {
+        return m_desc[bufid].m_pid.load(memory_order_relaxed);
+    }
+
+    /*!
+     * Returns the latch of the buffer frame \p bufid, which protects the
+     * content of the page in it. The buffer manager itself never acquires
+     * it. The caller must hold a pin on the frame to acquire the latch in
+     * shared or exclusive mode, but it may start an optimistic read on the
+     * latch and validate it later without a pin as the frame never moves,
+     * provided that it also validates the page number of the frame.
+     */
+    Latch*
+    GetFrameLatch(BufferId bufid) const {
+        return &m_desc[bufid].m_latch;
+    }
+
+    /*!
+     * Acquires the latch of the buffer frame \p bufid in \p mode, counting
+     * it as a latch wait in the statistics if it is not immediately
+     * available. The caller must hold a pin on the frame, and releases the
+     * latch through GetFrameLatch().
+     */
+    void AcquireFrameLatch(BufferId bufid, LatchMode mode);
+
+    /*!
+     * Returns the address of the buffer frame \p bufid.
+     */
+    char*
+    GetBuffer(BufferId bufid) const {
+        return m_frames + bufid * PAGE_SIZE;
+    }
+
+    /*!
+     * Returns the number of frames in the buffer pool.
+     */
+    size_t
+    GetPoolSize() const {
+        return m_nframes.load(memory_order_relaxed);
+    }
+
+    /*!
+     * Returns the maximum number of frames the buffer pool may be resized
+     * to.
+     */
+    size_t
+    GetMaxPoolSize() const {
+        return m_max_nframes;
+    }
+
+    /*!
+     * Resizes the buffer pool to \p pool_size frames without blocking the
+     * other threads for long. To shrink the pool, the frames at the end are
+     * drained: the pages in them are evicted as soon as they are unpinned,
+     * so this may wait for the pins to be released. The dirty ones are
+     * written back by the background writer first, or by this thread
+     * without holding the buffer pool mutex if it is not running.
+     *
+     * It is an error if \p pool_size is 0 or larger than GetMaxPoolSize().
+     */
+    void Resize(size_t pool_size);
+
+    /*!
+     * Writes all the dirty pages back to the disk. See Checkpoint() for the
+     * order of the writes.
+     */
+    void FlushAll();
+
+    /*!
+     * Writes all the pages that are dirty at the time of the call back to
+     * the disk and forces them to be flushed. The pages are written in the
+     * order of (FileId, PageNumber), and pages with consecutive page numbers
+     * are merged into vectored writes.
+     *
+     * If \p target_duration_ms is positive, the writes are spread evenly
+     * over about that many milliseconds to avoid an I/O spike. Otherwise,
+     * the pages are written as fast as possible.
+     */
+    void Checkpoint(uint64_t target_duration_ms = 0);
+
+    /*!
+     * Saves the (FileId, PageNumber) pairs and the usage counts of the pages
+     * that are currently in the buffer pool to the file \p path, which is
+     * replaced atomically if it exists.
+     */
+    void SaveResidentPages(const std::string &path);
+
+    /*!
+     * Reads the file \p path saved by SaveResidentPages() and removes it,
+     * then starts --bufman_prewarm_threads background threads that read the
+     * saved pages back into the buffer pool in the order of (FileId,
+     * PageNumber) and restore their usage counts. If there are more saved
+     * pages than frames, the ones with the highest usage counts are chosen.
+     * It returns without waiting for the threads. Nothing happens if \p path
+     * does not exist or prewarming is disabled.
+     */
+    void StartPrewarm(const std::string &path);
+
+    /*!
+     * Waits for the prewarm threads started by StartPrewarm() to finish.
+     */
+    void WaitForPrewarm();
+
+    /*!
+     * Returns whether the page \p pid is in the buffer pool at the time of
+     * the call. This is for diagnostics only as the answer may be stale as
+     * soon as it returns.
+     */
+    bool IsPageResident(PageNumber pid);
+
+    /*!
+     * Returns a snapshot of the statistics of the buffer manager.
+     */
+    BufferManagerStats GetStats();
+
+    /*!
+     * Starts a background thread that replaces the file \p path with the
+     * text of GetStats() every --bufman_stats_dump_interval_ms milliseconds,
+     * and once more when the buffer manager is destroyed. Nothing happens if
+     * the interval is 0.
+     */
+    void StartStatsDump(const std::string &path);
+
+private:
+    /*!
+     * The events counted in the statistics, each of which is a field in
+     * \p BufferCounters.
+     */
+    enum StatCounter {
+        Hits = 0,
+        Misses,
+        Evictions,
+        EvictionWritebacks,
+        BackgroundWritebacks,
+        PinWaits,
+        LatchWaits,
+        ReadAheadPages,
+        ReadAheadHits,
+        ReadAheadWasted,
+        PrewarmPages,
+        CompressedHits,
+        NumStatCounters
+    };
+
+    /*!
+     * A set of event counters that may be updated concurrently.
+     */
+    struct StatCounters {
+        atomic<uint64_t>    m_cnt[NumStatCounters];
+
+        StatCounters() {
+            for (size_t i = 0; i < NumStatCounters; ++i) {
+                m_cnt[i].store(0, memory_order_relaxed);
+            }
+        }
+
+        void
+        Add(StatCounter c, uint64_t n) {
+            m_cnt[c].fetch_add(n, memory_order_relaxed);
+        }
+
+        void AddTo(BufferCounters &counters) const;
+    };
+
+    //! a stripe of the pool counters in its own cache lines
+    struct alignas(CACHELINE_SIZE) StatStripe {
+        StatCounters        m_counters;
+    };
+
+    //! the number of stripes of the pool counters
+    static constexpr size_t NumStatStripes = 16;
+
+    //! the maximum usage count of a buffer frame in the clock policy
+    static constexpr uint8_t MaxUsageCount = 5;
+
+    //! set in the pin count while a frame is claimed for a new page
+    static constexpr uint32_t FrameBusyBit = ((uint32_t) 1) << 31;
+
+    /*!
+     * The buffer descriptors are cache line aligned so that pinning pages in
+     * different frames never touches the same cache line.
+     */
+    struct alignas(CACHELINE_SIZE) BufferDesc {
+        //! the page in this frame, or INVALID_PID if it's empty. Only
+        //! changed under m_mutex while the frame is claimed.
+        atomic<PageNumber>  m_pid;
+
+        //! the pin count, may be changed without holding m_mutex. The
+        //! FrameBusyBit is set while the frame is claimed for a new page or
+        //! the page is being read.
+        atomic<uint32_t>    m_pincnt;
+
+        //! whether the page is dirty
+        atomic_bool         m_dirty;
+
+        //! usage count for the clock policy, protected by m_mutex except
+        //! that a pin through a swizzled reference may bump it
+        atomic<uint8_t>     m_usage;
+
+        //! whether the page is being read into this frame
+        bool                m_io_in_progress;
+
+        //! whether the page is being written back from this frame
+        bool                m_write_in_progress;
+
+        //! the latch on the page content, see GetFrameLatch()
+        mutable Latch       m_latch;
+
+        //! the cached reference to the next page, see PinNextPage()
+        SwizzledPageRef     m_next_ref;
+
+        //! the counters of the file of the page in this frame, or null if
+        //! unknown yet. Set under m_mutex. See ResolveFileStats().
+        StatCounters        *m_file_stats;
+
+        //! whether the page was read by the prefetcher and has not been
+        //! pinned by anyone else since
+        atomic_bool         m_prefetched;
+    };
+
+    /*!
+     * Returns whether a frame may be evicted. Requires \p m_mutex.
+     */
+    bool
+    IsEvictable(const BufferDesc &desc) const {
+        return desc.m_pincnt.load(memory_order_acquire) == 0 &&
+               !desc.m_io_in_progress && !desc.m_write_in_progress;
+    }
+
+    /*!
+     * Counts \p n events \p c in the pool counters and, if \p desc is not
+     * null, in the counters of the file of the page in it.
+     */
+    void CountEvent(StatCounter c, const BufferDesc *desc, uint64_t n = 1);
+
+    /*!
+     * Returns the counters of file \p fid, creating them if necessary.
+     * Requires \p m_mutex.
+     */
+    StatCounters *GetFileStats(FileId fid);
+
+    /*!
+     * Sets the file counters of the frame \p bufid from the file ID in the
+     * page if they are not set yet. A page that has just been allocated has
+     * no file ID until it is initialized after the pin, so this is retried
+     * on the hits. Requires \p m_mutex.
+     */
+    void ResolveFileStats(BufferId bufid);
+
+    void DumpStats();
+    void StatsDumperMain();
+    void StopStatsDump();
+
+    /*!
+     * Claims an unpinned frame for a new page, which prevents anyone from
+     * pinning it through a swizzled reference. The claiming thread holds a
+     * pin on it. Returns false if someone has pinned it. Requires \p
+     * m_mutex.
+     */
+    bool
+    ClaimFrame(BufferDesc &desc) {
+        uint32_t pincnt = 0;
+        return desc.m_pincnt.compare_exchange_strong(pincnt,
+                                                     FrameBusyBit | 1,
+                                                     memory_order_acquire,
+                                                     memory_order_relaxed);
+    }
+
+    /*!
+     * Releases the claim on the frame by ClaimFrame() when it is left empty.
+     * Someone may still hold a transient pin on it at this point, so the
+     * pin count is not simply reset.
+     */
+    void
+    ReleaseClaim(BufferDesc &desc) {
+        desc.m_pincnt.fetch_sub(FrameBusyBit | 1, memory_order_release);
+    }
+
+    /*!
+     * Tries to pin the page \p pid in the frame \p bufid without holding
+     * \p m_mutex. Returns \p INVALID_BUFID if the page is no longer there.
+     */
+    BufferId TryPinSwizzled(BufferId bufid, PageNumber pid, char **frame);
+
+    /*!
+     * Finds a victim frame using the clock policy. If the background writer
+     * is running, dirty frames are skipped and the caller waits for the
+     * background writer to clean some of them if there's no clean victim.
+     * Otherwise, the victim may be dirty and must be cleaned with
+     * CleanVictim() before it is claimed. \p lock must hold \p m_mutex.
+     *
+     * It is an error if all the frames are pinned.
+     */
+    BufferId FindVictim(std::unique_lock<std::mutex> &lock);
+
+    /*!
+     * Finds a victim frame from the ring of \p strategy. If the background
+     * writer is running, the dirty frames in the ring are handed to it and
+     * skipped, and the caller waits for it if all of them are being
+     * cleaned. \p lock must hold \p m_mutex.
+     */
+    BufferId FindVictimFromStrategy(std::unique_lock<std::mutex> &lock,
+                                    BufferAccessStrategy *strategy);
+
+    /*!
+     * Puts a compressed copy of the clean page in the claimed frame \p bufid
+     * into the compressed page cache if it's enabled, releasing \p lock
+     * while compressing it. Returns whether it has released the lock.
+     */
+    bool MaybeCompressVictim(std::unique_lock<std::mutex> &lock,
+                             BufferId bufid);
+
+    /*!
+     * Writes back the dirty page in the unpinned frame \p bufid through
+     * WriteFrames(), releasing \p lock during the write. The frame is not
+     * claimed, so the caller must check again whether it is still evictable
+     * and clean afterwards. \p lock must hold \p m_mutex.
+     */
+    void CleanVictim(std::unique_lock<std::mutex> &lock, BufferId bufid);
+
+    /*!
+     * Evicts the page in the claimed frame \p bufid, which must be clean.
+     * Requires \p m_mutex.
+     */
+    void EvictFrame(BufferId bufid);
+
+    /*!
+     * Marks the dirty page in the frame \p bufid as being written back and
+     * clears its dirty bit. Requires \p m_mutex.
+     */
+    void
+    BeginWrite(BufferDesc &desc) {
+        desc.m_write_in_progress = true;
+        desc.m_dirty.store(false, memory_order_release);
+    }
+
+    /*!
+     * Writes back the pages in the frames \p bufids, which must have been
+     * passed to BeginWrite(), in the order of (FileId, PageNumber). Pages
+     * with consecutive page numbers are written with one vectored write.
+     * Each page written is counted as \p counter. If a write fails, the
+     * pages are marked dirty again. Requires \p m_mutex not to be held. \p
+     * bufids is reordered.
+     */
+    void WriteFrames(std::vector<BufferId> &bufids,
+                     StatCounter counter = BackgroundWritebacks);
+
+    /*!
+     * Writes back all the pages that are dirty at the time of the call. See
+     * Checkpoint() for the meaning of \p target_duration_ms.
+     */
+    void WriteAllDirtyPages(uint64_t target_duration_ms);
+
+    /*!
+     * The main loop of the background writer thread.
+     */
+    void BgWriterMain();
+
+    /*!
+     * Checks if the reader of \p readahead is following the page links of a
+     * virtual file after pinning the page \p pid in \p frame, and issues a
+     * read-ahead request for the following pages if so. Does nothing if \p
+     * readahead is null. Requires \p m_mutex not to be held.
+     */
+    void MaybeReadAhead(PageNumber pid, const char *frame,
+                        ReadAheadState *readahead);
+
+    /*!
+     * The main loop of the prefetcher thread.
+     */
+    void PrefetcherMain();
+
+    /*!
+     * Starts the prefetcher thread if read-ahead is enabled.
+     */
+    void StartPrefetcher();
+
+    /*!
+     * Stops the prefetcher thread and drops all the pending requests.
+     */
+    void StopPrefetcher();
+
+    /*!
+     * Reads the page \p pid into the buffer pool if it is not there and
+     * raises its usage count to at least \p usage.
+     */
+    void PrewarmPage(PageNumber pid, uint8_t usage);
+
+    /*!
+     * Stops the prewarm threads early and waits for them to exit.
+     */
+    void StopPrewarm();
+
+    /*!
+     * Starts the background writer thread if it is enabled.
+     */
+    void StartBgWriter();
+
+    /*!
+     * Stops the background writer thread and waits for it to exit.
+     */
+    void StopBgWriter();
+
+    bool                m_initialized;
+
+    //! the number of frames currently in use
+    atomic<size_t>      m_nframes;
+
+    //! the number of frames reserved in m_frames and m_desc
+    size_t              m_max_nframes;
+
+    //! serializes the calls to Resize()
+    std::mutex          m_resize_mutex;
+
+    /*!
+     * Maps the memory for \p m_max_nframes buffer frames, backed by huge
+     * pages if possible. Sets \p m_frames and \p m_frames_mapsize.
+     */
+    void AllocateFrames();
+
+    /*!
+     * Unmaps the memory for the buffer frames.
+     */
+    void FreeFrames();
+
+    //! the buffer frames
+    char                *m_frames;
+
+    //! the size of the mapping at m_frames
+    size_t              m_frames_mapsize;
+
+    //! the buffer descriptors, allocated with aligned_alloc(3)
+    BufferDesc          *m_desc;
+    unique_malloced_ptr m_desc_mem;
+
+    //! protects the page table, the clock hand and the descriptors
+    std::mutex          m_mutex;
+
+    //! signaled when a read into or a write from some frame finishes
+    std::condition_variable m_io_cv;
+
+    //! the background writer thread
+    std::thread         m_bgwriter;
+
+    //! whether the background writer is running, protected by m_mutex
+    bool                m_bgwriter_running;
+
+    //! whether the background writer should exit, protected by m_mutex
+    bool                m_bgwriter_stop;
+
+    //! whether someone is waiting for a clean frame, protected by m_mutex
+    bool                m_bgwriter_wakeup;
+
+    //! signaled to wake up the background writer
+    std::condition_variable m_bgwriter_cv;
+
+    //! the dirty frames of the strategy rings to be written by the
+    //! background writer, protected by m_mutex
+    std::vector<BufferId> m_bgwriter_requests;
+
+    //! the maximum read-ahead window in pages, or 0 if it's disabled
+    uint32_t            m_readahead_max_pages;
+
+    //! the prefetcher thread
+    std::thread         m_prefetcher;
+
+    //! protects the prefetcher states below
+    std::mutex          m_prefetch_mutex;
+
+    //! signaled when there's a new read-ahead request or on stop
+    std::condition_variable m_prefetch_cv;
+
+    //! pending read-ahead requests of (first page, number of pages)
+    std::deque<std::pair<PageNumber, uint32_t>> m_prefetch_queue;
+
+    //! whether the prefetcher should exit
+    bool                m_prefetcher_stop;
+
+    //! the prewarm threads
+    std::vector<std::thread> m_prewarm_threads;
+
+    //! whether the prewarm threads should exit early
+    atomic_bool         m_prewarm_stop;
+
+    //! the number of pins held by the prefetcher and the prewarm threads
+    atomic<uint32_t>    m_background_pins;
+
+    //! the second-tier cache of the evicted pages, or null if disabled
+    std::unique_ptr<CompressedPageCache> m_compressed_cache;
+
+    //! the striped pool counters of NumStatStripes stripes
+    StatStripe          *m_stats;
+    unique_malloced_ptr m_stats_mem;
+
+    //! the counters of each file, protected by m_mutex
+    absl::flat_hash_map<FileId, std::unique_ptr<StatCounters>> m_file_stats;
+
+    //! the stats dumper, see StartStatsDump()
+    std::thread         m_stats_dumper;
+    std::string         m_stats_path;
+    uint64_t            m_stats_dump_interval_ms;
+    std::mutex          m_stats_dumper_mutex;
+    std::condition_variable m_stats_dumper_cv;
+    bool                m_stats_dumper_stop;
+
+    absl::flat_hash_map<PageNumber, BufferId> m_pagetable;
+
+    BufferId            m_clock_hand;
+};
+
+struct BufferUnpinFunc {
+    void operator()(BufferId bufid) const {
+        g_bufman->UnpinPage(bufid);
+    }
+};
+
+/*!
+ * A buffer ID that automatically unpins the page when it goes out of scope.
+ */
+using ScopedBufferId = ResourceGuard<BufferId, BufferUnpinFunc,
+                                     BufferId, INVALID_BUFID>;
+
+/*!
+ * Holds the latch of a pinned buffer frame until it goes out of scope. It
+ * must go out of scope before the pin is released, e.g., by declaring it
+ * after the ScopedBufferId of the frame.
+ */
+class ScopedFrameLatch {
+public:
+    ScopedFrameLatch(BufferId bufid, LatchMode mode):
+        m_bufid(bufid),
+        m_mode(mode) {
+        g_bufman->AcquireFrameLatch(bufid, mode);
+    }
+
+    ~ScopedFrameLatch() {
+        Release();
+    }
+
+    ScopedFrameLatch(const ScopedFrameLatch&) = delete;
+    ScopedFrameLatch &operator=(const ScopedFrameLatch&) = delete;
+
+    /*!
+     * Releases the latch early.
+     */
+    void
+    Release() {
+        if (m_bufid != INVALID_BUFID) {
+            g_bufman->GetFrameLatch(m_bufid)->Release(m_mode);
+            m_bufid = INVALID_BUFID;
+        }
+    }
+
+private:
+    BufferId    m_bufid;
+    LatchMode   m_mode;
+};
+
+}   // namespace taco
+
+#endif      // STORAGE_BUFFERMANAGER_H
@@ -0,0 +1,382 @@
+#ifndef STORAGE_COLUMNARTABLE_H
+#define STORAGE_COLUMNARTABLE_H
+
+#include "tdb.h"
+
+#include "catalog/TableDesc.h"
+#include "storage/FileManager.h"
+
+namespace taco {
+
+/*!
+ * The directory entry of a column chunk, i.e., the values of one column in
+ * one row group.
+ */
+struct ColumnChunkDesc {
+    //! the first of the consecutive pages of the chunk in the column file
+    PageNumber      m_first_pid;
+
+    //! the number of rows in the row group
+    uint32_t        m_nrows;
+
+    //! the length of the stored chunk
+    uint32_t        m_len;
+
+    //! the length of the encoded chunk before compression, which is the same
+    //! as \p m_len if the chunk is not compressed
+    uint32_t        m_rawlen;
+};
+
+/*!
+ * The header of the first page of the directory file of a columnar table,
+ * which is followed by the file IDs of the column files.
+ */
+struct ColumnarMetaPageHeader {
+    PageHeaderData  m_ph;
+
+    //! the number of columns
+    FieldId         m_ncols;
+};
+
+/*!
+ * The header of a row-group directory page, which is followed by an array
+ * of column chunk entries.
+ */
+struct ColumnarDirPageHeader {
+    PageHeaderData  m_ph;
+
+    //! the number of entries on this page
+    uint16_t        m_cnt;
+};
+
+/*!
+ * ColumnarTable is the storage of a table with the TABLAYOUT_COLUMNAR
+ * layout, meant for append-mostly analytic tables. Each column is stored in
+ * its own virtual file as a sequence of column chunks, one per row group of
+ * up to a fixed number of rows. A chunk is a typed array: an optional null
+ * bitmap followed by either the dense fixed-length values, or the end
+ * offsets and the bytes of the variable-length values. The encoded chunk is
+ * compressed with lz_compress() if that makes it smaller, and written to a
+ * run of consecutive new pages of the column file in one sequential write.
+ *
+ * The virtual file \p tabfid recorded in the table's catalog entry is the
+ * directory file: its first page stores the file IDs of the column files,
+ * and the following pages are the row-group directory, where the entries
+ * of row group \p i are the \p ncols entries starting from
+ * `i * ncols'. A row group becomes visible when its directory entries are
+ * written, after all of its chunks.
+ *
+ * Rows are only added through an Appender and there is no erase or update.
+ * A Scanner reads the row groups one at a time, and only decodes the chunks
+ * of the columns it is asked for into ColumnVectors, which the operators
+ * access directly. At most one Appender may be active on a table, and no
+ * scan may run concurrently with it.
+ */
+class ColumnarTable {
+public:
+    class ColumnVector;
+    class Appender;
+    class Scanner;
+
+    //! the default number of rows in a row group
+    static constexpr uint32_t DefaultRowGroupSize = 16384;
+
+    //! the number of bytes of a chunk on a page
+    static constexpr size_t ChunkBytesPerPage =
+        PAGE_SIZE - MAXALIGN(sizeof(PageHeaderData));
+
+    //! the number of directory entries on a directory page
+    static constexpr size_t DirEntriesPerPage =
+        (PAGE_SIZE - MAXALIGN(sizeof(ColumnarDirPageHeader))) /
+        sizeof(ColumnChunkDesc);
+
+    /*!
+     * Creates the column files of the new columnar table \p tabdesc and
+     * initializes its directory file, which must have just been created by
+     * the file manager.
+     */
+    static void Initialize(const TableDesc *tabdesc);
+
+    /*!
+     * Opens the columnar table \p tabdesc.
+     */
+    static std::unique_ptr<ColumnarTable> Create(
+        std::shared_ptr<const TableDesc> tabdesc);
+
+    const TableDesc*
+    GetTableDesc() const {
+        return m_tabdesc.get();
+    }
+
+    /*!
+     * Returns the number of row groups in the table.
+     */
+    uint32_t
+    GetNumRowGroups() const {
+        return (uint32_t)(m_chunks.size() / m_col_files.size());
+    }
+
+    /*!
+     * Returns the number of rows in the table.
+     */
+    uint64_t
+    GetNumRows() const {
+        return m_nrows;
+    }
+
+    /*!
+     * Starts appending rows to the table in row groups of \p rowgroup_nrows
+     * rows. See Appender.
+     */
+    std::unique_ptr<Appender> StartAppend(
+        uint32_t rowgroup_nrows = DefaultRowGroupSize);
+
+    /*!
+     * Returns a scanner over the row groups of the table that only reads
+     * the columns \p field_ids, in that order.
+     */
+    Scanner StartScan(std::vector<FieldId> field_ids);
+
+    /*!
+     * A ColumnVector holds the decoded values of one column in a row group.
+     * The values of a fixed-length column are a dense array, so an
+     * operator may process them without any per-row decoding.
+     */
+    class ColumnVector {
+    public:
+        ColumnVector():
+            m_nrows(0) {}
+
+        ColumnVector(ColumnVector&&) = default;
+        ColumnVector &operator=(ColumnVector&&) = default;
+
+        uint32_t
+        GetNumRows() const {
+            return m_nrows;
+        }
+
+        /*!
+         * Returns whether the value of row \p row is null.
+         */
+        bool
+        IsNull(uint32_t row) const {
+            if (!m_nullable)
+                return false;
+            const uint8_t *nulls = (const uint8_t*) m_buf.data();
+            return (nulls[row >> 3] >> (row & 7)) & 1;
+        }
+
+        /*!
+         * Returns the array of the values of a fixed-length column, where
+         * the value of row \p i is at `i * typlen'. The value of a null row
+         * is undefined.
+         */
+        const char*
+        GetFixedlenValues() const {
+            ASSERT(m_typlen > 0);
+            return m_buf.data() + m_values_begin;
+        }
+
+        /*!
+         * Returns the value of row \p row of a variable-length column and
+         * its length in \p *p_len.
+         */
+        const char*
+        GetVarlenValue(uint32_t row, uint32_t *p_len) const {
+            ASSERT(m_typlen == -1);
+            const uint32_t *ends =
+                (const uint32_t*)(m_buf.data() + m_values_begin);
+            uint32_t begin = (row == 0) ? 0 : ends[row - 1];
+            *p_len = ends[row] - begin;
+            return m_buf.data() + m_values_begin +
+                (size_t) m_nrows * sizeof(uint32_t) + begin;
+        }
+
+        /*!
+         * Returns the value of row \p row, which references this vector.
+         */
+        Datum GetField(uint32_t row) const;
+
+    private:
+        /*!
+         * Decodes the column chunk \p desc of the field \p field_id of the
+         * schema \p schema, whose stored bytes are in \p chunk. An
+         * uncompressed chunk is swapped into this vector rather than copied.
+         */
+        void Decode(const Schema *schema, FieldId field_id,
+                    const ColumnChunkDesc &desc, maxaligned_char_buf &chunk);
+
+        uint32_t            m_nrows;
+
+        int16_t             m_typlen;
+
+        bool                m_typbyref;
+
+        bool                m_nullable;
+
+        //! the offset of the values in \p m_buf, following the null bitmap
+        size_t              m_values_begin;
+
+        //! the encoded chunk
+        maxaligned_char_buf m_buf;
+
+        friend class ColumnarTable;
+    };
+
+    /*!
+     * An Appender buffers the appended rows in per-column buffers, and
+     * writes a row group of all the columns whenever it has
+     * \p rowgroup_nrows rows. The rows that have not been written when the
+     * Appender is destroyed without calling Finish() are discarded, while
+     * the row groups already written stay in the table.
+     */
+    class Appender {
+    public:
+        /*!
+         * Appends a row with the fields in \p data.
+         */
+        void Append(const std::vector<Datum> &data);
+
+        /*!
+         * See Append(const std::vector<Datum>&).
+         */
+        void Append(const std::vector<NullableDatumRef> &data);
+
+        /*!
+         * Writes the remaining rows as the last row group. No other
+         * function may be called after that.
+         */
+        void Finish();
+
+    private:
+        //! the values of a column that have not been written
+        struct ColumnBuffer {
+            //! the null bitmap, one bit per row
+            std::vector<uint8_t>    m_nulls;
+
+            //! the fixed-length values or the variable-length bytes
+            std::vector<char>       m_values;
+
+            //! the end offsets of the variable-length values
+            std::vector<uint32_t>   m_ends;
+        };
+
+        Appender(ColumnarTable *table, uint32_t rowgroup_nrows);
+
+        template<class SomeDatum>
+        void AppendImpl(const std::vector<SomeDatum> &data);
+
+        /*!
+         * Writes the buffered rows as a row group.
+         */
+        void FlushRowGroup();
+
+        ColumnarTable       *m_table;
+
+        uint32_t            m_rowgroup_nrows;
+
+        //! the number of buffered rows
+        uint32_t            m_nrows;
+
+        std::vector<ColumnBuffer> m_cols;
+
+        //! the buffer where a chunk is encoded
+        maxaligned_char_buf m_rawbuf;
+
+        friend class ColumnarTable;
+    };
+
+    /*!
+     * A Scanner iterates over the row groups of a columnar table in order.
+     * After each successful call to Next(), the column vectors of the
+     * current row group are valid until the next call to Next().
+     */
+    class Scanner {
+    public:
+        Scanner():
+            m_table(nullptr),
+            m_next_rowgroup(0),
+            m_nrows(0) {}
+
+        Scanner(Scanner&&) = default;
+        Scanner &operator=(Scanner&&) = default;
+
+        /*!
+         * Moves to the next row group and returns true, or returns false if
+         * there's no more row group.
+         */
+        bool Next();
+
+        /*!
+         * Returns the number of rows in the current row group.
+         */
+        uint32_t
+        GetNumRows() const {
+            return m_nrows;
+        }
+
+        /*!
+         * Returns the vector of the \p i-th column passed to StartScan() in
+         * the current row group.
+         */
+        const ColumnVector&
+        GetColumn(size_t i) const {
+            return m_vectors[i];
+        }
+
+    private:
+        Scanner(ColumnarTable *table, std::vector<FieldId> field_ids);
+
+        ColumnarTable       *m_table;
+
+        std::vector<FieldId> m_field_ids;
+
+        uint32_t            m_next_rowgroup;
+
+        uint32_t            m_nrows;
+
+        std::vector<ColumnVector> m_vectors;
+
+        //! the buffer where a compressed chunk is read
+        maxaligned_char_buf m_chunkbuf;
+
+        friend class ColumnarTable;
+    };
+
+private:
+    ColumnarTable(std::shared_ptr<const TableDesc> tabdesc,
+                  std::unique_ptr<File> dir_file);
+
+    /*!
+     * Writes the \p len bytes of a chunk in \p chunk to new pages of column
+     * file \p field_id and returns the first page number.
+     */
+    PageNumber WriteChunk(FieldId field_id, const char *chunk, size_t len);
+
+    /*!
+     * Reads the stored bytes of the chunk \p desc of the column file
+     * \p field_id into \p buf.
+     */
+    void ReadChunk(FieldId field_id, const ColumnChunkDesc &desc,
+                   maxaligned_char_buf &buf);
+
+    /*!
+     * Appends the directory entries of a row group in \p descs.
+     */
+    void AppendRowGroup(const std::vector<ColumnChunkDesc> &descs);
+
+    std::shared_ptr<const TableDesc> m_tabdesc;
+
+    std::unique_ptr<File> m_dir_file;
+
+    std::vector<std::unique_ptr<File>> m_col_files;
+
+    //! the in-memory copy of the row-group directory
+    std::vector<ColumnChunkDesc> m_chunks;
+
+    uint64_t        m_nrows;
+};
+
+}   // namespace taco
+
+#endif      // STORAGE_COLUMNARTABLE_H
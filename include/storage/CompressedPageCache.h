@@ -0,0 +1,120 @@
+#ifndef STORAGE_COMPRESSEDPAGECACHE_H
+#define STORAGE_COMPRESSEDPAGECACHE_H
+
+#include "tdb.h"
+
+#include <mutex>
+
+#include <absl/container/flat_hash_map.h>
+
+namespace taco {
+
+/*!
+ * The compressed page cache is an in-memory second tier behind the buffer
+ * pool. When the buffer manager evicts a clean page, it may put a
+ * compressed copy of the page here, so that a later miss on the page is
+ * served by decompressing it instead of a disk read. With a typical
+ * compression ratio of 2-3x, this increases the effective cache capacity
+ * for the same amount of memory at near-memory latency.
+ *
+ * The cache is exclusive of the buffer pool: a page is removed from the
+ * cache as soon as it is read back into the buffer pool, and it may only be
+ * inserted while it is not modifiable in the buffer pool. Hence, a cached
+ * copy is always the same as the page on disk, and nothing is ever written
+ * back from here.
+ *
+ * The pages are hashed into a few shards, each with its own mutex, a
+ * budget of an equal share of the total size and an LRU list. The pages
+ * that do not compress to at most 3/4 of their size are not cached.
+ *
+ * All the functions are thread-safe.
+ */
+class CompressedPageCache {
+public:
+    /*!
+     * Creates a compressed page cache that uses up to about \p budget bytes
+     * of memory, including the per-page overhead.
+     */
+    CompressedPageCache(size_t budget);
+
+    ~CompressedPageCache();
+
+    CompressedPageCache(const CompressedPageCache&) = delete;
+    CompressedPageCache &operator=(const CompressedPageCache&) = delete;
+
+    /*!
+     * Compresses and caches the page \p pid in \p page, replacing any
+     * existing copy of it. The least recently inserted pages are evicted if
+     * the cache is over its budget. Returns whether the page is cached.
+     */
+    bool Insert(PageNumber pid, const char *page);
+
+    /*!
+     * Decompresses the page \p pid into \p page and removes it from the
+     * cache if it is cached. Returns whether it was found.
+     */
+    bool Lookup(PageNumber pid, char *page);
+
+    /*!
+     * Returns the number of cached pages.
+     */
+    size_t GetNumPages() const;
+
+    /*!
+     * Returns the number of bytes used by the cached pages, including the
+     * per-page overhead.
+     */
+    size_t GetSize() const;
+
+private:
+    //! a compressed page, followed by its compressed bytes
+    struct Entry {
+        Entry       *m_prev;
+        Entry       *m_next;
+        PageNumber  m_pid;
+        uint32_t    m_size;
+
+        char*
+        GetData() {
+            return (char*)(this + 1);
+        }
+
+        size_t
+        GetMemSize() const {
+            return sizeof(Entry) + m_size;
+        }
+    };
+
+    struct alignas(CACHELINE_SIZE) Shard {
+        mutable std::mutex  m_mutex;
+
+        absl::flat_hash_map<PageNumber, Entry*> m_entries;
+
+        //! the LRU list with the most recent page at the head, circular
+        //! with a sentinel
+        Entry               m_lru;
+
+        size_t              m_size;
+    };
+
+    static constexpr size_t NumShards = 16;
+
+    Shard&
+    GetShard(PageNumber pid) const {
+        return m_shards[(pid * 0x9e3779b1u) >> 28];
+    }
+
+    static void Unlink(Entry *entry);
+    static void LinkAtHead(Shard &shard, Entry *entry);
+    static void RemoveEntry(Shard &shard, Entry *entry);
+
+    //! the budget of each shard
+    size_t              m_shard_budget;
+
+    Shard               *m_shards;
+    unique_malloced_ptr m_shards_mem;
+};
+
+}   // namespace taco
+
+#endif      // STORAGE_COMPRESSEDPAGECACHE_H
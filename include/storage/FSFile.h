@@ -3,6 +3,8 @@
 
 #include "tdb.h"
 
+#include <sys/uio.h>
+
 namespace taco {
 
 /*!
@@ -95,6 +97,15 @@ public:
      */
     void Write(const void *buf, size_t count, off_t offset);
 
+    /*!
+     * Writes the \p iovcnt buffers in \p iov into the file at the \p offset
+     * in a single pwritev(2) call. \p iovcnt must not exceed IOV_MAX. The
+     * same error conditions as Write() apply.
+     *
+     * This function is thread-safe.
+     */
+    void WriteV(const struct iovec *iov, int iovcnt, off_t offset);
+
     /*!
      * Allocates \p count bytes at the end of the file and zeros those bytes.
      *
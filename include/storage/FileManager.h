@@ -108,6 +108,298 @@ constexpr FileId INVALID_FID = 0;
 constexpr FileId NEW_REGULAR_FID = INVALID_FID;
 constexpr FileId NEW_TMP_FID = TMP_FILEID_MASK;
 
+/*!
+ * The number of pages in each data file segment on disk (1 GB segments). The
+ * data files are named `main.<segno>' in the database directory, and page
+ * number \p pid is stored in segment `pid / DataFileNumPages' at offset
+ * `(pid % DataFileNumPages) * PAGE_SIZE'.
+ */
+constexpr PageNumber DataFileNumPages = 262144;
+
+/*!
+ * The number of pages a data file segment is extended by when the file
+ * manager runs out of free pages.
+ */
+constexpr PageNumber DataFileExtentNumPages = 64;
+
+/*!
+ * The maximum number of data file segments.
+ */
+constexpr size_t MaxNumDataFiles =
+    (((uint64_t) MaxPageNumber) + DataFileNumPages) / DataFileNumPages;
+
+class FSFile;
+class FileManager;
+
+/*!
+ * A \p File is an open handle of a virtual file managed by the \p
+ * FileManager. A virtual file is a doubly-linked list of data pages
+ * (see \p PageHeaderData) plus a meta page that is only visible to the file
+ * manager. A newly created virtual file always has exactly one data page.
+ *
+ * The page header updates are always made through the buffer manager if
+ * there is one, so the callers may safely keep the data pages of the file
+ * cached in the buffer pool.
+ */
+class File {
+public:
+    /*!
+     * Closes the file if it's not closed yet.
+     */
+    ~File();
+
+    /*!
+     * Closes the file. No other function may be called after that.
+     */
+    void Close();
+
+    constexpr FileId
+    GetFileId() const {
+        return m_fid;
+    }
+
+    /*!
+     * Allocates a new page and appends it to the end of the file. The new
+     * page is zero filled except for its page header. Returns the page
+     * number of the new page.
+     */
+    PageNumber AllocatePage();
+
+    /*!
+     * Frees a data page of this file and returns it to the file manager.
+     * It is an error to free the only page in a file. The caller must not
+     * hold the latch of the page.
+     */
+    void FreePage(PageNumber pid);
+
+    /*!
+     * Reserves \p npages new consecutive pages at the end of the data files
+     * for bulk loading this file and returns the page number of the first
+     * one. The reserved pages are not part of any file and are never
+     * accessed through the buffer manager until they are appended to this
+     * file by AppendNewPages(). They must be either appended or freed by
+     * FreeNewPages() before the file is closed, or they are leaked.
+     */
+    PageNumber ReserveNewPages(PageNumber npages);
+
+    /*!
+     * Writes the \p npages reserved pages starting from \p first_pid
+     * directly to the disk with large sequential writes, bypassing the
+     * buffer manager. The content of page \p first_pid + i is the \p i-th
+     * page in the contiguous buffer \p buf, which must be aligned to 512
+     * bytes. The page headers in \p buf are overwritten so that the pages
+     * are the data pages of this file linked in order.
+     */
+    void WriteNewPages(PageNumber first_pid, char *buf, PageNumber npages);
+
+    /*!
+     * Appends the runs of reserved pages in \p runs, each of which is a pair
+     * of the first page number and the number of pages that have been
+     * written by WriteNewPages(), to the end of this file in order in one
+     * step.
+     */
+    void AppendNewPages(
+        const std::vector<std::pair<PageNumber, PageNumber>> &runs);
+
+    /*!
+     * Returns the \p npages reserved pages starting from \p first_pid to the
+     * file manager without appending them to the file.
+     */
+    void FreeNewPages(PageNumber first_pid, PageNumber npages);
+
+    /*!
+     * Returns the page number of the first data page.
+     */
+    PageNumber GetFirstPageNumber();
+
+    /*!
+     * Returns the page number of the last data page.
+     */
+    PageNumber GetLastPageNumber();
+
+    /*!
+     * Returns the number of data pages in this file.
+     */
+    PageNumber GetNumPages();
+
+private:
+    File(FileManager *fileman, FileId fid, PageNumber meta_pid):
+        m_fileman(fileman),
+        m_fid(fid),
+        m_meta_pid(meta_pid) {}
+
+    FileManager     *m_fileman;
+    FileId          m_fid;
+    PageNumber      m_meta_pid;
+
+    friend class FileManager;
+};
+
+/*!
+ * The \p FileManager manages all the virtual files of a database, which are
+ * stored in a number of data file segments (see \p DataFileNumPages). Page 0
+ * is the file manager meta page and is never visible outside the file
+ * manager, which is why \p INVALID_PID is 0.
+ *
+ * All the functions are thread-safe.
+ */
+class FileManager {
+public:
+    FileManager();
+
+    /*!
+     * Destructs the file manager. It calls Destroy() if it has not been
+     * called.
+     */
+    ~FileManager();
+
+    /*!
+     * Opens the data files in the database directory \p datadir. If \p
+     * create is true, a new set of data files is created and formatted.
+     */
+    void Init(const std::string &datadir, bool create);
+
+    /*!
+     * Flushes the file manager meta data and closes all the data files.
+     */
+    void Destroy();
+
+    /*!
+     * Opens a virtual file \p fid. If \p fid is \p NEW_REGULAR_FID, a new
+     * virtual file is created and returned. Returns a null pointer if \p fid
+     * does not exist.
+     */
+    std::unique_ptr<File> Open(FileId fid);
+
+    /*!
+     * Removes the virtual file \p fid and frees all of its pages. The
+     * caller must ensure no one has the file open or any of its page pinned.
+     */
+    void RemoveFile(FileId fid);
+
+    /*!
+     * Reads the page \p pid into \p buf directly from the disk.
+     */
+    void ReadPage(PageNumber pid, char *buf);
+
+    /*!
+     * Writes the page \p pid from \p buf directly to the disk.
+     */
+    void WritePage(PageNumber pid, const char *buf);
+
+    /*!
+     * Writes \p npages consecutive pages starting from \p first_pid, where
+     * the content of page \p first_pid + i is in \p bufs[i]. The pages are
+     * written with as few vectored writes as possible.
+     */
+    void WritePages(PageNumber first_pid, const char *const *bufs,
+                    size_t npages);
+
+    /*!
+     * Forces all the data files to be flushed to the disk.
+     */
+    void Flush();
+
+    /*!
+     * Returns the number of pages in the data files, including the meta
+     * pages and the free pages.
+     */
+    PageNumber GetNumPages() const {
+        return m_npages.load(memory_order_acquire);
+    }
+
+private:
+    /*!
+     * Returns the FSFile of the data file segment where page \p pid is
+     * stored.
+     */
+    FSFile *GetDataFile(PageNumber pid) const;
+
+    /*!
+     * Allocates a raw page from the free list or the end of the data files.
+     * Requires \p m_mutex to be held.
+     */
+    PageNumber AllocateRawPage();
+
+    /*!
+     * Extends the data files by \p npages consecutive raw pages, bypassing
+     * the free list, and returns the page number of the first one. Requires
+     * \p m_mutex to be held.
+     */
+    PageNumber ExtendDataFiles(PageNumber npages);
+
+    /*!
+     * Returns \p pid to the free list. Requires \p m_mutex to be held.
+     */
+    void FreeRawPage(PageNumber pid);
+
+    /*!
+     * Returns the meta page number of virtual file \p fid or \p INVALID_PID
+     * if it does not exist. Requires \p m_mutex to be held.
+     */
+    PageNumber GetVFileMetaPageNumber(FileId fid);
+
+    /*!
+     * Sets the meta page number of virtual file \p fid in the file
+     * directory. Requires \p m_mutex to be held.
+     */
+    void SetVFileMetaPageNumber(FileId fid, PageNumber meta_pid);
+
+    /*!
+     * Calls \p func with the content of page \p pid, through the buffer
+     * manager if there's one. All the pages other than the file manager
+     * meta page are accessed through this function. The caller must hold \p
+     * m_mutex.
+     *
+     * If \p latch is true, \p func is called with the frame latch held in
+     * exclusive mode. This is required when a page is allocated or freed, as
+     * a reader with a stale page number may still latch the page to find
+     * out whether it is still the page it's looking for. Hence, no one may
+     * call a function that frees a page while holding the latch of that
+     * page.
+     */
+    template<class Func>
+    void AccessPage(PageNumber pid, bool dirty, Func &&func,
+                    bool latch = false);
+
+    /*!
+     * Writes the in-memory copy of the file manager meta page to the disk.
+     */
+    void WriteMetaPage();
+
+    /*!
+     * Frees all the data pages and the meta page of a virtual file. Requires
+     * \p m_mutex to be held.
+     */
+    void RemoveFileImpl(FileId fid, PageNumber meta_pid);
+
+    std::string         m_datadir;
+    bool                m_initialized;
+
+    //! protects all the meta pages and the free list
+    std::mutex          m_mutex;
+
+    //! the number of pages in the data files
+    atomic<PageNumber>  m_npages;
+
+    //! the number of data file segments that are open
+    atomic<size_t>      m_ndatafiles;
+
+    //! the data file segments, indexed by segment number
+    std::unique_ptr<atomic<FSFile*>[]> m_datafiles;
+
+    //! head of the free page list
+    PageNumber          m_free_head;
+
+    //! the next file ID to be allocated
+    FileId              m_next_fid;
+
+    //! the page numbers of the file directory pages in order
+    std::vector<PageNumber> m_dir_pids;
+
+    friend class File;
+};
+
 }   // namespace taco
 
 #endif      // STORAGE_FILEMANAGER_H
@@ -0,0 +1,210 @@
+#ifndef STORAGE_FIXEDLENDATAPAGE_H
+#define STORAGE_FIXEDLENDATAPAGE_H
+
+#include "tdb.h"
+
+#include "storage/FileManager.h"
+#include "storage/Record.h"
+
+namespace taco {
+
+/*!
+ * The header of a fixed-length data page, which immediately follows the
+ * page header of the virtual file page.
+ */
+struct FixedlenDataPageHeader {
+    PageHeaderData  m_ph;
+
+    //! the length of the records on this page, a multiple of MAXALIGN_OF
+    FieldOffset     m_reclen;
+
+    //! the offset of the occupancy bitmap, which follows the user data area
+    FieldOffset     m_bitmap_begin;
+
+    //! the offset of the first record
+    FieldOffset     m_rec_begin;
+
+    //! the number of slots on the page
+    SlotId          m_nslots;
+
+    //! the number of occupied slots
+    SlotId          m_cnt;
+};
+
+/*!
+ * FixedlenDataPage is a dense page format for the records of the same
+ * length, i.e., the records of a schema with only non-nullable
+ * fixed-length fields. The page is an array of a fixed number of record
+ * slots, where slot \p sid is at `m_rec_begin + (sid - 1) * m_reclen'.
+ * Instead of a slot array, an occupancy bitmap with one bit per slot
+ * records which slots are occupied. Hence, a page holds a record for every
+ * `m_reclen + 1/8' bytes rather than every `m_reclen + 4' bytes on a
+ * VarlenDataPage, and never needs compaction.
+ *
+ * The bitmap is processed a 64-bit word at a time: a free slot is the
+ * first zero bit found in the words, and a scan visits the occupied slots
+ * by extracting the set bits of each word, without testing every slot.
+ *
+ * The interface is the same as VarlenDataPage except that the page must be
+ * initialized with the record length. A FixedlenDataPage does not own the
+ * page buffer and it is not thread-safe.
+ */
+class FixedlenDataPage {
+public:
+    /*!
+     * Initializes an empty page in \p pagebuf for records of length
+     * \p reclen, with a user data area of \p usr_data_sz bytes right after
+     * the page header. The page header data must have already been
+     * initialized by the file manager.
+     *
+     * It is an error if not even one record fits on the page.
+     */
+    static void Initialize(char *pagebuf, FieldOffset reclen,
+                           FieldOffset usr_data_sz = 0);
+
+    /*!
+     * Returns the number of records of length \p reclen that fit on a page
+     * with a user data area of \p usr_data_sz bytes.
+     */
+    static SlotId ComputeCapacity(FieldOffset reclen,
+                                  FieldOffset usr_data_sz = 0);
+
+    /*!
+     * Returns the number of free bytes, as in ComputeFreeSpace(), that is
+     * enough for inserting a record of length \p reclen.
+     */
+    static size_t
+    ComputeSpaceNeeded(FieldOffset reclen) {
+        return reclen;
+    }
+
+    FixedlenDataPage(char *pagebuf):
+        m_pagebuf(pagebuf) {}
+
+    /*!
+     * Returns the user data area of the page.
+     */
+    char*
+    GetUserData() const {
+        return m_pagebuf + MAXALIGN(sizeof(FixedlenDataPageHeader));
+    }
+
+    /*!
+     * Returns the length of the records on this page.
+     */
+    FieldOffset
+    GetRecordLength() const {
+        return GetHeader()->m_reclen;
+    }
+
+    /*!
+     * Inserts the record \p rec into the first free slot on the page by
+     * copying its content once into the page, and sets the slot ID of its
+     * record ID on success. Leaves \p rec unchanged and returns false if the
+     * page is full.
+     *
+     * It is an error if the record length is not GetRecordLength().
+     */
+    bool InsertRecord(Record &rec);
+
+    /*!
+     * Allocates a free slot for a new record, so that the caller may encode
+     * the record directly into the page. Returns the uninitialized space of
+     * GetRecordLength() bytes in the slot and sets the slot ID in \p *p_sid,
+     * or returns nullptr if the page is full.
+     */
+    char *AllocateRecord(SlotId *p_sid);
+
+    /*!
+     * Erases the record in slot \p sid. Returns false if the slot is not
+     * occupied.
+     */
+    bool EraseRecord(SlotId sid);
+
+    /*!
+     * Replaces the record in slot \p sid with \p rec in place, and sets the
+     * record ID of \p rec to the same slot. It always succeeds unless it is
+     * an error: the slot is not occupied or the record length is not
+     * GetRecordLength().
+     */
+    bool UpdateRecord(SlotId sid, Record &rec);
+
+    /*!
+     * Returns the record in slot \p sid and its length in \p *p_reclen if
+     * not null, or nullptr if the slot is not occupied. The returned
+     * pointer points into the page.
+     */
+    const char *GetRecordBuf(SlotId sid, FieldOffset *p_reclen = nullptr) const;
+
+    /*!
+     * Returns whether the slot \p sid is occupied.
+     */
+    bool
+    IsOccupied(SlotId sid) const {
+        if (sid < MinSlotId || sid > GetHeader()->m_nslots)
+            return false;
+        SlotId i = sid - MinSlotId;
+        return (GetBitmap()[i >> 6] >> (i & 63)) & 1;
+    }
+
+    /*!
+     * Returns the smallest occupied slot ID greater than \p sid, or
+     * INVALID_SID if there's none.
+     */
+    SlotId GetNextOccupiedSlot(SlotId sid) const;
+
+    constexpr SlotId
+    GetMinSlotId() const {
+        return MinSlotId;
+    }
+
+    /*!
+     * Returns the maximum slot ID on the page, which is the same for all
+     * the pages of the same record length.
+     */
+    SlotId
+    GetMaxSlotId() const {
+        return GetHeader()->m_nslots;
+    }
+
+    /*!
+     * Returns the number of records on the page.
+     */
+    SlotId
+    GetRecordCount() const {
+        return GetHeader()->m_cnt;
+    }
+
+    /*!
+     * Returns the number of free bytes on the page, i.e., the total length
+     * of the free slots.
+     */
+    FieldOffset
+    ComputeFreeSpace() const {
+        return (FieldOffset)((GetHeader()->m_nslots - GetHeader()->m_cnt) *
+                             GetHeader()->m_reclen);
+    }
+
+private:
+    FixedlenDataPageHeader*
+    GetHeader() const {
+        return (FixedlenDataPageHeader*) m_pagebuf;
+    }
+
+    uint64_t*
+    GetBitmap() const {
+        return (uint64_t*)(m_pagebuf + GetHeader()->m_bitmap_begin);
+    }
+
+    char*
+    GetRecordPtr(SlotId sid) const {
+        return m_pagebuf + GetHeader()->m_rec_begin +
+            (size_t)(sid - MinSlotId) * GetHeader()->m_reclen;
+    }
+
+    char    *m_pagebuf;
+};
+
+}   // namespace taco
+
+#endif      // STORAGE_FIXEDLENDATAPAGE_H
@@ -0,0 +1,171 @@
+#ifndef STORAGE_FREESPACEMAP_H
+#define STORAGE_FREESPACEMAP_H
+
+#include "tdb.h"
+
+#include <mutex>
+
+#include "storage/FileManager.h"
+
+namespace taco {
+
+/*!
+ * The header of a free-space map page, which immediately follows the page
+ * header of the virtual file page. It is followed by an array of the page
+ * numbers of the mapped pages, and an array of their 4-bit free-space
+ * categories.
+ */
+struct FreeSpaceMapPageHeader {
+    PageHeaderData  m_ph;
+
+    //! the number of entries on this page
+    uint16_t        m_cnt;
+
+    //! an upper bound of the categories on this page
+    uint8_t         m_max_cat;
+};
+
+/*!
+ * FreeSpaceMap records roughly how much free space each data page of a
+ * heap file has, so that an insertion finds a page with enough room without
+ * visiting the pages. It is stored in its own virtual file.
+ *
+ * Each mapped page has an entry with a dense index assigned when it is
+ * added to the map, which the caller remembers for updating the entry
+ * later. The entries are in the order the pages are added. An entry holds
+ * the page number and a 4-bit free-space category: a page in category \p c
+ * has at least `c * CategoryStep' free bytes. Each map page also keeps an
+ * upper bound of its categories, so that a search skips the map pages
+ * without enough free space for the request.
+ *
+ * The categories are only hints: the caller must check if the page it
+ * found really has enough space, and correct its category if it does not.
+ *
+ * All the functions are thread-safe.
+ */
+class FreeSpaceMap {
+public:
+    //! the number of free bytes per category
+    static constexpr size_t CategoryStep = PAGE_SIZE / 16;
+
+    //! the maximum category
+    static constexpr uint8_t MaxCategory = 15;
+
+    //! the number of entries on a map page
+    static constexpr size_t EntriesPerPage =
+        (PAGE_SIZE - MAXALIGN(sizeof(FreeSpaceMapPageHeader))) * 2 /
+        (2 * sizeof(PageNumber) + 1);
+
+    /*!
+     * Creates an empty free-space map in a new virtual file and returns its
+     * file ID.
+     */
+    static FileId Create();
+
+    /*!
+     * Opens the free-space map in the virtual file \p fid.
+     */
+    FreeSpaceMap(FileId fid);
+
+    FileId
+    GetFileId() const {
+        return m_file->GetFileId();
+    }
+
+    /*!
+     * Returns the category of a page with \p free_space free bytes.
+     */
+    static uint8_t
+    ComputeCategory(size_t free_space) {
+        return (uint8_t) std::min(free_space / CategoryStep,
+                                  (size_t) MaxCategory);
+    }
+
+    /*!
+     * Returns the minimum category of the pages that are known to have
+     * \p needed free bytes, or MaxCategory if it is more than that.
+     */
+    static uint8_t
+    ComputeMinCategory(size_t needed) {
+        return (uint8_t) std::min((needed + CategoryStep - 1) / CategoryStep,
+                                  (size_t) MaxCategory);
+    }
+
+    /*!
+     * Adds the page \p pid in category \p cat to the map and returns the
+     * index of its entry.
+     */
+    uint32_t AddPage(PageNumber pid, uint8_t cat);
+
+    /*!
+     * Removes the page of the entry \p idx from the map. The entry stays
+     * with an invalid page number, so the indexes of the other entries do
+     * not change.
+     */
+    void RemovePage(uint32_t idx);
+
+    /*!
+     * Returns the page number of the entry \p idx, or INVALID_PID if the
+     * page has been removed.
+     */
+    PageNumber GetPageNumber(uint32_t idx);
+
+    /*!
+     * Sets the category of the entry \p idx to \p cat, unless its page has
+     * been removed.
+     */
+    void UpdateCategory(uint32_t idx, uint8_t cat);
+
+    /*!
+     * Returns the category of the entry \p idx.
+     */
+    uint8_t GetCategory(uint32_t idx);
+
+    /*!
+     * Finds a page in a category of at least \p min_cat, starting from the
+     * entry \p start and wrapping around at the end. Returns its page number
+     * and sets its entry index in \p *p_idx, or returns INVALID_PID if
+     * there's none.
+     */
+    PageNumber Search(uint8_t min_cat, uint32_t start, uint32_t *p_idx);
+
+    /*!
+     * Returns the number of entries in the map.
+     */
+    uint32_t
+    GetNumEntries() const {
+        return m_nentries.load(memory_order_acquire);
+    }
+
+private:
+    /*!
+     * Returns the page number of the map page \p i.
+     */
+    PageNumber
+    GetMapPageNumber(size_t i) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_map_pids[i];
+    }
+
+    /*!
+     * Searches the map page \p i from its entry \p begin up to but not
+     * including entry \p end.
+     */
+    PageNumber SearchMapPage(size_t i, uint16_t begin, uint16_t end,
+                             uint8_t min_cat, uint32_t *p_idx);
+
+    std::unique_ptr<File> m_file;
+
+    //! protects m_map_pids and serializes AddPage()
+    std::mutex          m_mutex;
+
+    //! the page numbers of the map pages in order
+    std::vector<PageNumber> m_map_pids;
+
+    //! the number of entries in the map
+    atomic<uint32_t>    m_nentries;
+};
+
+}   // namespace taco
+
+#endif      // STORAGE_FREESPACEMAP_H
@@ -0,0 +1,357 @@
+#ifndef STORAGE_PAXDATAPAGE_H
+#define STORAGE_PAXDATAPAGE_H
+
+#include "tdb.h"
+
+#include "catalog/PayloadCodec.h"
+#include "catalog/Schema.h"
+#include "storage/FileManager.h"
+#include "storage/Record.h"
+
+namespace taco {
+
+/*!
+ * The header of a PAX data page, which immediately follows the page header
+ * of the virtual file page.
+ */
+struct PaxDataPageHeader {
+    PageHeaderData  m_ph;
+
+    //! the number of columns
+    FieldId         m_ncols;
+
+    //! the number of slots on the page
+    SlotId          m_nslots;
+
+    //! the number of occupied slots
+    SlotId          m_cnt;
+
+    //! the total length of the minipage values of a slot
+    FieldOffset     m_slot_sz;
+
+    //! the offset of the minipage directory, which follows the user data area
+    FieldOffset     m_dir_begin;
+
+    //! the offset of the occupancy bitmap
+    FieldOffset     m_bitmap_begin;
+
+    //! the offset of the heap of the variable-length values, which follows
+    //! the minipages
+    FieldOffset     m_heap_begin;
+
+    //! the heap is free up to this offset, and the values are after it
+    FieldOffset     m_heap_free_end;
+
+    //! the total length of the erased values in the heap
+    FieldOffset     m_heap_garbage;
+};
+
+/*!
+ * A minipage directory entry of a PAX data page.
+ */
+struct PaxMinipage {
+    //! the offset of the values of the column
+    FieldOffset     m_begin;
+
+    //! the offset of the null bitmap of the column, or 0 if the column is
+    //! not nullable
+    FieldOffset     m_null_begin;
+};
+
+/*!
+ * The value of a variable-length column in its minipage, which points to the
+ * bytes in the heap. As in the varlen field end array of a record payload,
+ * the most significant bit of \p m_len marks a value stored out of line.
+ */
+struct PaxVarlenValue {
+    FieldOffset     m_off;
+    FieldOffset     m_len;
+
+    FieldOffset
+    GetLength() const {
+        return (FieldOffset)((uint16_t) m_len &
+                             ~Schema::VarlenEndExternalBit);
+    }
+
+    bool
+    IsExternal() const {
+        return (uint16_t) m_len & Schema::VarlenEndExternalBit;
+    }
+};
+
+/*!
+ * PaxDataPage is a page format that stores the records of a schema in the
+ * PAX (Partition Attributes Across) layout. The values of each column are
+ * grouped together in a minipage with its own null bitmap, so a scan that
+ * only accesses a few columns of a wide table only touches the cache lines
+ * of those columns. A record is still identified by the slot ID on the page
+ * as in the row-wise data pages, and the value of slot \p sid in a
+ * fixed-length column is at `m_begin + (sid - 1) * typlen' of its minipage.
+ * The minipage of a variable-length column stores an offset and a length
+ * of the value (see PaxVarlenValue), which is in a heap at the end of the
+ * page.
+ *
+ * The number of slots is fixed for a schema when the page is initialized,
+ * assuming each variable-length value takes about VarlenFieldEstimate bytes.
+ * A page is full if either all the slots are occupied or the heap does not
+ * have enough space for the variable-length values of a new record.
+ *
+ * The records are passed in and out in the row-wise payload format of the
+ * schema, as in the other data pages, but they are copied into or out of the
+ * minipages rather than in place. A PaxDataPage does not own the page buffer
+ * and it is not thread-safe.
+ */
+class PaxDataPage {
+public:
+    //! the estimated average length of a variable-length value
+    static constexpr size_t VarlenFieldEstimate = 32;
+
+    /*!
+     * Initializes an empty page in \p pagebuf for the records of the schema
+     * \p schema, with a user data area of \p usr_data_sz bytes right after
+     * the page header. The page header data must have already been
+     * initialized by the file manager.
+     *
+     * It is an error if not even one record fits on the page.
+     */
+    static void Initialize(char *pagebuf, const Schema *schema,
+                           FieldOffset usr_data_sz = 0);
+
+    /*!
+     * Returns the number of slots of a page of the schema \p schema with a
+     * user data area of \p usr_data_sz bytes.
+     */
+    static SlotId ComputeCapacity(const Schema *schema,
+                                  FieldOffset usr_data_sz = 0);
+
+    /*!
+     * Returns the size of the heap of an empty page of the schema \p schema
+     * with a user data area of \p usr_data_sz bytes, which is the max total
+     * length of the variable-length values of a record.
+     */
+    static FieldOffset ComputeHeapSize(const Schema *schema,
+                                       FieldOffset usr_data_sz = 0);
+
+    /*!
+     * Returns the heap space needed for the variable-length values of the
+     * record payload \p payload of the schema \p schema, including the
+     * alignment padding.
+     */
+    static size_t ComputeVarlenLength(const Schema *schema,
+                                      const char *payload);
+
+    /*!
+     * Returns the number of free bytes, as in ComputeFreeSpace(), that is
+     * enough for inserting the record payload \p payload of the schema
+     * \p schema, i.e., the length of the minipage values of a slot plus
+     * ComputeVarlenLength().
+     */
+    static size_t ComputeSpaceNeeded(const Schema *schema,
+                                     const char *payload);
+
+    /*!
+     * Wraps the page in \p pagebuf with the records of the schema \p schema,
+     * which must be the one the page was initialized with. The records are
+     * encoded and deformed with \p codec, the payload codec of the schema,
+     * if it is not null.
+     */
+    PaxDataPage(char *pagebuf, const Schema *schema,
+                const PayloadCodec *codec = nullptr):
+        m_pagebuf(pagebuf),
+        m_schema(schema),
+        m_codec(codec) {}
+
+    /*!
+     * Returns the user data area of the page.
+     */
+    char*
+    GetUserData() const {
+        return m_pagebuf + MAXALIGN(sizeof(PaxDataPageHeader));
+    }
+
+    /*!
+     * Inserts the record \p rec into the first free slot on the page by
+     * copying its fields into the minipages, and sets the slot ID of its
+     * record ID on success. Leaves \p rec unchanged and returns false if the
+     * page is full.
+     */
+    bool InsertRecord(Record &rec);
+
+    /*!
+     * Erases the record in slot \p sid. Returns false if the slot is not
+     * occupied.
+     */
+    bool EraseRecord(SlotId sid);
+
+    /*!
+     * Replaces the record in slot \p sid with \p rec, and sets the record ID
+     * of \p rec to the same slot. Leaves the page unchanged and returns false
+     * if the variable-length values of the new record do not fit on the
+     * page. It is an error if the slot is not occupied.
+     */
+    bool UpdateRecord(SlotId sid, Record &rec);
+
+    /*!
+     * Reconstructs the record in slot \p sid in the row-wise payload format
+     * into \p buf, overwriting its content. Returns false if the slot is not
+     * occupied.
+     */
+    bool GetRecord(SlotId sid, maxaligned_char_buf &buf) const;
+
+    /*!
+     * Returns the field \p field_id of the record in slot \p sid, which
+     * references the page. The slot must be occupied.
+     */
+    Datum GetField(SlotId sid, FieldId field_id) const;
+
+    /*!
+     * Returns whether the field \p field_id of the record in slot \p sid is
+     * null.
+     */
+    bool
+    FieldIsNull(SlotId sid, FieldId field_id) const {
+        const PaxMinipage *mp = GetMinipage(field_id);
+        if (mp->m_null_begin == 0)
+            return false;
+        SlotId i = sid - MinSlotId;
+        return (m_pagebuf[mp->m_null_begin + (i >> 3)] >> (i & 7)) & 1;
+    }
+
+    /*!
+     * Returns whether the non-null variable-length field \p field_id of the
+     * record in slot \p sid is stored out of line.
+     */
+    bool
+    FieldIsExternal(SlotId sid, FieldId field_id) const {
+        ASSERT(m_schema->GetFieldLength(field_id) == -1);
+        return ((const PaxVarlenValue*)(m_pagebuf +
+                                        GetMinipage(field_id)->m_begin) +
+                (sid - MinSlotId))->IsExternal();
+    }
+
+    /*!
+     * Returns the minipage of the fixed-length column \p field_id, i.e., the
+     * array of the values of all the slots. The value of a null field is
+     * undefined.
+     */
+    const char*
+    GetFixedlenColumn(FieldId field_id) const {
+        ASSERT(m_schema->GetFieldLength(field_id) > 0);
+        return m_pagebuf + GetMinipage(field_id)->m_begin;
+    }
+
+    /*!
+     * Returns whether the slot \p sid is occupied.
+     */
+    bool
+    IsOccupied(SlotId sid) const {
+        if (sid < MinSlotId || sid > GetHeader()->m_nslots)
+            return false;
+        SlotId i = sid - MinSlotId;
+        return (GetBitmap()[i >> 6] >> (i & 63)) & 1;
+    }
+
+    /*!
+     * Returns the smallest occupied slot ID greater than \p sid, or
+     * INVALID_SID if there's none.
+     */
+    SlotId GetNextOccupiedSlot(SlotId sid) const;
+
+    constexpr SlotId
+    GetMinSlotId() const {
+        return MinSlotId;
+    }
+
+    /*!
+     * Returns the maximum slot ID on the page, which is the same for all
+     * the pages of the same schema.
+     */
+    SlotId
+    GetMaxSlotId() const {
+        return GetHeader()->m_nslots;
+    }
+
+    /*!
+     * Returns the number of records on the page.
+     */
+    SlotId
+    GetRecordCount() const {
+        return GetHeader()->m_cnt;
+    }
+
+    /*!
+     * Returns the number of free bytes on the page, i.e., the length of the
+     * minipage values of a slot plus the free and erased space in the heap,
+     * or 0 if there's no free slot. This is the space of the next record
+     * only, so a record fits on the page if and only if its
+     * ComputeSpaceNeeded() is no more than that.
+     */
+    FieldOffset
+    ComputeFreeSpace() const {
+        const PaxDataPageHeader *hdr = GetHeader();
+        if (hdr->m_cnt == hdr->m_nslots)
+            return 0;
+        return (FieldOffset)(hdr->m_slot_sz + hdr->m_heap_free_end -
+                             hdr->m_heap_begin + hdr->m_heap_garbage);
+    }
+
+    /*!
+     * Moves all the variable-length values of the occupied slots to the end
+     * of the page so that all the erased space in the heap is free.
+     */
+    void Compact();
+
+    /*!
+     * Returns whether the heap has no erased space, i.e., Compact() would
+     * not reclaim anything.
+     */
+    bool
+    IsCompact() const {
+        return GetHeader()->m_heap_garbage == 0;
+    }
+
+private:
+    /*!
+     * Returns the end of the minipages of a page of the schema \p schema
+     * with \p nslots slots, if the minipage directory begins at \p dir_begin.
+     */
+    static size_t ComputeMinipageEnd(const Schema *schema, size_t dir_begin,
+                                     size_t nslots);
+
+    PaxDataPageHeader*
+    GetHeader() const {
+        return (PaxDataPageHeader*) m_pagebuf;
+    }
+
+    PaxMinipage*
+    GetMinipage(FieldId field_id) const {
+        return ((PaxMinipage*)(m_pagebuf + GetHeader()->m_dir_begin)) +
+            field_id;
+    }
+
+    uint64_t*
+    GetBitmap() const {
+        return (uint64_t*)(m_pagebuf + GetHeader()->m_bitmap_begin);
+    }
+
+    /*!
+     * Copies the fields of the record payload \p payload into slot index
+     * \p idx of the minipages. The heap must have enough free space for the
+     * variable-length values.
+     */
+    void WriteFields(SlotId idx, const char *payload);
+
+    /*!
+     * Counts the variable-length values of slot index \p idx in the heap as
+     * erased.
+     */
+    void EraseVarlenValues(SlotId idx);
+
+    char            *m_pagebuf;
+    const Schema    *m_schema;
+    const PayloadCodec *m_codec;
+};
+
+}   // namespace taco
+
+#endif      // STORAGE_PAXDATAPAGE_H
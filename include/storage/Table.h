@@ -0,0 +1,873 @@
+#ifndef STORAGE_TABLE_H
+#define STORAGE_TABLE_H
+
+#include "tdb.h"
+
+#include <chrono>
+#include <mutex>
+
+#include "catalog/BatchPayloadEncoder.h"
+#include "catalog/TableDesc.h"
+#include "storage/BufferManager.h"
+#include "storage/FileManager.h"
+#include "storage/FreeSpaceMap.h"
+#include "storage/Record.h"
+#include "storage/ToastFile.h"
+#include "storage/ZoneMap.h"
+
+namespace taco {
+
+class PaxDataPage;
+
+/*!
+ * Table is a heap file of a table, which stores the records of the table in
+ * the data pages of the virtual file \p tabfid recorded in the table's
+ * catalog entry. The pages are the slotted VarlenDataPage if \p tabisvarlen
+ * is true in the catalog entry, or the dense FixedlenDataPage otherwise,
+ * unless \p tablayout is TABLAYOUT_PAX, in which case they are the
+ * column-grouped PaxDataPage.
+ * All the page accesses go through the buffer manager. A record is
+ * identified by its record ID `(PageNumber, SlotId)', which stays the same
+ * until the record is erased, or moved to another page by an update that
+ * does not fit on its page.
+ *
+ * An insertion copies the record once from the caller's buffer into the
+ * page. A scan does not copy the records at all: the iterator returns the
+ * records in place in the pinned pages, except that the records on a
+ * PaxDataPage are reconstructed one at a time into a buffer of the iterator
+ * when they are asked for.
+ *
+ * An insertion picks a page through the per-thread hint of the last page
+ * the thread inserted into, or through the free-space map of the table
+ * (see FreeSpaceMap) if that page is full, and only appends a new page if
+ * no page has enough free space. Hence, concurrent inserting threads tend
+ * to insert into different pages. The file ID of the free-space map is
+ * stored in the user data area of the first page, while every page stores
+ * the index of its entry in the free-space map in its user data area.
+ *
+ * The insertions also maintain a zone map of the table (see ZoneMap) over
+ * the groups of consecutive pages in the order of their free-space map
+ * entries, which is also stored in its own file. A range scan skips the
+ * page groups whose zones do not overlap with the range.
+ *
+ * A table with variable-length fields has a toast file (see ToastFile),
+ * where Insert() moves the largest variable-length values of a record until
+ * it is no longer than ToastThreshold, leaving a ToastPointer in the
+ * record. Such a value is only read when the field is read through
+ * GetField(), so a scan that does not read it never touches the toast file.
+ * The out-of-line values of a record are deleted when the record is erased,
+ * or when an update replaces them.
+ *
+ * The space of the erased records is reclaimed by a vacuum (see
+ * ParallelVacuum), which compacts the pages and returns the empty ones to
+ * the file manager.
+ *
+ * InsertRecord(), EraseRecord(), UpdateRecord() and a vacuum may be called
+ * concurrently on the same Table object, as they modify the pages under the
+ * frame latches. A scan must not run concurrently with any modification of
+ * the table.
+ */
+class Table {
+public:
+    class Iterator;
+    class RecordBatch;
+    class BulkLoader;
+    class ParallelScan;
+    class RangeScan;
+    class ParallelVacuum;
+
+    //! the length of an encoded record above which Insert() stores its
+    //! largest variable-length values out of line
+    static constexpr FieldOffset ToastThreshold = PAGE_SIZE / 4;
+
+    /*!
+     * Initializes the empty heap file of the new table \p tabdesc, which
+     * must have just been created by the file manager.
+     */
+    static void Initialize(const TableDesc *tabdesc);
+
+    /*!
+     * Opens the heap file of the table \p tabdesc.
+     */
+    static std::unique_ptr<Table> Create(
+        std::shared_ptr<const TableDesc> tabdesc);
+
+    ~Table();
+
+    const TableDesc*
+    GetTableDesc() const {
+        return m_tabdesc.get();
+    }
+
+    /*!
+     * Inserts the record \p rec into the table and sets its record ID. If
+     * the record is longer than ToastThreshold, its largest variable-length
+     * values are stored out of line as in Insert(), while \p rec itself is
+     * left as it is.
+     *
+     * It is an error if the record is still too long to fit on an empty
+     * page.
+     */
+    void InsertRecord(Record &rec);
+
+    /*!
+     * Encodes a record with the fields in \p data, storing its largest
+     * variable-length values out of line if it is longer than
+     * ToastThreshold, inserts it into the table and returns its record ID.
+     *
+     * It is an error if the record is still too long to fit on an empty
+     * page.
+     */
+    RecordId Insert(const std::vector<Datum> &data);
+
+    /*!
+     * See Insert(const std::vector<Datum>&).
+     */
+    RecordId Insert(const std::vector<NullableDatumRef> &data);
+
+    /*!
+     * Returns the field \p field_id of the record payload \p payload of this
+     * table. A value stored out of line is read from the toast file into a
+     * Datum that owns its bytes, and any other value references the
+     * payload as in Schema::GetField().
+     */
+    Datum GetField(FieldId field_id, const char *payload) const;
+
+    /*!
+     * Erases the record \p rid from the table. It is an error if \p rid does
+     * not exist.
+     */
+    void EraseRecord(RecordId rid);
+
+    /*!
+     * Replaces the record \p rid with \p rec, storing its long values out
+     * of line as in InsertRecord(). The record is updated in place if it
+     * fits on the same page, or otherwise erased and inserted into another
+     * page. In either case, the record ID of \p rec is set to the new
+     * record ID of the record. It is an error if \p rid does not exist.
+     */
+    void UpdateRecord(RecordId rid, Record &rec);
+
+    /*!
+     * Returns an iterator positioned before the first record of the table.
+     */
+    Iterator StartScan();
+
+    /*!
+     * Returns an iterator positioned before the first record with a record
+     * ID that is not less than \p rid in the scan order. \p rid.pid must be
+     * a page of this table.
+     */
+    Iterator StartScanFrom(RecordId rid);
+
+    /*!
+     * Starts a parallel scan of this table that hands out morsels of
+     * \p morsel_npages pages. See ParallelScan.
+     */
+    std::unique_ptr<ParallelScan> StartParallelScan(
+        uint32_t morsel_npages = 64);
+
+    /*!
+     * Starts a scan of the records of this table whose field \p field_id is
+     * not null and in the range [\p lo, \p hi], where a null bound means
+     * unbounded. See RangeScan.
+     *
+     * It is an error if the type of the field does not have a `<' operator.
+     */
+    std::unique_ptr<RangeScan> StartRangeScan(FieldId field_id,
+                                              const Datum &lo,
+                                              const Datum &hi);
+
+    /*!
+     * Starts a vacuum of this table that hands out morsels of
+     * \p morsel_npages pages and visits at most \p max_pages_per_sec pages
+     * per second, or any number of pages if it is 0. See ParallelVacuum.
+     */
+    std::unique_ptr<ParallelVacuum> StartVacuum(
+        uint32_t morsel_npages = 64, uint32_t max_pages_per_sec = 0);
+
+    /*!
+     * Starts a bulk load of this table with a private buffer of \p nbufpages
+     * pages. See BulkLoader.
+     */
+    std::unique_ptr<BulkLoader> StartBulkLoad(PageNumber nbufpages = 256);
+
+    /*!
+     * An iterator over the records of a table in the order of the pages in
+     * the file and the slot IDs on the page. The iterator holds a pin on the
+     * current page until it moves off the page or the scan ends. A record
+     * returned by GetCurrentRecord() points into the pinned page and is only
+     * valid until the next call to Next() or EndScan().
+     *
+     * On a PAX table, a record is only reconstructed in the row-wise format
+     * when GetCurrentRecord() is called, so a scan that reads its fields
+     * with GetField() only touches the minipages of those fields.
+     */
+    class Iterator {
+    public:
+        Iterator():
+            m_table(nullptr),
+            m_end_pid(INVALID_PID),
+            m_cur_deferred(false) {}
+
+        Iterator(Iterator&&) = default;
+        Iterator &operator=(Iterator&&) = default;
+
+        Table*
+        GetTable() const {
+            return m_table;
+        }
+
+        /*!
+         * Moves to the next record and returns true, or returns false and
+         * ends the scan if there's no more record.
+         */
+        bool Next();
+
+        /*!
+         * Returns whether the iterator is on a record, i.e., the last call
+         * to Next() returned true.
+         */
+        bool
+        IsAtValidRecord() const {
+            return m_cur.IsValid() || m_cur_deferred;
+        }
+
+        /*!
+         * Returns the current record.
+         */
+        const Record&
+        GetCurrentRecord() const {
+            if (m_cur_deferred)
+                LoadDeferredRecord();
+            return m_cur;
+        }
+
+        /*!
+         * Returns the field \p field_id of the current record as
+         * Table::GetField() does. A value that is not stored out of line
+         * references the pinned page, and is only valid until the next call
+         * to Next() or EndScan(). On a PAX table, the value is read from its
+         * minipage without reconstructing the record.
+         */
+        Datum GetField(FieldId field_id) const;
+
+        /*!
+         * Returns the record ID of the current record.
+         */
+        RecordId
+        GetCurrentRecordId() const {
+            return m_cur.GetRecordId();
+        }
+
+        /*!
+         * Moves past up to `batch->GetCapacity()' records and returns them
+         * in \p batch, after releasing the pins held by its previous
+         * contents. Returns the number of records in the batch, which is
+         * less than the capacity only if the scan has ended. The records
+         * stay valid until \p batch is cleared, refilled or destroyed, even
+         * if the scan ends earlier, as the batch holds its own pins on all
+         * the pages its records are on.
+         *
+         * After that, the iterator is not on a record, and the next call to
+         * Next() or NextBatch() continues after the last record in the
+         * batch.
+         */
+        size_t NextBatch(RecordBatch *batch);
+
+        /*!
+         * Ends the scan and releases the pin on the current page.
+         */
+        void EndScan();
+
+    private:
+        Iterator(Table *table, BufferId bufid, RecordId rid,
+                 PageNumber end_pid = INVALID_PID);
+
+        template<class DataPage> bool NextImpl();
+
+        /*!
+         * Points the current record to slot `m_cur.GetRecordId().sid' of
+         * \p dp, or defers it until GetCurrentRecord() on a PAX page.
+         */
+        template<class DataPage> void SetCurrentRecord(const DataPage &dp);
+        void SetCurrentRecord(const PaxDataPage &dp);
+
+        /*!
+         * Reconstructs the deferred current record on a PAX page.
+         */
+        void LoadDeferredRecord() const;
+
+        template<class DataPage> void NextBatchImpl(RecordBatch *batch);
+
+        Table           *m_table;
+
+        //! the buffer of the current record if it is not stored row-wise
+        mutable maxaligned_char_buf m_recbuf;
+
+        //! the current page, or invalid if the scan has ended
+        ScopedBufferId  m_bufid;
+
+        //! the page where the scan ends, which is not scanned
+        PageNumber      m_end_pid;
+
+        //! the read-ahead state of this scan
+        ReadAheadState  m_readahead;
+
+        //! the current record, whose record ID is the current position even
+        //! if it is not valid
+        mutable Record  m_cur;
+
+        //! whether the iterator is on a PAX record that has not been
+        //! reconstructed into m_recbuf yet
+        mutable bool    m_cur_deferred;
+
+        friend class Table;
+    };
+
+    /*!
+     * A RecordBatch is a caller-owned array of up to a fixed number of
+     * records filled by Iterator::NextBatch(). Each record is a view with
+     * the pointer, the length and the record ID of a record on a page that
+     * the batch keeps pinned, or of a record reconstructed
+     * into a buffer of the batch if it is not stored row-wise. A batch may
+     * be reused across calls without any allocation once its buffers have
+     * grown to the size of the records.
+     *
+     * A batch pins all the pages its records are on, so its capacity
+     * should be small compared to the buffer pool if the records are large.
+     */
+    class RecordBatch {
+    public:
+        //! the default number of records in a batch
+        static constexpr size_t DefaultCapacity = 1024;
+
+        explicit RecordBatch(size_t capacity = DefaultCapacity);
+
+        RecordBatch(RecordBatch&&) = default;
+        RecordBatch &operator=(RecordBatch&&) = default;
+
+        size_t
+        GetCapacity() const {
+            return m_recs.size();
+        }
+
+        size_t
+        GetNumRecords() const {
+            return m_nrecs;
+        }
+
+        /*!
+         * Returns the \p i-th record in the batch.
+         */
+        const Record&
+        GetRecord(size_t i) const {
+            ASSERT(i < m_nrecs);
+            return m_recs[i];
+        }
+
+        /*!
+         * Returns the array of the GetNumRecords() records in the batch.
+         */
+        const Record*
+        GetRecords() const {
+            return m_recs.data();
+        }
+
+        /*!
+         * Removes all the records and releases the pins held by the batch.
+         */
+        void Clear();
+
+    private:
+        std::vector<Record> m_recs;
+
+        size_t              m_nrecs;
+
+        //! the pins on the pages of the records
+        std::vector<ScopedBufferId> m_pins;
+
+        //! the buffers of the records that are not stored row-wise, one per
+        //! record, which are only used on a PAX table
+        std::vector<maxaligned_char_buf> m_recbufs;
+
+        friend class Table;
+    };
+
+    /*!
+     * A ParallelScan splits a scan of the table into morsels of a fixed
+     * number of consecutive pages, which are handed out to any number of
+     * worker threads through an atomic cursor. A worker scans a morsel
+     * with an ordinary Iterator, which follows the page chain from the
+     * first page of the morsel up to the first page of the next one, so
+     * the workers never visit the same page. Because the pages are added to
+     * the free-space map in the same order as they are linked into the
+     * file, the first page of each morsel is looked up in the free-space
+     * map rather than found by walking the chain.
+     *
+     * Each worker gets the records of its morsels as a stream and is
+     * responsible for merging its results with the others'. The pages
+     * appended after the scan has started are not scanned. As with
+     * Iterator, no modification of the table may run concurrently with the
+     * scan.
+     */
+    class ParallelScan {
+    public:
+        /*!
+         * Positions \p *iter before the first record of the next morsel
+         * that has not been handed out and returns true, or returns false
+         * if there's no more morsel. The caller calls \p iter->Next() until
+         * it returns false, and then asks for the next morsel.
+         */
+        bool NextMorsel(Iterator *iter);
+
+    private:
+        ParallelScan(Table *table, uint32_t morsel_npages);
+
+        Table               *m_table;
+
+        uint32_t            m_morsel_npages;
+
+        //! the number of free-space map entries when the scan starts
+        uint32_t            m_nentries;
+
+        //! the next morsel to hand out
+        atomic<uint32_t>    m_next_morsel;
+
+        friend class Table;
+    };
+
+    /*!
+     * A RangeScan returns the records of a table with a field in a range.
+     * It scans the page groups of the zone map one at a time as in
+     * ParallelScan, skipping the ones whose zone of the field does not
+     * overlap with the range, and filters the records of the other groups
+     * with the `<' operator of the field type. The fields without a zone
+     * are still filtered, but no page group is skipped.
+     *
+     * As with Iterator, no modification of the table may run concurrently
+     * with the scan.
+     */
+    class RangeScan {
+    public:
+        /*!
+         * Moves to the next record in the range and returns true, or
+         * returns false and ends the scan if there's no more record.
+         */
+        bool Next();
+
+        const Record&
+        GetCurrentRecord() const {
+            return m_iter.GetCurrentRecord();
+        }
+
+        RecordId
+        GetCurrentRecordId() const {
+            return m_iter.GetCurrentRecordId();
+        }
+
+        /*!
+         * Returns the number of page groups skipped so far.
+         */
+        uint32_t
+        GetNumSkippedGroups() const {
+            return m_nskipped;
+        }
+
+        /*!
+         * Ends the scan and releases the pin on the current page.
+         */
+        void EndScan();
+
+    private:
+        RangeScan(Table *table, FieldId field_id, Datum lo, Datum hi,
+                  FunctionInfo lt_func);
+
+        /*!
+         * Returns whether the current record is in the range.
+         */
+        bool IsInRange() const;
+
+        Table               *m_table;
+
+        FieldId             m_field_id;
+
+        Datum               m_lo;
+
+        Datum               m_hi;
+
+        FunctionInfo        m_lt_func;
+
+        //! the number of free-space map entries when the scan starts
+        uint32_t            m_nentries;
+
+        //! the next page group to scan
+        uint32_t            m_next_group;
+
+        uint32_t            m_nskipped;
+
+        Iterator            m_iter;
+
+        friend class Table;
+    };
+
+    /*!
+     * A ParallelVacuum reclaims the space of the erased records of a table.
+     * As in ParallelScan, the pages are handed out to any number of worker
+     * threads in morsels of consecutive free-space map entries. Each page
+     * is compacted under its frame latch so that all of its free space is
+     * contiguous, and its free-space map category is set to the actual
+     * free space. An empty page other than the first one is removed from
+     * the free-space map and freed, so that the file manager may reuse it.
+     * The zones of the freed pages are kept, as they are supersets anyway.
+     *
+     * The vacuum runs online: the insertions, updates and erasures may
+     * proceed concurrently, and an insertion that picked a page before it
+     * was freed finds out under the frame latch and picks another page.
+     * The pages added after the vacuum has started are not visited.
+     *
+     * To limit the I/O a vacuum takes away from the other work, the
+     * workers share a budget of pages per second, and wait before visiting
+     * a page until the budget allows it.
+     */
+    class ParallelVacuum {
+    public:
+        /*!
+         * Vacuums the pages of the next morsel that has not been handed out
+         * and returns true, or returns false if there's no more morsel.
+         */
+        bool VacuumNextMorsel();
+
+        /*!
+         * Returns the number of pages visited so far.
+         */
+        uint32_t
+        GetNumVisitedPages() const {
+            return m_nvisited.load(memory_order_relaxed);
+        }
+
+        /*!
+         * Returns the number of pages compacted so far.
+         */
+        uint32_t
+        GetNumCompactedPages() const {
+            return m_ncompacted.load(memory_order_relaxed);
+        }
+
+        /*!
+         * Returns the number of empty pages freed so far.
+         */
+        uint32_t
+        GetNumFreedPages() const {
+            return m_nfreed.load(memory_order_relaxed);
+        }
+
+    private:
+        ParallelVacuum(Table *table, uint32_t morsel_npages,
+                       uint32_t max_pages_per_sec);
+
+        /*!
+         * Waits until the I/O budget allows visiting one more page.
+         */
+        void Throttle();
+
+        /*!
+         * Vacuums the page \p pid of the free-space map entry \p fsm_idx.
+         */
+        template<class DataPage> void VacuumPage(uint32_t fsm_idx,
+                                                 PageNumber pid);
+
+        Table               *m_table;
+
+        uint32_t            m_morsel_npages;
+
+        uint32_t            m_max_pages_per_sec;
+
+        //! the number of free-space map entries when the vacuum starts
+        uint32_t            m_nentries;
+
+        //! the next morsel to hand out
+        atomic<uint32_t>    m_next_morsel;
+
+        std::chrono::steady_clock::time_point m_start_time;
+
+        atomic<uint32_t>    m_nvisited;
+
+        atomic<uint32_t>    m_ncompacted;
+
+        atomic<uint32_t>    m_nfreed;
+
+        friend class Table;
+    };
+
+    /*!
+     * A BulkLoader appends a large number of records to a table without
+     * going through the buffer manager. The records are encoded into full
+     * pages formatted in a private aligned buffer, which is written with a
+     * single large sequential write to new pages reserved at the end of the
+     * data files whenever it is full. The new pages are added to the
+     * free-space map when they are written, but they are only linked into
+     * the heap file in one step by Finish(). If the loader is destroyed
+     * before Finish() is called, the load is aborted and the new pages are
+     * freed.
+     *
+     * The record IDs of the loaded records are not returned. No other
+     * thread may modify the table during a bulk load, and the loaded records
+     * are not visible to the scans until Finish() returns.
+     */
+    class BulkLoader {
+    public:
+        ~BulkLoader();
+
+        /*!
+         * Encodes a record with the fields in \p data as in Table::Insert()
+         * and appends it to the table. It is an error if the record is too
+         * long to fit on an empty page.
+         */
+        void Insert(const std::vector<Datum> &data);
+
+        /*!
+         * See Insert(const std::vector<Datum>&).
+         */
+        void Insert(const std::vector<NullableDatumRef> &data);
+
+        /*!
+         * Appends the record \p rec to the table. It is an error if the
+         * record is too long to fit on an empty page.
+         */
+        void InsertRecord(const Record &rec);
+
+        /*!
+         * Appends the records of all the rows encoded in \p batch to the
+         * table in their order, which must have been encoded with the
+         * schema of the table. No value is stored out of line, so it is an
+         * error if a record is too long to fit on an empty page.
+         */
+        void InsertBatch(const BatchPayloadEncoder &batch);
+
+        /*!
+         * Writes the remaining pages in the buffer and links all the new
+         * pages into the heap file. No other function may be called after
+         * that.
+         */
+        void Finish();
+
+    private:
+        BulkLoader(Table *table, PageNumber nbufpages);
+
+        template<class SomeDatum>
+        void InsertImpl(const std::vector<SomeDatum> &data);
+
+        /*!
+         * Inserts the record \p rec into the last page in the buffer,
+         * starting a new page if it is full.
+         */
+        template<class DataPage> void AppendRecord(Record &rec);
+
+        /*!
+         * Writes all the pages in the buffer to new pages and adds them to
+         * the free-space map.
+         */
+        void FlushPages();
+
+        char*
+        GetBufferedPage(PageNumber i) const {
+            return ((char*) m_buf.get()) + (size_t) i * PAGE_SIZE;
+        }
+
+        Table               *m_table;
+
+        //! the private page buffer
+        unique_malloced_ptr m_buf;
+
+        //! the number of pages the buffer holds
+        PageNumber          m_nbufpages;
+
+        //! the number of pages in use in the buffer
+        PageNumber          m_npages;
+
+        //! the buffer where a record is encoded
+        maxaligned_char_buf m_recbuf;
+
+        //! the runs of the new pages that have been written, as pairs of
+        //! the first page number and the number of pages
+        std::vector<std::pair<PageNumber, PageNumber>> m_runs;
+
+        //! the free-space map entry index of the first page of each run
+        std::vector<uint32_t> m_run_fsm_idx;
+
+        //! the zones of the records on each page in the buffer, which are
+        //! merged into the zone map when the page is written
+        std::vector<ColumnZone> m_zones;
+
+        //! the values stored out of line, which are deleted if the load is
+        //! aborted
+        std::vector<ToastPointer> m_toasted;
+
+        friend class Table;
+    };
+
+private:
+    //! the data page formats of a heap file
+    enum class PageFormat: uint8_t {
+        Varlen,
+        Fixedlen,
+        Pax,
+    };
+
+    //! the user data area of every data page
+    struct TablePageData {
+        //! the index of the page's entry in the free-space map
+        uint32_t    m_fsm_idx;
+
+        //! the file ID of the free-space map, only set on the first page
+        FileId      m_fsm_fid;
+
+        //! the file ID of the zone map, only set on the first page
+        FileId      m_zm_fid;
+
+        //! the file ID of the toast file, only set on the first page of a
+        //! table with variable-length fields
+        FileId      m_toast_fid;
+    };
+
+    Table(std::shared_ptr<const TableDesc> tabdesc,
+          std::unique_ptr<File> file);
+
+    /*!
+     * Pins the page \p pid of this table and returns its buffer ID.
+     */
+    BufferId PinTablePage(PageNumber pid, char **frame);
+
+    /*!
+     * Returns whether the page \p pid in \p frame, which must be latched,
+     * is still a data page of this table, i.e., it has not been freed by a
+     * vacuum since the caller found it.
+     */
+    bool IsLiveTablePage(PageNumber pid, char *frame) const;
+
+    /*!
+     * Allocates and initializes a new page at the end of the file, adds it
+     * to the free-space map and returns its buffer ID with a pin. The index
+     * of its free-space map entry is returned in \p *p_fsm_idx.
+     */
+    BufferId AllocateTablePage(char **frame, uint32_t *p_fsm_idx);
+
+    /*!
+     * Encodes a record with the fields in \p data into the empty buffer
+     * \p buf and returns its length, first storing its largest
+     * variable-length values out of line as long as it is longer than
+     * ToastThreshold. The pointers to the values stored are appended to
+     * \p *stored if \p stored is not null. It is an error if the record
+     * does not fit on an empty page, in which case no value is stored.
+     */
+    template<class SomeDatum>
+    FieldOffset EncodeRecord(const std::vector<SomeDatum> &data,
+                             maxaligned_char_buf &buf,
+                             std::vector<ToastPointer> *stored);
+
+    template<class SomeDatum>
+    RecordId InsertImpl(const std::vector<SomeDatum> &data);
+
+    /*!
+     * Returns \p rec if it is no longer than ToastThreshold, or otherwise
+     * re-encodes it into the empty buffer \p buf with EncodeRecord() and
+     * returns the new record. The values of \p rec already stored out of
+     * line are kept as they are.
+     */
+    Record ToastRecord(const Record &rec, maxaligned_char_buf &buf,
+                       std::vector<ToastPointer> *stored);
+
+    /*!
+     * Appends the pointers to the out-of-line values of the record payload
+     * \p payload to \p *ptrs.
+     */
+    void GetToastPointers(const char *payload,
+                          std::vector<ToastPointer> *ptrs) const;
+
+    /*!
+     * Positions \p *iter before the first record of the pages of the
+     * free-space map entries [\p begin, \p end), where \p nentries is the
+     * number of entries when the scan started. Returns false if none of
+     * those pages is still in the map.
+     */
+    bool StartScanOfEntries(uint32_t begin, uint32_t end, uint32_t nentries,
+                            Iterator *iter);
+
+    /*!
+     * Returns the data page format of the table \p tabdesc.
+     */
+    static PageFormat GetPageFormat(const TableDesc *tabdesc);
+
+    /*!
+     * Initializes an empty data page of the table \p tabdesc in \p frame.
+     */
+    static void InitializeDataPage(const TableDesc *tabdesc, char *frame);
+
+    /*!
+     * Returns the user data area of the data page in \p frame of the
+     * format \p format.
+     */
+    static TablePageData *GetTablePageData(PageFormat format, char *frame);
+
+    /*!
+     * Returns the number of free bytes on the data page in \p frame of the
+     * table \p tabdesc.
+     */
+    static FieldOffset ComputeFreeSpace(const TableDesc *tabdesc,
+                                        char *frame);
+
+    TablePageData*
+    GetTablePageData(char *frame) const {
+        return GetTablePageData(m_format, frame);
+    }
+
+    /*!
+     * Returns the data page in \p frame as a \p DataPage.
+     */
+    template<class DataPage> DataPage GetDataPage(char *frame) const;
+
+    /*!
+     * Returns whether the record \p rec fits on an empty page of the table.
+     */
+    bool IsValidRecord(const Record &rec) const;
+
+    template<class DataPage> void InsertRecordImpl(Record &rec);
+
+    /*!
+     * Erases the record \p rid. Its out-of-line values are deleted as well
+     * unless \p delete_toasted is false, e.g., when they have been moved to
+     * a new version of the record.
+     */
+    template<class DataPage> void EraseRecordImpl(RecordId rid,
+                                                  bool delete_toasted = true);
+    template<class DataPage> void UpdateRecordImpl(RecordId rid, Record &rec);
+
+    std::shared_ptr<const TableDesc> m_tabdesc;
+
+    std::unique_ptr<File> m_file;
+
+    PageFormat      m_format;
+
+    //! the max total length of the variable-length values of a record on a
+    //! PaxDataPage
+    FieldOffset     m_pax_heap_sz;
+
+    std::unique_ptr<FreeSpaceMap> m_fsm;
+
+    std::unique_ptr<ZoneMap> m_zonemap;
+
+    //! the toast file, or null if the table has no variable-length field
+    std::unique_ptr<ToastFile> m_toast;
+
+    //! serializes the page allocations, so that the order of the pages in
+    //! the free-space map is the same as in the file
+    std::mutex      m_alloc_mutex;
+
+    //! a unique ID of this object, which identifies its insertion hints
+    uint64_t        m_hint_key;
+};
+
+}   // namespace taco
+
+#endif      // STORAGE_TABLE_H
@@ -0,0 +1,82 @@
+#ifndef STORAGE_TOASTFILE_H
+#define STORAGE_TOASTFILE_H
+
+#include "tdb.h"
+
+#include "storage/FileManager.h"
+
+namespace taco {
+
+/*!
+ * The pointer to a variable-length value stored out of line, which is
+ * stored in place of the value in a record payload.
+ */
+struct ToastPointer {
+    //! the first of the consecutive pages of the value in the toast file
+    PageNumber      m_first_pid;
+
+    //! the length of the value
+    uint32_t        m_len;
+};
+
+/*!
+ * ToastFile stores the variable-length values of a table that are too large
+ * to be stored in its records, so that a record only has a small
+ * ToastPointer for each of them. A value is split into chunks of
+ * ChunkBytesPerPage bytes, which are written to a run of consecutive new
+ * pages of the file in one sequential write, and are only read when the
+ * value is fetched. The pages of a value are returned to the file manager
+ * when it is deleted.
+ *
+ * All the functions are thread-safe.
+ */
+class ToastFile {
+public:
+    //! the number of bytes of a value on a page
+    static constexpr size_t ChunkBytesPerPage =
+        PAGE_SIZE - MAXALIGN(sizeof(PageHeaderData));
+
+    /*!
+     * Creates an empty toast file and returns its file ID.
+     */
+    static FileId Create();
+
+    /*!
+     * Opens the toast file \p fid.
+     */
+    ToastFile(FileId fid);
+
+    FileId
+    GetFileId() const {
+        return m_file->GetFileId();
+    }
+
+    /*!
+     * Stores the \p len bytes in \p bytes as a new value and returns the
+     * pointer to it.
+     */
+    ToastPointer Store(const char *bytes, uint32_t len);
+
+    /*!
+     * Reads the value \p ptr into a new Datum that owns its bytes.
+     */
+    Datum Fetch(const ToastPointer &ptr);
+
+    /*!
+     * Deletes the value \p ptr and frees its pages.
+     */
+    void Delete(const ToastPointer &ptr);
+
+private:
+    static PageNumber
+    GetNumPages(const ToastPointer &ptr) {
+        return (PageNumber)((ptr.m_len + ChunkBytesPerPage - 1) /
+                            ChunkBytesPerPage);
+    }
+
+    std::unique_ptr<File> m_file;
+};
+
+}   // namespace taco
+
+#endif      // STORAGE_TOASTFILE_H
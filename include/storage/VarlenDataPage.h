@@ -0,0 +1,238 @@
+#ifndef STORAGE_VARLENDATAPAGE_H
+#define STORAGE_VARLENDATAPAGE_H
+
+#include "tdb.h"
+
+#include "storage/FileManager.h"
+#include "storage/Record.h"
+
+namespace taco {
+
+/*!
+ * The header of a variable-length data page, which immediately follows the
+ * page header of the virtual file page.
+ */
+struct VarlenDataPageHeader {
+    PageHeaderData  m_ph;
+
+    //! the offset of the slot array, which follows the user data area
+    FieldOffset     m_slot_begin;
+
+    //! the beginning of the free space, i.e., the end of the slot array
+    FieldOffset     m_fs_begin;
+
+    //! the end of the free space, i.e., the beginning of the record data
+    FieldOffset     m_fs_end;
+
+    //! the number of slots in the slot array
+    SlotId          m_nslots;
+
+    //! the number of occupied slots
+    SlotId          m_cnt;
+
+    //! the total size of the records on the page, each aligned to
+    //! MAXALIGN_OF
+    FieldOffset     m_total_reclen;
+
+    //! no slot below this one is free
+    SlotId          m_free_hint;
+};
+
+/*!
+ * A slot in the slot array of a variable-length data page. An unoccupied
+ * slot has an offset of 0.
+ */
+struct VarlenDataPageSlot {
+    FieldOffset     m_off;
+    FieldOffset     m_len;
+};
+
+/*!
+ * VarlenDataPage is a slotted page for variable-length records. The slot
+ * array grows from the end of the page header (and an optional user data
+ * area) towards the end of the page, while the records grow from the end
+ * of the page towards the beginning. A record is identified by its slot ID
+ * on the page, which never changes as long as the record is on the page.
+ * Every record is aligned to MAXALIGN_OF on the page, so that its fields
+ * may be accessed in place.
+ *
+ * When a record is erased or shrunk, the space it frees is only reclaimed
+ * when an insertion or update does not fit in the contiguous free space,
+ * in which case the page is compacted by sliding all the records towards
+ * the end of the page. The slots of the erased records are reused by later
+ * insertions.
+ *
+ * A VarlenDataPage does not own the page buffer and it is not thread-safe.
+ */
+class VarlenDataPage {
+public:
+    /*!
+     * Initializes an empty page in \p pagebuf with a user data area of
+     * \p usr_data_sz bytes right after the page header. The page header
+     * data must have already been initialized by the file manager.
+     */
+    static void Initialize(char *pagebuf, FieldOffset usr_data_sz = 0);
+
+    /*!
+     * Returns the maximum length of a record that may be inserted into an
+     * empty page with a user data area of \p usr_data_sz bytes.
+     */
+    static FieldOffset ComputeMaxRecordLength(FieldOffset usr_data_sz = 0);
+
+    /*!
+     * Returns the number of free bytes, as in ComputeFreeSpace(), that is
+     * enough for inserting a record of length \p reclen.
+     */
+    static size_t
+    ComputeSpaceNeeded(FieldOffset reclen) {
+        return MAXALIGN(reclen) + sizeof(VarlenDataPageSlot);
+    }
+
+    VarlenDataPage(char *pagebuf):
+        m_pagebuf(pagebuf) {}
+
+    /*!
+     * Returns the user data area of the page.
+     */
+    char*
+    GetUserData() const {
+        return m_pagebuf + MAXALIGN(sizeof(VarlenDataPageHeader));
+    }
+
+    /*!
+     * Inserts the record \p rec into the page by copying its content once
+     * into the page, and sets the slot ID of its record ID on success. Leaves
+     * \p rec unchanged and returns false if the page does not have enough
+     * space for it.
+     *
+     * It is an error if the record is longer than ComputeMaxRecordLength().
+     */
+    bool InsertRecord(Record &rec);
+
+    /*!
+     * Allocates a free slot and \p reclen bytes of uninitialized space for a
+     * new record, so that the caller may encode the record directly into
+     * the page. Returns the space and sets the slot ID in \p *p_sid, or
+     * returns nullptr if the page does not have enough space for it.
+     *
+     * It is an error if \p reclen is longer than ComputeMaxRecordLength().
+     */
+    char *AllocateRecord(FieldOffset reclen, SlotId *p_sid);
+
+    /*!
+     * Erases the record in slot \p sid. Returns false if the slot is not
+     * occupied.
+     */
+    bool EraseRecord(SlotId sid);
+
+    /*!
+     * Replaces the record in slot \p sid with \p rec, and sets the record ID
+     * of \p rec to the same slot. Leaves the page unchanged and returns false
+     * if the new record does not fit on the page. It is an error if the slot
+     * is not occupied.
+     */
+    bool UpdateRecord(SlotId sid, Record &rec);
+
+    /*!
+     * Returns the record in slot \p sid and its length in \p *p_reclen if
+     * not null, or nullptr if the slot is not occupied. The returned
+     * pointer points into the page.
+     */
+    const char *GetRecordBuf(SlotId sid, FieldOffset *p_reclen = nullptr) const;
+
+    /*!
+     * Returns whether the slot \p sid is occupied.
+     */
+    bool
+    IsOccupied(SlotId sid) const {
+        return sid >= MinSlotId && sid <= GetHeader()->m_nslots &&
+               GetSlot(sid)->m_off != 0;
+    }
+
+    /*!
+     * Returns the smallest occupied slot ID greater than \p sid, or
+     * INVALID_SID if there's none.
+     */
+    SlotId GetNextOccupiedSlot(SlotId sid) const;
+
+    /*!
+     * Returns the minimum slot ID that may be occupied.
+     */
+    constexpr SlotId
+    GetMinSlotId() const {
+        return MinSlotId;
+    }
+
+    /*!
+     * Returns the maximum slot ID that may be occupied, which is less than
+     * GetMinSlotId() if the page has no slot at all.
+     */
+    SlotId
+    GetMaxSlotId() const {
+        return GetHeader()->m_nslots;
+    }
+
+    /*!
+     * Returns the number of records on the page.
+     */
+    SlotId
+    GetRecordCount() const {
+        return GetHeader()->m_cnt;
+    }
+
+    /*!
+     * Returns the number of free bytes on the page after compaction,
+     * excluding the space for a new slot.
+     */
+    FieldOffset ComputeFreeSpace() const;
+
+    /*!
+     * Moves all the records to the end of the page so that all the free
+     * space is contiguous.
+     */
+    void Compact();
+
+    /*!
+     * Returns whether all the free space on the page is contiguous, i.e.,
+     * Compact() would not reclaim anything.
+     */
+    bool
+    IsCompact() const {
+        return (FieldOffset) PAGE_SIZE - GetHeader()->m_fs_end ==
+            GetHeader()->m_total_reclen;
+    }
+
+private:
+    VarlenDataPageHeader*
+    GetHeader() const {
+        return (VarlenDataPageHeader*) m_pagebuf;
+    }
+
+    VarlenDataPageSlot*
+    GetSlot(SlotId sid) const {
+        return ((VarlenDataPageSlot*)(m_pagebuf + GetHeader()->m_slot_begin))
+            + (sid - MinSlotId);
+    }
+
+    /*!
+     * Returns the first unoccupied slot, or m_nslots + 1 if there's none.
+     */
+    SlotId FindFreeSlot() const;
+
+    /*!
+     * Returns whether \p alen bytes of record data and \p slot_sz bytes of
+     * slot array may be allocated on the page, compacting it if necessary.
+     */
+    bool ReserveSpace(FieldOffset alen, FieldOffset slot_sz);
+
+    /*!
+     * Removes the trailing unoccupied slots from the slot array.
+     */
+    void TruncateSlotArray();
+
+    char    *m_pagebuf;
+};
+
+}   // namespace taco
+
+#endif      // STORAGE_VARLENDATAPAGE_H
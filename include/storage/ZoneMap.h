@@ -0,0 +1,171 @@
+#ifndef STORAGE_ZONEMAP_H
+#define STORAGE_ZONEMAP_H
+
+#include "tdb.h"
+
+#include <mutex>
+
+#include "catalog/Schema.h"
+#include "storage/FileManager.h"
+
+namespace taco {
+
+/*!
+ * The summary of the values of one column in a page group. The min and max
+ * values are stored in the bytes of their Datum representations.
+ */
+struct ColumnZone {
+    uint64_t        m_min;
+
+    uint64_t        m_max;
+
+    //! the number of non-null values
+    uint32_t        m_nvalues;
+
+    //! the number of null values
+    uint32_t        m_nnulls;
+};
+
+/*!
+ * ZoneMap keeps the min and max values and the null count of some columns
+ * for each group of PagesPerGroup consecutive pages of a heap file, so that
+ * a scan with a range predicate can skip the page groups that cannot have
+ * any matching record. It is stored in its own virtual file as an array of
+ * the zones of all the page groups, where the pages are numbered in the
+ * order of their free-space map entries, i.e., the order in the file.
+ *
+ * Only the fixed-length pass-by-value columns with a `<' operator have
+ * zones. A zone is only widened by the insertions, and never narrowed when
+ * a record is erased, so it is always a superset of the values of the
+ * group, and the null count is the number of null values ever inserted.
+ *
+ * All the functions are thread-safe.
+ */
+class ZoneMap {
+public:
+    //! the number of consecutive pages summarized by a zone
+    static constexpr uint32_t PagesPerGroup = 16;
+
+    /*!
+     * Creates an empty zone map in a new virtual file and returns its file
+     * ID.
+     */
+    static FileId Create();
+
+    /*!
+     * Opens the zone map of the heap file of the schema \p schema in the
+     * virtual file \p fid.
+     */
+    ZoneMap(FileId fid, const Schema *schema);
+
+    FileId
+    GetFileId() const {
+        return m_file->GetFileId();
+    }
+
+    /*!
+     * Returns the number of columns with a zone.
+     */
+    size_t
+    GetNumZonedColumns() const {
+        return m_field_ids.size();
+    }
+
+    /*!
+     * Returns whether the field \p field_id has a zone.
+     */
+    bool
+    HasZone(FieldId field_id) const {
+        return m_zone_idx[field_id] != -1;
+    }
+
+    /*!
+     * Widens the zones of the group of page \p page_idx with the record
+     * payload \p payload.
+     */
+    void Update(uint32_t page_idx, const char *payload);
+
+    /*!
+     * Widens the GetNumZonedColumns() zones in \p zones with the record
+     * payload \p payload. The zones are not in the map, e.g., the ones of a
+     * page that is not in the file yet.
+     */
+    void AddToZones(ColumnZone *zones, const char *payload) const;
+
+    /*!
+     * Merges the GetNumZonedColumns() zones in \p zones into the zones of
+     * the group of page \p page_idx.
+     */
+    void Merge(uint32_t page_idx, const ColumnZone *zones);
+
+    /*!
+     * Returns whether the page group \p group may have a record with a
+     * non-null value of field \p field_id in the range [\p lo, \p hi],
+     * where a null bound means unbounded. Always returns true if the field
+     * has no zone or the map page of the group does not exist yet.
+     */
+    bool GroupMayMatch(uint32_t group, FieldId field_id, const Datum &lo,
+                       const Datum &hi);
+
+private:
+    /*!
+     * Pins the map page of the zones of group \p group and returns its
+     * buffer ID and the zones in \p *p_zones. If the map page does not
+     * exist, allocates the map pages up to it if \p create is true, or
+     * returns INVALID_BUFID otherwise.
+     */
+    BufferId PinZones(uint32_t group, ColumnZone **p_zones,
+                      bool create = true);
+
+    /*!
+     * Returns the Datum of the value stored in \p bits of the \p i-th zoned
+     * column.
+     */
+    Datum
+    GetZoneDatum(size_t i, const uint64_t &bits) const {
+        return Datum::FromFixedlenBytes((const char*) &bits,
+                                        m_schema->GetFieldLength(
+                                            m_field_ids[i]));
+    }
+
+    /*!
+     * Returns whether \p lhs < \p rhs in the type of the \p i-th zoned
+     * column.
+     */
+    bool
+    Less(size_t i, const Datum &lhs, const Datum &rhs) const {
+        return FunctionCall(m_lt_funcs[i], lhs, rhs).GetBool();
+    }
+
+    /*!
+     * Widens the zone \p zone of the \p i-th zoned column with the value
+     * \p value.
+     */
+    void AddValue(size_t i, ColumnZone *zone, const Datum &value) const;
+
+    std::unique_ptr<File> m_file;
+
+    const Schema    *m_schema;
+
+    //! the zoned columns
+    std::vector<FieldId> m_field_ids;
+
+    //! the index of each field in m_field_ids, or -1 if it has no zone
+    std::vector<int> m_zone_idx;
+
+    //! the `<' functions of the zoned columns
+    std::vector<FunctionInfo> m_lt_funcs;
+
+    //! the number of groups on a map page
+    uint32_t        m_groups_per_page;
+
+    //! protects m_map_pids
+    std::mutex      m_mutex;
+
+    //! the map pages in the order of the groups
+    std::vector<PageNumber> m_map_pids;
+};
+
+}   // namespace taco
+
+#endif      // STORAGE_ZONEMAP_H
@@ -13,6 +13,266 @@ enum class LatchMode {
     EX, // exclusive latch
 };
 
+/*!
+ * A compact reader-writer latch of 8 bytes that is small enough to be
+ * embedded in every buffer frame or tree node.
+ *
+ * The latch state is a single 32-bit word: the highest bit is set if the
+ * latch is held in exclusive mode, the next bit is set if some thread is
+ * waiting for the exclusive mode, the next bit is set if some thread is
+ * parked on the latch, and the rest is the number of shared holders.
+ * Acquiring or releasing an uncontended latch is a single atomic operation
+ * on the state word. A thread that fails to acquire the latch spins for a
+ * while and then parks itself on the state word with futex(2) until the
+ * latch is released.
+ *
+ * New shared holders are not admitted while a thread is waiting for the
+ * exclusive mode, so a stream of readers can't starve a writer.
+ *
+ * Besides the shared and exclusive modes, the latch supports optimistic
+ * reads that never write to the latch. The other 32-bit word is a version
+ * counter, which is odd if and only if the latch is held in exclusive mode.
+ * An optimistic reader records an even version with
+ * TryBeginOptimisticRead(), reads the protected data, and then checks with
+ * ValidateOptimisticRead() that no writer has come in between. The reader
+ * must be prepared to see inconsistent data before the validation, e.g., it
+ * must not follow a pointer it read without checking it first. See also
+ * ReadOptimistically().
+ *
+ * The latch is not recursive and it does not track its holders. It is the
+ * caller's responsibility to release the latch in the mode it was acquired.
+ */
+class Latch {
+public:
+    Latch():
+        m_state(0),
+        m_version(0) {}
+
+    Latch(const Latch&) = delete;
+    Latch &operator=(const Latch&) = delete;
+
+    /*!
+     * Acquires the latch in \p mode, blocking until it is available.
+     */
+    void
+    Acquire(LatchMode mode) {
+        if (!TryAcquire(mode)) {
+            AcquireSlow(mode);
+        }
+    }
+
+    /*!
+     * Tries to acquire the latch in \p mode without blocking. Returns
+     * whether the latch is acquired.
+     */
+    bool
+    TryAcquire(LatchMode mode) {
+        if (mode == LatchMode::SH) {
+            uint32_t state = m_state.load(memory_order_relaxed);
+            return !(state & (EXBit | EXWaitBit)) &&
+                m_state.compare_exchange_strong(state, state + 1,
+                                                memory_order_acquire,
+                                                memory_order_relaxed);
+        }
+        uint32_t state = m_state.load(memory_order_relaxed);
+        if ((state & ~(EXWaitBit | ParkedBit)) ||
+            !m_state.compare_exchange_strong(state, state_after_ex(state),
+                                             memory_order_acquire,
+                                             memory_order_relaxed))
+            return false;
+        BeginWrite();
+        return true;
+    }
+
+    /*!
+     * Releases the latch held in \p mode.
+     */
+    void
+    Release(LatchMode mode) {
+        if (mode == LatchMode::SH) {
+            uint32_t old_state = m_state.fetch_sub(1, memory_order_release);
+            ASSERT((old_state & SHCountMask) != 0);
+            // Only the last shared holder can let anyone else in.
+            if ((old_state & SHCountMask) == 1 && (old_state & ParkedBit))
+                WakeUpWaiters();
+        } else {
+            ASSERT(m_state.load(memory_order_relaxed) & EXBit);
+            EndWrite();
+            uint32_t old_state = m_state.fetch_and(~(EXBit | ParkedBit),
+                                                   memory_order_release);
+            if (old_state & ParkedBit)
+                WakeUpWaiters();
+        }
+    }
+
+    /*!
+     * Tries to upgrade the latch from the shared mode to the exclusive mode
+     * without blocking. It only succeeds if the caller is the only shared
+     * holder. If it fails, the caller still holds the latch in the shared
+     * mode.
+     */
+    bool
+    TryUpgrade() {
+        uint32_t state = m_state.load(memory_order_relaxed);
+        for (;;) {
+            ASSERT((state & SHCountMask) != 0);
+            if ((state & SHCountMask) != 1)
+                return false;
+            if (m_state.compare_exchange_weak(state, state_after_ex(state),
+                                              memory_order_acquire,
+                                              memory_order_relaxed)) {
+                BeginWrite();
+                return true;
+            }
+        }
+    }
+
+    /*!
+     * Downgrades the latch from the exclusive mode to the shared mode
+     * without releasing it.
+     */
+    void
+    Downgrade() {
+        ASSERT(m_state.load(memory_order_relaxed) & EXBit);
+        EndWrite();
+        // Any waiting writer will set the EX-wait bit again.
+        uint32_t old_state = m_state.exchange(1, memory_order_release);
+        if (old_state & ParkedBit)
+            WakeUpWaiters();
+    }
+
+    /*!
+     * Starts an optimistic read. Returns false if the latch is currently
+     * held in exclusive mode. Otherwise, returns true and the version to be
+     * passed to ValidateOptimisticRead() in \p version.
+     */
+    bool
+    TryBeginOptimisticRead(uint32_t &version) const {
+        version = m_version.load(memory_order_acquire);
+        return !(version & 1);
+    }
+
+    /*!
+     * Returns whether no one has acquired the latch in exclusive mode since
+     * the optimistic read at \p version started, i.e., whether whatever read
+     * in between is consistent.
+     */
+    bool
+    ValidateOptimisticRead(uint32_t version) const {
+        // Orders the reads of the protected data before the version check.
+        std::atomic_thread_fence(memory_order_acquire);
+        return m_version.load(memory_order_relaxed) == version;
+    }
+
+    /*!
+     * Calls \p func() under an optimistic read and retries it if the read
+     * fails to validate. It falls back to acquiring the latch in shared mode
+     * after a few failed attempts, so that a reader makes progress under
+     * heavy updates. \p func may be called more than once and it should not
+     * have any side effect other than reading the protected data.
+     */
+    template<class Func>
+    void
+    ReadOptimistically(Func &&func) {
+        for (uint32_t i = 0; i < MaxOptimisticRetries; ++i) {
+            uint32_t version;
+            if (!TryBeginOptimisticRead(version)) {
+                std::this_thread::yield();
+                continue;
+            }
+            func();
+            if (ValidateOptimisticRead(version))
+                return ;
+        }
+        Acquire(LatchMode::SH);
+        func();
+        Release(LatchMode::SH);
+    }
+
+    /*!
+     * Returns the current version of the latch.
+     */
+    uint32_t
+    GetVersion() const {
+        return m_version.load(memory_order_relaxed);
+    }
+
+    /*!
+     * Returns whether the latch is held in the exclusive mode by someone.
+     */
+    bool
+    IsHeldExclusive() const {
+        return m_state.load(memory_order_relaxed) & EXBit;
+    }
+
+    /*!
+     * Returns the number of shared holders of the latch.
+     */
+    uint32_t
+    GetNumSharedHolders() const {
+        return m_state.load(memory_order_relaxed) & SHCountMask;
+    }
+
+private:
+    static constexpr uint32_t EXBit = ((uint32_t) 1) << 31;
+    static constexpr uint32_t EXWaitBit = ((uint32_t) 1) << 30;
+    static constexpr uint32_t ParkedBit = ((uint32_t) 1) << 29;
+    static constexpr uint32_t SHCountMask = ParkedBit - 1;
+
+    static constexpr uint32_t MaxOptimisticRetries = 8;
+
+    /*!
+     * Returns the state after acquiring the exclusive mode from \p state.
+     * The EX-wait bit is cleared and any other waiting writer will set it
+     * again.
+     */
+    static constexpr uint32_t
+    state_after_ex(uint32_t state) {
+        return EXBit | (state & ParkedBit);
+    }
+
+    /*!
+     * Makes the version odd after acquiring the exclusive mode.
+     */
+    void
+    BeginWrite() {
+        m_version.store(m_version.load(memory_order_relaxed) + 1,
+                        memory_order_relaxed);
+        // Orders the version update before any write to the protected data.
+        std::atomic_thread_fence(memory_order_release);
+    }
+
+    /*!
+     * Makes the version even before releasing the exclusive mode.
+     */
+    void
+    EndWrite() {
+        m_version.store(m_version.load(memory_order_relaxed) + 1,
+                        memory_order_release);
+    }
+
+    void AcquireSlow(LatchMode mode);
+
+    /*!
+     * Wakes up all the threads parked on the latch.
+     */
+    void WakeUpWaiters();
+
+    /*!
+     * Parks the calling thread until the state word is changed from \p
+     * state, or returns immediately if it has already been changed.
+     */
+    void Park(uint32_t state);
+
+    //! the latch state and the futex word
+    atomic<uint32_t>    m_state;
+
+    //! the version for optimistic reads, odd iff held in exclusive mode
+    atomic<uint32_t>    m_version;
+};
+
+static_assert(sizeof(Latch) == 8, "Latch is expected to be 8 bytes");
+
 }   // namespace taco
 
 #endif  // UTILS_LATCH_H
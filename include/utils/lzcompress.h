@@ -0,0 +1,26 @@
+#ifndef UTILS_LZCOMPRESS_H
+#define UTILS_LZCOMPRESS_H
+
+#include "tdb.h"
+
+namespace taco {
+
+/*!
+ * Compresses \p srclen bytes at \p src into \p dst with a fast LZ77 codec
+ * in a format similar to the LZ4 block format, and returns the compressed
+ * size. Returns 0 if the compressed data would not fit in \p dstcap bytes.
+ * It is meant for pages and other small buffers: matches are only looked
+ * for within the last 64 KB.
+ */
+size_t lz_compress(const char *src, size_t srclen, char *dst, size_t dstcap);
+
+/*!
+ * Decompresses \p srclen bytes at \p src produced by lz_compress() into
+ * exactly \p dstlen bytes at \p dst. Returns false if \p src is not a valid
+ * compressed buffer of \p dstlen bytes.
+ */
+bool lz_decompress(const char *src, size_t srclen, char *dst, size_t dstlen);
+
+}   // namespace taco
+
+#endif      // UTILS_LZCOMPRESS_H
@@ -0,0 +1,157 @@
+// src/catalog/BatchPayloadEncoder.cpp
+#include "catalog/BatchPayloadEncoder.h"
+
+namespace taco {
+
+static inline bool
+ColumnIsNull(const BatchColumn &column, uint32_t row) {
+    return column.m_nulls && ((column.m_nulls[row >> 3] >> (row & 7)) & 1);
+}
+
+/*!
+ * Returns the value of row \p row of \p column of a field with length
+ * \p typlen, and its length in \p *p_len.
+ */
+static inline const char*
+GetColumnValue(const BatchColumn &column, int16_t typlen, uint32_t row,
+               FieldOffset *p_len) {
+    if (typlen != -1) {
+        *p_len = typlen;
+        return column.m_values + (size_t) row * typlen;
+    }
+    uint32_t begin = (row == 0) ? 0 : column.m_ends[row - 1];
+    // a length that does not fit is caught by the length check of the row
+    *p_len = (FieldOffset) std::min(
+        column.m_ends[row] - begin,
+        (uint32_t) std::numeric_limits<FieldOffset>::max());
+    return column.m_values + begin;
+}
+
+BatchPayloadEncoder::BatchPayloadEncoder(const Schema *schema):
+    m_null_bitmap_begin(schema->m_null_bitmap_begin),
+    m_varlen_end_array_begin(schema->m_varlen_end_array_begin),
+    m_varlen_payload_begin(schema->m_varlen_payload_begin) {
+    if (!schema->IsLayoutComputed()) {
+        LOG(kError, "the schema layout must be computed before encoding "
+                    "payloads");
+    }
+
+    for (FieldId field_id : schema->m_field_reorder_idx) {
+        const Schema::FieldInfo &field = schema->m_field[field_id];
+        FieldPlan plan;
+        plan.m_field_id = field_id;
+        plan.m_typlen = field.m_typlen;
+        plan.m_typalign = (uint8_t) field.m_typalign;
+        plan.m_nullbit_id = field.m_nullbit_id;
+        if (field.m_offset >= 0) {
+            plan.m_offset = field.m_offset;
+            m_fixed_fields.push_back(plan);
+        } else {
+            plan.m_offset = -field.m_offset - 1;
+            m_trailing_fields.push_back(plan);
+        }
+    }
+}
+
+void
+BatchPayloadEncoder::Reserve(size_t nbytes, size_t nrows) {
+    m_buf.reserve(m_buf.size() + nbytes);
+    m_rows.reserve(m_rows.size() + nrows);
+}
+
+size_t
+BatchPayloadEncoder::Append(const BatchColumn *columns, uint32_t nrows) {
+    // Compute the lengths before touching the arena so that it's unchanged
+    // if any row fails to encode.
+    const size_t first_row = m_rows.size();
+    size_t end = m_buf.size();
+    m_rows.resize(first_row + nrows);
+    try {
+        for (uint32_t row = 0; row < nrows; ++row) {
+            FieldOffset len = ComputeRowLength(columns, row);
+            m_rows[first_row + row] = std::make_pair(end, len);
+            end += len;
+        }
+    } catch (...) {
+        m_rows.resize(first_row);
+        throw;
+    }
+
+    // The new space is zeroed, which takes care of all the padding bytes and
+    // the null bits of the non-null fields.
+    m_buf.resize(end);
+    for (uint32_t row = 0; row < nrows; ++row) {
+        WriteRow(columns, row, m_buf.data() + m_rows[first_row + row].first);
+    }
+    return first_row;
+}
+
+FieldOffset
+BatchPayloadEncoder::ComputeRowLength(const BatchColumn *columns,
+                                      uint32_t row) const {
+    for (const FieldPlan &field : m_fixed_fields) {
+        if (ColumnIsNull(columns[field.m_field_id], row)) {
+            LOG(kError, "NULL value passed to non-null field " FIELDID_FORMAT
+                        " in row %u", field.m_field_id, row);
+        }
+    }
+
+    // Computed in 64 bits, so none of the additions below can overflow.
+    int64_t off = m_varlen_payload_begin;
+    for (const FieldPlan &field : m_trailing_fields) {
+        const BatchColumn &column = columns[field.m_field_id];
+        if (ColumnIsNull(column, row)) {
+            if (field.m_nullbit_id < 0) {
+                LOG(kError, "NULL value passed to non-null field "
+                            FIELDID_FORMAT " in row %u",
+                            field.m_field_id, row);
+            }
+            continue;
+        }
+        FieldOffset len;
+        (void) GetColumnValue(column, field.m_typlen, row, &len);
+        off = TYPEALIGN(field.m_typalign, off) + len;
+    }
+    off = MAXALIGN(off);
+    if (off > std::numeric_limits<FieldOffset>::max()) {
+        LOG(kError, "row %u is too long to be encoded into a payload", row);
+    }
+    return (FieldOffset) off;
+}
+
+void
+BatchPayloadEncoder::WriteRow(const BatchColumn *columns, uint32_t row,
+                              char *payload) const {
+    for (const FieldPlan &field : m_fixed_fields) {
+        memcpy(payload + field.m_offset,
+               columns[field.m_field_id].m_values +
+                (size_t) row * field.m_typlen,
+               field.m_typlen);
+    }
+
+    uint8_t *null_bitmap = (uint8_t*)(payload + m_null_bitmap_begin);
+    FieldOffset *varlen_end_array =
+        (FieldOffset*)(payload + m_varlen_end_array_begin);
+    FieldOffset off = m_varlen_payload_begin;
+    for (const FieldPlan &field : m_trailing_fields) {
+        const BatchColumn &column = columns[field.m_field_id];
+        if (ColumnIsNull(column, row)) {
+            null_bitmap[field.m_nullbit_id >> 3] |=
+                1 << (field.m_nullbit_id & 7);
+            // a null varlen field ends where the previous one does
+            if (field.m_typlen == -1)
+                varlen_end_array[field.m_offset] = off;
+            continue;
+        }
+
+        FieldOffset len;
+        const char *bytes = GetColumnValue(column, field.m_typlen, row, &len);
+        off = TYPEALIGN(field.m_typalign, off);
+        memcpy(payload + off, bytes, len);
+        off += len;
+        if (field.m_typlen == -1)
+            varlen_end_array[field.m_offset] = off;
+    }
+}
+
+}   // namespace taco
@@ -0,0 +1,338 @@
+// src/catalog/PayloadCodec.cpp
+#include "catalog/PayloadCodec.h"
+
+#include <array>
+
+namespace taco {
+
+constexpr FieldId PayloadCodec::MaxNumFixedlenFields;
+constexpr FieldId PayloadCodec::MaxNumVarlenFields;
+constexpr FieldId PayloadCodec::MaxNumFields;
+
+namespace {
+
+/*!
+ * The payload layout of a schema of a specialized shape, which is extracted
+ * from the schema by PayloadCodec::Create().
+ */
+struct CodecLayout {
+    FieldOffset             m_null_bitmap_begin;
+
+    FieldOffset             m_varlen_end_array_begin;
+
+    FieldOffset             m_varlen_payload_begin;
+
+    //! the fixed-length fields in the payload order
+    std::vector<FieldId>    m_fixed_fids;
+
+    //! the offsets of the fixed-length fields
+    std::vector<FieldOffset> m_fixed_offs;
+
+    //! the variable-length fields in the payload order
+    std::vector<FieldId>    m_varlen_fids;
+
+    //! the alignments of the variable-length fields
+    std::vector<uint8_t>    m_varlen_aligns;
+
+    //! the null bit IDs of the variable-length fields, or -1 for the
+    //! non-nullable ones
+    std::vector<FieldId>    m_varlen_nullbits;
+};
+
+/*!
+ * The fixed-length fields at the positions [I, I + sizeof...(Ts)) of the
+ * payload order, where each field is accessed as the unsigned integer type
+ * in Ts of the same length. The functions are unrolled over the fields at
+ * compile time. This primary template is the empty list of fields.
+ */
+template<size_t I, class... Ts>
+struct FixedlenFields {
+    template<class SomeDatum>
+    static bool
+    AnyNull(const FieldId*, const std::vector<SomeDatum>&) {
+        return false;
+    }
+
+    template<class SomeDatum>
+    static void
+    Write(const FieldId*, const FieldOffset*, const std::vector<SomeDatum>&,
+          char*) {
+    }
+
+    static void
+    Deform(const FieldId*, const FieldOffset*,
+           std::pair<FieldOffset, FieldOffset>*) {
+    }
+};
+
+template<size_t I, class T, class... Ts>
+struct FixedlenFields<I, T, Ts...> {
+    typedef FixedlenFields<I + 1, Ts...> Rest;
+
+    template<class SomeDatum>
+    static bool
+    AnyNull(const FieldId *fids, const std::vector<SomeDatum> &data) {
+        return data[fids[I]].isnull() | Rest::AnyNull(fids, data);
+    }
+
+    template<class SomeDatum>
+    static void
+    Write(const FieldId *fids, const FieldOffset *offs,
+          const std::vector<SomeDatum> &data, char *payload) {
+        *(T*)(payload + offs[I]) = *(const T*) data[fids[I]].GetFixedlenBytes();
+        Rest::Write(fids, offs, data, payload);
+    }
+
+    static void
+    Deform(const FieldId *fids, const FieldOffset *offs,
+           std::pair<FieldOffset, FieldOffset> *offlen) {
+        offlen[fids[I]] = std::make_pair(offs[I], (FieldOffset) sizeof(T));
+        Rest::Deform(fids, offs, offlen);
+    }
+};
+
+/*!
+ * The codec of the schemas with the non-nullable fixed-length fields of the
+ * types \p Fixed, followed by \p NVarlen variable-length fields.
+ */
+template<FieldId NVarlen, class... Fixed>
+class SpecializedPayloadCodec: public PayloadCodec {
+    static constexpr size_t NFixed = sizeof...(Fixed);
+
+    typedef FixedlenFields<0, Fixed...> Fields;
+
+public:
+    SpecializedPayloadCodec(const CodecLayout &layout):
+        m_null_bitmap_begin(layout.m_null_bitmap_begin),
+        m_varlen_end_array_begin(layout.m_varlen_end_array_begin),
+        m_varlen_payload_begin(layout.m_varlen_payload_begin) {
+        ASSERT(layout.m_fixed_fids.size() == NFixed);
+        ASSERT(layout.m_varlen_fids.size() == (size_t) NVarlen);
+        for (size_t k = 0; k < NFixed; ++k) {
+            m_fixed_fids[k] = layout.m_fixed_fids[k];
+            m_fixed_offs[k] = layout.m_fixed_offs[k];
+        }
+        for (size_t v = 0; v < (size_t) NVarlen; ++v) {
+            m_varlen_fids[v] = layout.m_varlen_fids[v];
+            m_varlen_aligns[v] = layout.m_varlen_aligns[v];
+            m_varlen_nullable[v] = layout.m_varlen_nullbits[v] >= 0;
+            m_varlen_nullbits[v] = m_varlen_nullable[v] ?
+                layout.m_varlen_nullbits[v] : 0;
+        }
+    }
+
+    FieldOffset
+    WritePayloadToBuffer(const std::vector<Datum> &data,
+                         maxaligned_char_buf &buf) const override {
+        return WritePayloadToBufferImpl(data, buf);
+    }
+
+    FieldOffset
+    WritePayloadToBuffer(const std::vector<DatumRef> &data,
+                         maxaligned_char_buf &buf) const override {
+        return WritePayloadToBufferImpl(data, buf);
+    }
+
+    FieldOffset
+    WritePayloadToBuffer(const std::vector<NullableDatumRef> &data,
+                         maxaligned_char_buf &buf) const override {
+        return WritePayloadToBufferImpl(data, buf);
+    }
+
+    void
+    DeformPayload(const char *payload,
+                  std::pair<FieldOffset, FieldOffset> *offlen) const override {
+        Fields::Deform(m_fixed_fids.data(), m_fixed_offs.data(), offlen);
+
+        const uint8_t *null_bitmap =
+            reinterpret_cast<const uint8_t*>(payload + m_null_bitmap_begin);
+        const uint16_t *varlen_end =
+            reinterpret_cast<const uint16_t*>(payload +
+                                              m_varlen_end_array_begin);
+        FieldOffset off = m_varlen_payload_begin;
+        for (size_t v = 0; v < (size_t) NVarlen; ++v) {
+            FieldOffset end = (FieldOffset)(varlen_end[v] &
+                                            ~Schema::VarlenEndExternalBit);
+            FieldId nullbit_id = m_varlen_nullbits[v];
+            bool isnull = m_varlen_nullable[v] &
+                ((null_bitmap[nullbit_id >> 3] >> (nullbit_id & 7)) & 1);
+            FieldOffset begin = TYPEALIGN(m_varlen_aligns[v], off);
+            offlen[m_varlen_fids[v]] = isnull ?
+                std::make_pair(off, (FieldOffset) -1) :
+                std::make_pair(begin, (FieldOffset)(end - begin));
+            off = end;
+        }
+    }
+
+private:
+    template<class SomeDatum>
+    FieldOffset
+    WritePayloadToBufferImpl(const std::vector<SomeDatum> &data,
+                             maxaligned_char_buf &buf) const {
+        const size_t max_len = (size_t) std::numeric_limits<FieldOffset>::max();
+        if (buf.size() >= max_len) {
+            return -1;
+        }
+        const size_t init_len = MAXALIGN(buf.size());
+
+        if (Fields::AnyNull(m_fixed_fids.data(), data)) {
+            for (FieldId field_id : m_fixed_fids) {
+                if (data[field_id].isnull()) {
+                    LOG(kError, "NULL value passed to non-null field "
+                                FIELDID_FORMAT, field_id);
+                }
+            }
+        }
+
+        // Lay out the varlen fields first, so that the buffer is resized
+        // only once.
+        std::array<bool, NVarlen> isnull;
+        std::array<size_t, NVarlen> begin;
+        std::array<size_t, NVarlen> len;
+        size_t off = m_varlen_payload_begin;
+        for (size_t v = 0; v < (size_t) NVarlen; ++v) {
+            const SomeDatum &d = data[m_varlen_fids[v]];
+            isnull[v] = d.isnull();
+            if (isnull[v] & !m_varlen_nullable[v]) {
+                LOG(kError, "NULL value passed to non-null field "
+                            FIELDID_FORMAT, m_varlen_fids[v]);
+            }
+            len[v] = isnull[v] ? 0 : (size_t) d.GetVarlenSize();
+            begin[v] = isnull[v] ? off : TYPEALIGN(m_varlen_aligns[v], off);
+            off = begin[v] + len[v];
+        }
+        const size_t reclen = MAXALIGN(off);
+        if (init_len + reclen > max_len) {
+            return -1;
+        }
+
+        // The new bytes are zeroed, including the null bitmap.
+        buf.resize(init_len + reclen);
+        char *payload = buf.data() + init_len;
+        Fields::Write(m_fixed_fids.data(), m_fixed_offs.data(), data, payload);
+
+        uint8_t *null_bitmap = (uint8_t*)(payload + m_null_bitmap_begin);
+        FieldOffset *varlen_end =
+            (FieldOffset*)(payload + m_varlen_end_array_begin);
+        for (size_t v = 0; v < (size_t) NVarlen; ++v) {
+            FieldId nullbit_id = m_varlen_nullbits[v];
+            null_bitmap[nullbit_id >> 3] |=
+                (uint8_t)(isnull[v] << (nullbit_id & 7));
+            varlen_end[v] = (FieldOffset)(begin[v] + len[v]);
+            if (!isnull[v]) {
+                memcpy(payload + begin[v],
+                       data[m_varlen_fids[v]].GetVarlenBytes(), len[v]);
+            }
+        }
+        return (FieldOffset) reclen;
+    }
+
+    FieldOffset                         m_null_bitmap_begin;
+
+    FieldOffset                         m_varlen_end_array_begin;
+
+    FieldOffset                         m_varlen_payload_begin;
+
+    std::array<FieldId, NFixed>         m_fixed_fids;
+
+    std::array<FieldOffset, NFixed>     m_fixed_offs;
+
+    std::array<FieldId, NVarlen>        m_varlen_fids;
+
+    std::array<uint8_t, NVarlen>        m_varlen_aligns;
+
+    std::array<bool, NVarlen>           m_varlen_nullable;
+
+    //! the null bit IDs of the varlen fields, or 0 for the non-nullable
+    //! ones, whose null bits are never set
+    std::array<FieldId, NVarlen>        m_varlen_nullbits;
+};
+
+/*!
+ * Picks the codec for the fixed-length fields of the lengths in \p lens
+ * after the ones of the types \p Fixed. This primary template is used when
+ * no more fixed-length fields can be added.
+ */
+template<bool CanGrow, FieldId NVarlen, class... Fixed>
+struct CodecPicker {
+    static std::unique_ptr<PayloadCodec>
+    Pick(const CodecLayout &layout, const int16_t*, size_t nlens) {
+        if (nlens > 0)
+            return nullptr;
+        return absl::make_unique<SpecializedPayloadCodec<NVarlen, Fixed...>>(
+            layout);
+    }
+};
+
+template<FieldId NVarlen, class... Fixed>
+struct CodecPicker<true, NVarlen, Fixed...> {
+    static std::unique_ptr<PayloadCodec>
+    Pick(const CodecLayout &layout, const int16_t *lens, size_t nlens) {
+        if (nlens == 0) {
+            return absl::make_unique<
+                SpecializedPayloadCodec<NVarlen, Fixed...>>(layout);
+        }
+
+        constexpr bool can_grow = sizeof...(Fixed) + 1 <
+            (size_t) PayloadCodec::MaxNumFixedlenFields;
+        switch (lens[0]) {
+        case 1:
+            return CodecPicker<can_grow, NVarlen, Fixed..., uint8_t>::Pick(
+                layout, lens + 1, nlens - 1);
+        case 2:
+            return CodecPicker<can_grow, NVarlen, Fixed..., uint16_t>::Pick(
+                layout, lens + 1, nlens - 1);
+        case 4:
+            return CodecPicker<can_grow, NVarlen, Fixed..., uint32_t>::Pick(
+                layout, lens + 1, nlens - 1);
+        case 8:
+            return CodecPicker<can_grow, NVarlen, Fixed..., uint64_t>::Pick(
+                layout, lens + 1, nlens - 1);
+        }
+        return nullptr;
+    }
+};
+
+}   // namespace
+
+std::unique_ptr<PayloadCodec>
+PayloadCodec::Create(const Schema *schema) {
+    if (!schema->IsLayoutComputed() ||
+        schema->m_num_nullable_fixedlen_fields > 0 ||
+        schema->m_num_nonnullable_fixedlen_fields > MaxNumFixedlenFields ||
+        schema->m_num_varlen_fields > MaxNumVarlenFields) {
+        return nullptr;
+    }
+
+    CodecLayout layout;
+    layout.m_null_bitmap_begin = schema->m_null_bitmap_begin;
+    layout.m_varlen_end_array_begin = schema->m_varlen_end_array_begin;
+    layout.m_varlen_payload_begin = schema->m_varlen_payload_begin;
+    std::vector<int16_t> lens;
+    for (FieldId i : schema->m_field_reorder_idx) {
+        const Schema::FieldInfo &field = schema->m_field[i];
+        if (field.m_typlen == -1) {
+            layout.m_varlen_fids.push_back(i);
+            layout.m_varlen_aligns.push_back((uint8_t) field.m_typalign);
+            layout.m_varlen_nullbits.push_back(field.m_nullbit_id);
+        } else {
+            if (field.m_typbyref)
+                return nullptr;
+            layout.m_fixed_fids.push_back(i);
+            layout.m_fixed_offs.push_back(field.m_offset);
+            lens.push_back(field.m_typlen);
+        }
+    }
+
+    switch (layout.m_varlen_fids.size()) {
+    case 0:
+        return CodecPicker<true, 0>::Pick(layout, lens.data(), lens.size());
+    case 1:
+        return CodecPicker<true, 1>::Pick(layout, lens.data(), lens.size());
+    case 2:
+        return CodecPicker<true, 2>::Pick(layout, lens.data(), lens.size());
+    }
+    return nullptr;
+}
+
+}   // namespace taco
@@ -8,6 +8,8 @@
 
 namespace taco {
 
+constexpr uint16_t Schema::VarlenEndExternalBit;
+
 static void inline
 copy_bytes(bool passbyref, int16_t len, const char *src, char *tgt) {
     if (passbyref) {
@@ -177,6 +179,7 @@ Schema::ComputeLayoutImpl(CCache *catcache) {
         m_varlen_end_array_begin = off;
         m_varlen_payload_begin = off;
         m_has_only_nonnullable_fixedlen_fields = true;
+        ComputeDeformEnds();
         m_layout_computed = true;
         return ;
     }
@@ -232,9 +235,25 @@ Schema::ComputeLayoutImpl(CCache *catcache) {
                             sizeof(FieldOffset) * num_varlen_fields));
     m_varlen_payload_begin = off;
 
+    ComputeDeformEnds();
     m_layout_computed = true;
 }
 
+void
+Schema::ComputeDeformEnds() {
+    FieldId num_fields = GetNumFields();
+    std::vector<FieldId> seqno(num_fields);
+    for (FieldId k = 0; k < num_fields; ++k) {
+        seqno[m_field_reorder_idx[k]] = k;
+    }
+    m_deform_end.resize(num_fields);
+    FieldId end = 0;
+    for (FieldId i = 0; i < num_fields; ++i) {
+        end = std::max(end, (FieldId)(seqno[i] + 1));
+        m_deform_end[i] = end;
+    }
+}
+
 void
 Schema::ComputeLayout() {
     ComputeLayoutImpl(g_db->catcache());
@@ -264,17 +283,14 @@ Schema::GetOffsetAndLength(
         FieldOffset begin;
         FieldOffset end;
         // variable-length field
-        const FieldOffset *varlen_end =
-            reinterpret_cast<const FieldOffset*>(payload +
-                                                 m_varlen_end_array_begin);
         FieldId varlen_idx = -m_field[field_id].m_offset - 1;
 
         // find the end offset
-        end = varlen_end[varlen_idx];
+        end = GetVarlenEnd(payload, varlen_idx);
 
         // find the (unaligned) begin offset
         if (varlen_idx > 0) {
-            begin = varlen_end[varlen_idx - 1];
+            begin = GetVarlenEnd(payload, varlen_idx - 1);
         } else {
             begin = m_varlen_payload_begin;
         }
@@ -296,10 +312,7 @@ Schema::GetOffsetAndLength(
     if (m_num_varlen_fields == 0) {
         off = m_varlen_payload_begin;
     } else {
-        const FieldOffset *varlen_end =
-            reinterpret_cast<const FieldOffset*>(payload +
-                                                 m_varlen_end_array_begin);
-        off = varlen_end[m_num_varlen_fields - 1];
+        off = GetVarlenEnd(payload, m_num_varlen_fields - 1);
     }
 
     const uint8_t *null_bitmap =
@@ -473,34 +486,111 @@ Schema::FieldIsNull(FieldId field_id, const char *payload) const {
     return null_bitmap[i >> 3] & (1 << (i & 7));
 }
 
+bool
+Schema::FieldIsExternal(FieldId field_id, const char *payload) const {
+    ASSERT(m_field[field_id].m_typlen == -1);
+    const uint16_t *varlen_end =
+        reinterpret_cast<const uint16_t*>(payload + m_varlen_end_array_begin);
+    return varlen_end[-m_field[field_id].m_offset - 1] & VarlenEndExternalBit;
+}
+
+void
+Schema::SetFieldExternal(FieldId field_id, char *payload) const {
+    ASSERT(m_field[field_id].m_typlen == -1);
+    uint16_t *varlen_end =
+        reinterpret_cast<uint16_t*>(payload + m_varlen_end_array_begin);
+    varlen_end[-m_field[field_id].m_offset - 1] |= VarlenEndExternalBit;
+}
+
 Datum
 Schema::GetField(FieldId field_id, const char *payload) const {
     if (FieldIsNull(field_id, payload)) {
         return Datum::FromNull();
     }
 
+    // Only the table can read a value stored out of line.
+    if (m_field[field_id].m_typlen == -1 &&
+            FieldIsExternal(field_id, payload)) {
+        LOG(kError, "field %d is stored out of line and must be read with "
+                    "Table::GetField()", (int) field_id);
+    }
+
     auto p = GetOffsetAndLength(field_id, payload);
-    if (m_field[field_id].m_typlen == -1) {
-        // varlen field
-        return Datum::FromVarlenBytes(payload + p.first, p.second);
+    return MakeFieldDatum(field_id, payload + p.first, p.second);
+}
+
+/*!
+ * Returns whether the null bit \p nullbit_id is set in \p null_bitmap, or
+ * false if it is negative, i.e., the field is not nullable.
+ */
+static inline bool
+NullBitIsSet(const uint8_t *null_bitmap, FieldId nullbit_id) {
+    return nullbit_id >= 0 &&
+        (null_bitmap[nullbit_id >> 3] & (1 << (nullbit_id & 7)));
+}
+
+void
+Schema::DeformPayload(const char *payload, FieldId max_field_id,
+                      std::pair<FieldOffset, FieldOffset> *offlen) const {
+    // As in GetOffsetAndLength(), an overflow is an assertion failure
+    // rather than a run-time error, so we don't check for it here.
+    const FieldId end = m_deform_end[max_field_id];
+    const FieldId fixedlen_end =
+        std::min(end, m_num_nonnullable_fixedlen_fields);
+    const FieldId varlen_end =
+        std::min(end, (FieldId)(m_num_nonnullable_fixedlen_fields +
+                                m_num_varlen_fields));
+    FieldId seqno = 0;
+
+    // the non-nullable fixed-len fields are at fixed offsets
+    for (; seqno < fixedlen_end; ++seqno) {
+        FieldId i = m_field_reorder_idx[seqno];
+        offlen[i] = std::make_pair(m_field[i].m_offset,
+                                   (FieldOffset) m_field[i].m_typlen);
     }
 
-    if (m_field[field_id].m_typbyref) {
-        // pass-by-reference fixed-len field
-        return Datum::FromVarlenBytes(payload + p.first,
-                                      m_field[field_id].m_typlen);
+    // Each varlen field begins at the end of the previous one, which is
+    // also the end of a null varlen field.
+    const uint8_t *null_bitmap =
+        reinterpret_cast<const uint8_t*>(payload + m_null_bitmap_begin);
+    FieldOffset off = m_varlen_payload_begin;
+    FieldId varlen_idx = 0;
+    for (; seqno < varlen_end; ++seqno, ++varlen_idx) {
+        FieldId i = m_field_reorder_idx[seqno];
+        FieldOffset field_end = GetVarlenEnd(payload, varlen_idx);
+        if (NullBitIsSet(null_bitmap, m_field[i].m_nullbit_id)) {
+            offlen[i] = std::make_pair(off, (FieldOffset) -1);
+        } else {
+            FieldOffset begin = TYPEALIGN(m_field[i].m_typalign, off);
+            offlen[i] = std::make_pair(begin, (FieldOffset)(field_end -
+                                                            begin));
+        }
+        off = field_end;
     }
 
-    // pass-by-value fixed-len field
-    return Datum::FromFixedlenBytes(payload + p.first, p.second);
+    // the nullable fixed-len fields follow the varlen fields, skipping the
+    // null ones
+    for (; seqno < end; ++seqno) {
+        FieldId i = m_field_reorder_idx[seqno];
+        if (NullBitIsSet(null_bitmap, m_field[i].m_nullbit_id)) {
+            offlen[i] = std::make_pair(off, (FieldOffset) -1);
+            continue;
+        }
+        FieldOffset begin = TYPEALIGN(m_field[i].m_typalign, off);
+        offlen[i] = std::make_pair(begin, (FieldOffset) m_field[i].m_typlen);
+        off = begin + m_field[i].m_typlen;
+    }
 }
 
 std::vector<Datum>
 Schema::DissemblePayload(const char *payload) const {
     std::vector<Datum> ret;
     FieldId n = GetNumFields();
+    std::vector<std::pair<FieldOffset, FieldOffset>> offlen(n);
+    DeformPayload(payload, n - 1, offlen.data());
+    ret.reserve(n);
     for (FieldId i = 0; i < n; ++i) {
-        ret.emplace_back(GetField(i, payload));
+        ret.emplace_back(GetDeformedField(i, payload, offlen.data()));
     }
     return ret;
 }
@@ -39,4 +39,22 @@ TableDesc::Create(std::shared_ptr<const SysTable_Table> table,
     return new TableDesc(std::move(table), std::move(schema));
 }
 
+std::vector<Datum>
+TableDesc::DissemblePayload(const char *payload) const {
+    if (!m_codec)
+        return m_schema->DissemblePayload(payload);
+
+    // A specialized schema is small enough for the offsets to be on the
+    // stack.
+    std::pair<FieldOffset, FieldOffset> offlen[PayloadCodec::MaxNumFields];
+    m_codec->DeformPayload(payload, offlen);
+    std::vector<Datum> ret;
+    FieldId n = m_schema->GetNumFields();
+    ret.reserve(n);
+    for (FieldId i = 0; i < n; ++i) {
+        ret.emplace_back(m_schema->GetDeformedField(i, payload, offlen));
+    }
+    return ret;
+}
+
 }    // namespace taco
@@ -55,7 +55,7 @@ BootstrapCatCache::BootstrapCatCache():
 bootstrap_tabnames = set(["Table", "Column", "Type", "Function"])
 for d in datalist:
     if d["tabname"] in bootstrap_tabnames:
-        print("BEGIN_BRACKET {}, {}, {}, {}, {}, \"{}\"}},".format(d["tabid"], d["tabissys"] and "true" or "false", d["tabisvarlen"] and "true" or "false", d["tabncols"], d["tabfid"], d["tabname"]))
+        print("BEGIN_BRACKET {}, {}, {}, {}, {}, {}, \"{}\"}},".format(d["tabid"], d["tabissys"] and "true" or "false", d["tabisvarlen"] and "true" or "false", d["tablayout"], d["tabncols"], d["tabfid"], d["tabname"]))
 
 ' | ${CXX} -E - | ${PYTHON3}
     )"'
@@ -2,10 +2,15 @@
 #include "dbmain/Database.h"
 
 #include <absl/flags/flag.h>
+#include <absl/strings/str_cat.h>
 #include <absl/strings/str_join.h>
 
 #include "catalog/CatCache.h"
 #include "query/expr/optypes.h"
+#include "storage/BufferManager.h"
+#include "storage/ColumnarTable.h"
+#include "storage/FileManager.h"
+#include "storage/Table.h"
 #include "utils/builtin_funcs.h"
 #include "utils/fsutils.h"
 
@@ -18,6 +23,14 @@ namespace taco {
 static Database s_db_instance;
 Database * const g_db = &s_db_instance;
 
+//! the file in the database directory where the resident pages of the
+//! buffer pool are saved at close for a warm restart
+static constexpr const char *s_bufpool_state_filename = "bufpool_state";
+
+//! the file in the database directory where the buffer manager statistics
+//! are periodically dumped
+static constexpr const char *s_bufman_stats_filename = "bufman_stats";
+
 static bool s_init_global_called = false;
 bool g_test_no_bufman = false;
 bool g_test_no_catcache = false;
@@ -52,6 +65,39 @@ Database::open(const std::string &path,
     }
 
     m_db_path = path;
+    m_file_manager = nullptr;
+    m_buf_manager = nullptr;
+    m_catcache = nullptr;
+
+    if (create) {
+        if (dir_exists(path.c_str()) && !dir_empty(path.c_str())) {
+            if (!allow_overwrite) {
+                LOG(kFatal, "database directory %s already exists", path);
+            }
+            remove_dir(path.c_str());
+        }
+        std::string path_copy = path;
+        if (pg_mkdir_p(&path_copy[0], 0700) != 0) {
+            LOG(kFatal, "unable to create database directory %s: %s",
+                path, strerror(errno));
+        }
+    } else if (!dir_exists(path.c_str())) {
+        LOG(kFatal, "database directory %s does not exist", path);
+    }
+
+    m_file_manager = new FileManager();
+    m_file_manager->Init(path, create);
+
+    if (!g_test_no_bufman) {
+        m_buf_manager = new BufferManager();
+        m_buf_manager->Init(bpool_size);
+        if (!create) {
+            m_buf_manager->StartPrewarm(
+                absl::StrCat(path, "/", s_bufpool_state_filename));
+        }
+        m_buf_manager->StartStatsDump(
+            absl::StrCat(path, "/", s_bufman_stats_filename));
+    }
 
     if (!g_test_no_catcache) {
         m_catcache = new CatCache();
@@ -77,6 +123,26 @@ Database::close()
         m_catcache = nullptr;
     }
 
+    if (m_buf_manager) {
+        try {
+            m_buf_manager->SaveResidentPages(
+                absl::StrCat(m_db_path, "/", s_bufpool_state_filename));
+        } catch (const TDBError &e) {
+            // Not a big deal, we'll just start with a cold cache next time.
+            LOG(kWarning, "unable to save the buffer pool state: %s",
+                          e.GetMessage());
+        }
+        m_buf_manager->Destroy();
+        delete m_buf_manager;
+        m_buf_manager = nullptr;
+    }
+
+    if (m_file_manager) {
+        m_file_manager->Destroy();
+        delete m_file_manager;
+        m_file_manager = nullptr;
+    }
+
     m_initialized = false;
 }
 
@@ -86,9 +152,36 @@ Database::CreateTable(absl::string_view tabname,
                       std::vector<uint64_t> coltypparam,
                       const std::vector<absl::string_view> &field_names,
                       std::vector<bool> colisnullable,
-                      std::vector<bool> colisarray) {
+                      std::vector<bool> colisarray,
+                      uint8_t tablayout) {
+
+    FileId tabfid;
+    {
+        std::unique_ptr<File> f = m_file_manager->Open(NEW_REGULAR_FID);
+        tabfid = f->GetFileId();
+    }
+
+    std::vector<std::string> field_names_str;
+    field_names_str.reserve(field_names.size());
+    for (absl::string_view field_name : field_names) {
+        field_names_str.emplace_back(field_name);
+    }
 
-    LOG(kFatal, "not available until heap file is implemented");
+    Oid tabid = m_catcache->AddTable(tabname,
+                                     std::move(coltypid),
+                                     std::move(coltypparam),
+                                     std::move(field_names_str),
+                                     std::move(colisnullable),
+                                     std::move(colisarray),
+                                     tabfid,
+                                     tablayout);
+    std::shared_ptr<const TableDesc> tabdesc =
+        m_catcache->FindTableDesc(tabid);
+    if (tablayout == TABLAYOUT_COLUMNAR) {
+        ColumnarTable::Initialize(tabdesc.get());
+    } else {
+        Table::Initialize(tabdesc.get());
+    }
 }
 
 void
@@ -0,0 +1,1543 @@
+#include "storage/BufferManager.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include <absl/flags/flag.h>
+#include <absl/strings/str_format.h>
+
+#include "storage/FSFile.h"
+
+ABSL_FLAG(bool, bufman_huge_pages, true,
+          "Whether to back the buffer pool with huge pages if available");
+ABSL_FLAG(uint64_t, bufman_bgwriter_delay_ms, 200,
+          "The sleep time between two rounds of the background writer, "
+          "or 0 to disable the background writer");
+ABSL_FLAG(uint64_t, bufman_bgwriter_maxpages, 100,
+          "The maximum number of pages the background writer writes in "
+          "one round");
+ABSL_FLAG(uint64_t, bufman_max_pool_size, 0,
+          "The maximum number of frames the buffer pool may be resized to, "
+          "or 0 for 4 times the initial size");
+ABSL_FLAG(uint32_t, bufman_prewarm_threads, 2,
+          "The number of threads to prewarm the buffer pool with after a "
+          "restart, or 0 to disable prewarming");
+ABSL_FLAG(uint32_t, bufman_readahead_max_pages, 32,
+          "The maximum number of pages to read ahead for a sequential scan, "
+          "or 0 to disable read-ahead");
+ABSL_FLAG(uint64_t, bufman_compressed_cache_size, 0,
+          "The memory budget in bytes of the compressed page cache behind "
+          "the buffer pool, or 0 to disable it");
+ABSL_FLAG(bool, test_never_map_hugetlb, false,
+          "Whether to always fall back to transparent huge pages for the "
+          "buffer pool, even if MAP_HUGETLB is available");
+ABSL_FLAG(uint64_t, bufman_stats_dump_interval_ms, 60000,
+          "The interval between two dumps of the buffer manager statistics "
+          "to the stats file, or 0 to disable the dumps");
+
+namespace taco {
+
+//! The size of the huge pages we try to back the buffer pool with.
+static constexpr size_t s_huge_page_size = 2 * 1024 * 1024;
+
+//! The initial read-ahead window once a sequential scan is detected.
+static constexpr uint32_t s_readahead_min_pages = 4;
+
+//! The maximum number of pending read-ahead requests.
+static constexpr size_t s_max_prefetch_queue_len = 64;
+
+namespace {
+
+constexpr uint64_t PREWARM_MAGIC = 0x54444250524557ul;
+
+/*!
+ * The header of the file saved by BufferManager::SaveResidentPages(), which
+ * is followed by \p m_npages \p PrewarmEntry's sorted by (FileId,
+ * PageNumber).
+ */
+struct PrewarmFileHeader {
+    uint64_t    m_magic;
+    uint64_t    m_npages;
+};
+
+struct PrewarmEntry {
+    FileId      m_fid;
+    PageNumber  m_pid;
+    uint32_t    m_usage;
+};
+
+//! whether this thread is a prefetcher thread, which never reads ahead
+thread_local bool s_is_prefetcher = false;
+
+//! whether this thread is a prewarm thread, which is also a prefetcher
+thread_local bool s_is_prewarmer = false;
+
+std::atomic<size_t> s_next_stat_stripe(0);
+
+//! the stripe of the pool counters this thread updates
+thread_local size_t s_stat_stripe =
+    s_next_stat_stripe.fetch_add(1, memory_order_relaxed);
+
+//! the fields of BufferCounters in the order of BufferManager::StatCounter
+uint64_t BufferCounters::* const s_counter_fields[] = {
+    &BufferCounters::m_hits,
+    &BufferCounters::m_misses,
+    &BufferCounters::m_evictions,
+    &BufferCounters::m_eviction_writebacks,
+    &BufferCounters::m_background_writebacks,
+    &BufferCounters::m_pin_waits,
+    &BufferCounters::m_latch_waits,
+    &BufferCounters::m_readahead_pages,
+    &BufferCounters::m_readahead_hits,
+    &BufferCounters::m_readahead_wasted,
+    &BufferCounters::m_prewarm_pages,
+    &BufferCounters::m_compressed_hits,
+};
+
+void
+AppendCounters(std::string &s, const BufferCounters &counters) {
+    absl::StrAppendFormat(&s, "hits %lu\n", counters.m_hits);
+    absl::StrAppendFormat(&s, "misses %lu\n", counters.m_misses);
+    absl::StrAppendFormat(&s, "hit_ratio %.4f\n", counters.GetHitRatio());
+    absl::StrAppendFormat(&s, "evictions %lu\n", counters.m_evictions);
+    absl::StrAppendFormat(&s, "eviction_writebacks %lu\n",
+                          counters.m_eviction_writebacks);
+    absl::StrAppendFormat(&s, "background_writebacks %lu\n",
+                          counters.m_background_writebacks);
+    absl::StrAppendFormat(&s, "pin_waits %lu\n", counters.m_pin_waits);
+    absl::StrAppendFormat(&s, "latch_waits %lu\n", counters.m_latch_waits);
+    absl::StrAppendFormat(&s, "readahead_pages %lu\n",
+                          counters.m_readahead_pages);
+    absl::StrAppendFormat(&s, "readahead_hits %lu\n",
+                          counters.m_readahead_hits);
+    absl::StrAppendFormat(&s, "readahead_wasted %lu\n",
+                          counters.m_readahead_wasted);
+    absl::StrAppendFormat(&s, "prewarm_pages %lu\n",
+                          counters.m_prewarm_pages);
+    absl::StrAppendFormat(&s, "compressed_hits %lu\n",
+                          counters.m_compressed_hits);
+}
+
+}   // namespace
+
+std::unique_ptr<BufferAccessStrategy>
+BufferAccessStrategy::Create(BufferAccessStrategyType type) {
+    switch (type) {
+    case BufferAccessStrategyType::BULKREAD:
+        return Create(type, 256 * 1024);
+    case BufferAccessStrategyType::BULKWRITE:
+        return Create(type, 16 * 1024 * 1024);
+    case BufferAccessStrategyType::VACUUM:
+        return Create(type, 256 * 1024);
+    }
+    LOG(kFatal, "unknown buffer access strategy type %d", (int) type);
+    return nullptr;
+}
+
+std::unique_ptr<BufferAccessStrategy>
+BufferAccessStrategy::Create(BufferAccessStrategyType type, size_t ring_size) {
+    size_t nframes = ring_size / PAGE_SIZE;
+    BufferManager *bufman = g_bufman;
+    if (bufman) {
+        nframes = std::min(nframes, bufman->GetPoolSize() / 8);
+    }
+    nframes = std::max(nframes, (size_t) 1);
+    return std::unique_ptr<BufferAccessStrategy>(
+        new BufferAccessStrategy(type, nframes));
+}
+
+BufferManager::BufferManager():
+    m_initialized(false),
+    m_nframes(0),
+    m_max_nframes(0),
+    m_frames(nullptr),
+    m_frames_mapsize(0),
+    m_desc(nullptr),
+    m_bgwriter_running(false),
+    m_bgwriter_stop(false),
+    m_bgwriter_wakeup(false),
+    m_readahead_max_pages(0),
+    m_prefetcher_stop(false),
+    m_prewarm_stop(false),
+    m_background_pins(0),
+    m_stats(nullptr),
+    m_stats_dump_interval_ms(0),
+    m_stats_dumper_stop(false),
+    m_clock_hand(0) {
+}
+
+BufferManager::~BufferManager() {
+    Destroy();
+}
+
+void
+BufferManager::Init(size_t pool_size, size_t max_pool_size) {
+    if (m_initialized) {
+        LOG(kFatal, "BufferManager has already been initialized");
+    }
+    if (pool_size == 0) {
+        LOG(kFatal, "buffer pool size must be positive");
+    }
+
+    if (max_pool_size == 0) {
+        max_pool_size = absl::GetFlag(FLAGS_bufman_max_pool_size);
+        if (max_pool_size == 0)
+            max_pool_size = pool_size * 4;
+    }
+    if (max_pool_size < pool_size) {
+        LOG(kFatal, "the maximum buffer pool size %lu is smaller than the "
+                    "buffer pool size %lu", max_pool_size, pool_size);
+    }
+
+    m_nframes.store(pool_size, memory_order_relaxed);
+    m_max_nframes = max_pool_size;
+    AllocateFrames();
+
+    m_desc_mem = unique_aligned_alloc(CACHELINE_SIZE,
+                                      m_max_nframes * sizeof(BufferDesc));
+    if (!m_desc_mem) {
+        FreeFrames();
+        LOG(kFatal, "unable to allocate %lu buffer descriptors",
+                    m_max_nframes);
+    }
+    m_desc = (BufferDesc*) m_desc_mem.get();
+    for (size_t i = 0; i < m_max_nframes; ++i) {
+        new (&m_desc[i]) BufferDesc();
+        m_desc[i].m_pid.store(INVALID_PID, memory_order_relaxed);
+        m_desc[i].m_pincnt.store(0, memory_order_relaxed);
+        m_desc[i].m_dirty.store(false, memory_order_relaxed);
+        m_desc[i].m_usage.store(0, memory_order_relaxed);
+        m_desc[i].m_io_in_progress = false;
+        m_desc[i].m_write_in_progress = false;
+        m_desc[i].m_file_stats = nullptr;
+        m_desc[i].m_prefetched.store(false, memory_order_relaxed);
+    }
+
+    m_stats_mem = unique_aligned_alloc(CACHELINE_SIZE,
+                                       NumStatStripes * sizeof(StatStripe));
+    if (!m_stats_mem) {
+        m_desc_mem.reset();
+        FreeFrames();
+        LOG(kFatal, "unable to allocate the buffer manager statistics");
+    }
+    m_stats = (StatStripe*) m_stats_mem.get();
+    for (size_t i = 0; i < NumStatStripes; ++i) {
+        new (&m_stats[i]) StatStripe();
+    }
+    size_t compressed_cache_size =
+        absl::GetFlag(FLAGS_bufman_compressed_cache_size);
+    if (compressed_cache_size > 0) {
+        m_compressed_cache.reset(
+            new CompressedPageCache(compressed_cache_size));
+    }
+    m_pagetable.reserve(pool_size);
+    m_clock_hand = 0;
+    m_initialized = true;
+    StartBgWriter();
+    StartPrefetcher();
+}
+
+void
+BufferManager::AllocateFrames() {
+    // The range for the maximum pool size is mapped with MAP_NORESERVE
+    // unless we use MAP_HUGETLB, so that we only pay for the frames that
+    // have been used.
+    size_t size = m_max_nframes * PAGE_SIZE;
+    if (!absl::GetFlag(FLAGS_bufman_huge_pages)) {
+        void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            LOG(kFatal, "unable to allocate a buffer pool of %lu frames: %s",
+                        m_max_nframes, strerror(errno));
+        }
+        m_frames = (char*) p;
+        m_frames_mapsize = size;
+        return ;
+    }
+
+    size = TYPEALIGN(s_huge_page_size, size);
+    void *p;
+#ifdef MAP_HUGETLB
+    // This only succeeds if there are enough huge pages reserved in
+    // /proc/sys/vm/nr_hugepages for the maximum pool size. We can't use
+    // MAP_NORESERVE here, or a page fault would fail with SIGBUS if we later
+    // run out of huge pages.
+    if (!absl::GetFlag(FLAGS_test_never_map_hugetlb)) {
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            m_frames = (char*) p;
+            m_frames_mapsize = size;
+            return ;
+        }
+    }
+#endif
+
+    // Fall back to transparent huge pages on a mapping aligned to the huge
+    // page size. Over-allocate and trim the unaligned head and tail.
+    size_t mapsize = size + s_huge_page_size;
+    p = mmap(nullptr, mapsize, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        LOG(kFatal, "unable to allocate a buffer pool of %lu frames: %s",
+                    m_max_nframes, strerror(errno));
+    }
+    char *begin = (char*) p;
+    char *aligned_begin =
+        (char*) TYPEALIGN(s_huge_page_size, (uintptr_t) begin);
+    char *end = begin + mapsize;
+    char *aligned_end = aligned_begin + size;
+    if (aligned_begin != begin) {
+        munmap(begin, aligned_begin - begin);
+    }
+    if (aligned_end != end) {
+        munmap(aligned_end, end - aligned_end);
+    }
+
+#ifdef MADV_HUGEPAGE
+    // Not a fatal error if THP is disabled in the kernel.
+    if (madvise(aligned_begin, size, MADV_HUGEPAGE) != 0) {
+        LOG(kInfo, "madvise(MADV_HUGEPAGE) failed on the buffer pool: %s",
+                   strerror(errno));
+    }
+#endif
+    m_frames = aligned_begin;
+    m_frames_mapsize = size;
+}
+
+void
+BufferManager::FreeFrames() {
+    if (m_frames) {
+        munmap(m_frames, m_frames_mapsize);
+        m_frames = nullptr;
+        m_frames_mapsize = 0;
+    }
+}
+
+void
+BufferManager::Destroy() {
+    if (!m_initialized)
+        return;
+
+    StopStatsDump();
+    StopPrewarm();
+    StopPrefetcher();
+    StopBgWriter();
+    FlushAll();
+    for (size_t i = 0; i < m_max_nframes; ++i) {
+        if (m_desc[i].m_pincnt.load(memory_order_relaxed) != 0) {
+            LOG(kWarning, "page " PAGENUMBER_FORMAT " is still pinned "
+                          "when the buffer manager is destroyed",
+                          m_desc[i].m_pid.load(memory_order_relaxed));
+        }
+    }
+    m_pagetable.clear();
+    m_desc_mem.reset();
+    m_desc = nullptr;
+    m_compressed_cache.reset();
+    m_file_stats.clear();
+    m_stats_mem.reset();
+    m_stats = nullptr;
+    FreeFrames();
+    m_nframes.store(0, memory_order_relaxed);
+    m_max_nframes = 0;
+    m_initialized = false;
+}
+
+void
+BufferManager::Resize(size_t pool_size) {
+    if (pool_size == 0 || pool_size > m_max_nframes) {
+        LOG(kError, "invalid buffer pool size %lu: must be between 1 and %lu",
+                    pool_size, m_max_nframes);
+    }
+
+    std::lock_guard<std::mutex> resize_guard(m_resize_mutex);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    size_t old_pool_size = m_nframes.load(memory_order_relaxed);
+    if (pool_size >= old_pool_size) {
+        // The new frames are all empty since the last shrink, so they are
+        // ready to use right away.
+        m_nframes.store(pool_size, memory_order_relaxed);
+        return ;
+    }
+
+    // Hide the frames to drain from the clock and the background writer
+    // first, so that no new page is loaded into them. The pages in them may
+    // still be found in the page table until they are evicted.
+    m_nframes.store(pool_size, memory_order_relaxed);
+    if (m_clock_hand >= pool_size)
+        m_clock_hand = 0;
+
+    // The dirty pages are handed to the background writer, or written in
+    // batches by ourselves without holding the mutex if it is not running.
+    std::vector<BufferId> batch;
+    for (;;) {
+        bool drained = true;
+        batch.clear();
+        for (BufferId bufid = pool_size; bufid < old_pool_size; ++bufid) {
+            BufferDesc &desc = m_desc[bufid];
+            if (desc.m_pid == INVALID_PID)
+                continue;
+            drained = false;
+            if (!IsEvictable(desc))
+                continue;
+            if (desc.m_dirty.load(memory_order_acquire)) {
+                if (m_bgwriter_running) {
+                    m_bgwriter_requests.push_back(bufid);
+                } else {
+                    BeginWrite(desc);
+                    batch.push_back(bufid);
+                }
+                continue;
+            }
+            if (!ClaimFrame(desc))
+                continue;
+            EvictFrame(bufid);
+            desc.m_usage.store(0, memory_order_relaxed);
+            ReleaseClaim(desc);
+        }
+        if (drained)
+            break;
+
+        if (!batch.empty()) {
+            lock.unlock();
+            try {
+                WriteFrames(batch, EvictionWritebacks);
+            } catch (...) {
+                // Give the frames that are not drained back to the pool.
+                lock.lock();
+                m_nframes.store(old_pool_size, memory_order_relaxed);
+                throw;
+            }
+            lock.lock();
+            continue;
+        }
+        if (!m_bgwriter_requests.empty()) {
+            m_bgwriter_wakeup = true;
+            m_bgwriter_cv.notify_one();
+        }
+        // UnpinPage() does not signal anyone, so poll.
+        m_io_cv.wait_for(lock, std::chrono::milliseconds(1));
+    }
+    lock.unlock();
+
+    // Return the memory of the drained frames to the OS, in segments of the
+    // huge page size.
+    char *begin = (char*) TYPEALIGN(s_huge_page_size,
+                                    (uintptr_t) GetBuffer(pool_size));
+    char *end = GetBuffer(old_pool_size);
+    if (begin < end && madvise(begin, end - begin, MADV_DONTNEED) != 0) {
+        // The pool is still shrunk, it just keeps the memory.
+        LOG(kWarning, "madvise(MADV_DONTNEED) failed on the drained buffer "
+                      "frames: %s", strerror(errno));
+    }
+}
+
+BufferId
+BufferManager::PinPage(PageNumber pid, char **frame,
+                       BufferAccessStrategy *strategy,
+                       ReadAheadState *readahead) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        auto iter = m_pagetable.find(pid);
+        if (iter == m_pagetable.end())
+            break;
+
+        BufferId bufid = iter->second;
+        BufferDesc &desc = m_desc[bufid];
+        desc.m_pincnt.fetch_add(1, memory_order_relaxed);
+        if (!strategy) {
+            if (desc.m_usage < MaxUsageCount)
+                ++desc.m_usage;
+        } else if (desc.m_usage == 0) {
+            // Don't let a bulk operation promote a page it merely hits.
+            desc.m_usage = 1;
+        }
+
+        if (desc.m_io_in_progress) {
+            CountEvent(PinWaits, nullptr);
+            do {
+                m_io_cv.wait(lock);
+            } while (desc.m_io_in_progress);
+        }
+        if (desc.m_pid != pid) {
+            // the read failed and the frame has been released; retry
+            desc.m_pincnt.fetch_sub(1, memory_order_relaxed);
+            continue;
+        }
+        if (!s_is_prefetcher) {
+            ResolveFileStats(bufid);
+            CountEvent(Hits, &desc);
+            if (desc.m_prefetched.load(memory_order_relaxed) &&
+                desc.m_prefetched.exchange(false, memory_order_relaxed))
+                CountEvent(ReadAheadHits, &desc);
+        }
+        *frame = GetBuffer(bufid);
+        lock.unlock();
+        if (!strategy)
+            MaybeReadAhead(pid, *frame, readahead);
+        return bufid;
+    }
+
+    BufferId bufid;
+    for (;;) {
+        bufid = strategy ? FindVictimFromStrategy(lock, strategy)
+                         : FindVictim(lock);
+        BufferDesc &victim = m_desc[bufid];
+        if (victim.m_dirty.load(memory_order_acquire)) {
+            // Only if the background writer is not running. Someone may
+            // pin or dirty the page again while we write it.
+            CleanVictim(lock, bufid);
+            if (!IsEvictable(victim) ||
+                victim.m_dirty.load(memory_order_acquire))
+                continue;
+        }
+
+        // We might have released the lock while waiting for a clean frame,
+        // so someone else may have read the page in the meantime.
+        auto iter = m_pagetable.find(pid);
+        if (iter != m_pagetable.end()) {
+            lock.unlock();
+            return PinPage(pid, frame, strategy, readahead);
+        }
+
+        // Claim the frame, which fails only if someone has just pinned it
+        // through a swizzled reference.
+        if (!ClaimFrame(m_desc[bufid]))
+            continue;
+        if (strategy || !MaybeCompressVictim(lock, bufid))
+            break;
+
+        // We have released the lock to compress the old page.
+        if (m_pagetable.contains(pid)) {
+            EvictFrame(bufid);
+            m_desc[bufid].m_usage.store(0, memory_order_relaxed);
+            ReleaseClaim(m_desc[bufid]);
+            lock.unlock();
+            return PinPage(pid, frame, strategy, readahead);
+        }
+        break;
+    }
+    EvictFrame(bufid);
+
+    BufferDesc &desc = m_desc[bufid];
+    desc.m_pid.store(pid, memory_order_relaxed);
+    desc.m_dirty.store(false, memory_order_relaxed);
+    desc.m_usage.store(1, memory_order_relaxed);
+    desc.m_io_in_progress = true;
+    m_pagetable.emplace(pid, bufid);
+    lock.unlock();
+
+    bool from_compressed_cache = false;
+    try {
+        if (m_compressed_cache &&
+            m_compressed_cache->Lookup(pid, GetBuffer(bufid))) {
+            from_compressed_cache = true;
+        } else {
+            g_fileman->ReadPage(pid, GetBuffer(bufid));
+        }
+    } catch (...) {
+        lock.lock();
+        m_pagetable.erase(pid);
+        desc.m_pid.store(INVALID_PID, memory_order_relaxed);
+        desc.m_usage.store(0, memory_order_relaxed);
+        desc.m_io_in_progress = false;
+        desc.m_pincnt.fetch_and(~FrameBusyBit, memory_order_release);
+        desc.m_pincnt.fetch_sub(1, memory_order_release);
+        m_io_cv.notify_all();
+        throw;
+    }
+
+    lock.lock();
+    desc.m_io_in_progress = false;
+    ResolveFileStats(bufid);
+    if (s_is_prewarmer) {
+        CountEvent(PrewarmPages, &desc);
+    } else if (s_is_prefetcher) {
+        CountEvent(ReadAheadPages, &desc);
+        desc.m_prefetched.store(true, memory_order_relaxed);
+    } else {
+        CountEvent(Misses, &desc);
+    }
+    if (from_compressed_cache)
+        CountEvent(CompressedHits, &desc);
+    // Keeps our own pin.
+    desc.m_pincnt.fetch_and(~FrameBusyBit, memory_order_release);
+    m_io_cv.notify_all();
+    lock.unlock();
+    *frame = GetBuffer(bufid);
+    if (!strategy)
+        MaybeReadAhead(pid, *frame, readahead);
+    return bufid;
+}
+
+void
+BufferManager::UnpinPage(BufferId bufid) {
+    ASSERT(bufid < m_max_nframes);
+    uint32_t pincnt = m_desc[bufid].m_pincnt.fetch_sub(1,
+                                                       memory_order_release);
+    if ((pincnt & ~FrameBusyBit) == 0) {
+        m_desc[bufid].m_pincnt.fetch_add(1, memory_order_relaxed);
+        LOG(kError, "buffer frame " BUFFERID_FORMAT " is not pinned", bufid);
+    }
+}
+
+void
+BufferManager::MarkDirty(BufferId bufid) {
+    ASSERT(bufid < m_max_nframes);
+    ASSERT((m_desc[bufid].m_pincnt.load(memory_order_relaxed) &
+            ~FrameBusyBit) > 0);
+    m_desc[bufid].m_dirty.store(true, memory_order_release);
+}
+
+void
+BufferManager::FlushAll() {
+    WriteAllDirtyPages(0);
+}
+
+void
+BufferManager::Checkpoint(uint64_t target_duration_ms) {
+    WriteAllDirtyPages(target_duration_ms);
+    g_fileman->Flush();
+}
+
+void
+BufferManager::WriteAllDirtyPages(uint64_t target_duration_ms) {
+    struct DirtyPage {
+        FileId      m_fid;
+        PageNumber  m_pid;
+        BufferId    m_bufid;
+    };
+
+    // Take a snapshot of the dirty pages. Pages dirtied after this point
+    // are left to the next checkpoint.
+    std::vector<DirtyPage> dirty_pages;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (BufferId bufid = 0; bufid < m_max_nframes; ++bufid) {
+        BufferDesc &desc = m_desc[bufid];
+        if (desc.m_pid != INVALID_PID && !desc.m_io_in_progress &&
+            (desc.m_dirty.load(memory_order_acquire) ||
+             desc.m_write_in_progress)) {
+            FileId fid = ((PageHeaderData*) GetBuffer(bufid))->GetFileId();
+            dirty_pages.push_back(DirtyPage{fid, desc.m_pid, bufid});
+        }
+    }
+    lock.unlock();
+
+    std::sort(dirty_pages.begin(), dirty_pages.end(),
+        [](const DirtyPage &a, const DirtyPage &b) -> bool {
+            return a.m_fid < b.m_fid ||
+                   (a.m_fid == b.m_fid && a.m_pid < b.m_pid);
+        });
+
+    auto start_time = std::chrono::steady_clock::now();
+    auto target_duration = std::chrono::milliseconds(target_duration_ms);
+
+    // Write the pages in batches of consecutive pages. We wait here if some
+    // of them are being written by someone else, so that all the pages in
+    // the snapshot are on the disk when we return.
+    std::vector<BufferId> batch;
+    size_t i = 0;
+    while (i < dirty_pages.size()) {
+        size_t j = i + 1;
+        while (j < dirty_pages.size() &&
+               dirty_pages[j].m_fid == dirty_pages[i].m_fid &&
+               dirty_pages[j].m_pid == dirty_pages[j - 1].m_pid + 1 &&
+               j - i < (size_t) IOV_MAX) {
+            ++j;
+        }
+
+        batch.clear();
+        lock.lock();
+        for (size_t k = i; k < j; ++k) {
+            BufferDesc &desc = m_desc[dirty_pages[k].m_bufid];
+            while (desc.m_pid == dirty_pages[k].m_pid &&
+                   desc.m_write_in_progress) {
+                m_io_cv.wait(lock);
+            }
+            if (desc.m_pid == dirty_pages[k].m_pid &&
+                !desc.m_io_in_progress &&
+                desc.m_dirty.load(memory_order_acquire)) {
+                BeginWrite(desc);
+                batch.push_back(dirty_pages[k].m_bufid);
+            }
+        }
+        lock.unlock();
+        if (!batch.empty()) {
+            WriteFrames(batch);
+        }
+        i = j;
+
+        if (target_duration_ms > 0) {
+            // Sleep if we are ahead of the schedule.
+            auto scheduled_time = start_time +
+                target_duration * i / dirty_pages.size();
+            std::this_thread::sleep_until(scheduled_time);
+        }
+    }
+}
+
+void
+BufferManager::WriteFrames(std::vector<BufferId> &bufids,
+                           StatCounter counter) {
+    std::vector<std::pair<FileId, BufferId>> order;
+    order.reserve(bufids.size());
+    for (BufferId bufid : bufids) {
+        order.emplace_back(((PageHeaderData*) GetBuffer(bufid))->GetFileId(),
+                           bufid);
+    }
+    std::sort(order.begin(), order.end(),
+        [&](const std::pair<FileId, BufferId> &a,
+            const std::pair<FileId, BufferId> &b) -> bool {
+            return a.first < b.first ||
+                   (a.first == b.first &&
+                    m_desc[a.second].m_pid < m_desc[b.second].m_pid);
+        });
+
+    std::vector<const char*> bufs;
+    bufs.reserve(order.size());
+    auto release_frames = [&]() {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (const auto &p : order) {
+            m_desc[p.second].m_write_in_progress = false;
+        }
+        m_io_cv.notify_all();
+    };
+
+    try {
+        size_t i = 0;
+        while (i < order.size()) {
+            PageNumber first_pid = m_desc[order[i].second].m_pid;
+            bufs.clear();
+            bufs.push_back(GetBuffer(order[i].second));
+            size_t j = i + 1;
+            while (j < order.size() &&
+                   m_desc[order[j].second].m_pid == first_pid + (j - i)) {
+                bufs.push_back(GetBuffer(order[j].second));
+                ++j;
+            }
+            g_fileman->WritePages(first_pid, bufs.data(), bufs.size());
+            for (; i < j; ++i) {
+                CountEvent(counter, &m_desc[order[i].second]);
+            }
+        }
+    } catch (...) {
+        // The pages must be written again later.
+        for (const auto &p : order) {
+            m_desc[p.second].m_dirty.store(true, memory_order_release);
+        }
+        release_frames();
+        throw;
+    }
+    release_frames();
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        bufids[i] = order[i].second;
+    }
+}
+
+void
+BufferManager::MaybeReadAhead(PageNumber pid, const char *frame,
+                              ReadAheadState *readahead) {
+    if (!readahead || m_readahead_max_pages == 0 || s_is_prefetcher)
+        return;
+
+    const PageHeaderData *ph = (const PageHeaderData*) frame;
+    if (!ph->IsVFileDataPage())
+        return;
+    FileId fid = ph->GetFileId();
+    PageNumber next_pid = ph->GetNextPageNumber();
+
+    ReadAheadState *st = readahead;
+    if (st->m_fid != fid) {
+        // The reader has just started on this file.
+        st->m_fid = fid;
+        st->m_next_pid = next_pid;
+        st->m_window = 0;
+        st->m_ahead = 0;
+        return;
+    }
+
+    if (st->m_next_pid != pid || next_pid == INVALID_PID) {
+        // Not (or no longer) a sequential scan.
+        st->m_next_pid = next_pid;
+        st->m_window = 0;
+        st->m_ahead = 0;
+        return;
+    }
+    st->m_next_pid = next_pid;
+    if (st->m_ahead > 0)
+        --st->m_ahead;
+
+    // Issue the next request when half of the window has been consumed, so
+    // that the prefetcher stays ahead of the scan.
+    if (st->m_ahead > st->m_window / 2)
+        return;
+    st->m_window = (st->m_window == 0) ? s_readahead_min_pages
+                   : std::min(st->m_window * 2, m_readahead_max_pages);
+    st->m_ahead = st->m_window;
+
+    std::lock_guard<std::mutex> guard(m_prefetch_mutex);
+    if (m_prefetch_queue.size() >= s_max_prefetch_queue_len) {
+        // The prefetcher is falling behind. Just drop the request.
+        return;
+    }
+    m_prefetch_queue.emplace_back(next_pid, st->m_window);
+    m_prefetch_cv.notify_one();
+}
+
+void
+BufferManager::StartPrefetcher() {
+    // Never read ahead more than a quarter of the buffer pool.
+    m_readahead_max_pages = (uint32_t) std::min(
+        (size_t) absl::GetFlag(FLAGS_bufman_readahead_max_pages),
+        GetPoolSize() / 4);
+    if (m_readahead_max_pages < s_readahead_min_pages) {
+        m_readahead_max_pages = 0;
+        return;
+    }
+
+    m_prefetcher_stop = false;
+    m_prefetcher = std::thread(&BufferManager::PrefetcherMain, this);
+}
+
+void
+BufferManager::StopPrefetcher() {
+    if (m_readahead_max_pages == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(m_prefetch_mutex);
+        m_prefetcher_stop = true;
+        m_prefetch_queue.clear();
+        m_prefetch_cv.notify_one();
+    }
+    m_prefetcher.join();
+    m_readahead_max_pages = 0;
+}
+
+void
+BufferManager::PrefetcherMain() {
+    s_is_prefetcher = true;
+    std::unique_lock<std::mutex> lock(m_prefetch_mutex);
+    for (;;) {
+        m_prefetch_cv.wait(lock, [&]() {
+            return m_prefetcher_stop || !m_prefetch_queue.empty();
+        });
+        if (m_prefetcher_stop)
+            break;
+        PageNumber pid = m_prefetch_queue.front().first;
+        uint32_t npages = m_prefetch_queue.front().second;
+        m_prefetch_queue.pop_front();
+        lock.unlock();
+
+        // Follow the page links. The pages that are already in the buffer
+        // pool are skipped quickly since pinning them does no I/O.
+        for (uint32_t i = 0; i < npages && pid != INVALID_PID; ++i) {
+            char *frame;
+            BufferId bufid;
+            m_background_pins.fetch_add(1, memory_order_relaxed);
+            try {
+                bufid = PinPage(pid, &frame);
+            } catch (const TDBError &e) {
+                // e.g., all the frames are pinned or the page is gone. This
+                // is only a hint anyway.
+                m_background_pins.fetch_sub(1, memory_order_relaxed);
+                break;
+            }
+            const PageHeaderData *ph = (const PageHeaderData*) frame;
+            pid = ph->IsVFileDataPage() ? ph->GetNextPageNumber()
+                                        : INVALID_PID;
+            UnpinPage(bufid);
+            m_background_pins.fetch_sub(1, memory_order_relaxed);
+        }
+        lock.lock();
+    }
+}
+
+void
+BufferManager::SaveResidentPages(const std::string &path) {
+    std::vector<PrewarmEntry> entries;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        entries.reserve(m_pagetable.size());
+        for (const auto &p : m_pagetable) {
+            const BufferDesc &desc = m_desc[p.second];
+            if (desc.m_io_in_progress)
+                continue;
+            FileId fid = ((PageHeaderData*) GetBuffer(p.second))->GetFileId();
+            entries.push_back(PrewarmEntry{fid, p.first, desc.m_usage});
+        }
+    }
+    std::sort(entries.begin(), entries.end(),
+        [](const PrewarmEntry &a, const PrewarmEntry &b) -> bool {
+            return a.m_fid < b.m_fid ||
+                   (a.m_fid == b.m_fid && a.m_pid < b.m_pid);
+        });
+
+    size_t size = sizeof(PrewarmFileHeader) +
+                  entries.size() * sizeof(PrewarmEntry);
+    std::vector<char> buf(size);
+    PrewarmFileHeader *hdr = (PrewarmFileHeader*) buf.data();
+    hdr->m_magic = PREWARM_MAGIC;
+    hdr->m_npages = entries.size();
+    if (!entries.empty()) {
+        memcpy(buf.data() + sizeof(PrewarmFileHeader), entries.data(),
+               entries.size() * sizeof(PrewarmEntry));
+    }
+
+    std::string tmp_path = path + ".tmp";
+    std::unique_ptr<FSFile> f(FSFile::Open(tmp_path, true, false, true));
+    if (!f) {
+        LOG(kError, "unable to create %s: %s", tmp_path, strerror(errno));
+    }
+    f->Allocate(size);
+    f->Write(buf.data(), size, 0);
+    f->Flush();
+    f->Close();
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        LOG(kError, "unable to rename %s to %s: %s",
+                    tmp_path, path, strerror(errno));
+    }
+}
+
+void
+BufferManager::StartPrewarm(const std::string &path) {
+    size_t nthreads = absl::GetFlag(FLAGS_bufman_prewarm_threads);
+    if (nthreads == 0)
+        return;
+
+    std::unique_ptr<FSFile> f(FSFile::Open(path, false, false, false));
+    if (!f)
+        return;
+
+    // The file is removed right away, so that a crash won't leave a stale
+    // one for the next restart.
+    std::vector<PrewarmEntry> entries;
+    size_t size = f->Size();
+    if (size >= sizeof(PrewarmFileHeader)) {
+        PrewarmFileHeader hdr;
+        f->Read(&hdr, sizeof(PrewarmFileHeader), 0);
+        if (hdr.m_magic == PREWARM_MAGIC &&
+            size == sizeof(PrewarmFileHeader) +
+                    hdr.m_npages * sizeof(PrewarmEntry)) {
+            entries.resize(hdr.m_npages);
+            if (!entries.empty()) {
+                f->Read(entries.data(),
+                        entries.size() * sizeof(PrewarmEntry),
+                        sizeof(PrewarmFileHeader));
+            }
+        } else {
+            LOG(kWarning, "ignoring invalid buffer pool state file %s", path);
+        }
+    }
+    f->Delete();
+    f->Close();
+
+    // The pages might have been freed since the file was saved, or even
+    // be out of the data files if they were truncated.
+    PageNumber npages = g_fileman->GetNumPages();
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+        [npages](const PrewarmEntry &e) -> bool {
+            return e.m_pid == INVALID_PID || e.m_pid >= npages;
+        }), entries.end());
+
+    size_t pool_size = GetPoolSize();
+    if (entries.size() > pool_size) {
+        std::stable_sort(entries.begin(), entries.end(),
+            [](const PrewarmEntry &a, const PrewarmEntry &b) -> bool {
+                return a.m_usage > b.m_usage;
+            });
+        entries.resize(pool_size);
+        std::sort(entries.begin(), entries.end(),
+            [](const PrewarmEntry &a, const PrewarmEntry &b) -> bool {
+                return a.m_fid < b.m_fid ||
+                       (a.m_fid == b.m_fid && a.m_pid < b.m_pid);
+            });
+    }
+    if (entries.empty())
+        return;
+
+    // Each thread reads a contiguous part of the sorted pages so that its
+    // reads are mostly sequential.
+    std::shared_ptr<std::vector<PrewarmEntry>> shared_entries =
+        std::make_shared<std::vector<PrewarmEntry>>(std::move(entries));
+    nthreads = std::min(nthreads, shared_entries->size());
+    size_t chunk_size = (shared_entries->size() + nthreads - 1) / nthreads;
+    m_prewarm_stop.store(false, memory_order_relaxed);
+    for (size_t i = 0; i < nthreads; ++i) {
+        size_t begin = i * chunk_size;
+        size_t end = std::min(begin + chunk_size, shared_entries->size());
+        m_prewarm_threads.emplace_back([this, shared_entries, begin, end]() {
+            s_is_prefetcher = true;
+            s_is_prewarmer = true;
+            for (size_t j = begin; j < end; ++j) {
+                if (m_prewarm_stop.load(memory_order_relaxed))
+                    break;
+                const PrewarmEntry &e = (*shared_entries)[j];
+                try {
+                    PrewarmPage(e.m_pid, (uint8_t) std::min(e.m_usage,
+                                            (uint32_t) MaxUsageCount));
+                } catch (const TDBError &err) {
+                    // e.g., all the frames are pinned by the queries.
+                    break;
+                }
+            }
+        });
+    }
+}
+
+void
+BufferManager::PrewarmPage(PageNumber pid, uint8_t usage) {
+    char *frame;
+    BufferId bufid;
+    m_background_pins.fetch_add(1, memory_order_relaxed);
+    try {
+        bufid = PinPage(pid, &frame);
+    } catch (...) {
+        m_background_pins.fetch_sub(1, memory_order_relaxed);
+        throw;
+    }
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        BufferDesc &desc = m_desc[bufid];
+        if (desc.m_usage < usage)
+            desc.m_usage = usage;
+    }
+    UnpinPage(bufid);
+    m_background_pins.fetch_sub(1, memory_order_relaxed);
+}
+
+void
+BufferManager::WaitForPrewarm() {
+    for (std::thread &t : m_prewarm_threads) {
+        t.join();
+    }
+    m_prewarm_threads.clear();
+}
+
+void
+BufferManager::StopPrewarm() {
+    m_prewarm_stop.store(true, memory_order_relaxed);
+    WaitForPrewarm();
+}
+
+bool
+BufferManager::IsPageResident(PageNumber pid) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_pagetable.contains(pid);
+}
+
+void
+BufferManager::StartBgWriter() {
+    if (absl::GetFlag(FLAGS_bufman_bgwriter_delay_ms) == 0)
+        return;
+
+    m_bgwriter_stop = false;
+    m_bgwriter_wakeup = false;
+    m_bgwriter_running = true;
+    m_bgwriter = std::thread(&BufferManager::BgWriterMain, this);
+}
+
+void
+BufferManager::StopBgWriter() {
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (!m_bgwriter_running)
+            return;
+        m_bgwriter_stop = true;
+        m_bgwriter_cv.notify_one();
+    }
+    m_bgwriter.join();
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_bgwriter_running = false;
+    m_bgwriter_requests.clear();
+    // Wake up anyone waiting for a clean frame. They will write the dirty
+    // page by themselves from now on.
+    m_io_cv.notify_all();
+}
+
+void
+BufferManager::BgWriterMain() {
+    const auto delay = std::chrono::milliseconds(
+        absl::GetFlag(FLAGS_bufman_bgwriter_delay_ms));
+    const size_t maxpages = absl::GetFlag(FLAGS_bufman_bgwriter_maxpages);
+
+    std::vector<BufferId> batch;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_bgwriter_stop) {
+        // Try to keep the next quarter of the frames ahead of the clock hand
+        // clean, as those are the ones to be evicted soon.
+        const size_t nframes = m_nframes.load(memory_order_relaxed);
+        const size_t scan_limit = std::max(nframes / 4, (size_t) 1);
+
+        // The frames handed over by the rings of the buffer access
+        // strategies come first.
+        batch.clear();
+        for (BufferId bufid : m_bgwriter_requests) {
+            BufferDesc &desc = m_desc[bufid];
+            if (desc.m_pid == INVALID_PID || !IsEvictable(desc) ||
+                !desc.m_dirty.load(memory_order_acquire)) {
+                continue;
+            }
+            BeginWrite(desc);
+            batch.push_back(bufid);
+        }
+        m_bgwriter_requests.clear();
+
+        BufferId bufid = m_clock_hand;
+        for (size_t n = 0; n < scan_limit && batch.size() < maxpages; ++n) {
+            BufferDesc &desc = m_desc[bufid];
+            if (++bufid == nframes)
+                bufid = 0;
+            if (desc.m_pid == INVALID_PID || !IsEvictable(desc) ||
+                desc.m_usage > 0 ||
+                !desc.m_dirty.load(memory_order_acquire)) {
+                continue;
+            }
+            BeginWrite(desc);
+            batch.push_back(&desc - m_desc);
+        }
+
+        if (!batch.empty()) {
+            lock.unlock();
+            try {
+                WriteFrames(batch);
+            } catch (const TDBError &e) {
+                // The pages are still dirty. Leave them to the next round or
+                // the foreground.
+                LOG(kWarning, "background writer failed: %s", e.GetMessage());
+            }
+            lock.lock();
+        }
+
+        if (m_bgwriter_wakeup) {
+            // Someone is waiting for a clean frame, keep going.
+            m_bgwriter_wakeup = false;
+            if (!batch.empty())
+                continue;
+        }
+        m_bgwriter_cv.wait_for(lock, delay, [&]() {
+            return m_bgwriter_stop || m_bgwriter_wakeup;
+        });
+    }
+}
+
+BufferId
+BufferManager::FindVictim(std::unique_lock<std::mutex> &lock) {
+    bool waited = false;
+    // Only a full sweep decays the usage counts. A retry after a wait only
+    // looks for a frame that has become available in the meantime, so that
+    // waiting does not age the pages of everyone else. It falls back to a
+    // full sweep if the only candidates left have been used since.
+    bool decay = true;
+    for (;;) {
+        // The pool might have been resized while we were waiting.
+        const size_t nframes = m_nframes.load(memory_order_relaxed);
+        const size_t max_steps =
+            decay ? nframes * (MaxUsageCount + 1) : nframes;
+        // whether there's some frame that will be clean soon
+        bool wait_for_clean = false;
+        // whether some frame was skipped only because of its usage count
+        bool skipped_used = false;
+        for (size_t n = 0; n <= max_steps; ++n) {
+            BufferId bufid = m_clock_hand;
+            if (++m_clock_hand >= nframes)
+                m_clock_hand = 0;
+
+            BufferDesc &desc = m_desc[bufid];
+            if (desc.m_pincnt.load(memory_order_acquire) != 0 ||
+                desc.m_io_in_progress)
+                continue;
+            if (desc.m_write_in_progress) {
+                wait_for_clean = true;
+                continue;
+            }
+            if (desc.m_usage > 0) {
+                if (decay)
+                    --desc.m_usage;
+                else
+                    skipped_used = true;
+                continue;
+            }
+            if (m_bgwriter_running && desc.m_dirty.load(memory_order_acquire)) {
+                wait_for_clean = true;
+                continue;
+            }
+            return bufid;
+        }
+
+        if (!decay && !wait_for_clean && skipped_used) {
+            decay = true;
+            continue;
+        }
+
+        if (!wait_for_clean) {
+            // The prefetcher and the prewarm threads only hold their pins
+            // for a short while, so wait for them rather than failing a
+            // request because of a hint. They never wait for each other.
+            if (s_is_prefetcher ||
+                m_background_pins.load(memory_order_relaxed) == 0) {
+                LOG(kError,
+                    "no buffer frame is available: all frames are pinned");
+            }
+            if (!waited) {
+                CountEvent(PinWaits, nullptr);
+                waited = true;
+            }
+            m_io_cv.wait_for(lock, std::chrono::milliseconds(1));
+            decay = false;
+            continue;
+        }
+
+        // Every unpinned frame is dirty. Ask the background writer to clean
+        // some and retry.
+        if (!waited) {
+            CountEvent(PinWaits, nullptr);
+            waited = true;
+        }
+        m_bgwriter_wakeup = true;
+        m_bgwriter_cv.notify_one();
+        m_io_cv.wait_for(lock, std::chrono::milliseconds(1));
+        decay = false;
+    }
+}
+
+BufferId
+BufferManager::FindVictimFromStrategy(std::unique_lock<std::mutex> &lock,
+                                      BufferAccessStrategy *strategy) {
+    const size_t nslots = strategy->m_ring.size();
+    for (;;) {
+        for (size_t i = 0; i < nslots; ++i) {
+            BufferId &slot = strategy->m_ring[strategy->m_current];
+            if (++strategy->m_current == nslots)
+                strategy->m_current = 0;
+
+            // Reuse the frame only if no one else has used it since we
+            // loaded a page into it. Otherwise, leave it to the shared pool
+            // and replace it in the ring with a victim of the clock.
+            if (slot == INVALID_BUFID ||
+                slot >= m_nframes.load(memory_order_relaxed)) {
+                slot = FindVictim(lock);
+                return slot;
+            }
+            BufferDesc &desc = m_desc[slot];
+            if (desc.m_pincnt.load(memory_order_acquire) != 0 ||
+                desc.m_io_in_progress || desc.m_usage > 1) {
+                slot = FindVictim(lock);
+                return slot;
+            }
+
+            if (desc.m_write_in_progress)
+                continue;
+            if (m_bgwriter_running && desc.m_dirty.load(memory_order_acquire)) {
+                // Hand the frame to the background writer rather than
+                // writing it ourselves, and try the next one in the ring.
+                m_bgwriter_requests.push_back(slot);
+                m_bgwriter_wakeup = true;
+                m_bgwriter_cv.notify_one();
+                continue;
+            }
+            return slot;
+        }
+
+        // Every frame in the ring is being cleaned. Waiting for them keeps
+        // a bulk operation from running too far ahead of the disk.
+        m_io_cv.wait_for(lock, std::chrono::milliseconds(1));
+    }
+}
+
+bool
+BufferManager::MaybeCompressVictim(std::unique_lock<std::mutex> &lock,
+                                   BufferId bufid) {
+    BufferDesc &desc = m_desc[bufid];
+    PageNumber old_pid = desc.m_pid.load(memory_order_relaxed);
+    if (!m_compressed_cache || old_pid == INVALID_PID ||
+        desc.m_dirty.load(memory_order_acquire))
+        return false;
+
+    // The old page stays in the page table while we compress it, but anyone
+    // who wants to pin it has to wait as if it were being read and then
+    // retry after we evict it. It can't be modified since no one else has a
+    // pin on it, so the cached copy is the same as the page on disk.
+    desc.m_io_in_progress = true;
+    lock.unlock();
+    m_compressed_cache->Insert(old_pid, GetBuffer(bufid));
+    lock.lock();
+    desc.m_io_in_progress = false;
+    m_io_cv.notify_all();
+    return true;
+}
+
+void
+BufferManager::CleanVictim(std::unique_lock<std::mutex> &lock,
+                           BufferId bufid) {
+    // Write the page like the background writer does, so that a failed
+    // write leaves it dirty and the other pins don't wait on the disk.
+    std::vector<BufferId> batch(1, bufid);
+    BeginWrite(m_desc[bufid]);
+    lock.unlock();
+    WriteFrames(batch, EvictionWritebacks);
+    lock.lock();
+}
+
+void
+BufferManager::EvictFrame(BufferId bufid) {
+    BufferDesc &desc = m_desc[bufid];
+    if (desc.m_pid == INVALID_PID)
+        return;
+
+    ASSERT(!desc.m_dirty.load(memory_order_acquire));
+    CountEvent(Evictions, &desc);
+    if (desc.m_prefetched.exchange(false, memory_order_relaxed))
+        CountEvent(ReadAheadWasted, &desc);
+    m_pagetable.erase(desc.m_pid);
+    desc.m_pid.store(INVALID_PID, memory_order_relaxed);
+    desc.m_file_stats = nullptr;
+    // The cached link is no longer the next page of the page in this frame.
+    desc.m_next_ref.Reset();
+}
+
+BufferId
+BufferManager::TryPinSwizzled(BufferId bufid, PageNumber pid, char **frame) {
+    BufferDesc &desc = m_desc[bufid];
+    uint32_t pincnt = desc.m_pincnt.fetch_add(1, memory_order_acquire);
+    // The frame can't be claimed for another page while we hold the pin,
+    // so the page number is stable after this check.
+    if ((pincnt & FrameBusyBit) ||
+        desc.m_pid.load(memory_order_relaxed) != pid) {
+        desc.m_pincnt.fetch_sub(1, memory_order_release);
+        return INVALID_BUFID;
+    }
+
+    // This may race with the clock and lose an update, which is fine.
+    uint8_t usage = desc.m_usage.load(memory_order_relaxed);
+    if (usage < MaxUsageCount)
+        desc.m_usage.store(usage + 1, memory_order_relaxed);
+    CountEvent(Hits, &desc);
+    if (desc.m_prefetched.load(memory_order_relaxed) &&
+        desc.m_prefetched.exchange(false, memory_order_relaxed))
+        CountEvent(ReadAheadHits, &desc);
+    *frame = GetBuffer(bufid);
+    return bufid;
+}
+
+BufferId
+BufferManager::PinPage(SwizzledPageRef &ref, char **frame,
+                       ReadAheadState *readahead) {
+    uint64_t word = ref.m_word.load(memory_order_relaxed);
+    PageNumber pid = SwizzledPageRef::GetPageNumber(word);
+    if (SwizzledPageRef::IsSwizzled(word)) {
+        BufferId bufid = TryPinSwizzled(SwizzledPageRef::GetBufferId(word),
+                                        pid, frame);
+        if (bufid != INVALID_BUFID) {
+            MaybeReadAhead(pid, *frame, readahead);
+            return bufid;
+        }
+        // The page has been evicted from that frame since.
+    }
+
+    BufferId bufid = PinPage(pid, frame, nullptr, readahead);
+    // Someone else may have changed the reference to another page in the
+    // meantime, in which case we leave it alone.
+    ref.m_word.compare_exchange_strong(word,
+        SwizzledPageRef::MakeSwizzled(pid, bufid), memory_order_relaxed);
+    return bufid;
+}
+
+BufferId
+BufferManager::PinNextPage(BufferId bufid, char **frame,
+                           ReadAheadState *readahead) {
+    ASSERT(bufid < m_max_nframes);
+    const PageHeaderData *ph = (const PageHeaderData*) GetBuffer(bufid);
+    PageNumber next_pid = ph->GetNextPageNumber();
+    if (next_pid == INVALID_PID)
+        return INVALID_BUFID;
+
+    SwizzledPageRef &ref = m_desc[bufid].m_next_ref;
+    if (ref.GetPageNumber() != next_pid) {
+        // The link has changed or it's not cached yet.
+        ref.Set(next_pid);
+    }
+    return PinPage(ref, frame, readahead);
+}
+
+void
+BufferManager::AcquireFrameLatch(BufferId bufid, LatchMode mode) {
+    ASSERT(bufid < m_max_nframes);
+    BufferDesc &desc = m_desc[bufid];
+    if (!desc.m_latch.TryAcquire(mode)) {
+        CountEvent(LatchWaits, &desc);
+        desc.m_latch.Acquire(mode);
+    }
+}
+
+void
+BufferManager::CountEvent(StatCounter c, const BufferDesc *desc, uint64_t n) {
+    m_stats[s_stat_stripe % NumStatStripes].m_counters.Add(c, n);
+    if (desc && desc->m_file_stats)
+        desc->m_file_stats->Add(c, n);
+}
+
+BufferManager::StatCounters*
+BufferManager::GetFileStats(FileId fid) {
+    auto iter = m_file_stats.find(fid);
+    if (iter != m_file_stats.end())
+        return iter->second.get();
+    StatCounters *stats = new StatCounters();
+    m_file_stats.emplace(fid, std::unique_ptr<StatCounters>(stats));
+    return stats;
+}
+
+void
+BufferManager::ResolveFileStats(BufferId bufid) {
+    BufferDesc &desc = m_desc[bufid];
+    if (desc.m_file_stats)
+        return;
+    FileId fid = ((PageHeaderData*) GetBuffer(bufid))->GetFileId();
+    if (fid != INVALID_FID)
+        desc.m_file_stats = GetFileStats(fid);
+}
+
+void
+BufferManager::StatCounters::AddTo(BufferCounters &counters) const {
+    for (size_t i = 0; i < NumStatCounters; ++i) {
+        counters.*s_counter_fields[i] += m_cnt[i].load(memory_order_relaxed);
+    }
+}
+
+BufferManagerStats
+BufferManager::GetStats() {
+    static_assert(sizeof(s_counter_fields) / sizeof(s_counter_fields[0]) ==
+                  NumStatCounters,
+                  "every counter must be mapped to a field");
+    if (!m_initialized) {
+        LOG(kError, "BufferManager is not initialized");
+    }
+
+    BufferManagerStats stats;
+    for (size_t i = 0; i < NumStatStripes; ++i) {
+        m_stats[i].m_counters.AddTo(stats.m_pool);
+    }
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    stats.m_pool_size = m_nframes.load(memory_order_relaxed);
+    for (BufferId bufid = 0; bufid < stats.m_pool_size; ++bufid) {
+        const BufferDesc &desc = m_desc[bufid];
+        if (desc.m_pid.load(memory_order_relaxed) == INVALID_PID)
+            continue;
+        ++stats.m_nresident;
+        if (desc.m_dirty.load(memory_order_relaxed))
+            ++stats.m_ndirty;
+        if (desc.m_pincnt.load(memory_order_relaxed) & ~FrameBusyBit)
+            ++stats.m_npinned;
+    }
+    if (m_compressed_cache) {
+        stats.m_ncompressed = m_compressed_cache->GetNumPages();
+        stats.m_compressed_size = m_compressed_cache->GetSize();
+    }
+
+    stats.m_files.reserve(m_file_stats.size());
+    for (const auto &p : m_file_stats) {
+        stats.m_files.emplace_back(p.first, BufferCounters());
+        p.second->AddTo(stats.m_files.back().second);
+    }
+    std::sort(stats.m_files.begin(), stats.m_files.end(),
+        [](const std::pair<FileId, BufferCounters> &a,
+           const std::pair<FileId, BufferCounters> &b) -> bool {
+            return a.first < b.first;
+        });
+    return stats;
+}
+
+std::string
+BufferManagerStats::ToString() const {
+    std::string s;
+    absl::StrAppendFormat(&s, "pool_size %lu\n", m_pool_size);
+    absl::StrAppendFormat(&s, "resident_pages %lu\n", m_nresident);
+    absl::StrAppendFormat(&s, "dirty_pages %lu\n", m_ndirty);
+    absl::StrAppendFormat(&s, "pinned_pages %lu\n", m_npinned);
+    absl::StrAppendFormat(&s, "compressed_pages %lu\n", m_ncompressed);
+    absl::StrAppendFormat(&s, "compressed_size %lu\n", m_compressed_size);
+    AppendCounters(s, m_pool);
+    for (const auto &p : m_files) {
+        absl::StrAppendFormat(&s, "\n[file " FILEID_FORMAT "]\n", p.first);
+        AppendCounters(s, p.second);
+    }
+    return s;
+}
+
+void
+BufferManager::StartStatsDump(const std::string &path) {
+    uint64_t interval_ms = absl::GetFlag(FLAGS_bufman_stats_dump_interval_ms);
+    if (interval_ms == 0)
+        return;
+    if (m_stats_dumper.joinable()) {
+        LOG(kError, "the stats dump has already been started");
+    }
+
+    m_stats_path = path;
+    m_stats_dump_interval_ms = interval_ms;
+    m_stats_dumper_stop = false;
+    m_stats_dumper = std::thread(&BufferManager::StatsDumperMain, this);
+}
+
+void
+BufferManager::StopStatsDump() {
+    if (!m_stats_dumper.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(m_stats_dumper_mutex);
+        m_stats_dumper_stop = true;
+    }
+    m_stats_dumper_cv.notify_one();
+    m_stats_dumper.join();
+}
+
+void
+BufferManager::StatsDumperMain() {
+    const auto interval = std::chrono::milliseconds(m_stats_dump_interval_ms);
+    std::unique_lock<std::mutex> lock(m_stats_dumper_mutex);
+    for (;;) {
+        bool stop = m_stats_dumper_cv.wait_for(lock, interval, [&]() {
+            return m_stats_dumper_stop;
+        });
+        lock.unlock();
+        try {
+            DumpStats();
+        } catch (const TDBError &e) {
+            LOG(kWarning, "unable to dump the buffer manager statistics: %s",
+                          e.GetMessage());
+        }
+        if (stop)
+            break;
+        lock.lock();
+    }
+}
+
+void
+BufferManager::DumpStats() {
+    std::string text = GetStats().ToString();
+
+    // Replace the file atomically so that a reader never sees a partial
+    // dump.
+    std::string tmp_path = m_stats_path + ".tmp";
+    std::unique_ptr<FSFile> f(FSFile::Open(tmp_path, true, false, true));
+    if (!f) {
+        LOG(kError, "unable to create %s: %s", tmp_path, strerror(errno));
+    }
+    f->Allocate(text.size());
+    f->Write(text.data(), text.size(), 0);
+    f->Close();
+    if (rename(tmp_path.c_str(), m_stats_path.c_str()) != 0) {
+        LOG(kError, "unable to rename %s to %s: %s",
+                    tmp_path, m_stats_path, strerror(errno));
+    }
+}
+
+}   // namespace taco
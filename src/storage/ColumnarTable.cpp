@@ -0,0 +1,394 @@
+#include "storage/ColumnarTable.h"
+
+#include "catalog/systables.h"
+#include "storage/BufferManager.h"
+#include "utils/lzcompress.h"
+
+namespace taco {
+
+constexpr uint32_t ColumnarTable::DefaultRowGroupSize;
+constexpr size_t ColumnarTable::ChunkBytesPerPage;
+constexpr size_t ColumnarTable::DirEntriesPerPage;
+
+//! Returns the file ID array of the directory file meta page.
+static inline FileId*
+GetColumnFileIds(char *frame) {
+    return (FileId*)(frame + MAXALIGN(sizeof(ColumnarMetaPageHeader)));
+}
+
+//! Returns the entry array of a row-group directory page.
+static inline ColumnChunkDesc*
+GetDirEntries(char *frame) {
+    return (ColumnChunkDesc*)(frame +
+                              MAXALIGN(sizeof(ColumnarDirPageHeader)));
+}
+
+//! Returns the length of the null bitmap of a chunk of \p nrows rows.
+static inline size_t
+GetNullBitmapLength(uint32_t nrows) {
+    return MAXALIGN((nrows + 7) >> 3);
+}
+
+void
+ColumnarTable::Initialize(const TableDesc *tabdesc) {
+    FileId fid = tabdesc->GetTableEntry()->tabfid();
+    std::unique_ptr<File> dir_file = g_fileman->Open(fid);
+    if (dir_file->GetNumPages() != 1) {
+        LOG(kError, "the directory file " FILEID_FORMAT " is not empty", fid);
+    }
+
+    FieldId ncols = tabdesc->GetSchema()->GetNumFields();
+    if (MAXALIGN(sizeof(ColumnarMetaPageHeader)) +
+            (size_t) ncols * sizeof(FileId) > PAGE_SIZE) {
+        LOG(kError, "too many columns in a columnar table: " FIELDID_FORMAT,
+                    ncols);
+    }
+
+    char *frame;
+    ScopedBufferId bufid =
+        g_bufman->PinPage(dir_file->GetFirstPageNumber(), &frame);
+    ColumnarMetaPageHeader *hdr = (ColumnarMetaPageHeader*) frame;
+    hdr->m_ncols = ncols;
+    for (FieldId i = 0; i < ncols; ++i) {
+        std::unique_ptr<File> col_file = g_fileman->Open(NEW_REGULAR_FID);
+        GetColumnFileIds(frame)[i] = col_file->GetFileId();
+    }
+    g_bufman->MarkDirty(bufid);
+}
+
+std::unique_ptr<ColumnarTable>
+ColumnarTable::Create(std::shared_ptr<const TableDesc> tabdesc) {
+    if (tabdesc->GetTableEntry()->tablayout() != TABLAYOUT_COLUMNAR) {
+        LOG(kError, "table " OID_FORMAT " is not a columnar table",
+                    tabdesc->GetTableEntry()->tabid());
+    }
+    FileId fid = tabdesc->GetTableEntry()->tabfid();
+    std::unique_ptr<File> dir_file = g_fileman->Open(fid);
+    return absl::WrapUnique(new ColumnarTable(std::move(tabdesc),
+                                              std::move(dir_file)));
+}
+
+ColumnarTable::ColumnarTable(std::shared_ptr<const TableDesc> tabdesc,
+                             std::unique_ptr<File> dir_file):
+    m_tabdesc(std::move(tabdesc)),
+    m_dir_file(std::move(dir_file)),
+    m_nrows(0) {
+    char *frame;
+    PageNumber pid = m_dir_file->GetFirstPageNumber();
+    {
+        ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+        ColumnarMetaPageHeader *hdr = (ColumnarMetaPageHeader*) frame;
+        for (FieldId i = 0; i < hdr->m_ncols; ++i) {
+            FileId col_fid = GetColumnFileIds(frame)[i];
+            m_col_files.emplace_back(g_fileman->Open(col_fid));
+            if (!m_col_files.back()) {
+                LOG(kError, "column file " FILEID_FORMAT " does not exist",
+                            col_fid);
+            }
+        }
+        pid = hdr->m_ph.GetNextPageNumber();
+    }
+
+    while (pid != INVALID_PID) {
+        ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+        ColumnarDirPageHeader *hdr = (ColumnarDirPageHeader*) frame;
+        const ColumnChunkDesc *entries = GetDirEntries(frame);
+        m_chunks.insert(m_chunks.end(), entries, entries + hdr->m_cnt);
+        pid = hdr->m_ph.GetNextPageNumber();
+    }
+
+    // Only the complete row groups are visible.
+    size_t ncols = m_col_files.size();
+    m_chunks.resize(m_chunks.size() / ncols * ncols);
+    for (size_t i = 0; i < m_chunks.size(); i += ncols) {
+        m_nrows += m_chunks[i].m_nrows;
+    }
+}
+
+PageNumber
+ColumnarTable::WriteChunk(FieldId field_id, const char *chunk, size_t len) {
+    PageNumber npages =
+        (PageNumber)((len + ChunkBytesPerPage - 1) / ChunkBytesPerPage);
+    unique_malloced_ptr buf =
+        unique_aligned_alloc(512, (size_t) npages * PAGE_SIZE);
+    char *pages = (char*) buf.get();
+    memset(pages, 0, (size_t) npages * PAGE_SIZE);
+    for (PageNumber i = 0; i < npages; ++i) {
+        size_t off = (size_t) i * ChunkBytesPerPage;
+        memcpy(pages + (size_t) i * PAGE_SIZE +
+               MAXALIGN(sizeof(PageHeaderData)),
+               chunk + off, std::min(ChunkBytesPerPage, len - off));
+    }
+
+    File *file = m_col_files[field_id].get();
+    PageNumber first_pid = file->ReserveNewPages(npages);
+    file->WriteNewPages(first_pid, pages, npages);
+    file->AppendNewPages({{first_pid, npages}});
+    return first_pid;
+}
+
+void
+ColumnarTable::ReadChunk(FieldId field_id, const ColumnChunkDesc &desc,
+                         maxaligned_char_buf &buf) {
+    FileId fid = m_col_files[field_id]->GetFileId();
+    buf.resize(desc.m_len);
+    size_t off = 0;
+    for (PageNumber pid = desc.m_first_pid; off < desc.m_len; ++pid) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+        PageHeaderData *ph = (PageHeaderData*) frame;
+        if (!ph->IsVFileDataPage() || ph->GetFileId() != fid) {
+            bufid.Reset();
+            LOG(kError, "page " PAGENUMBER_FORMAT " is not a page of file "
+                        FILEID_FORMAT, pid, fid);
+        }
+        size_t n = std::min(ChunkBytesPerPage, desc.m_len - off);
+        memcpy(buf.data() + off, frame + MAXALIGN(sizeof(PageHeaderData)), n);
+        off += n;
+    }
+}
+
+void
+ColumnarTable::AppendRowGroup(const std::vector<ColumnChunkDesc> &descs) {
+    ASSERT(descs.size() == m_col_files.size());
+    size_t i = 0;
+    PageNumber pid = m_dir_file->GetLastPageNumber();
+    while (i < descs.size()) {
+        if (pid == m_dir_file->GetFirstPageNumber()) {
+            // The first page is the meta page.
+            pid = m_dir_file->AllocatePage();
+        }
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+        ColumnarDirPageHeader *hdr = (ColumnarDirPageHeader*) frame;
+        if (hdr->m_cnt == DirEntriesPerPage) {
+            pid = m_dir_file->AllocatePage();
+            continue;
+        }
+        ColumnChunkDesc *entries = GetDirEntries(frame);
+        while (i < descs.size() && hdr->m_cnt < DirEntriesPerPage) {
+            entries[hdr->m_cnt++] = descs[i++];
+        }
+        g_bufman->MarkDirty(bufid);
+    }
+    m_chunks.insert(m_chunks.end(), descs.begin(), descs.end());
+    m_nrows += descs[0].m_nrows;
+}
+
+std::unique_ptr<ColumnarTable::Appender>
+ColumnarTable::StartAppend(uint32_t rowgroup_nrows) {
+    if (rowgroup_nrows == 0) {
+        LOG(kError, "a row group must have at least one row");
+    }
+    return absl::WrapUnique(new Appender(this, rowgroup_nrows));
+}
+
+ColumnarTable::Appender::Appender(ColumnarTable *table,
+                                  uint32_t rowgroup_nrows):
+    m_table(table),
+    m_rowgroup_nrows(rowgroup_nrows),
+    m_nrows(0),
+    m_cols(table->m_col_files.size()) {
+}
+
+void
+ColumnarTable::Appender::Append(const std::vector<Datum> &data) {
+    AppendImpl(data);
+}
+
+void
+ColumnarTable::Appender::Append(const std::vector<NullableDatumRef> &data) {
+    AppendImpl(data);
+}
+
+template<class SomeDatum>
+void
+ColumnarTable::Appender::AppendImpl(const std::vector<SomeDatum> &data) {
+    const Schema *schema = m_table->m_tabdesc->GetSchema();
+    if (data.size() != m_cols.size()) {
+        LOG(kError, "expecting %lu fields but got %lu", m_cols.size(),
+                    data.size());
+    }
+    // Checks all the fields before modifying any column buffer.
+    for (FieldId i = 0; i < (FieldId) data.size(); ++i) {
+        if (data[i].isnull() && !schema->FieldIsNullable(i)) {
+            LOG(kError, "NULL value passed to non-null field "
+                        FIELDID_FORMAT, i);
+        }
+    }
+
+    for (FieldId i = 0; i < (FieldId) data.size(); ++i) {
+        ColumnBuffer &col = m_cols[i];
+        bool isnull = data[i].isnull();
+        if (schema->FieldIsNullable(i)) {
+            if ((m_nrows & 7) == 0)
+                col.m_nulls.push_back(0);
+            if (isnull)
+                col.m_nulls.back() |= (uint8_t)(1 << (m_nrows & 7));
+        }
+
+        int16_t typlen = schema->GetFieldLength(i);
+        if (typlen == -1) {
+            if (!isnull) {
+                const char *bytes = data[i].GetVarlenBytes();
+                col.m_values.insert(col.m_values.end(), bytes,
+                                    bytes + data[i].GetVarlenSize());
+            }
+            col.m_ends.push_back((uint32_t) col.m_values.size());
+        } else {
+            size_t off = col.m_values.size();
+            col.m_values.resize(off + typlen);
+            if (isnull) {
+                memset(&col.m_values[off], 0, typlen);
+            } else if (schema->FieldPassByRef(i)) {
+                memcpy(&col.m_values[off], data[i].GetVarlenBytes(), typlen);
+            } else {
+                memcpy(&col.m_values[off], data[i].GetFixedlenBytes(),
+                       typlen);
+            }
+        }
+    }
+
+    if (++m_nrows == m_rowgroup_nrows) {
+        FlushRowGroup();
+    }
+}
+
+void
+ColumnarTable::Appender::FlushRowGroup() {
+    if (m_nrows == 0)
+        return ;
+
+    const Schema *schema = m_table->m_tabdesc->GetSchema();
+    std::vector<ColumnChunkDesc> descs(m_cols.size());
+    std::vector<char> zbuf;
+    for (FieldId i = 0; i < (FieldId) m_cols.size(); ++i) {
+        ColumnBuffer &col = m_cols[i];
+        m_rawbuf.clear();
+        if (schema->FieldIsNullable(i)) {
+            ASSERT(col.m_nulls.size() == (size_t)((m_nrows + 7) >> 3));
+            m_rawbuf.insert(m_rawbuf.end(), col.m_nulls.begin(),
+                            col.m_nulls.end());
+            m_rawbuf.resize(GetNullBitmapLength(m_nrows), 0);
+        }
+        if (schema->GetFieldLength(i) == -1) {
+            const char *ends = (const char*) col.m_ends.data();
+            m_rawbuf.insert(m_rawbuf.end(), ends,
+                            ends + col.m_ends.size() * sizeof(uint32_t));
+        }
+        m_rawbuf.insert(m_rawbuf.end(), col.m_values.begin(),
+                        col.m_values.end());
+        if (m_rawbuf.size() > (size_t) std::numeric_limits<uint32_t>::max()) {
+            LOG(kError, "the column chunk is too long");
+        }
+
+        // Stores the chunk uncompressed unless compression saves space.
+        const char *chunk = m_rawbuf.data();
+        size_t len = m_rawbuf.size();
+        zbuf.resize(len);
+        size_t zlen = lz_compress(m_rawbuf.data(), len, zbuf.data(), len - 1);
+        if (zlen != 0) {
+            chunk = zbuf.data();
+            len = zlen;
+        }
+
+        descs[i].m_first_pid = m_table->WriteChunk(i, chunk, len);
+        descs[i].m_nrows = m_nrows;
+        descs[i].m_len = (uint32_t) len;
+        descs[i].m_rawlen = (uint32_t) m_rawbuf.size();
+
+        col.m_nulls.clear();
+        col.m_values.clear();
+        col.m_ends.clear();
+    }
+    m_table->AppendRowGroup(descs);
+    m_nrows = 0;
+}
+
+void
+ColumnarTable::Appender::Finish() {
+    FlushRowGroup();
+    m_table = nullptr;
+}
+
+ColumnarTable::Scanner
+ColumnarTable::StartScan(std::vector<FieldId> field_ids) {
+    for (FieldId field_id : field_ids) {
+        if (field_id < 0 || (size_t) field_id >= m_col_files.size()) {
+            LOG(kError, "invalid field ID " FIELDID_FORMAT, field_id);
+        }
+    }
+    return Scanner(this, std::move(field_ids));
+}
+
+ColumnarTable::Scanner::Scanner(ColumnarTable *table,
+                                std::vector<FieldId> field_ids):
+    m_table(table),
+    m_field_ids(std::move(field_ids)),
+    m_next_rowgroup(0),
+    m_nrows(0),
+    m_vectors(m_field_ids.size()) {
+}
+
+bool
+ColumnarTable::Scanner::Next() {
+    if (!m_table || m_next_rowgroup >= m_table->GetNumRowGroups()) {
+        m_nrows = 0;
+        return false;
+    }
+
+    const Schema *schema = m_table->m_tabdesc->GetSchema();
+    size_t ncols = m_table->m_col_files.size();
+    for (size_t j = 0; j < m_field_ids.size(); ++j) {
+        FieldId field_id = m_field_ids[j];
+        const ColumnChunkDesc &desc =
+            m_table->m_chunks[(size_t) m_next_rowgroup * ncols + field_id];
+        m_table->ReadChunk(field_id, desc, m_chunkbuf);
+        m_vectors[j].Decode(schema, field_id, desc, m_chunkbuf);
+        m_nrows = desc.m_nrows;
+    }
+    if (m_field_ids.empty()) {
+        m_nrows = m_table->m_chunks[(size_t) m_next_rowgroup * ncols].m_nrows;
+    }
+    ++m_next_rowgroup;
+    return true;
+}
+
+void
+ColumnarTable::ColumnVector::Decode(const Schema *schema, FieldId field_id,
+                                    const ColumnChunkDesc &desc,
+                                    maxaligned_char_buf &chunk) {
+    m_nrows = desc.m_nrows;
+    m_typlen = schema->GetFieldLength(field_id);
+    m_typbyref = schema->FieldPassByRef(field_id);
+    m_nullable = schema->FieldIsNullable(field_id);
+    m_values_begin = m_nullable ? GetNullBitmapLength(m_nrows) : 0;
+    if (desc.m_len == desc.m_rawlen) {
+        m_buf.swap(chunk);
+    } else {
+        m_buf.resize(desc.m_rawlen);
+        if (!lz_decompress(chunk.data(), desc.m_len, m_buf.data(),
+                           desc.m_rawlen)) {
+            LOG(kError, "corrupted column chunk at page " PAGENUMBER_FORMAT,
+                        desc.m_first_pid);
+        }
+    }
+}
+
+Datum
+ColumnarTable::ColumnVector::GetField(uint32_t row) const {
+    ASSERT(row < m_nrows);
+    if (IsNull(row))
+        return Datum::FromNull();
+    if (m_typlen == -1) {
+        uint32_t len;
+        const char *value = GetVarlenValue(row, &len);
+        return Datum::FromVarlenBytes(value, len);
+    }
+    const char *value = GetFixedlenValues() + (size_t) row * m_typlen;
+    if (m_typbyref)
+        return Datum::FromVarlenBytes(value, m_typlen);
+    return Datum::FromFixedlenBytes(value, m_typlen);
+}
+
+}   // namespace taco
@@ -0,0 +1,139 @@
+#include "storage/CompressedPageCache.h"
+
+#include "utils/lzcompress.h"
+
+namespace taco {
+
+//! Pages that don't compress to this size are not worth caching.
+static constexpr size_t s_max_compressed_size = PAGE_SIZE * 3 / 4;
+
+CompressedPageCache::CompressedPageCache(size_t budget):
+    m_shard_budget(budget / NumShards),
+    m_shards(nullptr) {
+    m_shards_mem = unique_aligned_alloc(CACHELINE_SIZE,
+                                        NumShards * sizeof(Shard));
+    if (!m_shards_mem) {
+        LOG(kFatal, "unable to allocate the compressed page cache");
+    }
+    m_shards = (Shard*) m_shards_mem.get();
+    for (size_t i = 0; i < NumShards; ++i) {
+        Shard *shard = new (&m_shards[i]) Shard();
+        shard->m_lru.m_prev = &shard->m_lru;
+        shard->m_lru.m_next = &shard->m_lru;
+        shard->m_size = 0;
+    }
+}
+
+CompressedPageCache::~CompressedPageCache() {
+    for (size_t i = 0; i < NumShards; ++i) {
+        Shard &shard = m_shards[i];
+        for (const auto &p : shard.m_entries) {
+            free(p.second);
+        }
+        shard.~Shard();
+    }
+}
+
+void
+CompressedPageCache::Unlink(Entry *entry) {
+    entry->m_prev->m_next = entry->m_next;
+    entry->m_next->m_prev = entry->m_prev;
+}
+
+void
+CompressedPageCache::LinkAtHead(Shard &shard, Entry *entry) {
+    entry->m_prev = &shard.m_lru;
+    entry->m_next = shard.m_lru.m_next;
+    shard.m_lru.m_next->m_prev = entry;
+    shard.m_lru.m_next = entry;
+}
+
+void
+CompressedPageCache::RemoveEntry(Shard &shard, Entry *entry) {
+    Unlink(entry);
+    shard.m_entries.erase(entry->m_pid);
+    shard.m_size -= entry->GetMemSize();
+    free(entry);
+}
+
+bool
+CompressedPageCache::Insert(PageNumber pid, const char *page) {
+    // Compress the page outside the mutex.
+    char buf[s_max_compressed_size];
+    size_t size = lz_compress(page, PAGE_SIZE, buf, s_max_compressed_size);
+
+    Entry *entry = nullptr;
+    if (size != 0 && sizeof(Entry) + size <= m_shard_budget) {
+        entry = (Entry*) malloc(sizeof(Entry) + size);
+        if (entry) {
+            entry->m_pid = pid;
+            entry->m_size = (uint32_t) size;
+            memcpy(entry->GetData(), buf, size);
+        }
+    }
+
+    Shard &shard = GetShard(pid);
+    std::lock_guard<std::mutex> guard(shard.m_mutex);
+    auto iter = shard.m_entries.find(pid);
+    if (iter != shard.m_entries.end()) {
+        // The old copy must not outlive a failed insertion.
+        RemoveEntry(shard, iter->second);
+    }
+    if (!entry)
+        return false;
+
+    while (shard.m_size + entry->GetMemSize() > m_shard_budget) {
+        ASSERT(shard.m_lru.m_prev != &shard.m_lru);
+        RemoveEntry(shard, shard.m_lru.m_prev);
+    }
+    shard.m_entries.emplace(pid, entry);
+    LinkAtHead(shard, entry);
+    shard.m_size += entry->GetMemSize();
+    return true;
+}
+
+bool
+CompressedPageCache::Lookup(PageNumber pid, char *page) {
+    Entry *entry;
+    {
+        Shard &shard = GetShard(pid);
+        std::lock_guard<std::mutex> guard(shard.m_mutex);
+        auto iter = shard.m_entries.find(pid);
+        if (iter == shard.m_entries.end())
+            return false;
+        entry = iter->second;
+        Unlink(entry);
+        shard.m_entries.erase(iter);
+        shard.m_size -= entry->GetMemSize();
+    }
+
+    bool ok = lz_decompress(entry->GetData(), entry->m_size, page, PAGE_SIZE);
+    free(entry);
+    if (!ok) {
+        LOG(kWarning, "corrupted compressed copy of page " PAGENUMBER_FORMAT,
+                      pid);
+    }
+    return ok;
+}
+
+size_t
+CompressedPageCache::GetNumPages() const {
+    size_t n = 0;
+    for (size_t i = 0; i < NumShards; ++i) {
+        std::lock_guard<std::mutex> guard(m_shards[i].m_mutex);
+        n += m_shards[i].m_entries.size();
+    }
+    return n;
+}
+
+size_t
+CompressedPageCache::GetSize() const {
+    size_t size = 0;
+    for (size_t i = 0; i < NumShards; ++i) {
+        std::lock_guard<std::mutex> guard(m_shards[i].m_mutex);
+        size += m_shards[i].m_size;
+    }
+    return size;
+}
+
+}   // namespace taco
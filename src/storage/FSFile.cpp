@@ -3,7 +3,9 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cerrno>
 
 #include "utils/zerobuf.h"
@@ -50,7 +52,7 @@ FSFile::Reopen() {
     if (get_o_direct())
         flags = flags | O_DIRECT;	 
 
-    int fd = open(get_file_path().c_str(), O_RDWR, 0600);
+    int fd = open(get_file_path().c_str(), flags, 0600);
     
     if (fd < 0)
         return false;
@@ -84,10 +86,6 @@ FSFile::IsOpen() const {
 
 void
 FSFile::Delete() const {
-    
-	if (is_file_open())
-		Close();
-
     int ret_val = unlink(get_file_path().c_str());
     
     if (ret_val != 0) {
@@ -104,41 +102,56 @@ FSFile::Read(void *buf, size_t count, off_t offset) {
         return;
     }
     
-    int ret_val = pread(get_fd(), buf, count, offset);
+    ssize_t ret_val = pread(get_fd(), buf, count, offset);
     if (ret_val < 0) {
         LOG(kFatal, "Read failed with error %s", strerror(errno));
         return;
     }
+    if ((size_t) ret_val != count) {
+        LOG(kFatal, "Read only partially completed");
+    }
 
 }
 
 void
 FSFile::Write(const void *buf, size_t count, off_t offset) {
 
-    if (Size() == 0) {
-        LOG(kFatal, "File is empty");
+    if (count + offset > Size()) {
+        LOG(kFatal, "Invalid write");
         return;
     }
 
-    if (offset >= Size()) {
-        LOG(kFatal, "Offset is outside the file size");
+    ssize_t ret_val = pwrite(get_fd(), buf, count, offset);
+    if (ret_val < 0) {
+        LOG(kFatal, "Write failed with error %s", strerror(errno));
         return;
     }
-   
-    if (offset % PAGE_SIZE != 0) {
-        LOG(kFatal, "Offset is not page size aligned");
+    if ((size_t) ret_val != count) {
+        LOG(kFatal, "Partial write of %ld bytes out of %lu bytes",
+                    ret_val, count);
+    }
+}
+
+void
+FSFile::WriteV(const struct iovec *iov, int iovcnt, off_t offset) {
+    size_t count = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        count += iov[i].iov_len;
+    }
+    if (count + offset > Size()) {
+        LOG(kFatal, "Invalid write");
         return;
     }
-   
-    LOG(kInfo, "Count : %d", count);
-    LOG(kInfo, "FD : %d", get_fd());
-    LOG(kInfo, "offset : %d", offset);
-    int ret_val = pwrite(get_fd(), buf, count, offset);
-    LOG(kInfo, "ret : %d", ret_val);
+
+    ssize_t ret_val = pwritev(get_fd(), iov, iovcnt, offset);
     if (ret_val < 0) {
         LOG(kFatal, "Write failed with error %s", strerror(errno));
         return;
     }
+    if ((size_t) ret_val != count) {
+        LOG(kFatal, "Partial write of %ld bytes out of %lu bytes",
+                    ret_val, count);
+    }
 }
 
 void
@@ -154,24 +167,28 @@ FSFile::Allocate(size_t count) {
     // If fallocate_zerofill_fast() returns false and errno is not either 0 or
     // EOPNOTSUPP, log a fatal error with strerror(errno) as a substring.
 
-    //TODO implement it
-    bool ret = fallocate_zerofill_fast(get_fd(), Size(), count);
-    if (!ret && errno == EOPNOTSUPP) {
-    
-    int size = Size(); 
-
-    int ret_val = pwrite(get_fd(), g_zerobuf, count, size);
-
-    LOG(kInfo, "ret : %d", ret_val);
-    if (ret_val < 0) {
-        LOG(kFatal, "Write failed with error %s", strerror(errno));
-        return;
+    size_t size = Size();
+    bool ret = fallocate_zerofill_fast(get_fd(), size, count);
+    if (!ret) {
+        if (errno != 0 && errno != EOPNOTSUPP) {
+            LOG(kFatal, "fallocate failed with error %s", strerror(errno));
+        }
+
+        size_t off = 0;
+        while (off < count) {
+            size_t n = std::min(count - off, g_zerobuf_size);
+            ssize_t ret_val = pwrite(get_fd(), g_zerobuf, n, size + off);
+            if (ret_val < 0) {
+                LOG(kFatal, "Write failed with error %s", strerror(errno));
+                return;
+            }
+            off += ret_val;
+        }
     }
 
+    // the cached file size is stale now
     set_size(-1);
-    size = Size();
-    set_size(size);
-    } 
+    set_size(Size());
 }
 
 size_t
@@ -182,9 +199,8 @@ FSFile::Size() const noexcept {
     // an FSFile::Allocate() call may extend it). You may assume no one may
     // extend or shrink the file externally when the database is running.
 
-    if (get_size() != -1) {
-        LOG(kInfo, "Return size from cache");
-        return get_size();    
+    if (get_size() != (size_t) -1) {
+        return get_size();
     }
 
     struct stat *buf = (struct stat*) malloc(sizeof(struct stat));
@@ -202,15 +218,15 @@ FSFile::Size() const noexcept {
     }
 
     size_t size = buf->st_size;
-    LOG(kInfo, "size : %d", size);
     free(buf);
     return size;
 }
 
 void
 FSFile::Flush() {
-    // Hint: use fsync(2) or fdatasync(2).
-    //TODO implement it
+    if (fdatasync(get_fd()) != 0) {
+        LOG(kFatal, "Flush failed with error %s", strerror(errno));
+    }
 }
 
 }   // namespace taco
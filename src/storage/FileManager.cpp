@@ -0,0 +1,642 @@
+#include "storage/FileManager.h"
+
+#include <algorithm>
+#include <climits>
+
+#include <absl/strings/str_format.h>
+
+#include "storage/BufferManager.h"
+#include "storage/FSFile.h"
+#include "utils/fsutils.h"
+
+namespace taco {
+
+namespace {
+
+constexpr uint64_t FM_MAGIC = 0x54444246494c454dul;
+
+/*!
+ * The layout of page 0, the file manager meta page.
+ */
+struct FMMetaPage {
+    PageHeaderData  m_ph;
+    uint64_t        m_magic;
+    PageNumber      m_npages;
+    PageNumber      m_free_head;
+    FileId          m_next_fid;
+    PageNumber      m_dir_first_pid;
+};
+
+constexpr size_t FMDirPageNumEntries =
+    (PAGE_SIZE - sizeof(PageHeaderData)) / sizeof(PageNumber);
+
+/*!
+ * The layout of a file directory page, which maps file IDs to the page
+ * numbers of the virtual file meta pages. The directory pages are chained
+ * through the page header.
+ */
+struct FMDirPage {
+    PageHeaderData  m_ph;
+    PageNumber      m_meta_pid[FMDirPageNumEntries];
+};
+
+/*!
+ * The layout of a virtual file meta page.
+ */
+struct VFileMetaPage {
+    PageHeaderData  m_ph;
+    PageNumber      m_first_pid;
+    PageNumber      m_last_pid;
+    PageNumber      m_npages;
+};
+
+static_assert(sizeof(FMMetaPage) <= PAGE_SIZE,
+              "the file manager meta page must fit in a page");
+static_assert(sizeof(FMDirPage) <= PAGE_SIZE,
+              "a file manager directory page must fit in a page");
+static_assert(sizeof(VFileMetaPage) <= PAGE_SIZE,
+              "a virtual file meta page must fit in a page");
+
+std::string
+GetDataFilePath(const std::string &datadir, size_t segno) {
+    return absl::StrFormat("%s/main.%lu", datadir, segno);
+}
+
+}   // namespace
+
+File::~File() {
+    Close();
+}
+
+void
+File::Close() {
+    m_fid = INVALID_FID;
+    m_meta_pid = INVALID_PID;
+}
+
+PageNumber
+File::AllocatePage() {
+    std::lock_guard<std::mutex> guard(m_fileman->m_mutex);
+    PageNumber last_pid;
+    m_fileman->AccessPage(m_meta_pid, false, [&](char *buf) {
+        last_pid = ((VFileMetaPage*) buf)->m_last_pid;
+    });
+
+    PageNumber pid = m_fileman->AllocateRawPage();
+    m_fileman->AccessPage(pid, true, [&](char *buf) {
+        memset(buf, 0, PAGE_SIZE);
+        PageHeaderData *ph = (PageHeaderData*) buf;
+        ph->m_flags = PageHeaderData::FLAG_VFILE_PAGE;
+        ph->m_fid = m_fid;
+        ph->m_prev_pid.store(last_pid, memory_order_relaxed);
+        ph->m_next_pid.store(INVALID_PID, memory_order_relaxed);
+    }, true);
+    m_fileman->AccessPage(last_pid, true, [&](char *buf) {
+        ((PageHeaderData*) buf)->m_next_pid.store(pid, memory_order_release);
+    });
+    m_fileman->AccessPage(m_meta_pid, true, [&](char *buf) {
+        VFileMetaPage *meta = (VFileMetaPage*) buf;
+        meta->m_last_pid = pid;
+        ++meta->m_npages;
+    });
+    m_fileman->WriteMetaPage();
+    return pid;
+}
+
+void
+File::FreePage(PageNumber pid) {
+    std::lock_guard<std::mutex> guard(m_fileman->m_mutex);
+    PageNumber npages;
+    m_fileman->AccessPage(m_meta_pid, false, [&](char *buf) {
+        npages = ((VFileMetaPage*) buf)->m_npages;
+    });
+    if (npages <= 1) {
+        LOG(kError, "can't free the only page " PAGENUMBER_FORMAT
+                    " in file " FILEID_FORMAT, pid, m_fid);
+    }
+
+    PageNumber prev_pid, next_pid;
+    m_fileman->AccessPage(pid, false, [&](char *buf) {
+        PageHeaderData *ph = (PageHeaderData*) buf;
+        if (!ph->IsVFileDataPage() || ph->GetFileId() != m_fid) {
+            LOG(kError, "page " PAGENUMBER_FORMAT " is not a data page of "
+                        "file " FILEID_FORMAT, pid, m_fid);
+        }
+        prev_pid = ph->GetPrevPageNumber();
+        next_pid = ph->GetNextPageNumber();
+    });
+
+    if (prev_pid != INVALID_PID) {
+        m_fileman->AccessPage(prev_pid, true, [&](char *buf) {
+            ((PageHeaderData*) buf)->m_next_pid.store(next_pid,
+                                                      memory_order_release);
+        });
+    }
+    if (next_pid != INVALID_PID) {
+        m_fileman->AccessPage(next_pid, true, [&](char *buf) {
+            ((PageHeaderData*) buf)->m_prev_pid.store(prev_pid,
+                                                      memory_order_relaxed);
+        });
+    }
+    m_fileman->AccessPage(m_meta_pid, true, [&](char *buf) {
+        VFileMetaPage *meta = (VFileMetaPage*) buf;
+        if (prev_pid == INVALID_PID)
+            meta->m_first_pid = next_pid;
+        if (next_pid == INVALID_PID)
+            meta->m_last_pid = prev_pid;
+        --meta->m_npages;
+    });
+    m_fileman->FreeRawPage(pid);
+    m_fileman->WriteMetaPage();
+}
+
+PageNumber
+File::ReserveNewPages(PageNumber npages) {
+    ASSERT(npages > 0);
+    std::lock_guard<std::mutex> guard(m_fileman->m_mutex);
+    PageNumber first_pid = m_fileman->ExtendDataFiles(npages);
+    m_fileman->WriteMetaPage();
+    return first_pid;
+}
+
+void
+File::WriteNewPages(PageNumber first_pid, char *buf, PageNumber npages) {
+    ASSERT(first_pid + npages <= m_fileman->GetNumPages(),
+           "page " PAGENUMBER_FORMAT " does not exist",
+           (PageNumber)(first_pid + npages - 1));
+    for (PageNumber i = 0; i < npages; ++i) {
+        PageHeaderData *ph = (PageHeaderData*)(buf + (size_t) i * PAGE_SIZE);
+        ph->m_flags = PageHeaderData::FLAG_VFILE_PAGE;
+        ph->m_reserved = 0;
+        ph->m_fid = m_fid;
+        PageNumber pid = first_pid + i;
+        ph->m_prev_pid.store((i == 0) ? INVALID_PID : pid - 1,
+                             memory_order_relaxed);
+        ph->m_next_pid.store((i + 1 == npages) ? INVALID_PID : pid + 1,
+                             memory_order_relaxed);
+    }
+
+    while (npages > 0) {
+        // A single write can't cross the boundary of a data file segment.
+        PageNumber n = std::min(npages,
+            (PageNumber)(DataFileNumPages - first_pid % DataFileNumPages));
+        m_fileman->GetDataFile(first_pid)->Write(buf, (size_t) n * PAGE_SIZE,
+            (off_t)(first_pid % DataFileNumPages) * PAGE_SIZE);
+        first_pid += n;
+        buf += (size_t) n * PAGE_SIZE;
+        npages -= n;
+    }
+}
+
+void
+File::AppendNewPages(
+    const std::vector<std::pair<PageNumber, PageNumber>> &runs) {
+    if (runs.empty())
+        return ;
+
+    std::lock_guard<std::mutex> guard(m_fileman->m_mutex);
+    PageNumber last_pid;
+    m_fileman->AccessPage(m_meta_pid, false, [&](char *buf) {
+        last_pid = ((VFileMetaPage*) buf)->m_last_pid;
+    });
+
+    // Only the pages at the boundaries of the runs need to be fixed up, as
+    // the pages in a run are already linked by WriteNewPages().
+    PageNumber npages = 0;
+    for (const std::pair<PageNumber, PageNumber> &run : runs) {
+        m_fileman->AccessPage(run.first, true, [&](char *buf) {
+            ((PageHeaderData*) buf)->m_prev_pid.store(last_pid,
+                                                      memory_order_relaxed);
+        });
+        m_fileman->AccessPage(last_pid, true, [&](char *buf) {
+            ((PageHeaderData*) buf)->m_next_pid.store(run.first,
+                                                      memory_order_release);
+        });
+        last_pid = run.first + run.second - 1;
+        npages += run.second;
+    }
+    m_fileman->AccessPage(m_meta_pid, true, [&](char *buf) {
+        VFileMetaPage *meta = (VFileMetaPage*) buf;
+        meta->m_last_pid = last_pid;
+        meta->m_npages += npages;
+    });
+    m_fileman->WriteMetaPage();
+}
+
+void
+File::FreeNewPages(PageNumber first_pid, PageNumber npages) {
+    std::lock_guard<std::mutex> guard(m_fileman->m_mutex);
+    for (PageNumber i = 0; i < npages; ++i) {
+        m_fileman->FreeRawPage(first_pid + i);
+    }
+    m_fileman->WriteMetaPage();
+}
+
+PageNumber
+File::GetFirstPageNumber() {
+    std::lock_guard<std::mutex> guard(m_fileman->m_mutex);
+    PageNumber pid;
+    m_fileman->AccessPage(m_meta_pid, false, [&](char *buf) {
+        pid = ((VFileMetaPage*) buf)->m_first_pid;
+    });
+    return pid;
+}
+
+PageNumber
+File::GetLastPageNumber() {
+    std::lock_guard<std::mutex> guard(m_fileman->m_mutex);
+    PageNumber pid;
+    m_fileman->AccessPage(m_meta_pid, false, [&](char *buf) {
+        pid = ((VFileMetaPage*) buf)->m_last_pid;
+    });
+    return pid;
+}
+
+PageNumber
+File::GetNumPages() {
+    std::lock_guard<std::mutex> guard(m_fileman->m_mutex);
+    PageNumber npages;
+    m_fileman->AccessPage(m_meta_pid, false, [&](char *buf) {
+        npages = ((VFileMetaPage*) buf)->m_npages;
+    });
+    return npages;
+}
+
+FileManager::FileManager():
+    m_initialized(false),
+    m_npages(0),
+    m_ndatafiles(0),
+    m_free_head(INVALID_PID),
+    m_next_fid(MinRegularFileId) {
+}
+
+FileManager::~FileManager() {
+    Destroy();
+}
+
+void
+FileManager::Init(const std::string &datadir, bool create) {
+    if (m_initialized) {
+        LOG(kFatal, "FileManager has already been initialized");
+    }
+
+    m_datadir = datadir;
+    m_datafiles.reset(new atomic<FSFile*>[MaxNumDataFiles]());
+    m_dir_pids.clear();
+
+    if (create) {
+        std::string path = GetDataFilePath(m_datadir, 0);
+        FSFile *f = FSFile::Open(path, true, false, true);
+        if (!f) {
+            LOG(kFatal, "unable to create data file %s: %s",
+                path, strerror(errno));
+        }
+        f->Allocate(DataFileExtentNumPages * PAGE_SIZE);
+        m_datafiles[0].store(f, memory_order_relaxed);
+        m_ndatafiles.store(1, memory_order_release);
+        m_npages.store(1, memory_order_release);
+        m_free_head = INVALID_PID;
+        m_next_fid = MinRegularFileId;
+        m_initialized = true;
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        PageNumber dir_pid = AllocateRawPage();
+        AccessPage(dir_pid, true, [&](char *buf) {
+            memset(buf, 0, PAGE_SIZE);
+            ((PageHeaderData*) buf)->m_flags = PageHeaderData::FLAG_META_PAGE;
+        });
+        m_dir_pids.push_back(dir_pid);
+        WriteMetaPage();
+        return ;
+    }
+
+    size_t segno = 0;
+    for (;;) {
+        std::string path = GetDataFilePath(m_datadir, segno);
+        if (!regular_file_exists(path.c_str()))
+            break;
+        FSFile *f = FSFile::Open(path, false, false, false);
+        if (!f) {
+            LOG(kFatal, "unable to open data file %s: %s",
+                path, strerror(errno));
+        }
+        m_datafiles[segno].store(f, memory_order_relaxed);
+        ++segno;
+    }
+    if (segno == 0) {
+        LOG(kFatal, "no data file found in %s", m_datadir);
+    }
+    m_ndatafiles.store(segno, memory_order_release);
+
+    unique_malloced_ptr buf = unique_aligned_alloc(512, PAGE_SIZE);
+    m_npages.store(1, memory_order_release);
+    ReadPage(0, (char*) buf.get());
+    FMMetaPage *meta = (FMMetaPage*) buf.get();
+    if (meta->m_magic != FM_MAGIC) {
+        LOG(kFatal, "%s is not a valid data directory", m_datadir);
+    }
+    m_npages.store(meta->m_npages, memory_order_release);
+    m_free_head = meta->m_free_head;
+    m_next_fid = meta->m_next_fid;
+    m_initialized = true;
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    PageNumber dir_pid = meta->m_dir_first_pid;
+    while (dir_pid != INVALID_PID) {
+        m_dir_pids.push_back(dir_pid);
+        AccessPage(dir_pid, false, [&](char *buf) {
+            dir_pid = ((PageHeaderData*) buf)->GetNextPageNumber();
+        });
+    }
+}
+
+void
+FileManager::Destroy() {
+    if (!m_initialized)
+        return;
+
+    WriteMetaPage();
+    Flush();
+    size_t ndatafiles = m_ndatafiles.load(memory_order_acquire);
+    for (size_t i = 0; i < ndatafiles; ++i) {
+        delete m_datafiles[i].load(memory_order_relaxed);
+        m_datafiles[i].store(nullptr, memory_order_relaxed);
+    }
+    m_ndatafiles.store(0, memory_order_release);
+    m_datafiles.reset();
+    m_dir_pids.clear();
+    m_initialized = false;
+}
+
+std::unique_ptr<File>
+FileManager::Open(FileId fid) {
+    if (fid & (TMP_FILEID_MASK | WAL_FILEID_MASK)) {
+        LOG(kError, "temporary and WAL files are not supported yet");
+    }
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (fid != NEW_REGULAR_FID) {
+        PageNumber meta_pid = GetVFileMetaPageNumber(fid);
+        if (meta_pid == INVALID_PID)
+            return nullptr;
+        return std::unique_ptr<File>(new File(this, fid, meta_pid));
+    }
+
+    if (m_next_fid > MaxRegularFileId) {
+        LOG(kError, "running out of file IDs");
+    }
+    fid = m_next_fid++;
+
+    PageNumber meta_pid = AllocateRawPage();
+    PageNumber pid = AllocateRawPage();
+    AccessPage(pid, true, [&](char *buf) {
+        memset(buf, 0, PAGE_SIZE);
+        PageHeaderData *ph = (PageHeaderData*) buf;
+        ph->m_flags = PageHeaderData::FLAG_VFILE_PAGE;
+        ph->m_fid = fid;
+        ph->m_prev_pid.store(INVALID_PID, memory_order_relaxed);
+        ph->m_next_pid.store(INVALID_PID, memory_order_relaxed);
+    }, true);
+    AccessPage(meta_pid, true, [&](char *buf) {
+        memset(buf, 0, PAGE_SIZE);
+        VFileMetaPage *meta = (VFileMetaPage*) buf;
+        meta->m_ph.m_flags = PageHeaderData::FLAG_META_PAGE |
+                             PageHeaderData::FLAG_VFILE_PAGE;
+        meta->m_ph.m_fid = fid;
+        meta->m_first_pid = pid;
+        meta->m_last_pid = pid;
+        meta->m_npages = 1;
+    }, true);
+    SetVFileMetaPageNumber(fid, meta_pid);
+    WriteMetaPage();
+    return std::unique_ptr<File>(new File(this, fid, meta_pid));
+}
+
+void
+FileManager::RemoveFile(FileId fid) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    PageNumber meta_pid = GetVFileMetaPageNumber(fid);
+    if (meta_pid == INVALID_PID) {
+        LOG(kError, "file " FILEID_FORMAT " does not exist", fid);
+    }
+    RemoveFileImpl(fid, meta_pid);
+    WriteMetaPage();
+}
+
+void
+FileManager::RemoveFileImpl(FileId fid, PageNumber meta_pid) {
+    PageNumber pid;
+    AccessPage(meta_pid, false, [&](char *buf) {
+        pid = ((VFileMetaPage*) buf)->m_first_pid;
+    });
+    while (pid != INVALID_PID) {
+        PageNumber next_pid;
+        AccessPage(pid, false, [&](char *buf) {
+            next_pid = ((PageHeaderData*) buf)->GetNextPageNumber();
+        });
+        FreeRawPage(pid);
+        pid = next_pid;
+    }
+    FreeRawPage(meta_pid);
+    SetVFileMetaPageNumber(fid, INVALID_PID);
+}
+
+void
+FileManager::ReadPage(PageNumber pid, char *buf) {
+    ASSERT(pid < m_npages.load(memory_order_acquire),
+           "page " PAGENUMBER_FORMAT " does not exist", pid);
+    GetDataFile(pid)->Read(buf, PAGE_SIZE,
+                           (off_t)(pid % DataFileNumPages) * PAGE_SIZE);
+}
+
+void
+FileManager::WritePage(PageNumber pid, const char *buf) {
+    ASSERT(pid < m_npages.load(memory_order_acquire),
+           "page " PAGENUMBER_FORMAT " does not exist", pid);
+    GetDataFile(pid)->Write(buf, PAGE_SIZE,
+                            (off_t)(pid % DataFileNumPages) * PAGE_SIZE);
+}
+
+void
+FileManager::WritePages(PageNumber first_pid, const char *const *bufs,
+                        size_t npages) {
+    ASSERT(first_pid + npages <= m_npages.load(memory_order_acquire),
+           "page " PAGENUMBER_FORMAT " does not exist",
+           (PageNumber)(first_pid + npages - 1));
+    struct iovec iov[IOV_MAX];
+    while (npages > 0) {
+        // A single write can't cross the boundary of a data file segment.
+        size_t n = std::min(npages,
+            (size_t)(DataFileNumPages - first_pid % DataFileNumPages));
+        n = std::min(n, (size_t) IOV_MAX);
+        for (size_t i = 0; i < n; ++i) {
+            iov[i].iov_base = (void*) bufs[i];
+            iov[i].iov_len = PAGE_SIZE;
+        }
+        GetDataFile(first_pid)->WriteV(iov, (int) n,
+            (off_t)(first_pid % DataFileNumPages) * PAGE_SIZE);
+        first_pid += n;
+        bufs += n;
+        npages -= n;
+    }
+}
+
+void
+FileManager::Flush() {
+    size_t ndatafiles = m_ndatafiles.load(memory_order_acquire);
+    for (size_t i = 0; i < ndatafiles; ++i) {
+        m_datafiles[i].load(memory_order_relaxed)->Flush();
+    }
+}
+
+FSFile*
+FileManager::GetDataFile(PageNumber pid) const {
+    size_t segno = pid / DataFileNumPages;
+    ASSERT(segno < m_ndatafiles.load(memory_order_acquire));
+    return m_datafiles[segno].load(memory_order_acquire);
+}
+
+PageNumber
+FileManager::AllocateRawPage() {
+    if (m_free_head != INVALID_PID) {
+        PageNumber pid = m_free_head;
+        AccessPage(pid, false, [&](char *buf) {
+            m_free_head = ((PageHeaderData*) buf)->GetNextPageNumber();
+        });
+        return pid;
+    }
+
+    return ExtendDataFiles(1);
+}
+
+PageNumber
+FileManager::ExtendDataFiles(PageNumber npages) {
+    PageNumber first_pid = m_npages.load(memory_order_relaxed);
+    if (first_pid > MaxPageNumber || npages - 1 > MaxPageNumber - first_pid) {
+        LOG(kError, "running out of page numbers");
+    }
+
+    PageNumber pid = first_pid;
+    PageNumber end_pid = first_pid + npages;
+    while (pid != end_pid) {
+        size_t segno = pid / DataFileNumPages;
+        if (segno >= m_ndatafiles.load(memory_order_relaxed)) {
+            std::string path = GetDataFilePath(m_datadir, segno);
+            FSFile *f = FSFile::Open(path, true, false, true);
+            if (!f) {
+                LOG(kFatal, "unable to create data file %s: %s",
+                    path, strerror(errno));
+            }
+            m_datafiles[segno].store(f, memory_order_release);
+            m_ndatafiles.store(segno + 1, memory_order_release);
+        }
+
+        // The pages up to seg_end are in this segment.
+        PageNumber seg_end = std::min(end_pid - pid,
+            (PageNumber)(DataFileNumPages - pid % DataFileNumPages)) + pid;
+        FSFile *f = m_datafiles[segno].load(memory_order_relaxed);
+        size_t end_off = (size_t)((seg_end - 1) % DataFileNumPages + 1) *
+                         PAGE_SIZE;
+        if (end_off > f->Size()) {
+            size_t nbytes = std::max(end_off - f->Size(),
+                                     (size_t) DataFileExtentNumPages *
+                                     PAGE_SIZE);
+            nbytes = std::min(nbytes, (size_t) DataFileNumPages * PAGE_SIZE -
+                                      f->Size());
+            f->Allocate(nbytes);
+        }
+        pid = seg_end;
+    }
+    m_npages.store(end_pid, memory_order_release);
+    return first_pid;
+}
+
+void
+FileManager::FreeRawPage(PageNumber pid) {
+    AccessPage(pid, true, [&](char *buf) {
+        PageHeaderData *ph = (PageHeaderData*) buf;
+        ph->m_flags = 0;
+        ph->m_fid = INVALID_FID;
+        ph->m_prev_pid.store(INVALID_PID, memory_order_relaxed);
+        ph->m_next_pid.store(m_free_head, memory_order_release);
+    }, true);
+    m_free_head = pid;
+}
+
+PageNumber
+FileManager::GetVFileMetaPageNumber(FileId fid) {
+    if (fid < MinRegularFileId || fid >= m_next_fid)
+        return INVALID_PID;
+    size_t idx = fid / FMDirPageNumEntries;
+    if (idx >= m_dir_pids.size())
+        return INVALID_PID;
+    PageNumber meta_pid;
+    AccessPage(m_dir_pids[idx], false, [&](char *buf) {
+        meta_pid = ((FMDirPage*) buf)->m_meta_pid[fid % FMDirPageNumEntries];
+    });
+    return meta_pid;
+}
+
+void
+FileManager::SetVFileMetaPageNumber(FileId fid, PageNumber meta_pid) {
+    size_t idx = fid / FMDirPageNumEntries;
+    while (idx >= m_dir_pids.size()) {
+        PageNumber dir_pid = AllocateRawPage();
+        AccessPage(dir_pid, true, [&](char *buf) {
+            memset(buf, 0, PAGE_SIZE);
+            ((PageHeaderData*) buf)->m_flags = PageHeaderData::FLAG_META_PAGE;
+        }, true);
+        AccessPage(m_dir_pids.back(), true, [&](char *buf) {
+            ((PageHeaderData*) buf)->m_next_pid.store(dir_pid,
+                                                      memory_order_release);
+        });
+        m_dir_pids.push_back(dir_pid);
+    }
+    AccessPage(m_dir_pids[idx], true, [&](char *buf) {
+        ((FMDirPage*) buf)->m_meta_pid[fid % FMDirPageNumEntries] = meta_pid;
+    });
+}
+
+template<class Func>
+void
+FileManager::AccessPage(PageNumber pid, bool dirty, Func &&func,
+                        bool latch) {
+    BufferManager *bufman = g_bufman;
+    if (bufman) {
+        char *frame;
+        ScopedBufferId bufid = bufman->PinPage(pid, &frame);
+        if (latch) {
+            ScopedFrameLatch frame_latch(bufid, LatchMode::EX);
+            func(frame);
+        } else {
+            func(frame);
+        }
+        if (dirty) {
+            bufman->MarkDirty(bufid);
+        }
+        return ;
+    }
+
+    unique_malloced_ptr buf = unique_aligned_alloc(512, PAGE_SIZE);
+    ReadPage(pid, (char*) buf.get());
+    func((char*) buf.get());
+    if (dirty) {
+        WritePage(pid, (char*) buf.get());
+    }
+}
+
+void
+FileManager::WriteMetaPage() {
+    unique_malloced_ptr buf = unique_aligned_alloc(512, PAGE_SIZE);
+    memset(buf.get(), 0, PAGE_SIZE);
+    FMMetaPage *meta = (FMMetaPage*) buf.get();
+    meta->m_ph.m_flags = PageHeaderData::FLAG_META_PAGE;
+    meta->m_magic = FM_MAGIC;
+    meta->m_npages = m_npages.load(memory_order_relaxed);
+    meta->m_free_head = m_free_head;
+    meta->m_next_fid = m_next_fid;
+    meta->m_dir_first_pid = m_dir_pids.empty() ? INVALID_PID : m_dir_pids[0];
+    WritePage(0, (char*) buf.get());
+}
+
+}   // namespace taco
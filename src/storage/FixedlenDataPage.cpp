@@ -0,0 +1,141 @@
+#include "storage/FixedlenDataPage.h"
+
+namespace taco {
+
+//! Returns the number of 64-bit words in the bitmap of \p nslots slots.
+static inline size_t
+BitmapNumWords(size_t nslots) {
+    return (nslots + 63) >> 6;
+}
+
+SlotId
+FixedlenDataPage::ComputeCapacity(FieldOffset reclen,
+                                  FieldOffset usr_data_sz) {
+    if (reclen <= 0 || reclen % MAXALIGN_OF != 0)
+        return 0;
+    size_t avail = PAGE_SIZE - MAXALIGN(sizeof(FixedlenDataPageHeader)) -
+        MAXALIGN(usr_data_sz);
+    if (avail > PAGE_SIZE)
+        return 0;
+
+    // Each record takes reclen bytes and one bit, and the bitmap is
+    // rounded up to 64-bit words.
+    size_t nslots = avail * 8 / ((size_t) reclen * 8 + 1);
+    while (nslots > 0 && nslots * reclen + BitmapNumWords(nslots) * 8 > avail)
+        --nslots;
+    return (SlotId) nslots;
+}
+
+void
+FixedlenDataPage::Initialize(char *pagebuf, FieldOffset reclen,
+                             FieldOffset usr_data_sz) {
+    SlotId nslots = ComputeCapacity(reclen, usr_data_sz);
+    if (nslots == 0) {
+        LOG(kError, "unable to fit a record of length %d on a fixed-length "
+                    "data page with %d bytes of user data",
+                    reclen, usr_data_sz);
+    }
+
+    FixedlenDataPageHeader *hdr = (FixedlenDataPageHeader*) pagebuf;
+    hdr->m_reclen = reclen;
+    hdr->m_bitmap_begin = (FieldOffset)(
+        MAXALIGN(sizeof(FixedlenDataPageHeader)) + MAXALIGN(usr_data_sz));
+    hdr->m_rec_begin = (FieldOffset)(hdr->m_bitmap_begin +
+                                     BitmapNumWords(nslots) * 8);
+    hdr->m_nslots = nslots;
+    hdr->m_cnt = 0;
+    memset(pagebuf + hdr->m_bitmap_begin, 0, BitmapNumWords(nslots) * 8);
+}
+
+bool
+FixedlenDataPage::InsertRecord(Record &rec) {
+    if (rec.GetLength() != GetHeader()->m_reclen) {
+        LOG(kError, "expecting a record of length %d, but got %d",
+                    GetHeader()->m_reclen, rec.GetLength());
+    }
+    SlotId sid;
+    char *buf = AllocateRecord(&sid);
+    if (!buf)
+        return false;
+    memcpy(buf, rec.GetData(), rec.GetLength());
+    rec.GetRecordId().sid = sid;
+    return true;
+}
+
+char*
+FixedlenDataPage::AllocateRecord(SlotId *p_sid) {
+    FixedlenDataPageHeader *hdr = GetHeader();
+    if (hdr->m_cnt == hdr->m_nslots)
+        return nullptr;
+
+    // There must be a free slot, so the first zero bit is found before the
+    // unused bits of the last word.
+    uint64_t *bitmap = GetBitmap();
+    size_t i = 0;
+    while (bitmap[i] == ~(uint64_t) 0)
+        ++i;
+    SlotId idx = (SlotId)((i << 6) + __builtin_ctzll(~bitmap[i]));
+    ASSERT(idx < hdr->m_nslots);
+    bitmap[i] |= ((uint64_t) 1) << (idx & 63);
+    ++hdr->m_cnt;
+
+    *p_sid = idx + MinSlotId;
+    return GetRecordPtr(*p_sid);
+}
+
+bool
+FixedlenDataPage::EraseRecord(SlotId sid) {
+    if (!IsOccupied(sid))
+        return false;
+    SlotId idx = sid - MinSlotId;
+    GetBitmap()[idx >> 6] &= ~(((uint64_t) 1) << (idx & 63));
+    --GetHeader()->m_cnt;
+    return true;
+}
+
+bool
+FixedlenDataPage::UpdateRecord(SlotId sid, Record &rec) {
+    FixedlenDataPageHeader *hdr = GetHeader();
+    if (!IsOccupied(sid)) {
+        LOG(kError, "slot " SLOTID_FORMAT " is not occupied", sid);
+    }
+    if (rec.GetLength() != hdr->m_reclen) {
+        LOG(kError, "expecting a record of length %d, but got %d",
+                    hdr->m_reclen, rec.GetLength());
+    }
+    memmove(GetRecordPtr(sid), rec.GetData(), hdr->m_reclen);
+    rec.GetRecordId().sid = sid;
+    return true;
+}
+
+const char*
+FixedlenDataPage::GetRecordBuf(SlotId sid, FieldOffset *p_reclen) const {
+    if (!IsOccupied(sid))
+        return nullptr;
+    if (p_reclen)
+        *p_reclen = GetHeader()->m_reclen;
+    return GetRecordPtr(sid);
+}
+
+SlotId
+FixedlenDataPage::GetNextOccupiedSlot(SlotId sid) const {
+    // idx is the bit index of sid + 1
+    size_t idx = sid;
+    size_t nslots = GetHeader()->m_nslots;
+    if (idx >= nslots)
+        return INVALID_SID;
+
+    const uint64_t *bitmap = GetBitmap();
+    size_t i = idx >> 6;
+    uint64_t word = bitmap[i] & (~(uint64_t) 0 << (idx & 63));
+    const size_t nwords = BitmapNumWords(nslots);
+    for (;;) {
+        if (word)
+            return (SlotId)((i << 6) + __builtin_ctzll(word) + MinSlotId);
+        if (++i == nwords)
+            return INVALID_SID;
+        word = bitmap[i];
+    }
+}
+
+}   // namespace taco
@@ -0,0 +1,199 @@
+#include "storage/FreeSpaceMap.h"
+
+#include "storage/BufferManager.h"
+
+namespace taco {
+
+constexpr size_t FreeSpaceMap::CategoryStep;
+constexpr uint8_t FreeSpaceMap::MaxCategory;
+constexpr size_t FreeSpaceMap::EntriesPerPage;
+
+static_assert(MAXALIGN(sizeof(FreeSpaceMapPageHeader)) +
+              FreeSpaceMap::EntriesPerPage * sizeof(PageNumber) +
+              (FreeSpaceMap::EntriesPerPage + 1) / 2 <= PAGE_SIZE,
+              "the free-space map page entries do not fit on a page");
+
+//! Returns the page number array of a map page.
+static inline PageNumber*
+GetMapPagePids(char *frame) {
+    return (PageNumber*)(frame + MAXALIGN(sizeof(FreeSpaceMapPageHeader)));
+}
+
+//! Returns the category array of a map page.
+static inline uint8_t*
+GetMapPageCats(char *frame) {
+    return (uint8_t*)(GetMapPagePids(frame) + FreeSpaceMap::EntriesPerPage);
+}
+
+static inline uint8_t
+GetCat(const uint8_t *cats, size_t i) {
+    return (cats[i >> 1] >> ((i & 1) << 2)) & 0xf;
+}
+
+static inline void
+SetCat(uint8_t *cats, size_t i, uint8_t cat) {
+    uint8_t shift = (i & 1) << 2;
+    cats[i >> 1] = (uint8_t)((cats[i >> 1] & ~(0xf << shift)) |
+                             (cat << shift));
+}
+
+FileId
+FreeSpaceMap::Create() {
+    // A zero-filled page is an empty map page.
+    std::unique_ptr<File> file = g_fileman->Open(NEW_REGULAR_FID);
+    return file->GetFileId();
+}
+
+FreeSpaceMap::FreeSpaceMap(FileId fid):
+    m_file(g_fileman->Open(fid)),
+    m_nentries(0) {
+    PageNumber pid = m_file->GetFirstPageNumber();
+    uint16_t last_cnt = 0;
+    while (pid != INVALID_PID) {
+        m_map_pids.push_back(pid);
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+        FreeSpaceMapPageHeader *hdr = (FreeSpaceMapPageHeader*) frame;
+        last_cnt = hdr->m_cnt;
+        pid = hdr->m_ph.GetNextPageNumber();
+    }
+    m_nentries.store((uint32_t)((m_map_pids.size() - 1) * EntriesPerPage +
+                                last_cnt), memory_order_release);
+}
+
+uint32_t
+FreeSpaceMap::AddPage(PageNumber pid, uint8_t cat) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    char *frame;
+    ScopedBufferId bufid = g_bufman->PinPage(m_map_pids.back(), &frame);
+    FreeSpaceMapPageHeader *hdr = (FreeSpaceMapPageHeader*) frame;
+    if (hdr->m_cnt == EntriesPerPage) {
+        // Only AddPage() changes m_cnt, so there's no need to latch the
+        // page for reading it.
+        PageNumber map_pid = m_file->AllocatePage();
+        bufid = ScopedBufferId(g_bufman->PinPage(map_pid, &frame));
+        hdr = (FreeSpaceMapPageHeader*) frame;
+        m_map_pids.push_back(map_pid);
+    }
+
+    ScopedFrameLatch latch(bufid, LatchMode::EX);
+    uint16_t i = hdr->m_cnt;
+    GetMapPagePids(frame)[i] = pid;
+    SetCat(GetMapPageCats(frame), i, cat);
+    hdr->m_cnt = i + 1;
+    hdr->m_max_cat = std::max(hdr->m_max_cat, cat);
+    g_bufman->MarkDirty(bufid);
+
+    uint32_t idx = (uint32_t)((m_map_pids.size() - 1) * EntriesPerPage + i);
+    m_nentries.store(idx + 1, memory_order_release);
+    return idx;
+}
+
+void
+FreeSpaceMap::RemovePage(uint32_t idx) {
+    ASSERT(idx < GetNumEntries());
+    char *frame;
+    ScopedBufferId bufid =
+        g_bufman->PinPage(GetMapPageNumber(idx / EntriesPerPage), &frame);
+    ScopedFrameLatch latch(bufid, LatchMode::EX);
+    size_t i = idx % EntriesPerPage;
+    GetMapPagePids(frame)[i] = INVALID_PID;
+    SetCat(GetMapPageCats(frame), i, 0);
+    g_bufman->MarkDirty(bufid);
+}
+
+PageNumber
+FreeSpaceMap::GetPageNumber(uint32_t idx) {
+    ASSERT(idx < GetNumEntries());
+    char *frame;
+    ScopedBufferId bufid =
+        g_bufman->PinPage(GetMapPageNumber(idx / EntriesPerPage), &frame);
+    ScopedFrameLatch latch(bufid, LatchMode::SH);
+    return GetMapPagePids(frame)[idx % EntriesPerPage];
+}
+
+void
+FreeSpaceMap::UpdateCategory(uint32_t idx, uint8_t cat) {
+    ASSERT(idx < GetNumEntries());
+    char *frame;
+    ScopedBufferId bufid =
+        g_bufman->PinPage(GetMapPageNumber(idx / EntriesPerPage), &frame);
+    ScopedFrameLatch latch(bufid, LatchMode::EX);
+    FreeSpaceMapPageHeader *hdr = (FreeSpaceMapPageHeader*) frame;
+    uint8_t *cats = GetMapPageCats(frame);
+    size_t i = idx % EntriesPerPage;
+    if (GetMapPagePids(frame)[i] == INVALID_PID) {
+        // The page has been removed since the caller looked it up.
+        return ;
+    }
+    if (GetCat(cats, i) != cat) {
+        SetCat(cats, i, cat);
+        hdr->m_max_cat = std::max(hdr->m_max_cat, cat);
+        g_bufman->MarkDirty(bufid);
+    }
+}
+
+uint8_t
+FreeSpaceMap::GetCategory(uint32_t idx) {
+    ASSERT(idx < GetNumEntries());
+    char *frame;
+    ScopedBufferId bufid =
+        g_bufman->PinPage(GetMapPageNumber(idx / EntriesPerPage), &frame);
+    ScopedFrameLatch latch(bufid, LatchMode::SH);
+    return GetCat(GetMapPageCats(frame), idx % EntriesPerPage);
+}
+
+PageNumber
+FreeSpaceMap::SearchMapPage(size_t i, uint16_t begin, uint16_t end,
+                            uint8_t min_cat, uint32_t *p_idx) {
+    char *frame;
+    ScopedBufferId bufid = g_bufman->PinPage(GetMapPageNumber(i), &frame);
+    ScopedFrameLatch latch(bufid, LatchMode::EX);
+    FreeSpaceMapPageHeader *hdr = (FreeSpaceMapPageHeader*) frame;
+    if (hdr->m_max_cat < min_cat)
+        return INVALID_PID;
+
+    end = std::min(end, hdr->m_cnt);
+    const uint8_t *cats = GetMapPageCats(frame);
+    uint8_t max_cat = 0;
+    for (uint16_t j = begin; j < end; ++j) {
+        uint8_t cat = GetCat(cats, j);
+        if (cat >= min_cat && GetMapPagePids(frame)[j] != INVALID_PID) {
+            *p_idx = (uint32_t)(i * EntriesPerPage + j);
+            return GetMapPagePids(frame)[j];
+        }
+        max_cat = std::max(max_cat, cat);
+    }
+
+    if (begin == 0 && end == hdr->m_cnt && max_cat < hdr->m_max_cat) {
+        // We've seen all the entries, so tighten the upper bound.
+        hdr->m_max_cat = max_cat;
+        g_bufman->MarkDirty(bufid);
+    }
+    return INVALID_PID;
+}
+
+PageNumber
+FreeSpaceMap::Search(uint8_t min_cat, uint32_t start, uint32_t *p_idx) {
+    uint32_t n = GetNumEntries();
+    if (n == 0)
+        return INVALID_PID;
+    start %= n;
+
+    size_t npages = (n + EntriesPerPage - 1) / EntriesPerPage;
+    size_t start_page = start / EntriesPerPage;
+    uint16_t start_entry = (uint16_t)(start % EntriesPerPage);
+    for (size_t k = 0; k <= npages; ++k) {
+        size_t i = (start_page + k) % npages;
+        uint16_t begin = (k == 0) ? start_entry : 0;
+        uint16_t end = (k == npages) ? start_entry : (uint16_t) EntriesPerPage;
+        if (begin >= end)
+            continue;
+        PageNumber pid = SearchMapPage(i, begin, end, min_cat, p_idx);
+        if (pid != INVALID_PID)
+            return pid;
+    }
+    return INVALID_PID;
+}
+
+}   // namespace taco
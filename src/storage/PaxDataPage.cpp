@@ -0,0 +1,395 @@
+#include "storage/PaxDataPage.h"
+
+#include <algorithm>
+
+namespace taco {
+
+static_assert(PAGE_SIZE < 32768,
+              "the offsets on a PAX data page must fit in a FieldOffset");
+
+//! Returns the number of 64-bit words in the bitmap of \p nslots slots.
+static inline size_t
+BitmapNumWords(size_t nslots) {
+    return (nslots + 63) >> 6;
+}
+
+//! Returns the length of a column value in its minipage.
+static inline size_t
+GetMinipageValueLength(const Schema *schema, FieldId field_id) {
+    int16_t typlen = schema->GetFieldLength(field_id);
+    return (typlen == -1) ? sizeof(PaxVarlenValue) : (size_t) typlen;
+}
+
+size_t
+PaxDataPage::ComputeMinipageEnd(const Schema *schema, size_t dir_begin,
+                                size_t nslots) {
+    size_t off = dir_begin +
+        MAXALIGN(schema->GetNumFields() * sizeof(PaxMinipage));
+    off += BitmapNumWords(nslots) * 8;
+    for (FieldId i = 0; i < schema->GetNumFields(); ++i) {
+        if (schema->FieldIsNullable(i)) {
+            off += MAXALIGN((nslots + 7) >> 3);
+        }
+        off += MAXALIGN(nslots * GetMinipageValueLength(schema, i));
+    }
+    return off;
+}
+
+SlotId
+PaxDataPage::ComputeCapacity(const Schema *schema, FieldOffset usr_data_sz) {
+    size_t dir_begin = MAXALIGN(sizeof(PaxDataPageHeader)) +
+                       MAXALIGN(usr_data_sz);
+    size_t nvarlen = 0;
+    for (FieldId i = 0; i < schema->GetNumFields(); ++i) {
+        if (schema->GetFieldLength(i) == -1)
+            ++nvarlen;
+    }
+
+    // Finds the max number of slots that leaves enough heap space for the
+    // estimated variable-length values.
+    size_t lo = 0, hi = PAGE_SIZE;
+    while (lo < hi) {
+        size_t mid = (lo + hi + 1) / 2;
+        if (ComputeMinipageEnd(schema, dir_begin, mid) +
+                mid * nvarlen * VarlenFieldEstimate <= PAGE_SIZE) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return (SlotId) lo;
+}
+
+FieldOffset
+PaxDataPage::ComputeHeapSize(const Schema *schema, FieldOffset usr_data_sz) {
+    SlotId nslots = ComputeCapacity(schema, usr_data_sz);
+    if (nslots == 0)
+        return 0;
+    size_t dir_begin = MAXALIGN(sizeof(PaxDataPageHeader)) +
+                       MAXALIGN(usr_data_sz);
+    return (FieldOffset)(PAGE_SIZE -
+                         ComputeMinipageEnd(schema, dir_begin, nslots));
+}
+
+void
+PaxDataPage::Initialize(char *pagebuf, const Schema *schema,
+                        FieldOffset usr_data_sz) {
+    SlotId nslots = ComputeCapacity(schema, usr_data_sz);
+    if (nslots == 0) {
+        LOG(kError, "unable to fit a record on a PAX data page with %d bytes "
+                    "of user data", usr_data_sz);
+    }
+
+    PaxDataPageHeader *hdr = (PaxDataPageHeader*) pagebuf;
+    hdr->m_ncols = schema->GetNumFields();
+    hdr->m_nslots = nslots;
+    hdr->m_cnt = 0;
+    hdr->m_dir_begin = (FieldOffset)(
+        MAXALIGN(sizeof(PaxDataPageHeader)) + MAXALIGN(usr_data_sz));
+    hdr->m_bitmap_begin = (FieldOffset)(hdr->m_dir_begin +
+        MAXALIGN(hdr->m_ncols * sizeof(PaxMinipage)));
+
+    size_t off = hdr->m_bitmap_begin + BitmapNumWords(nslots) * 8;
+    size_t slot_sz = 0;
+    PaxMinipage *dir = (PaxMinipage*)(pagebuf + hdr->m_dir_begin);
+    for (FieldId i = 0; i < hdr->m_ncols; ++i) {
+        if (schema->FieldIsNullable(i)) {
+            dir[i].m_null_begin = (FieldOffset) off;
+            off += MAXALIGN((nslots + 7) >> 3);
+        } else {
+            dir[i].m_null_begin = 0;
+        }
+        dir[i].m_begin = (FieldOffset) off;
+        size_t vlen = GetMinipageValueLength(schema, i);
+        off += MAXALIGN(nslots * vlen);
+        slot_sz += vlen;
+    }
+    ASSERT(off == ComputeMinipageEnd(schema, hdr->m_dir_begin, nslots));
+    hdr->m_slot_sz = (FieldOffset) slot_sz;
+    hdr->m_heap_begin = (FieldOffset) off;
+    hdr->m_heap_free_end = (FieldOffset) PAGE_SIZE;
+    hdr->m_heap_garbage = 0;
+
+    // Only the bitmaps need to be cleared. The values of the free slots are
+    // never read.
+    memset(pagebuf + hdr->m_bitmap_begin, 0, BitmapNumWords(nslots) * 8);
+    for (FieldId i = 0; i < hdr->m_ncols; ++i) {
+        if (dir[i].m_null_begin != 0) {
+            memset(pagebuf + dir[i].m_null_begin, 0, (nslots + 7) >> 3);
+        }
+    }
+}
+
+size_t
+PaxDataPage::ComputeVarlenLength(const Schema *schema, const char *payload) {
+    size_t len = 0;
+    for (FieldId i = 0; i < schema->GetNumFields(); ++i) {
+        if (schema->GetFieldLength(i) != -1 || schema->FieldIsNull(i, payload))
+            continue;
+        len += schema->GetOffsetAndLength(i, payload).second +
+               schema->GetFieldAlignment(i) - 1;
+    }
+    return len;
+}
+
+size_t
+PaxDataPage::ComputeSpaceNeeded(const Schema *schema, const char *payload) {
+    size_t slot_sz = 0;
+    for (FieldId i = 0; i < schema->GetNumFields(); ++i) {
+        slot_sz += GetMinipageValueLength(schema, i);
+    }
+    return slot_sz + ComputeVarlenLength(schema, payload);
+}
+
+//! the field offsets and lengths of the payload written by WriteFields(),
+//! which are reused across the calls in the same thread
+static thread_local std::vector<std::pair<FieldOffset, FieldOffset>>
+    s_offlen;
+
+//! the fields of the record reconstructed by GetRecord(), which are reused
+//! across the calls in the same thread
+static thread_local std::vector<Datum> s_fields;
+
+void
+PaxDataPage::WriteFields(SlotId idx, const char *payload) {
+    PaxDataPageHeader *hdr = GetHeader();
+    s_offlen.resize(m_schema->GetNumFields());
+    if (m_codec)
+        m_codec->DeformPayload(payload, s_offlen.data());
+    else
+        m_schema->DeformPayload(payload, hdr->m_ncols - 1, s_offlen.data());
+    for (FieldId i = 0; i < hdr->m_ncols; ++i) {
+        const PaxMinipage *mp = GetMinipage(i);
+        const std::pair<FieldOffset, FieldOffset> &p = s_offlen[i];
+        bool isnull = p.second < 0;
+        if (mp->m_null_begin != 0) {
+            uint8_t *null_byte =
+                (uint8_t*)(m_pagebuf + mp->m_null_begin + (idx >> 3));
+            if (isnull)
+                *null_byte |= (uint8_t)(1 << (idx & 7));
+            else
+                *null_byte &= (uint8_t) ~(1 << (idx & 7));
+        }
+
+        int16_t typlen = m_schema->GetFieldLength(i);
+        if (typlen == -1) {
+            PaxVarlenValue *v =
+                ((PaxVarlenValue*)(m_pagebuf + mp->m_begin)) + idx;
+            if (isnull) {
+                v->m_off = 0;
+                v->m_len = 0;
+                continue;
+            }
+            hdr->m_heap_free_end = TYPEALIGN_DOWN(
+                m_schema->GetFieldAlignment(i),
+                (FieldOffset)(hdr->m_heap_free_end - p.second));
+            ASSERT(hdr->m_heap_free_end >= hdr->m_heap_begin);
+            memcpy(m_pagebuf + hdr->m_heap_free_end, payload + p.first,
+                   p.second);
+            v->m_off = hdr->m_heap_free_end;
+            v->m_len = p.second;
+            if (m_schema->FieldIsExternal(i, payload)) {
+                v->m_len = (FieldOffset)((uint16_t) v->m_len |
+                                         Schema::VarlenEndExternalBit);
+            }
+        } else {
+            char *dst = m_pagebuf + mp->m_begin + (size_t) idx * typlen;
+            if (isnull) {
+                memset(dst, 0, typlen);
+                continue;
+            }
+            memcpy(dst, payload + p.first, typlen);
+        }
+    }
+}
+
+void
+PaxDataPage::EraseVarlenValues(SlotId idx) {
+    PaxDataPageHeader *hdr = GetHeader();
+    for (FieldId i = 0; i < hdr->m_ncols; ++i) {
+        if (m_schema->GetFieldLength(i) != -1)
+            continue;
+        const PaxVarlenValue *v =
+            ((const PaxVarlenValue*)(m_pagebuf + GetMinipage(i)->m_begin)) +
+            idx;
+        hdr->m_heap_garbage += v->GetLength();
+    }
+}
+
+void
+PaxDataPage::Compact() {
+    PaxDataPageHeader *hdr = GetHeader();
+    std::vector<std::pair<PaxVarlenValue*, FieldId>> values;
+    for (SlotId sid = GetNextOccupiedSlot(INVALID_SID); sid != INVALID_SID;
+            sid = GetNextOccupiedSlot(sid)) {
+        for (FieldId i = 0; i < hdr->m_ncols; ++i) {
+            if (m_schema->GetFieldLength(i) != -1 || FieldIsNull(sid, i))
+                continue;
+            values.emplace_back(
+                ((PaxVarlenValue*)(m_pagebuf + GetMinipage(i)->m_begin)) +
+                (sid - MinSlotId), i);
+        }
+    }
+
+    // Moving the values in the descending order of their offsets never
+    // overwrites a value that has not been moved.
+    std::sort(values.begin(), values.end(),
+        [](const std::pair<PaxVarlenValue*, FieldId> &a,
+           const std::pair<PaxVarlenValue*, FieldId> &b) {
+            return a.first->m_off > b.first->m_off;
+        });
+    FieldOffset end = (FieldOffset) PAGE_SIZE;
+    for (const std::pair<PaxVarlenValue*, FieldId> &p : values) {
+        PaxVarlenValue *v = p.first;
+        end = TYPEALIGN_DOWN(m_schema->GetFieldAlignment(p.second),
+                             (FieldOffset)(end - v->GetLength()));
+        if (end != v->m_off) {
+            memmove(m_pagebuf + end, m_pagebuf + v->m_off, v->GetLength());
+            v->m_off = end;
+        }
+    }
+    hdr->m_heap_free_end = end;
+    hdr->m_heap_garbage = 0;
+}
+
+bool
+PaxDataPage::InsertRecord(Record &rec) {
+    PaxDataPageHeader *hdr = GetHeader();
+    if (hdr->m_cnt == hdr->m_nslots)
+        return false;
+
+    size_t varlen_len = ComputeVarlenLength(m_schema, rec.GetData());
+    if ((size_t)(hdr->m_heap_free_end - hdr->m_heap_begin) < varlen_len) {
+        if ((size_t)(hdr->m_heap_free_end - hdr->m_heap_begin +
+                     hdr->m_heap_garbage) < varlen_len)
+            return false;
+        Compact();
+        if ((size_t)(hdr->m_heap_free_end - hdr->m_heap_begin) < varlen_len)
+            return false;
+    }
+
+    // There must be a free slot, so the first zero bit is found before the
+    // unused bits of the last word.
+    uint64_t *bitmap = GetBitmap();
+    size_t i = 0;
+    while (bitmap[i] == ~(uint64_t) 0)
+        ++i;
+    SlotId idx = (SlotId)((i << 6) + __builtin_ctzll(~bitmap[i]));
+    ASSERT(idx < hdr->m_nslots);
+    WriteFields(idx, rec.GetData());
+    bitmap[i] |= ((uint64_t) 1) << (idx & 63);
+    ++hdr->m_cnt;
+    rec.GetRecordId().sid = idx + MinSlotId;
+    return true;
+}
+
+bool
+PaxDataPage::EraseRecord(SlotId sid) {
+    if (!IsOccupied(sid))
+        return false;
+    SlotId idx = sid - MinSlotId;
+    EraseVarlenValues(idx);
+    GetBitmap()[idx >> 6] &= ~(((uint64_t) 1) << (idx & 63));
+    --GetHeader()->m_cnt;
+    return true;
+}
+
+bool
+PaxDataPage::UpdateRecord(SlotId sid, Record &rec) {
+    if (!IsOccupied(sid)) {
+        LOG(kError, "slot " SLOTID_FORMAT " is not occupied", sid);
+    }
+
+    PaxDataPageHeader *hdr = GetHeader();
+    SlotId idx = sid - MinSlotId;
+    size_t varlen_len = ComputeVarlenLength(m_schema, rec.GetData());
+    if ((size_t)(hdr->m_heap_free_end - hdr->m_heap_begin) < varlen_len) {
+        // The old values may be compacted away, so save the old record in
+        // case the new one still does not fit.
+        maxaligned_char_buf oldrec;
+        GetRecord(sid, oldrec);
+        EraseRecord(sid);
+        Compact();
+        bool fits = (size_t)(hdr->m_heap_free_end - hdr->m_heap_begin) >=
+                    varlen_len;
+        WriteFields(idx, fits ? rec.GetData() : oldrec.data());
+        GetBitmap()[idx >> 6] |= ((uint64_t) 1) << (idx & 63);
+        ++hdr->m_cnt;
+        if (!fits)
+            return false;
+    } else {
+        EraseVarlenValues(idx);
+        WriteFields(idx, rec.GetData());
+    }
+    rec.GetRecordId().sid = sid;
+    return true;
+}
+
+Datum
+PaxDataPage::GetField(SlotId sid, FieldId field_id) const {
+    ASSERT(IsOccupied(sid));
+    if (FieldIsNull(sid, field_id))
+        return Datum::FromNull();
+
+    const PaxMinipage *mp = GetMinipage(field_id);
+    SlotId idx = sid - MinSlotId;
+    int16_t typlen = m_schema->GetFieldLength(field_id);
+    if (typlen == -1) {
+        const PaxVarlenValue *v =
+            ((const PaxVarlenValue*)(m_pagebuf + mp->m_begin)) + idx;
+        return Datum::FromVarlenBytes(m_pagebuf + v->m_off, v->GetLength());
+    }
+
+    const char *value = m_pagebuf + mp->m_begin + (size_t) idx * typlen;
+    if (m_schema->FieldPassByRef(field_id))
+        return Datum::FromVarlenBytes(value, typlen);
+    return Datum::FromFixedlenBytes(value, typlen);
+}
+
+bool
+PaxDataPage::GetRecord(SlotId sid, maxaligned_char_buf &buf) const {
+    if (!IsOccupied(sid))
+        return false;
+
+    // The fields reference the page, so neither they nor the buffer are
+    // allocated once they have grown to the size of the records.
+    s_fields.clear();
+    for (FieldId i = 0; i < GetHeader()->m_ncols; ++i) {
+        s_fields.emplace_back(GetField(sid, i));
+    }
+    buf.clear();
+    if (m_codec)
+        m_codec->WritePayloadToBuffer(s_fields, buf);
+    else
+        m_schema->WritePayloadToBuffer(s_fields, buf);
+    for (FieldId i = 0; i < GetHeader()->m_ncols; ++i) {
+        if (m_schema->GetFieldLength(i) != -1 || s_fields[i].isnull())
+            continue;
+        if (FieldIsExternal(sid, i))
+            m_schema->SetFieldExternal(i, buf.data());
+    }
+    return true;
+}
+
+SlotId
+PaxDataPage::GetNextOccupiedSlot(SlotId sid) const {
+    // idx is the bit index of sid + 1
+    size_t idx = sid;
+    size_t nslots = GetHeader()->m_nslots;
+    if (idx >= nslots)
+        return INVALID_SID;
+
+    const uint64_t *bitmap = GetBitmap();
+    size_t i = idx >> 6;
+    uint64_t word = bitmap[i] & (~(uint64_t) 0 << (idx & 63));
+    const size_t nwords = BitmapNumWords(nslots);
+    for (;;) {
+        if (word)
+            return (SlotId)((i << 6) + __builtin_ctzll(word) + MinSlotId);
+        if (++i == nwords)
+            return INVALID_SID;
+        word = bitmap[i];
+    }
+}
+
+}   // namespace taco
@@ -0,0 +1,1391 @@
+#include "storage/Table.h"
+
+#include <thread>
+
+#include <absl/container/flat_hash_map.h>
+
+#include "catalog/CatCache.h"
+#include "catalog/systables.h"
+#include "query/expr/optypes.h"
+#include "storage/FixedlenDataPage.h"
+#include "storage/PaxDataPage.h"
+#include "storage/VarlenDataPage.h"
+#include "utils/builtin_funcs.h"
+
+namespace taco {
+
+//! the source of Table::m_hint_key
+static atomic<uint64_t> s_next_hint_key(0);
+
+namespace {
+
+//! the page a thread last inserted into
+struct InsertionHint {
+    PageNumber  m_pid;
+
+    //! the free-space map entry of m_pid, or where to start the search for
+    //! free space if m_pid is invalid
+    uint32_t    m_fsm_idx;
+};
+
+}   // namespace
+
+//! the insertion hints of this thread, keyed by Table::m_hint_key
+static thread_local absl::flat_hash_map<uint64_t, InsertionHint>
+    s_insertion_hints;
+
+//! the max number of insertion hints a thread keeps
+static constexpr size_t s_max_insertion_hints = 1024;
+
+constexpr FieldOffset Table::ToastThreshold;
+constexpr size_t Table::RecordBatch::DefaultCapacity;
+
+Table::PageFormat
+Table::GetPageFormat(const TableDesc *tabdesc) {
+    if (tabdesc->GetTableEntry()->tablayout() == TABLAYOUT_PAX)
+        return PageFormat::Pax;
+    if (tabdesc->GetTableEntry()->tabisvarlen())
+        return PageFormat::Varlen;
+    return PageFormat::Fixedlen;
+}
+
+void
+Table::InitializeDataPage(const TableDesc *tabdesc, char *frame) {
+    switch (GetPageFormat(tabdesc)) {
+    case PageFormat::Varlen:
+        VarlenDataPage::Initialize(frame, sizeof(TablePageData));
+        break;
+    case PageFormat::Fixedlen:
+        FixedlenDataPage::Initialize(
+            frame, tabdesc->GetSchema()->GetFixedRecordLength(),
+            sizeof(TablePageData));
+        break;
+    case PageFormat::Pax:
+        PaxDataPage::Initialize(frame, tabdesc->GetSchema(),
+                                sizeof(TablePageData));
+        break;
+    }
+}
+
+Table::TablePageData*
+Table::GetTablePageData(PageFormat format, char *frame) {
+    switch (format) {
+    case PageFormat::Varlen:
+        return (TablePageData*) VarlenDataPage(frame).GetUserData();
+    case PageFormat::Fixedlen:
+        return (TablePageData*) FixedlenDataPage(frame).GetUserData();
+    case PageFormat::Pax:
+        // The user data area does not depend on the schema.
+        return (TablePageData*) PaxDataPage(frame, nullptr).GetUserData();
+    }
+    ASSERT(false);
+    return nullptr;
+}
+
+FieldOffset
+Table::ComputeFreeSpace(const TableDesc *tabdesc, char *frame) {
+    switch (GetPageFormat(tabdesc)) {
+    case PageFormat::Varlen:
+        return VarlenDataPage(frame).ComputeFreeSpace();
+    case PageFormat::Fixedlen:
+        return FixedlenDataPage(frame).ComputeFreeSpace();
+    case PageFormat::Pax:
+        return PaxDataPage(frame, tabdesc->GetSchema()).ComputeFreeSpace();
+    }
+    ASSERT(false);
+    return 0;
+}
+
+template<class DataPage>
+DataPage
+Table::GetDataPage(char *frame) const {
+    return DataPage(frame);
+}
+
+template<>
+PaxDataPage
+Table::GetDataPage<PaxDataPage>(char *frame) const {
+    return PaxDataPage(frame, m_tabdesc->GetSchema(),
+                       m_tabdesc->GetPayloadCodec());
+}
+
+/*!
+ * Points \p *p_data and \p *p_reclen to the record in the occupied slot
+ * \p sid of \p dp, which is reconstructed into \p buf if it is not stored
+ * row-wise on the page.
+ */
+template<class DataPage>
+static void
+LoadRecord(const DataPage &dp, SlotId sid, maxaligned_char_buf &buf,
+           const char **p_data, FieldOffset *p_reclen) {
+    (void) buf;
+    *p_data = dp.GetRecordBuf(sid, p_reclen);
+}
+
+static void
+LoadRecord(const PaxDataPage &dp, SlotId sid, maxaligned_char_buf &buf,
+           const char **p_data, FieldOffset *p_reclen) {
+    dp.GetRecord(sid, buf);
+    *p_data = buf.data();
+    *p_reclen = (FieldOffset) buf.size();
+}
+
+/*!
+ * Returns the free space, as in the ComputeFreeSpace() of \p DataPage, that
+ * is enough for inserting the record \p rec of the schema \p schema.
+ */
+template<class DataPage>
+static size_t
+ComputeSpaceNeeded(const Schema *schema, const Record &rec) {
+    (void) schema;
+    return DataPage::ComputeSpaceNeeded(rec.GetLength());
+}
+
+template<>
+size_t
+ComputeSpaceNeeded<PaxDataPage>(const Schema *schema, const Record &rec) {
+    return PaxDataPage::ComputeSpaceNeeded(schema, rec.GetData());
+}
+
+bool
+Table::IsValidRecord(const Record &rec) const {
+    switch (m_format) {
+    case PageFormat::Varlen:
+        return rec.GetLength() > 0 &&
+            rec.GetLength() <= VarlenDataPage::ComputeMaxRecordLength(
+                sizeof(TablePageData));
+    case PageFormat::Fixedlen:
+        return rec.GetLength() ==
+            m_tabdesc->GetSchema()->GetFixedRecordLength();
+    case PageFormat::Pax:
+        // All the fixed-length values fit in a free slot, so only the
+        // variable-length values may not fit on an empty page.
+        return rec.GetLength() > 0 &&
+            PaxDataPage::ComputeVarlenLength(m_tabdesc->GetSchema(),
+                                             rec.GetData()) <=
+            (size_t) m_pax_heap_sz;
+    }
+    ASSERT(false);
+    return false;
+}
+
+void
+Table::Initialize(const TableDesc *tabdesc) {
+    FileId fid = tabdesc->GetTableEntry()->tabfid();
+    std::unique_ptr<File> file = g_fileman->Open(fid);
+    if (file->GetNumPages() != 1) {
+        LOG(kError, "the heap file " FILEID_FORMAT " is not empty", fid);
+    }
+
+    FreeSpaceMap fsm(FreeSpaceMap::Create());
+    char *frame;
+    PageNumber pid = file->GetFirstPageNumber();
+    ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+    InitializeDataPage(tabdesc, frame);
+    FieldOffset free_space = ComputeFreeSpace(tabdesc, frame);
+    TablePageData *pd = GetTablePageData(GetPageFormat(tabdesc), frame);
+    pd->m_fsm_idx = fsm.AddPage(pid,
+                                FreeSpaceMap::ComputeCategory(free_space));
+    pd->m_fsm_fid = fsm.GetFileId();
+    pd->m_zm_fid = ZoneMap::Create();
+    pd->m_toast_fid = INVALID_FID;
+    const Schema *schema = tabdesc->GetSchema();
+    for (FieldId i = 0; i < schema->GetNumFields(); ++i) {
+        if (schema->GetFieldLength(i) == -1) {
+            pd->m_toast_fid = ToastFile::Create();
+            break;
+        }
+    }
+    g_bufman->MarkDirty(bufid);
+}
+
+std::unique_ptr<Table>
+Table::Create(std::shared_ptr<const TableDesc> tabdesc) {
+    if (tabdesc->GetTableEntry()->tablayout() == TABLAYOUT_COLUMNAR) {
+        LOG(kError, "table " OID_FORMAT " is a columnar table",
+                    tabdesc->GetTableEntry()->tabid());
+    }
+    FileId fid = tabdesc->GetTableEntry()->tabfid();
+    std::unique_ptr<File> file = g_fileman->Open(fid);
+    return absl::WrapUnique(new Table(std::move(tabdesc), std::move(file)));
+}
+
+Table::Table(std::shared_ptr<const TableDesc> tabdesc,
+             std::unique_ptr<File> file):
+    m_tabdesc(std::move(tabdesc)),
+    m_file(std::move(file)),
+    m_format(GetPageFormat(m_tabdesc.get())),
+    m_pax_heap_sz((m_format == PageFormat::Pax) ?
+                  PaxDataPage::ComputeHeapSize(m_tabdesc->GetSchema(),
+                                               sizeof(TablePageData)) : 0),
+    m_hint_key(s_next_hint_key.fetch_add(1, memory_order_relaxed)) {
+    char *frame;
+    ScopedBufferId bufid = PinTablePage(m_file->GetFirstPageNumber(), &frame);
+    m_fsm.reset(new FreeSpaceMap(GetTablePageData(frame)->m_fsm_fid));
+    m_zonemap.reset(new ZoneMap(GetTablePageData(frame)->m_zm_fid,
+                                m_tabdesc->GetSchema()));
+    if (GetTablePageData(frame)->m_toast_fid != INVALID_FID) {
+        m_toast.reset(new ToastFile(GetTablePageData(frame)->m_toast_fid));
+    }
+}
+
+Table::~Table() {
+    s_insertion_hints.erase(m_hint_key);
+}
+
+/*!
+ * Returns the insertion hint of the calling thread for the table with the
+ * hint key \p hint_key.
+ */
+static InsertionHint&
+GetInsertionHint(uint64_t hint_key) {
+    auto iter = s_insertion_hints.find(hint_key);
+    if (iter == s_insertion_hints.end()) {
+        if (s_insertion_hints.size() >= s_max_insertion_hints) {
+            // Most of them are probably of the tables closed by other
+            // threads.
+            s_insertion_hints.clear();
+        }
+        // Start the search for free space at a different place in each
+        // thread so that the threads spread out over the pages.
+        InsertionHint hint;
+        hint.m_pid = INVALID_PID;
+        hint.m_fsm_idx = (uint32_t) std::hash<std::thread::id>()(
+            std::this_thread::get_id());
+        iter = s_insertion_hints.emplace(hint_key, hint).first;
+    }
+    return iter->second;
+}
+
+BufferId
+Table::PinTablePage(PageNumber pid, char **frame) {
+    BufferId bufid = g_bufman->PinPage(pid, frame);
+    PageHeaderData *ph = (PageHeaderData*) *frame;
+    if (!ph->IsVFileDataPage() || ph->GetFileId() != m_file->GetFileId()) {
+        g_bufman->UnpinPage(bufid);
+        LOG(kError, "page " PAGENUMBER_FORMAT " is not a page of file "
+                    FILEID_FORMAT, pid, m_file->GetFileId());
+    }
+    return bufid;
+}
+
+bool
+Table::IsLiveTablePage(PageNumber pid, char *frame) const {
+    PageHeaderData *ph = (PageHeaderData*) frame;
+    if (!ph->IsVFileDataPage() || ph->GetFileId() != m_file->GetFileId())
+        return false;
+
+    // The page may also have been reallocated and not initialized yet, in
+    // which case its entry index is either 0 or that of its old entry,
+    // neither of which maps to it.
+    uint32_t fsm_idx = GetTablePageData(frame)->m_fsm_idx;
+    return fsm_idx < m_fsm->GetNumEntries() &&
+        m_fsm->GetPageNumber(fsm_idx) == pid;
+}
+
+BufferId
+Table::AllocateTablePage(char **frame, uint32_t *p_fsm_idx) {
+    std::lock_guard<std::mutex> guard(m_alloc_mutex);
+    PageNumber pid = m_file->AllocatePage();
+    BufferId bufid = g_bufman->PinPage(pid, frame);
+
+    // The page is latched until it is fully initialized, as other threads
+    // may find it in the free-space map as soon as it is added.
+    ScopedFrameLatch latch(bufid, LatchMode::EX);
+    InitializeDataPage(m_tabdesc.get(), *frame);
+    FieldOffset free_space = ComputeFreeSpace(m_tabdesc.get(), *frame);
+    TablePageData *pd = GetTablePageData(*frame);
+    pd->m_fsm_idx = m_fsm->AddPage(pid,
+                                   FreeSpaceMap::ComputeCategory(free_space));
+    pd->m_fsm_fid = INVALID_FID;
+    pd->m_zm_fid = INVALID_FID;
+    pd->m_toast_fid = INVALID_FID;
+    *p_fsm_idx = pd->m_fsm_idx;
+    g_bufman->MarkDirty(bufid);
+    return bufid;
+}
+
+void
+Table::InsertRecord(Record &rec) {
+    maxaligned_char_buf buf;
+    std::vector<ToastPointer> stored;
+    Record newrec = ToastRecord(rec, buf, &stored);
+    if (!IsValidRecord(newrec)) {
+        LOG(kError, "unable to insert a record of length %d",
+                    newrec.GetLength());
+    }
+    try {
+        switch (m_format) {
+        case PageFormat::Varlen:
+            InsertRecordImpl<VarlenDataPage>(newrec);
+            break;
+        case PageFormat::Fixedlen:
+            InsertRecordImpl<FixedlenDataPage>(newrec);
+            break;
+        case PageFormat::Pax:
+            InsertRecordImpl<PaxDataPage>(newrec);
+            break;
+        }
+    } catch (...) {
+        for (const ToastPointer &ptr : stored) {
+            m_toast->Delete(ptr);
+        }
+        throw;
+    }
+    rec.GetRecordId() = newrec.GetRecordId();
+}
+
+template<class DataPage>
+void
+Table::InsertRecordImpl(Record &rec) {
+    uint8_t min_cat = FreeSpaceMap::ComputeMinCategory(
+        ComputeSpaceNeeded<DataPage>(m_tabdesc->GetSchema(), rec));
+    InsertionHint &hint = GetInsertionHint(m_hint_key);
+    PageNumber pid = hint.m_pid;
+    uint32_t fsm_idx = hint.m_fsm_idx;
+    bool new_page = false;
+    for (;;) {
+        char *frame;
+        ScopedBufferId bufid;
+        if (pid == INVALID_PID) {
+            pid = m_fsm->Search(min_cat, fsm_idx, &fsm_idx);
+            if (pid == INVALID_PID) {
+                bufid = ScopedBufferId(AllocateTablePage(&frame, &fsm_idx));
+                pid = g_bufman->GetPageNumber(bufid);
+                new_page = true;
+            }
+        }
+        if (!bufid.IsValid()) {
+            bufid = ScopedBufferId(g_bufman->PinPage(pid, &frame));
+        }
+
+        bool inserted;
+        uint8_t old_cat, new_cat;
+        SlotId old_cnt;
+        {
+            ScopedFrameLatch latch(bufid, LatchMode::EX);
+            if (!IsLiveTablePage(pid, frame)) {
+                // The page has been freed by a vacuum after we found it.
+                pid = INVALID_PID;
+                continue;
+            }
+            DataPage dp = GetDataPage<DataPage>(frame);
+            old_cnt = dp.GetRecordCount();
+            old_cat = FreeSpaceMap::ComputeCategory(dp.ComputeFreeSpace());
+            inserted = dp.InsertRecord(rec);
+            new_cat = FreeSpaceMap::ComputeCategory(dp.ComputeFreeSpace());
+            fsm_idx = GetTablePageData(frame)->m_fsm_idx;
+        }
+
+        if (inserted) {
+            g_bufman->MarkDirty(bufid);
+            if (new_cat != old_cat) {
+                m_fsm->UpdateCategory(fsm_idx, new_cat);
+            }
+            m_zonemap->Update(fsm_idx, rec.GetData());
+            rec.GetRecordId().pid = pid;
+            hint.m_pid = pid;
+            hint.m_fsm_idx = fsm_idx;
+            return;
+        }
+
+        // Other threads may have filled the new page before we latched it,
+        // in which case we search again as for any other full page.
+        if (new_page && old_cnt == 0) {
+            LOG(kFatal, "unable to insert a record of length %d into an "
+                        "empty page", rec.GetLength());
+        }
+        new_page = false;
+
+        // The page is full for this record, so make sure the search does
+        // not find it again for the same request, and search from the next
+        // entry.
+        if (new_cat >= min_cat && min_cat > 0) {
+            new_cat = min_cat - 1;
+        }
+        m_fsm->UpdateCategory(fsm_idx, new_cat);
+        pid = INVALID_PID;
+        ++fsm_idx;
+    }
+}
+
+RecordId
+Table::Insert(const std::vector<Datum> &data) {
+    return InsertImpl(data);
+}
+
+RecordId
+Table::Insert(const std::vector<NullableDatumRef> &data) {
+    return InsertImpl(data);
+}
+
+template<class SomeDatum>
+RecordId
+Table::InsertImpl(const std::vector<SomeDatum> &data) {
+    maxaligned_char_buf buf;
+    FieldOffset reclen = EncodeRecord(data, buf, nullptr);
+    Record rec(buf.data(), reclen);
+    InsertRecord(rec);
+    return rec.GetRecordId();
+}
+
+template<class SomeDatum>
+FieldOffset
+Table::EncodeRecord(const std::vector<SomeDatum> &data,
+                    maxaligned_char_buf &buf,
+                    std::vector<ToastPointer> *stored) {
+    const Schema *schema = m_tabdesc->GetSchema();
+
+    // A value longer than the threshold is always moved out of line, as its
+    // length may not even fit in a FieldOffset.
+    bool has_long_value = false;
+    if (m_toast) {
+        for (FieldId i = 0; i < schema->GetNumFields(); ++i) {
+            if (schema->GetFieldLength(i) == -1 && !data[i].isnull() &&
+                    data[i].GetVarlenSize() > (uint32_t) ToastThreshold) {
+                has_long_value = true;
+                break;
+            }
+        }
+    }
+
+    // Most records are short enough, and are encoded without any
+    // allocation once the buffer is large enough.
+    FieldOffset reclen = -1;
+    if (!has_long_value) {
+        buf.clear();
+        reclen = m_tabdesc->WritePayloadToBuffer(data, buf);
+    }
+    std::vector<FieldId> toasted;
+    if (m_toast && (reclen == -1 || reclen > ToastThreshold)) {
+        // The values to be moved are replaced with placeholder pointers
+        // until we know the record fits on a page, starting from the
+        // longest ones.
+        ToastPointer placeholder;
+        placeholder.m_first_pid = INVALID_PID;
+        placeholder.m_len = 0;
+        Datum ptr_datum = Datum::FromVarlenBytes(
+            (const char*) &placeholder, sizeof(ToastPointer));
+        std::vector<bool> is_toasted(schema->GetNumFields(), false);
+        for (FieldId i = 0; i < schema->GetNumFields(); ++i) {
+            if (schema->GetFieldLength(i) == -1 && !data[i].isnull() &&
+                    data[i].GetVarlenSize() > (uint32_t) ToastThreshold) {
+                toasted.push_back(i);
+                is_toasted[i] = true;
+            }
+        }
+        std::vector<NullableDatumRef> fields;
+        for (;;) {
+            fields.clear();
+            for (FieldId i = 0; i < schema->GetNumFields(); ++i) {
+                if (is_toasted[i])
+                    fields.emplace_back(ptr_datum);
+                else
+                    fields.emplace_back(data[i]);
+            }
+            buf.clear();
+            reclen = m_tabdesc->WritePayloadToBuffer(fields, buf);
+            if (reclen != -1 && reclen <= ToastThreshold)
+                break;
+
+            FieldId longest = InvalidFieldId;
+            uint32_t maxlen = sizeof(ToastPointer);
+            for (FieldId i = 0; i < schema->GetNumFields(); ++i) {
+                if (schema->GetFieldLength(i) == -1 && !is_toasted[i] &&
+                        !data[i].isnull() && data[i].GetVarlenSize() > maxlen) {
+                    longest = i;
+                    maxlen = data[i].GetVarlenSize();
+                }
+            }
+            if (longest == InvalidFieldId)
+                break;
+            toasted.push_back(longest);
+            is_toasted[longest] = true;
+        }
+    }
+
+    if (reclen == -1) {
+        LOG(kError, "the record is too long");
+    }
+    if (!IsValidRecord(Record(buf.data(), reclen))) {
+        LOG(kError, "unable to insert a record of length %d", reclen);
+    }
+
+    for (FieldId i : toasted) {
+        ToastPointer ptr = m_toast->Store(data[i].GetVarlenBytes(),
+                                          data[i].GetVarlenSize());
+        memcpy(buf.data() + schema->GetOffsetAndLength(i, buf.data()).first,
+               &ptr, sizeof(ToastPointer));
+        schema->SetFieldExternal(i, buf.data());
+        if (stored)
+            stored->push_back(ptr);
+    }
+    return reclen;
+}
+
+Record
+Table::ToastRecord(const Record &rec, maxaligned_char_buf &buf,
+                   std::vector<ToastPointer> *stored) {
+    if (!m_toast || rec.GetLength() <= ToastThreshold)
+        return rec;
+
+    // The pointer of a value that is already out of line is copied as an
+    // 8-byte value, which is never moved again.
+    const Schema *schema = m_tabdesc->GetSchema();
+    const char *payload = rec.GetData();
+    std::vector<Datum> data;
+    std::vector<FieldId> external;
+    data.reserve(schema->GetNumFields());
+    for (FieldId i = 0; i < schema->GetNumFields(); ++i) {
+        if (schema->GetFieldLength(i) == -1 &&
+                !schema->FieldIsNull(i, payload) &&
+                schema->FieldIsExternal(i, payload)) {
+            auto p = schema->GetOffsetAndLength(i, payload);
+            data.emplace_back(Datum::FromVarlenBytes(payload + p.first,
+                                                     p.second));
+            external.push_back(i);
+        } else {
+            data.emplace_back(schema->GetField(i, payload));
+        }
+    }
+    FieldOffset reclen = EncodeRecord(data, buf, stored);
+    for (FieldId i : external) {
+        schema->SetFieldExternal(i, buf.data());
+    }
+    return Record(buf.data(), reclen);
+}
+
+Datum
+Table::GetField(FieldId field_id, const char *payload) const {
+    const Schema *schema = m_tabdesc->GetSchema();
+    if (m_toast && schema->GetFieldLength(field_id) == -1 &&
+            !schema->FieldIsNull(field_id, payload) &&
+            schema->FieldIsExternal(field_id, payload)) {
+        ToastPointer ptr;
+        memcpy(&ptr,
+               payload + schema->GetOffsetAndLength(field_id, payload).first,
+               sizeof(ToastPointer));
+        return m_toast->Fetch(ptr);
+    }
+    return schema->GetField(field_id, payload);
+}
+
+void
+Table::GetToastPointers(const char *payload,
+                        std::vector<ToastPointer> *ptrs) const {
+    const Schema *schema = m_tabdesc->GetSchema();
+    for (FieldId i = 0; i < schema->GetNumFields(); ++i) {
+        if (schema->GetFieldLength(i) == -1 &&
+                !schema->FieldIsNull(i, payload) &&
+                schema->FieldIsExternal(i, payload)) {
+            ToastPointer ptr;
+            memcpy(&ptr, payload + schema->GetOffsetAndLength(i, payload).first,
+                   sizeof(ToastPointer));
+            ptrs->push_back(ptr);
+        }
+    }
+}
+
+void
+Table::EraseRecord(RecordId rid) {
+    switch (m_format) {
+    case PageFormat::Varlen:
+        EraseRecordImpl<VarlenDataPage>(rid);
+        break;
+    case PageFormat::Fixedlen:
+        EraseRecordImpl<FixedlenDataPage>(rid);
+        break;
+    case PageFormat::Pax:
+        EraseRecordImpl<PaxDataPage>(rid);
+        break;
+    }
+}
+
+template<class DataPage>
+void
+Table::EraseRecordImpl(RecordId rid, bool delete_toasted) {
+    char *frame;
+    ScopedBufferId bufid = PinTablePage(rid.pid, &frame);
+    uint8_t old_cat, new_cat;
+    uint32_t fsm_idx;
+    std::vector<ToastPointer> toasted;
+    {
+        ScopedFrameLatch latch(bufid, LatchMode::EX);
+        DataPage dp = GetDataPage<DataPage>(frame);
+        if (m_toast && delete_toasted && dp.IsOccupied(rid.sid)) {
+            maxaligned_char_buf recbuf;
+            Record rec;
+            LoadRecord(dp, rid.sid, recbuf, &rec.GetData(), &rec.GetLength());
+            GetToastPointers(rec.GetData(), &toasted);
+        }
+        old_cat = FreeSpaceMap::ComputeCategory(dp.ComputeFreeSpace());
+        if (!dp.EraseRecord(rid.sid)) {
+            latch.Release();
+            LOG(kError, "record %s does not exist", rid.ToString());
+        }
+        new_cat = FreeSpaceMap::ComputeCategory(dp.ComputeFreeSpace());
+        fsm_idx = GetTablePageData(frame)->m_fsm_idx;
+    }
+    g_bufman->MarkDirty(bufid);
+    bufid.Reset();
+    if (new_cat != old_cat) {
+        m_fsm->UpdateCategory(fsm_idx, new_cat);
+    }
+    for (const ToastPointer &ptr : toasted) {
+        m_toast->Delete(ptr);
+    }
+}
+
+void
+Table::UpdateRecord(RecordId rid, Record &rec) {
+    maxaligned_char_buf buf;
+    std::vector<ToastPointer> stored;
+    Record newrec = ToastRecord(rec, buf, &stored);
+    if (!IsValidRecord(newrec)) {
+        LOG(kError, "unable to update a record to length %d",
+                    newrec.GetLength());
+    }
+    try {
+        switch (m_format) {
+        case PageFormat::Varlen:
+            UpdateRecordImpl<VarlenDataPage>(rid, newrec);
+            break;
+        case PageFormat::Fixedlen:
+            UpdateRecordImpl<FixedlenDataPage>(rid, newrec);
+            break;
+        case PageFormat::Pax:
+            UpdateRecordImpl<PaxDataPage>(rid, newrec);
+            break;
+        }
+    } catch (...) {
+        // e.g., the record does not exist
+        for (const ToastPointer &ptr : stored) {
+            m_toast->Delete(ptr);
+        }
+        throw;
+    }
+    rec.GetRecordId() = newrec.GetRecordId();
+}
+
+template<class DataPage>
+void
+Table::UpdateRecordImpl(RecordId rid, Record &rec) {
+    char *frame;
+    ScopedBufferId bufid = PinTablePage(rid.pid, &frame);
+    bool updated;
+    uint8_t old_cat, new_cat;
+    uint32_t fsm_idx;
+    std::vector<ToastPointer> toasted;
+    {
+        ScopedFrameLatch latch(bufid, LatchMode::EX);
+        DataPage dp = GetDataPage<DataPage>(frame);
+        if (!dp.IsOccupied(rid.sid)) {
+            latch.Release();
+            LOG(kError, "record %s does not exist", rid.ToString());
+        }
+        if (m_toast) {
+            maxaligned_char_buf recbuf;
+            Record oldrec;
+            LoadRecord(dp, rid.sid, recbuf, &oldrec.GetData(),
+                       &oldrec.GetLength());
+            GetToastPointers(oldrec.GetData(), &toasted);
+        }
+        old_cat = FreeSpaceMap::ComputeCategory(dp.ComputeFreeSpace());
+        updated = dp.UpdateRecord(rid.sid, rec);
+        new_cat = FreeSpaceMap::ComputeCategory(dp.ComputeFreeSpace());
+        fsm_idx = GetTablePageData(frame)->m_fsm_idx;
+    }
+    g_bufman->MarkDirty(bufid);
+    bufid.Reset();
+
+    if (updated) {
+        if (new_cat != old_cat) {
+            m_fsm->UpdateCategory(fsm_idx, new_cat);
+        }
+        m_zonemap->Update(fsm_idx, rec.GetData());
+        rec.GetRecordId().pid = rid.pid;
+    } else {
+        // The new record does not fit on the page, so move it to another
+        // one. It is inserted before the old one is erased, so that the old
+        // record and its out-of-line values stay if the insert fails.
+        InsertRecordImpl<DataPage>(rec);
+        try {
+            EraseRecordImpl<DataPage>(rid, false);
+        } catch (...) {
+            // e.g., someone else has erased the old record in the meantime
+            EraseRecordImpl<DataPage>(rec.GetRecordId(), false);
+            throw;
+        }
+    }
+
+    // Deletes the out-of-line values of the old record that the new one no
+    // longer points to.
+    if (!toasted.empty()) {
+        std::vector<ToastPointer> kept;
+        GetToastPointers(rec.GetData(), &kept);
+        for (const ToastPointer &ptr : toasted) {
+            bool is_kept = false;
+            for (const ToastPointer &p : kept) {
+                if (p.m_first_pid == ptr.m_first_pid) {
+                    is_kept = true;
+                    break;
+                }
+            }
+            if (!is_kept)
+                m_toast->Delete(ptr);
+        }
+    }
+}
+
+std::unique_ptr<Table::ParallelScan>
+Table::StartParallelScan(uint32_t morsel_npages) {
+    if (morsel_npages == 0) {
+        LOG(kError, "a morsel must have at least one page");
+    }
+    return absl::WrapUnique(new ParallelScan(this, morsel_npages));
+}
+
+Table::ParallelScan::ParallelScan(Table *table, uint32_t morsel_npages):
+    m_table(table),
+    m_morsel_npages(morsel_npages),
+    m_nentries(table->m_fsm->GetNumEntries()),
+    m_next_morsel(0) {
+}
+
+bool
+Table::ParallelScan::NextMorsel(Iterator *iter) {
+    for (;;) {
+        uint64_t begin = (uint64_t) m_next_morsel.fetch_add(
+            1, memory_order_relaxed) * m_morsel_npages;
+        if (begin >= m_nentries) {
+            iter->EndScan();
+            return false;
+        }
+
+        uint32_t end = (uint32_t) std::min(begin + m_morsel_npages,
+                                           (uint64_t) m_nentries);
+        if (m_table->StartScanOfEntries((uint32_t) begin, end, m_nentries,
+                                        iter)) {
+            return true;
+        }
+    }
+}
+
+bool
+Table::StartScanOfEntries(uint32_t begin, uint32_t end, uint32_t nentries,
+                          Iterator *iter) {
+    // The entries of the pages removed by an aborted bulk load are skipped,
+    // which may leave the range empty.
+    uint32_t idx = begin;
+    PageNumber pid = INVALID_PID;
+    while (idx < end && (pid = m_fsm->GetPageNumber(idx)) == INVALID_PID)
+        ++idx;
+    if (pid == INVALID_PID)
+        return false;
+
+    PageNumber end_pid = INVALID_PID;
+    for (idx = end; idx < nentries; ++idx) {
+        end_pid = m_fsm->GetPageNumber(idx);
+        if (end_pid != INVALID_PID)
+            break;
+    }
+
+    char *frame;
+    BufferId bufid = PinTablePage(pid, &frame);
+    RecordId rid;
+    rid.pid = pid;
+    rid.sid = INVALID_SID;
+    *iter = Iterator(this, bufid, rid, end_pid);
+    return true;
+}
+
+/*!
+ * Compacts the data page \p dp if it has any space to reclaim, and returns
+ * whether it did.
+ */
+template<class DataPage>
+static bool
+CompactPage(DataPage &dp) {
+    if (dp.IsCompact())
+        return false;
+    dp.Compact();
+    return true;
+}
+
+/*!
+ * A FixedlenDataPage never needs compaction, as all its free slots are
+ * reusable.
+ */
+static bool
+CompactPage(FixedlenDataPage&) {
+    return false;
+}
+
+std::unique_ptr<Table::ParallelVacuum>
+Table::StartVacuum(uint32_t morsel_npages, uint32_t max_pages_per_sec) {
+    if (morsel_npages == 0) {
+        LOG(kError, "a morsel must have at least one page");
+    }
+    return absl::WrapUnique(new ParallelVacuum(this, morsel_npages,
+                                               max_pages_per_sec));
+}
+
+Table::ParallelVacuum::ParallelVacuum(Table *table, uint32_t morsel_npages,
+                                      uint32_t max_pages_per_sec):
+    m_table(table),
+    m_morsel_npages(morsel_npages),
+    m_max_pages_per_sec(max_pages_per_sec),
+    m_nentries(table->m_fsm->GetNumEntries()),
+    m_next_morsel(0),
+    m_start_time(std::chrono::steady_clock::now()),
+    m_nvisited(0),
+    m_ncompacted(0),
+    m_nfreed(0) {
+}
+
+bool
+Table::ParallelVacuum::VacuumNextMorsel() {
+    uint64_t begin = (uint64_t) m_next_morsel.fetch_add(
+        1, memory_order_relaxed) * m_morsel_npages;
+    if (begin >= m_nentries)
+        return false;
+
+    uint32_t end = (uint32_t) std::min(begin + m_morsel_npages,
+                                       (uint64_t) m_nentries);
+    for (uint32_t idx = (uint32_t) begin; idx < end; ++idx) {
+        PageNumber pid = m_table->m_fsm->GetPageNumber(idx);
+        if (pid == INVALID_PID)
+            continue;
+        Throttle();
+        switch (m_table->m_format) {
+        case PageFormat::Varlen:
+            VacuumPage<VarlenDataPage>(idx, pid);
+            break;
+        case PageFormat::Fixedlen:
+            VacuumPage<FixedlenDataPage>(idx, pid);
+            break;
+        case PageFormat::Pax:
+            VacuumPage<PaxDataPage>(idx, pid);
+            break;
+        }
+    }
+    return true;
+}
+
+void
+Table::ParallelVacuum::Throttle() {
+    uint32_t n = m_nvisited.fetch_add(1, memory_order_relaxed);
+    if (m_max_pages_per_sec == 0)
+        return ;
+
+    // The n-th page is due n / m_max_pages_per_sec seconds after the start,
+    // no matter which worker visits it.
+    std::this_thread::sleep_until(m_start_time +
+        std::chrono::microseconds((uint64_t) n * 1000000 /
+                                  m_max_pages_per_sec));
+}
+
+template<class DataPage>
+void
+Table::ParallelVacuum::VacuumPage(uint32_t fsm_idx, PageNumber pid) {
+    char *frame;
+    ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+    bool compacted;
+    uint8_t new_cat;
+    {
+        ScopedFrameLatch latch(bufid, LatchMode::EX);
+        if (!m_table->IsLiveTablePage(pid, frame))
+            return ;
+
+        DataPage dp = m_table->GetDataPage<DataPage>(frame);
+        if (dp.GetRecordCount() == 0 &&
+            m_table->GetTablePageData(frame)->m_fsm_fid == INVALID_FID) {
+            // The first page is never freed as it has the file IDs of the
+            // other files of the table. The page is removed from the map
+            // under the latch, so that an insertion latching it later finds
+            // out it's no longer a page of the table. It is freed after the
+            // latch is released, as the file manager latches it to reset it.
+            m_table->m_fsm->RemovePage(fsm_idx);
+            latch.Release();
+            bufid.Reset();
+            m_table->m_file->FreePage(pid);
+            m_nfreed.fetch_add(1, memory_order_relaxed);
+            return ;
+        }
+        compacted = CompactPage(dp);
+        new_cat = FreeSpaceMap::ComputeCategory(dp.ComputeFreeSpace());
+    }
+    if (compacted) {
+        g_bufman->MarkDirty(bufid);
+        m_ncompacted.fetch_add(1, memory_order_relaxed);
+    }
+    bufid.Reset();
+
+    // A failed insertion may have lowered the category below the actual
+    // free space.
+    m_table->m_fsm->UpdateCategory(fsm_idx, new_cat);
+}
+
+std::unique_ptr<Table::RangeScan>
+Table::StartRangeScan(FieldId field_id, const Datum &lo, const Datum &hi) {
+    const Schema *schema = m_tabdesc->GetSchema();
+    if (field_id < 0 || field_id >= schema->GetNumFields()) {
+        LOG(kError, "invalid field ID " FIELDID_FORMAT, field_id);
+    }
+    Oid typid = schema->GetFieldTypeId(field_id);
+    Oid funcid = g_catcache->FindOperator(OPTYPE(LT), typid, typid);
+    FunctionInfo lt_func;
+    if (funcid != InvalidOid) {
+        lt_func = FindBuiltinFunction(funcid);
+    }
+    if (!lt_func) {
+        LOG(kError, "can't find \"<\" operator for type " OID_FORMAT, typid);
+    }
+    return absl::WrapUnique(new RangeScan(this, field_id, lo.DeepCopy(),
+                                          hi.DeepCopy(), std::move(lt_func)));
+}
+
+Table::RangeScan::RangeScan(Table *table, FieldId field_id, Datum lo,
+                            Datum hi, FunctionInfo lt_func):
+    m_table(table),
+    m_field_id(field_id),
+    m_lo(std::move(lo)),
+    m_hi(std::move(hi)),
+    m_lt_func(std::move(lt_func)),
+    m_nentries(table->m_fsm->GetNumEntries()),
+    m_next_group(0),
+    m_nskipped(0) {
+}
+
+bool
+Table::RangeScan::IsInRange() const {
+    Datum value = m_iter.GetField(m_field_id);
+    if (value.isnull())
+        return false;
+    if (!m_lo.isnull() && FunctionCall(m_lt_func, value, m_lo).GetBool())
+        return false;
+    if (!m_hi.isnull() && FunctionCall(m_lt_func, m_hi, value).GetBool())
+        return false;
+    return true;
+}
+
+bool
+Table::RangeScan::Next() {
+    for (;;) {
+        while (m_iter.Next()) {
+            if (IsInRange())
+                return true;
+        }
+
+        // Moves to the next page group that may have a record in the range.
+        for (;;) {
+            uint64_t begin =
+                (uint64_t) m_next_group * ZoneMap::PagesPerGroup;
+            if (begin >= m_nentries)
+                return false;
+            uint32_t group = m_next_group++;
+            if (!m_table->m_zonemap->GroupMayMatch(group, m_field_id, m_lo,
+                                                   m_hi)) {
+                ++m_nskipped;
+                continue;
+            }
+            uint32_t end = (uint32_t) std::min(
+                begin + ZoneMap::PagesPerGroup, (uint64_t) m_nentries);
+            if (m_table->StartScanOfEntries((uint32_t) begin, end,
+                                            m_nentries, &m_iter)) {
+                break;
+            }
+        }
+    }
+}
+
+void
+Table::RangeScan::EndScan() {
+    m_iter.EndScan();
+    m_next_group = (uint32_t)((m_nentries + ZoneMap::PagesPerGroup - 1) /
+                              ZoneMap::PagesPerGroup);
+}
+
+std::unique_ptr<Table::BulkLoader>
+Table::StartBulkLoad(PageNumber nbufpages) {
+    if (nbufpages == 0) {
+        LOG(kError, "the bulk load buffer must have at least one page");
+    }
+    return absl::WrapUnique(new BulkLoader(this, nbufpages));
+}
+
+Table::BulkLoader::BulkLoader(Table *table, PageNumber nbufpages):
+    m_table(table),
+    m_buf(unique_aligned_alloc(512, (size_t) nbufpages * PAGE_SIZE)),
+    m_nbufpages(nbufpages),
+    m_npages(0),
+    m_zones((size_t) nbufpages * table->m_zonemap->GetNumZonedColumns()) {
+}
+
+Table::BulkLoader::~BulkLoader() {
+    if (!m_table)
+        return ;
+
+    // Aborts the load.
+    for (size_t i = 0; i < m_runs.size(); ++i) {
+        for (PageNumber j = 0; j < m_runs[i].second; ++j) {
+            m_table->m_fsm->RemovePage(m_run_fsm_idx[i] + j);
+        }
+        m_table->m_file->FreeNewPages(m_runs[i].first, m_runs[i].second);
+    }
+    for (const ToastPointer &ptr : m_toasted) {
+        m_table->m_toast->Delete(ptr);
+    }
+}
+
+void
+Table::BulkLoader::Insert(const std::vector<Datum> &data) {
+    InsertImpl(data);
+}
+
+void
+Table::BulkLoader::Insert(const std::vector<NullableDatumRef> &data) {
+    InsertImpl(data);
+}
+
+template<class SomeDatum>
+void
+Table::BulkLoader::InsertImpl(const std::vector<SomeDatum> &data) {
+    // The record is encoded into the same buffer every time, so there's no
+    // allocation once the buffer is large enough for the records.
+    FieldOffset reclen = m_table->EncodeRecord(data, m_recbuf, &m_toasted);
+    InsertRecord(Record(m_recbuf.data(), reclen));
+}
+
+void
+Table::BulkLoader::InsertBatch(const BatchPayloadEncoder &batch) {
+    for (size_t i = 0; i < batch.GetNumRows(); ++i) {
+        InsertRecord(Record(batch.GetPayload(i), batch.GetRowLength(i)));
+    }
+}
+
+void
+Table::BulkLoader::InsertRecord(const Record &rec) {
+    if (!m_table->IsValidRecord(rec)) {
+        LOG(kError, "unable to insert a record of length %d",
+                    rec.GetLength());
+    }
+
+    Record r = rec;
+    switch (m_table->m_format) {
+    case PageFormat::Varlen:
+        AppendRecord<VarlenDataPage>(r);
+        break;
+    case PageFormat::Fixedlen:
+        AppendRecord<FixedlenDataPage>(r);
+        break;
+    case PageFormat::Pax:
+        AppendRecord<PaxDataPage>(r);
+        break;
+    }
+}
+
+template<class DataPage>
+void
+Table::BulkLoader::AppendRecord(Record &rec) {
+    size_t nzones = m_table->m_zonemap->GetNumZonedColumns();
+    if (m_npages > 0) {
+        DataPage dp = m_table->GetDataPage<DataPage>(
+            GetBufferedPage(m_npages - 1));
+        if (dp.InsertRecord(rec)) {
+            m_table->m_zonemap->AddToZones(
+                &m_zones[(m_npages - 1) * nzones], rec.GetData());
+            return ;
+        }
+    }
+
+    if (m_npages == m_nbufpages) {
+        FlushPages();
+    }
+    char *page = GetBufferedPage(m_npages++);
+    memset(page, 0, PAGE_SIZE);
+    InitializeDataPage(m_table->m_tabdesc.get(), page);
+    if (!m_table->GetDataPage<DataPage>(page).InsertRecord(rec)) {
+        LOG(kFatal, "unable to insert a record of length %d into an "
+                    "empty page", rec.GetLength());
+    }
+    ColumnZone *zones = &m_zones[(m_npages - 1) * nzones];
+    memset(zones, 0, nzones * sizeof(ColumnZone));
+    m_table->m_zonemap->AddToZones(zones, rec.GetData());
+}
+
+void
+Table::BulkLoader::FlushPages() {
+    if (m_npages == 0)
+        return ;
+
+    PageNumber first_pid = m_table->m_file->ReserveNewPages(m_npages);
+    uint32_t first_fsm_idx = 0;
+    PageNumber nadded = 0;
+    try {
+        for (; nadded < m_npages; ++nadded) {
+            char *page = GetBufferedPage(nadded);
+            FieldOffset free_space =
+                ComputeFreeSpace(m_table->m_tabdesc.get(), page);
+            TablePageData *pd = m_table->GetTablePageData(page);
+            pd->m_fsm_idx = m_table->m_fsm->AddPage(
+                first_pid + nadded, FreeSpaceMap::ComputeCategory(free_space));
+            pd->m_fsm_fid = INVALID_FID;
+            pd->m_zm_fid = INVALID_FID;
+            pd->m_toast_fid = INVALID_FID;
+            m_table->m_zonemap->Merge(
+                pd->m_fsm_idx,
+                &m_zones[nadded * m_table->m_zonemap->GetNumZonedColumns()]);
+            if (nadded == 0) {
+                first_fsm_idx = pd->m_fsm_idx;
+            }
+        }
+        m_table->m_file->WriteNewPages(first_pid, GetBufferedPage(0),
+                                       m_npages);
+    } catch (...) {
+        // The run is not in m_runs yet, so the destructor won't free it.
+        // The zones merged for the removed entries are left as they are,
+        // which only makes them less selective.
+        for (PageNumber i = 0; i < nadded; ++i) {
+            m_table->m_fsm->RemovePage(
+                m_table->GetTablePageData(GetBufferedPage(i))->m_fsm_idx);
+        }
+        m_table->m_file->FreeNewPages(first_pid, m_npages);
+        m_npages = 0;
+        throw;
+    }
+    m_runs.emplace_back(first_pid, m_npages);
+    m_run_fsm_idx.push_back(first_fsm_idx);
+    m_npages = 0;
+}
+
+void
+Table::BulkLoader::Finish() {
+    FlushPages();
+    m_table->m_file->AppendNewPages(m_runs);
+    m_runs.clear();
+    m_run_fsm_idx.clear();
+    m_toasted.clear();
+    m_table = nullptr;
+    m_buf.reset();
+}
+
+Table::Iterator
+Table::StartScan() {
+    char *frame;
+    BufferId bufid = PinTablePage(m_file->GetFirstPageNumber(), &frame);
+    RecordId rid;
+    rid.pid = g_bufman->GetPageNumber(bufid);
+    rid.sid = INVALID_SID;
+    return Iterator(this, bufid, rid);
+}
+
+Table::Iterator
+Table::StartScanFrom(RecordId rid) {
+    char *frame;
+    BufferId bufid = PinTablePage(rid.pid, &frame);
+    if (rid.sid != INVALID_SID) {
+        // Positions right before the slot.
+        --rid.sid;
+    }
+    return Iterator(this, bufid, rid);
+}
+
+Table::Iterator::Iterator(Table *table, BufferId bufid, RecordId rid,
+                          PageNumber end_pid):
+    m_table(table),
+    m_bufid(bufid),
+    m_end_pid(end_pid),
+    m_cur_deferred(false) {
+    m_cur.GetRecordId() = rid;
+}
+
+bool
+Table::Iterator::Next() {
+    if (!m_bufid.IsValid())
+        return false;
+    switch (m_table->m_format) {
+    case PageFormat::Varlen:
+        return NextImpl<VarlenDataPage>();
+    case PageFormat::Fixedlen:
+        return NextImpl<FixedlenDataPage>();
+    case PageFormat::Pax:
+        return NextImpl<PaxDataPage>();
+    }
+    ASSERT(false);
+    return false;
+}
+
+template<class DataPage>
+bool
+Table::Iterator::NextImpl() {
+    RecordId &rid = m_cur.GetRecordId();
+    for (;;) {
+        DataPage dp =
+            m_table->GetDataPage<DataPage>(g_bufman->GetBuffer(m_bufid));
+        rid.sid = dp.GetNextOccupiedSlot(rid.sid);
+        if (rid.sid != INVALID_SID) {
+            SetCurrentRecord(dp);
+            return true;
+        }
+
+        m_cur_deferred = false;
+        const PageHeaderData *ph =
+            (const PageHeaderData*) g_bufman->GetBuffer(m_bufid);
+        if (ph->GetNextPageNumber() == m_end_pid) {
+            m_bufid.Reset();
+            m_cur.Clear();
+            return false;
+        }
+
+        // Pins the next page before releasing the current one so that the
+        // swizzled link to it stays valid.
+        char *frame;
+        BufferId next_bufid = g_bufman->PinNextPage(m_bufid, &frame,
+                                                      &m_readahead);
+        m_bufid = ScopedBufferId(next_bufid);
+        if (next_bufid == INVALID_BUFID) {
+            m_cur.Clear();
+            return false;
+        }
+        rid.pid = g_bufman->GetPageNumber(next_bufid);
+    }
+}
+
+template<class DataPage>
+void
+Table::Iterator::SetCurrentRecord(const DataPage &dp) {
+    LoadRecord(dp, m_cur.GetRecordId().sid, m_recbuf, &m_cur.GetData(),
+               &m_cur.GetLength());
+}
+
+void
+Table::Iterator::SetCurrentRecord(const PaxDataPage &dp) {
+    (void) dp;
+    m_cur.GetData() = nullptr;
+    m_cur_deferred = true;
+}
+
+void
+Table::Iterator::LoadDeferredRecord() const {
+    PaxDataPage dp = m_table->GetDataPage<PaxDataPage>(
+        g_bufman->GetBuffer(m_bufid));
+    LoadRecord(dp, m_cur.GetRecordId().sid, m_recbuf, &m_cur.GetData(),
+               &m_cur.GetLength());
+    m_cur_deferred = false;
+}
+
+Datum
+Table::Iterator::GetField(FieldId field_id) const {
+    ASSERT(IsAtValidRecord());
+    if (m_table->m_format != PageFormat::Pax)
+        return m_table->GetField(field_id, m_cur.GetData());
+
+    PaxDataPage dp = m_table->GetDataPage<PaxDataPage>(
+        g_bufman->GetBuffer(m_bufid));
+    SlotId sid = m_cur.GetRecordId().sid;
+    Datum value = dp.GetField(sid, field_id);
+    if (m_table->m_toast && !value.isnull() &&
+            m_table->m_tabdesc->GetSchema()->GetFieldLength(field_id) == -1 &&
+            dp.FieldIsExternal(sid, field_id)) {
+        ToastPointer ptr;
+        memcpy(&ptr, value.GetVarlenBytes(), sizeof(ToastPointer));
+        return m_table->m_toast->Fetch(ptr);
+    }
+    return value;
+}
+
+size_t
+Table::Iterator::NextBatch(RecordBatch *batch) {
+    batch->Clear();
+    if (!m_bufid.IsValid())
+        return 0;
+    switch (m_table->m_format) {
+    case PageFormat::Varlen:
+        NextBatchImpl<VarlenDataPage>(batch);
+        break;
+    case PageFormat::Fixedlen:
+        NextBatchImpl<FixedlenDataPage>(batch);
+        break;
+    case PageFormat::Pax:
+        NextBatchImpl<PaxDataPage>(batch);
+        break;
+    }
+    m_cur.GetData() = nullptr;
+    m_cur_deferred = false;
+    return batch->m_nrecs;
+}
+
+template<class DataPage>
+void
+Table::Iterator::NextBatchImpl(RecordBatch *batch) {
+    RecordId &rid = m_cur.GetRecordId();
+    const size_t capacity = batch->GetCapacity();
+    for (;;) {
+        DataPage dp =
+            m_table->GetDataPage<DataPage>(g_bufman->GetBuffer(m_bufid));
+        const size_t page_first_rec = batch->m_nrecs;
+        while (batch->m_nrecs < capacity) {
+            rid.sid = dp.GetNextOccupiedSlot(rid.sid);
+            if (rid.sid == INVALID_SID)
+                break;
+            Record &rec = batch->m_recs[batch->m_nrecs];
+            LoadRecord(dp, rid.sid, batch->m_recbufs[batch->m_nrecs],
+                       &rec.GetData(), &rec.GetLength());
+            rec.GetRecordId() = rid;
+            ++batch->m_nrecs;
+        }
+        if (batch->m_nrecs == capacity) {
+            // The iterator stays on this page, so the batch takes its own
+            // pin on it for its records, which must outlive EndScan().
+            if (batch->m_nrecs > page_first_rec) {
+                char *frame;
+                batch->m_pins.emplace_back(g_bufman->PinPage(
+                    g_bufman->GetPageNumber(m_bufid), &frame));
+            }
+            return ;
+        }
+
+        // The batch keeps the pin on this page for its records.
+        const PageHeaderData *ph =
+            (const PageHeaderData*) g_bufman->GetBuffer(m_bufid);
+        if (ph->GetNextPageNumber() == m_end_pid) {
+            batch->m_pins.emplace_back(std::move(m_bufid));
+            return ;
+        }
+
+        char *frame;
+        BufferId next_bufid = g_bufman->PinNextPage(m_bufid, &frame,
+                                                      &m_readahead);
+        batch->m_pins.emplace_back(std::move(m_bufid));
+        m_bufid = ScopedBufferId(next_bufid);
+        if (next_bufid == INVALID_BUFID) {
+            return ;
+        }
+        rid.pid = g_bufman->GetPageNumber(next_bufid);
+    }
+}
+
+Table::RecordBatch::RecordBatch(size_t capacity):
+    m_recs(capacity),
+    m_nrecs(0),
+    m_recbufs(capacity) {
+    if (capacity == 0) {
+        LOG(kError, "the capacity of a record batch must be positive");
+    }
+}
+
+void
+Table::RecordBatch::Clear() {
+    m_nrecs = 0;
+    m_pins.clear();
+}
+
+void
+Table::Iterator::EndScan() {
+    m_bufid.Reset();
+    m_cur.Clear();
+    m_cur_deferred = false;
+}
+
+}   // namespace taco
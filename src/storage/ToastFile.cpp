@@ -0,0 +1,75 @@
+#include "storage/ToastFile.h"
+
+#include "storage/BufferManager.h"
+
+namespace taco {
+
+constexpr size_t ToastFile::ChunkBytesPerPage;
+
+FileId
+ToastFile::Create() {
+    std::unique_ptr<File> file = g_fileman->Open(NEW_REGULAR_FID);
+    return file->GetFileId();
+}
+
+ToastFile::ToastFile(FileId fid):
+    m_file(g_fileman->Open(fid)) {
+}
+
+ToastPointer
+ToastFile::Store(const char *bytes, uint32_t len) {
+    ToastPointer ptr;
+    ptr.m_len = len;
+    PageNumber npages = GetNumPages(ptr);
+    if (npages == 0) {
+        LOG(kError, "can't store an empty value out of line");
+    }
+
+    unique_malloced_ptr buf =
+        unique_aligned_alloc(512, (size_t) npages * PAGE_SIZE);
+    char *pages = (char*) buf.get();
+    memset(pages, 0, (size_t) npages * PAGE_SIZE);
+    for (PageNumber i = 0; i < npages; ++i) {
+        size_t off = (size_t) i * ChunkBytesPerPage;
+        memcpy(pages + (size_t) i * PAGE_SIZE +
+               MAXALIGN(sizeof(PageHeaderData)),
+               bytes + off, std::min(ChunkBytesPerPage, len - off));
+    }
+
+    ptr.m_first_pid = m_file->ReserveNewPages(npages);
+    m_file->WriteNewPages(ptr.m_first_pid, pages, npages);
+    m_file->AppendNewPages({{ptr.m_first_pid, npages}});
+    return ptr;
+}
+
+Datum
+ToastFile::Fetch(const ToastPointer &ptr) {
+    FileId fid = m_file->GetFileId();
+    unique_malloced_ptr bytes = unique_malloc(ptr.m_len);
+    size_t off = 0;
+    for (PageNumber pid = ptr.m_first_pid; off < ptr.m_len; ++pid) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+        PageHeaderData *ph = (PageHeaderData*) frame;
+        if (!ph->IsVFileDataPage() || ph->GetFileId() != fid) {
+            bufid.Reset();
+            LOG(kError, "page " PAGENUMBER_FORMAT " is not a page of file "
+                        FILEID_FORMAT, pid, fid);
+        }
+        size_t n = std::min(ChunkBytesPerPage, ptr.m_len - off);
+        memcpy((char*) bytes.get() + off,
+               frame + MAXALIGN(sizeof(PageHeaderData)), n);
+        off += n;
+    }
+    return Datum::FromVarlenBytes(std::move(bytes), ptr.m_len);
+}
+
+void
+ToastFile::Delete(const ToastPointer &ptr) {
+    PageNumber npages = GetNumPages(ptr);
+    for (PageNumber i = 0; i < npages; ++i) {
+        m_file->FreePage(ptr.m_first_pid + i);
+    }
+}
+
+}   // namespace taco
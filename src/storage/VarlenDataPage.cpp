@@ -0,0 +1,254 @@
+#include "storage/VarlenDataPage.h"
+
+#include <algorithm>
+
+namespace taco {
+
+static_assert(PAGE_SIZE < 32768,
+              "the offsets on a data page must fit in a FieldOffset");
+
+//! the maximum number of slots on a page
+static constexpr size_t s_max_nslots =
+    PAGE_SIZE / (sizeof(VarlenDataPageSlot) + MAXALIGN_OF);
+
+void
+VarlenDataPage::Initialize(char *pagebuf, FieldOffset usr_data_sz) {
+    VarlenDataPageHeader *hdr = (VarlenDataPageHeader*) pagebuf;
+    FieldOffset slot_begin = (FieldOffset)(
+        MAXALIGN(sizeof(VarlenDataPageHeader)) + MAXALIGN(usr_data_sz));
+    if (slot_begin > (FieldOffset) PAGE_SIZE) {
+        LOG(kError, "user data area of %d bytes does not fit on a page",
+                    usr_data_sz);
+    }
+    hdr->m_slot_begin = slot_begin;
+    hdr->m_fs_begin = slot_begin;
+    hdr->m_fs_end = (FieldOffset) PAGE_SIZE;
+    hdr->m_nslots = 0;
+    hdr->m_cnt = 0;
+    hdr->m_total_reclen = 0;
+    hdr->m_free_hint = MinSlotId;
+}
+
+FieldOffset
+VarlenDataPage::ComputeMaxRecordLength(FieldOffset usr_data_sz) {
+    return (FieldOffset)(PAGE_SIZE - MAXALIGN(sizeof(VarlenDataPageHeader))
+        - MAXALIGN(usr_data_sz) - MAXALIGN(sizeof(VarlenDataPageSlot)));
+}
+
+SlotId
+VarlenDataPage::FindFreeSlot() const {
+    VarlenDataPageHeader *hdr = GetHeader();
+    if (hdr->m_cnt == hdr->m_nslots)
+        return hdr->m_nslots + 1;
+    SlotId sid = hdr->m_free_hint;
+    while (sid <= hdr->m_nslots && GetSlot(sid)->m_off != 0)
+        ++sid;
+    return sid;
+}
+
+bool
+VarlenDataPage::ReserveSpace(FieldOffset alen, FieldOffset slot_sz) {
+    VarlenDataPageHeader *hdr = GetHeader();
+    if (hdr->m_fs_end - hdr->m_fs_begin >= alen + slot_sz)
+        return true;
+    if (PAGE_SIZE - hdr->m_fs_begin - hdr->m_total_reclen <
+            (size_t)(alen + slot_sz))
+        return false;
+    Compact();
+    return true;
+}
+
+bool
+VarlenDataPage::InsertRecord(Record &rec) {
+    SlotId sid;
+    char *buf = AllocateRecord(rec.GetLength(), &sid);
+    if (!buf)
+        return false;
+    memcpy(buf, rec.GetData(), rec.GetLength());
+    rec.GetRecordId().sid = sid;
+    return true;
+}
+
+char*
+VarlenDataPage::AllocateRecord(FieldOffset reclen, SlotId *p_sid) {
+    VarlenDataPageHeader *hdr = GetHeader();
+    if (reclen <= 0 || (size_t) reclen > PAGE_SIZE - hdr->m_slot_begin -
+                                         MAXALIGN(sizeof(VarlenDataPageSlot))) {
+        LOG(kError, "invalid record length %d", reclen);
+    }
+
+    SlotId sid = FindFreeSlot();
+    bool new_slot = sid > hdr->m_nslots;
+    if (new_slot && (size_t) sid > s_max_nslots)
+        return nullptr;
+    FieldOffset alen = (FieldOffset) MAXALIGN(reclen);
+    if (!ReserveSpace(alen, new_slot ? sizeof(VarlenDataPageSlot) : 0))
+        return nullptr;
+
+    if (new_slot) {
+        hdr->m_nslots = sid;
+        hdr->m_fs_begin += sizeof(VarlenDataPageSlot);
+    }
+    hdr->m_fs_end -= alen;
+    VarlenDataPageSlot *slot = GetSlot(sid);
+    slot->m_off = hdr->m_fs_end;
+    slot->m_len = reclen;
+    ++hdr->m_cnt;
+    hdr->m_total_reclen += alen;
+    hdr->m_free_hint = sid + 1;
+    *p_sid = sid;
+    return m_pagebuf + hdr->m_fs_end;
+}
+
+bool
+VarlenDataPage::EraseRecord(SlotId sid) {
+    if (!IsOccupied(sid))
+        return false;
+
+    VarlenDataPageHeader *hdr = GetHeader();
+    VarlenDataPageSlot *slot = GetSlot(sid);
+    FieldOffset alen = (FieldOffset) MAXALIGN(slot->m_len);
+    if (slot->m_off == hdr->m_fs_end) {
+        // The space of the lowest record is immediately reusable.
+        hdr->m_fs_end += alen;
+    }
+    slot->m_off = 0;
+    slot->m_len = 0;
+    --hdr->m_cnt;
+    hdr->m_total_reclen -= alen;
+    if (sid < hdr->m_free_hint)
+        hdr->m_free_hint = sid;
+    TruncateSlotArray();
+    return true;
+}
+
+void
+VarlenDataPage::TruncateSlotArray() {
+    VarlenDataPageHeader *hdr = GetHeader();
+    while (hdr->m_nslots > 0 && GetSlot(hdr->m_nslots)->m_off == 0) {
+        --hdr->m_nslots;
+        hdr->m_fs_begin -= sizeof(VarlenDataPageSlot);
+    }
+    if (hdr->m_cnt == 0) {
+        hdr->m_fs_end = (FieldOffset) PAGE_SIZE;
+    }
+    if (hdr->m_free_hint > hdr->m_nslots + 1)
+        hdr->m_free_hint = hdr->m_nslots + 1;
+}
+
+bool
+VarlenDataPage::UpdateRecord(SlotId sid, Record &rec) {
+    if (!IsOccupied(sid)) {
+        LOG(kError, "slot " SLOTID_FORMAT " is not occupied", sid);
+    }
+
+    VarlenDataPageHeader *hdr = GetHeader();
+    VarlenDataPageSlot *slot = GetSlot(sid);
+    FieldOffset reclen = rec.GetLength();
+    if (reclen <= 0) {
+        LOG(kError, "invalid record length %d", reclen);
+    }
+    FieldOffset alen = (FieldOffset) MAXALIGN(reclen);
+    FieldOffset old_alen = (FieldOffset) MAXALIGN(slot->m_len);
+
+    if (alen <= old_alen) {
+        // Overwrite the record in place. The tail of the old record is not
+        // reclaimed until the next compaction.
+        memmove(m_pagebuf + slot->m_off, rec.GetData(), reclen);
+        slot->m_len = reclen;
+        hdr->m_total_reclen -= old_alen - alen;
+        if (alen < old_alen && slot->m_off == hdr->m_fs_end) {
+            // Slide the lowest record up so that its tail is reclaimed
+            // immediately.
+            FieldOffset new_off = slot->m_off + old_alen - alen;
+            memmove(m_pagebuf + new_off, m_pagebuf + slot->m_off, reclen);
+            slot->m_off = new_off;
+            hdr->m_fs_end = new_off;
+        }
+        rec.GetRecordId().sid = sid;
+        return true;
+    }
+
+    // Check if the new record fits with the space of the old one freed,
+    // before touching the page.
+    if (PAGE_SIZE - hdr->m_fs_begin - hdr->m_total_reclen + old_alen <
+            (size_t) alen)
+        return false;
+
+    // Free the old record but keep the slot reserved, so that compaction
+    // does not move it.
+    if (slot->m_off == hdr->m_fs_end)
+        hdr->m_fs_end += old_alen;
+    slot->m_off = 0;
+    slot->m_len = 0;
+    hdr->m_total_reclen -= old_alen;
+    if (hdr->m_fs_end - hdr->m_fs_begin < alen) {
+        Compact();
+    }
+    hdr->m_fs_end -= alen;
+    memcpy(m_pagebuf + hdr->m_fs_end, rec.GetData(), reclen);
+    slot = GetSlot(sid);
+    slot->m_off = hdr->m_fs_end;
+    slot->m_len = reclen;
+    hdr->m_total_reclen += alen;
+    rec.GetRecordId().sid = sid;
+    return true;
+}
+
+const char*
+VarlenDataPage::GetRecordBuf(SlotId sid, FieldOffset *p_reclen) const {
+    if (!IsOccupied(sid))
+        return nullptr;
+    VarlenDataPageSlot *slot = GetSlot(sid);
+    if (p_reclen)
+        *p_reclen = slot->m_len;
+    return m_pagebuf + slot->m_off;
+}
+
+SlotId
+VarlenDataPage::GetNextOccupiedSlot(SlotId sid) const {
+    SlotId nslots = GetHeader()->m_nslots;
+    while (sid < nslots) {
+        ++sid;
+        if (GetSlot(sid)->m_off != 0)
+            return sid;
+    }
+    return INVALID_SID;
+}
+
+FieldOffset
+VarlenDataPage::ComputeFreeSpace() const {
+    VarlenDataPageHeader *hdr = GetHeader();
+    return (FieldOffset)(PAGE_SIZE - hdr->m_fs_begin - hdr->m_total_reclen);
+}
+
+void
+VarlenDataPage::Compact() {
+    VarlenDataPageHeader *hdr = GetHeader();
+
+    // Slide the records to the end of the page in the descending order of
+    // their offsets, so that a record never overwrites one that is yet to
+    // be moved.
+    SlotId sids[s_max_nslots];
+    size_t n = 0;
+    for (SlotId sid = MinSlotId; sid <= hdr->m_nslots; ++sid) {
+        if (GetSlot(sid)->m_off != 0)
+            sids[n++] = sid;
+    }
+    std::sort(sids, sids + n, [this](SlotId a, SlotId b) {
+        return GetSlot(a)->m_off > GetSlot(b)->m_off;
+    });
+
+    FieldOffset fs_end = (FieldOffset) PAGE_SIZE;
+    for (size_t i = 0; i < n; ++i) {
+        VarlenDataPageSlot *slot = GetSlot(sids[i]);
+        fs_end -= (FieldOffset) MAXALIGN(slot->m_len);
+        if (fs_end != slot->m_off) {
+            memmove(m_pagebuf + fs_end, m_pagebuf + slot->m_off, slot->m_len);
+            slot->m_off = fs_end;
+        }
+    }
+    hdr->m_fs_end = fs_end;
+}
+
+}   // namespace taco
@@ -0,0 +1,166 @@
+#include "storage/ZoneMap.h"
+
+#include "catalog/CatCache.h"
+#include "query/expr/optypes.h"
+#include "storage/BufferManager.h"
+#include "utils/builtin_funcs.h"
+
+namespace taco {
+
+constexpr uint32_t ZoneMap::PagesPerGroup;
+
+//! Returns the zone array of a map page.
+static inline ColumnZone*
+GetMapPageZones(char *frame) {
+    return (ColumnZone*)(frame + MAXALIGN(sizeof(PageHeaderData)));
+}
+
+FileId
+ZoneMap::Create() {
+    // A zero-filled page has the empty zones.
+    std::unique_ptr<File> file = g_fileman->Open(NEW_REGULAR_FID);
+    return file->GetFileId();
+}
+
+ZoneMap::ZoneMap(FileId fid, const Schema *schema):
+    m_file(g_fileman->Open(fid)),
+    m_schema(schema),
+    m_zone_idx(schema->GetNumFields(), -1) {
+    const size_t max_nzones =
+        (PAGE_SIZE - MAXALIGN(sizeof(PageHeaderData))) / sizeof(ColumnZone);
+    for (FieldId i = 0; i < schema->GetNumFields(); ++i) {
+        if (m_field_ids.size() == max_nzones)
+            break;
+        if (schema->GetFieldLength(i) <= 0 || schema->FieldPassByRef(i))
+            continue;
+        Oid typid = schema->GetFieldTypeId(i);
+        Oid funcid = g_catcache->FindOperator(OPTYPE(LT), typid, typid);
+        if (funcid == InvalidOid)
+            continue;
+        FunctionInfo lt_func = FindBuiltinFunction(funcid);
+        if (!lt_func)
+            continue;
+        m_zone_idx[i] = (int) m_field_ids.size();
+        m_field_ids.push_back(i);
+        m_lt_funcs.emplace_back(std::move(lt_func));
+    }
+    m_groups_per_page = m_field_ids.empty() ? 0 :
+        (uint32_t)(max_nzones / m_field_ids.size());
+
+    PageNumber pid = m_file->GetFirstPageNumber();
+    while (pid != INVALID_PID) {
+        m_map_pids.push_back(pid);
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+        pid = ((PageHeaderData*) frame)->GetNextPageNumber();
+    }
+}
+
+BufferId
+ZoneMap::PinZones(uint32_t group, ColumnZone **p_zones, bool create) {
+    size_t i = group / m_groups_per_page;
+    PageNumber pid;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (!create && m_map_pids.size() <= i)
+            return INVALID_BUFID;
+        while (m_map_pids.size() <= i) {
+            m_map_pids.push_back(m_file->AllocatePage());
+        }
+        pid = m_map_pids[i];
+    }
+
+    char *frame;
+    BufferId bufid = g_bufman->PinPage(pid, &frame);
+    *p_zones = GetMapPageZones(frame) +
+        (size_t)(group % m_groups_per_page) * m_field_ids.size();
+    return bufid;
+}
+
+void
+ZoneMap::AddValue(size_t i, ColumnZone *zone, const Datum &value) const {
+    int16_t typlen = m_schema->GetFieldLength(m_field_ids[i]);
+    if (zone->m_nvalues == 0) {
+        zone->m_min = 0;
+        memcpy(&zone->m_min, value.GetFixedlenBytes(), typlen);
+        zone->m_max = zone->m_min;
+    } else {
+        if (Less(i, value, GetZoneDatum(i, zone->m_min))) {
+            memcpy(&zone->m_min, value.GetFixedlenBytes(), typlen);
+        }
+        if (Less(i, GetZoneDatum(i, zone->m_max), value)) {
+            memcpy(&zone->m_max, value.GetFixedlenBytes(), typlen);
+        }
+    }
+    ++zone->m_nvalues;
+}
+
+void
+ZoneMap::AddToZones(ColumnZone *zones, const char *payload) const {
+    for (size_t i = 0; i < m_field_ids.size(); ++i) {
+        if (m_schema->FieldIsNull(m_field_ids[i], payload)) {
+            ++zones[i].m_nnulls;
+        } else {
+            AddValue(i, &zones[i], m_schema->GetField(m_field_ids[i],
+                                                      payload));
+        }
+    }
+}
+
+void
+ZoneMap::Update(uint32_t page_idx, const char *payload) {
+    if (m_field_ids.empty())
+        return ;
+
+    ColumnZone *zones;
+    ScopedBufferId bufid = PinZones(page_idx / PagesPerGroup, &zones);
+    ScopedFrameLatch latch(bufid, LatchMode::EX);
+    AddToZones(zones, payload);
+    g_bufman->MarkDirty(bufid);
+}
+
+void
+ZoneMap::Merge(uint32_t page_idx, const ColumnZone *zones) {
+    if (m_field_ids.empty())
+        return ;
+
+    ColumnZone *dst;
+    ScopedBufferId bufid = PinZones(page_idx / PagesPerGroup, &dst);
+    ScopedFrameLatch latch(bufid, LatchMode::EX);
+    for (size_t i = 0; i < m_field_ids.size(); ++i) {
+        if (zones[i].m_nvalues > 0) {
+            uint32_t nvalues = dst[i].m_nvalues + zones[i].m_nvalues;
+            AddValue(i, &dst[i], GetZoneDatum(i, zones[i].m_min));
+            AddValue(i, &dst[i], GetZoneDatum(i, zones[i].m_max));
+            dst[i].m_nvalues = nvalues;
+        }
+        dst[i].m_nnulls += zones[i].m_nnulls;
+    }
+    g_bufman->MarkDirty(bufid);
+}
+
+bool
+ZoneMap::GroupMayMatch(uint32_t group, FieldId field_id, const Datum &lo,
+                       const Datum &hi) {
+    if (!HasZone(field_id))
+        return true;
+
+    size_t i = (size_t) m_zone_idx[field_id];
+    ColumnZone *zones;
+    // A reader never allocates map pages. A group without a map page has
+    // no zones yet, so it is not skipped.
+    ScopedBufferId bufid = PinZones(group, &zones, false);
+    if (bufid.Get() == INVALID_BUFID)
+        return true;
+    ScopedFrameLatch latch(bufid, LatchMode::SH);
+    const ColumnZone &zone = zones[i];
+    if (zone.m_nvalues == 0)
+        return false;
+    if (!lo.isnull() && Less(i, GetZoneDatum(i, zone.m_max), lo))
+        return false;
+    if (!hi.isnull() && Less(i, hi, GetZoneDatum(i, zone.m_min)))
+        return false;
+    return true;
+}
+
+}   // namespace taco
@@ -0,0 +1,93 @@
+#include "utils/Latch.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <climits>
+
+namespace taco {
+
+//! The number of times to spin before parking on the futex.
+static constexpr uint32_t s_max_spins = 128;
+
+static inline void
+CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+void
+Latch::AcquireSlow(LatchMode mode) {
+    uint32_t nspins = 0;
+    for (;;) {
+        uint32_t state = m_state.load(memory_order_relaxed);
+        if (mode == LatchMode::SH) {
+            if (!(state & (EXBit | EXWaitBit))) {
+                if (m_state.compare_exchange_weak(state, state + 1,
+                                                  memory_order_acquire,
+                                                  memory_order_relaxed))
+                    return;
+                continue;
+            }
+        } else {
+            if (!(state & ~(EXWaitBit | ParkedBit))) {
+                if (m_state.compare_exchange_weak(state, state_after_ex(state),
+                                                  memory_order_acquire,
+                                                  memory_order_relaxed)) {
+                    BeginWrite();
+                    return;
+                }
+                continue;
+            }
+            if (!(state & EXWaitBit)) {
+                // Stop admitting new shared holders.
+                if (!m_state.compare_exchange_weak(state, state | EXWaitBit,
+                                                   memory_order_relaxed))
+                    continue;
+                state |= EXWaitBit;
+            }
+        }
+
+        if (nspins < s_max_spins) {
+            ++nspins;
+            CpuRelax();
+            continue;
+        }
+        Park(state);
+        nspins = 0;
+    }
+}
+
+void
+Latch::Park(uint32_t state) {
+    // Let the releaser know there's someone to wake up. The CAS fails if the
+    // state has changed, in which case the caller retries.
+    if (!(state & ParkedBit)) {
+        if (!m_state.compare_exchange_strong(state, state | ParkedBit,
+                                             memory_order_relaxed))
+            return ;
+        state |= ParkedBit;
+    }
+
+    // Returns immediately with EAGAIN if the state has changed since, and
+    // may return spuriously. Either way, the caller retries.
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state),
+            FUTEX_WAIT_PRIVATE, state, nullptr, nullptr, 0);
+}
+
+void
+Latch::WakeUpWaiters() {
+    // Everyone is woken up and those who still can't get the latch will set
+    // the parked bit again.
+    m_state.fetch_and(~ParkedBit, memory_order_relaxed);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state),
+            FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+}   // namespace taco
@@ -0,0 +1,212 @@
+#include "utils/lzcompress.h"
+
+namespace taco {
+
+namespace {
+
+//! the minimum length of a match
+constexpr size_t MinMatch = 4;
+
+//! the maximum distance of a match
+constexpr size_t MaxOffset = 65535;
+
+//! log2 of the number of entries in the hash table of the compressor
+constexpr size_t HashLog = 12;
+
+inline uint32_t
+read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t
+read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t
+hash32(uint32_t v) {
+    return (v * 2654435761u) >> (32 - HashLog);
+}
+
+/*!
+ * Returns the number of extra bytes to encode a length of \p len in a
+ * 4-bit field of a token.
+ */
+inline size_t
+extra_length_size(size_t len) {
+    return (len >= 15) ? (len - 15) / 255 + 1 : 0;
+}
+
+inline uint8_t*
+write_extra_length(uint8_t *op, size_t len) {
+    len -= 15;
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t) len;
+    return op;
+}
+
+inline bool
+read_extra_length(const uint8_t *&ip, const uint8_t *iend, size_t &len) {
+    uint8_t b;
+    do {
+        if (ip == iend)
+            return false;
+        b = *ip++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+/*!
+ * Appends a sequence of \p litlen literals at \p lit followed by a match of
+ * \p mlen bytes at \p offset, or no match if \p mlen is 0. Returns false if
+ * it does not fit before \p oend.
+ */
+bool
+write_sequence(uint8_t *&op, uint8_t *oend, const uint8_t *lit, size_t litlen,
+               size_t offset, size_t mlen) {
+    size_t mcode = mlen ? mlen - MinMatch : 0;
+    size_t size = 1 + extra_length_size(litlen) + litlen +
+                  (mlen ? 2 + extra_length_size(mcode) : 0);
+    if ((size_t)(oend - op) < size)
+        return false;
+
+    uint8_t *token = op++;
+    *token = (uint8_t)((std::min(litlen, (size_t) 15) << 4) |
+                       std::min(mcode, (size_t) 15));
+    if (litlen >= 15)
+        op = write_extra_length(op, litlen);
+    memcpy(op, lit, litlen);
+    op += litlen;
+    if (mlen) {
+        op[0] = (uint8_t)(offset & 0xff);
+        op[1] = (uint8_t)(offset >> 8);
+        op += 2;
+        if (mcode >= 15)
+            op = write_extra_length(op, mcode);
+    }
+    return true;
+}
+
+}   // namespace
+
+size_t
+lz_compress(const char *src, size_t srclen, char *dst, size_t dstcap) {
+    const uint8_t *const base = (const uint8_t*) src;
+    const uint8_t *const iend = base + srclen;
+    const uint8_t *ip = base;
+    const uint8_t *anchor = base;
+    uint8_t *op = (uint8_t*) dst;
+    uint8_t *const oend = op + dstcap;
+
+    // The entries are offsets from base. An empty entry points to the
+    // beginning, which is rejected by the comparison of the bytes or the
+    // position.
+    uint32_t table[1 << HashLog];
+    memset(table, 0, sizeof(table));
+
+    if (srclen >= MinMatch) {
+        const uint8_t *const mlimit = iend - MinMatch;
+        size_t nmisses = 0;
+        while (ip <= mlimit) {
+            uint32_t seq = read32(ip);
+            uint32_t h = hash32(seq);
+            const uint8_t *ref = base + table[h];
+            table[h] = (uint32_t)(ip - base);
+            if (ref >= ip || (size_t)(ip - ref) > MaxOffset ||
+                read32(ref) != seq) {
+                // Skip faster over data that does not compress.
+                ip += 1 + (nmisses++ >> 5);
+                continue;
+            }
+
+            size_t mlen = MinMatch;
+            while (ip + mlen + 8 <= iend) {
+                uint64_t diff = read64(ip + mlen) ^ read64(ref + mlen);
+                if (diff) {
+                    mlen += __builtin_ctzll(diff) >> 3;
+                    goto match_found;
+                }
+                mlen += 8;
+            }
+            while (ip + mlen < iend && ip[mlen] == ref[mlen])
+                ++mlen;
+match_found:
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                --ip;
+                --ref;
+                ++mlen;
+            }
+            if (!write_sequence(op, oend, anchor, ip - anchor, ip - ref, mlen))
+                return 0;
+            ip += mlen;
+            anchor = ip;
+            nmisses = 0;
+        }
+    }
+
+    if (!write_sequence(op, oend, anchor, iend - anchor, 0, 0))
+        return 0;
+    return op - (uint8_t*) dst;
+}
+
+bool
+lz_decompress(const char *src, size_t srclen, char *dst, size_t dstlen) {
+    const uint8_t *ip = (const uint8_t*) src;
+    const uint8_t *const iend = ip + srclen;
+    uint8_t *op = (uint8_t*) dst;
+    uint8_t *const oend = op + dstlen;
+
+    // The last sequence has only literals.
+    bool last_seq = false;
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t litlen = token >> 4;
+        if (litlen == 15 && !read_extra_length(ip, iend, litlen))
+            return false;
+        if ((size_t)(iend - ip) < litlen || (size_t)(oend - op) < litlen)
+            return false;
+        memcpy(op, ip, litlen);
+        op += litlen;
+        ip += litlen;
+        if (ip == iend) {
+            last_seq = true;
+            break;
+        }
+
+        // a match follows the literals unless it's the last sequence
+        if (iend - ip < 2)
+            return false;
+        size_t offset = ip[0] | ((size_t) ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - (uint8_t*) dst))
+            return false;
+        size_t mlen = token & 15;
+        if (mlen == 15 && !read_extra_length(ip, iend, mlen))
+            return false;
+        mlen += MinMatch;
+        if ((size_t)(oend - op) < mlen)
+            return false;
+
+        const uint8_t *ref = op - offset;
+        if (offset >= mlen) {
+            memcpy(op, ref, mlen);
+            op += mlen;
+        } else {
+            // The match overlaps with itself, e.g., a run of a byte.
+            for (size_t i = 0; i < mlen; ++i) {
+                *op++ = *ref++;
+            }
+        }
+    }
+    return last_seq && op == oend;
+}
+
+}   // namespace taco
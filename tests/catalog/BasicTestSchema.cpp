@@ -0,0 +1,360 @@
+// Basic tests for Schema
+#include "base/TDBDBTest.h"
+
+#include <absl/strings/str_format.h>
+
+#include "catalog/BatchPayloadEncoder.h"
+#include "catalog/CatCache.h"
+#include "catalog/PayloadCodec.h"
+#include "catalog/Schema.h"
+#include "catalog/systables.h"
+
+namespace taco {
+
+class BasicTestSchema: public TDBDBTest {
+protected:
+    void
+    SetUp() override {
+        TDBDBTest::SetUp();
+        // (INT4, VARCHAR(100), INT8 not null, VARCHAR(20) not null, INT2,
+        //  CHAR(5), VARCHAR(100))
+        m_schema.reset(Schema::Create(
+            {initoids::TYP_INT4, initoids::TYP_VARCHAR, initoids::TYP_INT8,
+             initoids::TYP_VARCHAR, initoids::TYP_INT2, initoids::TYP_CHAR,
+             initoids::TYP_VARCHAR},
+            {0, 100, 0, 20, 0, 5, 100},
+            {true, true, false, false, true, true, true}));
+        m_schema->ComputeLayout();
+    }
+
+    void
+    TearDown() override {
+        m_schema.reset();
+        TDBDBTest::TearDown();
+    }
+
+    /*!
+     * Returns the payload of the row \p key, where the nullable field `i'
+     * is null if bit `i' of \p key is set.
+     */
+    maxaligned_char_buf
+    MakePayload(int32_t key) {
+        std::string str = absl::StrFormat("%0*d", (int)(key % 50), key);
+        std::string chars = absl::StrFormat("%05d", key % 100000);
+        std::vector<Datum> data;
+        data.emplace_back(Datum::From(key));
+        data.emplace_back(Datum::FromCString(str.c_str()));
+        data.emplace_back(Datum::From((int64_t) key * 3));
+        data.emplace_back(Datum::FromCString(str.c_str() + str.size() / 2));
+        data.emplace_back(Datum::From((int16_t) key));
+        data.emplace_back(Datum::FromVarlenBytes(chars.data(), 5));
+        data.emplace_back(Datum::FromCString(chars.c_str()));
+        for (FieldId i = 0; i < m_schema->GetNumFields(); ++i) {
+            if (m_schema->FieldIsNullable(i) && ((key >> i) & 1)) {
+                data[i] = Datum::FromNull();
+            }
+        }
+        maxaligned_char_buf buf;
+        m_schema->WritePayloadToBuffer(data, buf);
+        return buf;
+    }
+
+    //! Returns whether \p a and \p b are the same value of field \p i.
+    bool
+    SameField(FieldId i, const Datum &a, const Datum &b) {
+        if (a.isnull() || b.isnull())
+            return a.isnull() && b.isnull();
+        if (m_schema->FieldPassByRef(i))
+            return a.GetVarlenAsStringView() == b.GetVarlenAsStringView();
+        return memcmp(a.GetFixedlenBytes(), b.GetFixedlenBytes(),
+                      m_schema->GetFieldLength(i)) == 0;
+    }
+
+    std::unique_ptr<Schema> m_schema;
+};
+
+TEST_F(BasicTestSchema, TestDeformPayload) {
+    TDB_TEST_BEGIN
+
+    const FieldId n = m_schema->GetNumFields();
+    std::vector<std::pair<FieldOffset, FieldOffset>> offlen(n);
+    for (int32_t key = 0; key < 1000; ++key) {
+        maxaligned_char_buf buf = MakePayload(key);
+        const char *payload = buf.data();
+        for (FieldId max_field_id = 0; max_field_id < n; ++max_field_id) {
+            std::fill(offlen.begin(), offlen.end(),
+                      std::make_pair((FieldOffset) -2, (FieldOffset) -2));
+            m_schema->DeformPayload(payload, max_field_id, offlen.data());
+            for (FieldId i = 0; i <= max_field_id; ++i) {
+                if (m_schema->FieldIsNull(i, payload)) {
+                    ASSERT_EQ(offlen[i].second, -1);
+                    ASSERT_TRUE(m_schema->GetDeformedField(i, payload,
+                                                           offlen.data())
+                                .isnull());
+                    continue;
+                }
+                ASSERT_EQ(offlen[i], m_schema->GetOffsetAndLength(i, payload))
+                    << "key " << key << " field " << i;
+                ASSERT_TRUE(SameField(
+                    i, m_schema->GetDeformedField(i, payload, offlen.data()),
+                    m_schema->GetField(i, payload)));
+            }
+        }
+
+        std::vector<Datum> data = m_schema->DissemblePayload(payload);
+        ASSERT_EQ(data.size(), (size_t) n);
+        for (FieldId i = 0; i < n; ++i) {
+            ASSERT_TRUE(SameField(i, data[i], m_schema->GetField(i, payload)));
+        }
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestSchema, TestBatchPayloadEncoder) {
+    TDB_TEST_BEGIN
+
+    // the column arrays of the rows of MakePayload()
+    const FieldId n = m_schema->GetNumFields();
+    const uint32_t nrows = 300;
+    std::vector<int32_t> col0;
+    std::string col1, col3, col5, col6;
+    std::vector<uint32_t> ends1, ends3, ends6;
+    std::vector<int64_t> col2;
+    std::vector<int16_t> col4;
+    std::vector<std::vector<uint8_t>> nulls(n);
+    auto fill_columns = [&](int32_t first_key) {
+        col0.clear();
+        col1.clear();
+        col2.clear();
+        col3.clear();
+        col4.clear();
+        col5.clear();
+        col6.clear();
+        ends1.clear();
+        ends3.clear();
+        ends6.clear();
+        for (FieldId i = 0; i < n; ++i) {
+            nulls[i].assign((nrows + 7) / 8, 0);
+        }
+        for (uint32_t row = 0; row < nrows; ++row) {
+            int32_t key = first_key + (int32_t) row;
+            std::string str = absl::StrFormat("%0*d", (int)(key % 50), key);
+            std::string chars = absl::StrFormat("%05d", key % 100000);
+            col0.push_back(key);
+            col1 += str;
+            ends1.push_back(col1.size());
+            col2.push_back((int64_t) key * 3);
+            col3 += str.substr(str.size() / 2);
+            ends3.push_back(col3.size());
+            col4.push_back((int16_t) key);
+            col5 += chars;
+            col6 += chars;
+            ends6.push_back(col6.size());
+            for (FieldId i = 0; i < n; ++i) {
+                if (m_schema->FieldIsNullable(i) && ((key >> i) & 1)) {
+                    nulls[i][row >> 3] |= 1 << (row & 7);
+                }
+            }
+        }
+    };
+    auto make_columns = [&]() -> std::vector<BatchColumn> {
+        std::vector<BatchColumn> columns(n);
+        columns[0] = {(const char*) col0.data(), nullptr, nulls[0].data()};
+        columns[1] = {col1.data(), ends1.data(), nulls[1].data()};
+        columns[2] = {(const char*) col2.data(), nullptr, nullptr};
+        columns[3] = {col3.data(), ends3.data(), nullptr};
+        columns[4] = {(const char*) col4.data(), nullptr, nulls[4].data()};
+        columns[5] = {col5.data(), nullptr, nulls[5].data()};
+        columns[6] = {col6.data(), ends6.data(), nulls[6].data()};
+        return columns;
+    };
+
+    BatchPayloadEncoder encoder(m_schema.get());
+    for (int32_t first_key : {0, (int32_t) nrows, 12345}) {
+        fill_columns(first_key);
+        std::vector<BatchColumn> columns = make_columns();
+        ASSERT_EQ(encoder.Append(columns.data(), nrows),
+                  encoder.GetNumRows());
+    }
+    ASSERT_EQ(encoder.GetNumRows(), (size_t) nrows * 3);
+
+    // The payloads are the same as the ones of Schema, and are stored
+    // contiguously in the arena.
+    size_t off = 0;
+    for (size_t i = 0; i < encoder.GetNumRows(); ++i) {
+        int32_t key = (i < 2 * nrows) ? (int32_t) i :
+            (int32_t)(12345 + i - 2 * nrows);
+        maxaligned_char_buf expected = MakePayload(key);
+        ASSERT_EQ(encoder.GetRowOffset(i), off);
+        ASSERT_EQ((size_t) encoder.GetRowLength(i), expected.size());
+        ASSERT_EQ(memcmp(encoder.GetPayload(i), expected.data(),
+                         expected.size()), 0) << "key " << key;
+        off += expected.size();
+    }
+    ASSERT_EQ(encoder.GetBuffer().size(), off);
+
+    // A cleared encoder reuses its arena.
+    const char *arena = encoder.GetBuffer().data();
+    encoder.Clear();
+    ASSERT_EQ(encoder.GetNumRows(), 0);
+    std::vector<BatchColumn> columns = make_columns();
+    ASSERT_EQ(encoder.Append(columns.data(), nrows), 0);
+    ASSERT_EQ(encoder.GetBuffer().data(), arena);
+    ASSERT_EQ(memcmp(encoder.GetPayload(0), MakePayload(12345).data(),
+                     encoder.GetRowLength(0)), 0);
+
+    // a null value of a non-null field, and a value that is too long,
+    // neither of which appends any row
+    size_t nbytes = encoder.GetBuffer().size();
+    columns[2].m_nulls = nulls[0].data();
+    EXPECT_REGULAR_ERROR(encoder.Append(columns.data(), nrows));
+    ASSERT_EQ(encoder.GetNumRows(), (size_t) nrows);
+    ASSERT_EQ(encoder.GetBuffer().size(), nbytes);
+    columns[2].m_nulls = nullptr;
+    std::string long_str(40000, 'x');
+    std::vector<uint32_t> long_ends(nrows, (uint32_t) long_str.size());
+    columns[3] = {long_str.data(), long_ends.data(), nullptr};
+    EXPECT_REGULAR_ERROR(encoder.Append(columns.data(), nrows));
+    ASSERT_EQ(encoder.GetNumRows(), (size_t) nrows);
+    ASSERT_EQ(encoder.GetBuffer().size(), nbytes);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestSchema, TestPayloadCodec) {
+    TDB_TEST_BEGIN
+
+    // not a specialized shape: nullable or pass-by-ref fixed-len fields, or
+    // too many fields
+    ASSERT_EQ(PayloadCodec::Create(m_schema.get()), nullptr);
+    std::unique_ptr<Schema> schema(Schema::Create(
+        {initoids::TYP_INT4, initoids::TYP_CHAR}, {0, 5}, {false, false}));
+    schema->ComputeLayout();
+    ASSERT_EQ(PayloadCodec::Create(schema.get()), nullptr);
+    schema.reset(Schema::Create(
+        {initoids::TYP_INT4, initoids::TYP_INT4, initoids::TYP_INT4,
+         initoids::TYP_INT4}, {0, 0, 0, 0}, {false, false, false, false}));
+    schema->ComputeLayout();
+    ASSERT_EQ(PayloadCodec::Create(schema.get()), nullptr);
+
+    // (INT8, INT2, INT4), (INT4, VARCHAR(100)) and
+    // (VARCHAR(100) not null, INT8, BOOL, VARCHAR(100))
+    std::vector<std::unique_ptr<Schema>> schemas;
+    schemas.emplace_back(Schema::Create(
+        {initoids::TYP_INT8, initoids::TYP_INT2, initoids::TYP_INT4},
+        {0, 0, 0}, {false, false, false}));
+    schemas.emplace_back(Schema::Create(
+        {initoids::TYP_INT4, initoids::TYP_VARCHAR}, {0, 100},
+        {false, true}));
+    schemas.emplace_back(Schema::Create(
+        {initoids::TYP_VARCHAR, initoids::TYP_INT8, initoids::TYP_BOOL,
+         initoids::TYP_VARCHAR}, {100, 0, 0, 100},
+        {false, false, false, true}));
+    for (std::unique_ptr<Schema> &schema : schemas) {
+        schema->ComputeLayout();
+        std::unique_ptr<PayloadCodec> codec =
+            PayloadCodec::Create(schema.get());
+        ASSERT_NE(codec, nullptr);
+
+        const FieldId n = schema->GetNumFields();
+        std::vector<std::pair<FieldOffset, FieldOffset>> offlen(n);
+        std::vector<std::pair<FieldOffset, FieldOffset>> expected_offlen(n);
+        for (int32_t key = 0; key < 500; ++key) {
+            std::string str = absl::StrFormat("%0*d", (int)(key % 60), key);
+            std::vector<Datum> data;
+            for (FieldId i = 0; i < n; ++i) {
+                if (schema->GetFieldLength(i) != -1) {
+                    int64_t val = (int64_t) key * 1000003;
+                    data.emplace_back(Datum::FromFixedlenBytes(
+                        (const char*) &val, schema->GetFieldLength(i)));
+                } else if (schema->FieldIsNullable(i) && key % 3 == 0) {
+                    data.emplace_back(Datum::FromNull());
+                } else {
+                    data.emplace_back(Datum::FromCString(
+                        str.c_str() + i % 2));
+                }
+            }
+
+            // the payloads are the same, with or without a prefix
+            for (size_t prefix_len : {0, 3}) {
+                maxaligned_char_buf expected(prefix_len, 'x');
+                maxaligned_char_buf buf(prefix_len, 'x');
+                FieldOffset reclen =
+                    schema->WritePayloadToBuffer(data, expected);
+                ASSERT_GT(reclen, 0);
+                ASSERT_EQ(codec->WritePayloadToBuffer(data, buf), reclen);
+                ASSERT_EQ(buf, expected);
+            }
+
+            maxaligned_char_buf buf;
+            codec->WritePayloadToBuffer(data, buf);
+            codec->DeformPayload(buf.data(), offlen.data());
+            schema->DeformPayload(buf.data(), n - 1, expected_offlen.data());
+            ASSERT_EQ(offlen, expected_offlen);
+        }
+
+        // a null value of a non-null field, and a payload that is too long
+        std::vector<NullableDatumRef> data;
+        Datum null_datum = Datum::FromNull();
+        std::string long_str(40000, 'x');
+        Datum long_datum = Datum::FromCString(long_str.c_str());
+        for (FieldId i = 0; i < n; ++i) {
+            data.emplace_back(null_datum);
+        }
+        maxaligned_char_buf buf;
+        EXPECT_REGULAR_ERROR(codec->WritePayloadToBuffer(data, buf));
+        if (schema->GetFieldLength(0) == -1) {
+            std::vector<Datum> long_data;
+            for (FieldId i = 0; i < n; ++i) {
+                int64_t zero = 0;
+                long_data.emplace_back((i == 0) ? long_datum.DeepCopy() :
+                    (schema->GetFieldLength(i) == -1) ? Datum::FromNull() :
+                    Datum::FromFixedlenBytes((const char*) &zero,
+                                             schema->GetFieldLength(i)));
+            }
+            buf.clear();
+            ASSERT_EQ(codec->WritePayloadToBuffer(long_data, buf), -1);
+            ASSERT_TRUE(buf.empty());
+        }
+    }
+
+    // the catalog picks the codec of a table
+    g_db->CreateTable("codec_table",
+                      {initoids::TYP_INT4, initoids::TYP_VARCHAR}, {0, 100},
+                      {}, {false, true});
+    Oid tabid = g_catcache->FindTableByName("codec_table");
+    ASSERT_NE(tabid, InvalidOid);
+    std::shared_ptr<const TableDesc> tabdesc =
+        g_catcache->FindTableDesc(tabid);
+    ASSERT_NE(tabdesc->GetPayloadCodec(), nullptr);
+
+    // and decodes its payloads through the codec
+    const Schema *tab_schema = tabdesc->GetSchema();
+    for (int32_t key = 0; key < 10; ++key) {
+        std::string str(key * 3, 'a' + key);
+        std::vector<Datum> data;
+        data.emplace_back(Datum::From(key));
+        data.emplace_back((key % 3 == 0) ? Datum::FromNull() :
+                          Datum::FromCString(str.c_str()));
+        maxaligned_char_buf buf;
+        ASSERT_GT(tabdesc->WritePayloadToBuffer(data, buf), 0);
+        std::pair<FieldOffset, FieldOffset> offlen[2];
+        std::pair<FieldOffset, FieldOffset> expected_offlen[2];
+        tabdesc->DeformPayload(buf.data(), offlen);
+        tab_schema->DeformPayload(buf.data(), 1, expected_offlen);
+        ASSERT_EQ(offlen[0], expected_offlen[0]);
+        ASSERT_EQ(offlen[1], expected_offlen[1]);
+        std::vector<Datum> fields = tabdesc->DissemblePayload(buf.data());
+        ASSERT_EQ(fields.size(), 2u);
+        ASSERT_EQ(fields[0].GetInt32(), key);
+        ASSERT_EQ(fields[1].isnull(), key % 3 == 0);
+        if (key % 3 != 0) {
+            ASSERT_EQ(fields[1].GetVarlenAsStringView(), str);
+        }
+    }
+
+    TDB_TEST_END
+}
+
+}   // namespace taco
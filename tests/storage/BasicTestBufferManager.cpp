@@ -0,0 +1,701 @@
+// Basic tests for BufferManager
+#include "base/TDBDBTest.h"
+
+#include <chrono>
+#include <thread>
+
+#include <absl/container/flat_hash_set.h>
+#include <absl/flags/declare.h>
+#include <absl/flags/flag.h>
+#include <absl/strings/str_format.h>
+
+#include "storage/BufferManager.h"
+#include "storage/FileManager.h"
+#include "storage/FSFile.h"
+#include "utils/fsutils.h"
+
+ABSL_DECLARE_FLAG(bool, bufman_huge_pages);
+ABSL_DECLARE_FLAG(uint64_t, bufman_bgwriter_delay_ms);
+ABSL_DECLARE_FLAG(uint64_t, bufman_compressed_cache_size);
+ABSL_DECLARE_FLAG(uint64_t, bufman_stats_dump_interval_ms);
+ABSL_DECLARE_FLAG(bool, test_never_map_hugetlb);
+
+namespace taco {
+
+class BasicTestBufferManager: public TDBDBTest {
+protected:
+    size_t
+    GetBufferPoolSize() override {
+        return 64;
+    }
+
+    /*!
+     * Creates a new file with \p npages data pages and returns the page
+     * numbers of the data pages in order.
+     */
+    std::vector<PageNumber>
+    CreateFile(size_t npages) {
+        std::unique_ptr<File> f = g_fileman->Open(NEW_REGULAR_FID);
+        std::vector<PageNumber> pids;
+        pids.push_back(f->GetFirstPageNumber());
+        while (pids.size() < npages) {
+            pids.push_back(f->AllocatePage());
+        }
+        return pids;
+    }
+
+    static constexpr size_t TagOffset = 64;
+};
+
+TEST_F(BasicTestBufferManager, TestPinWriteAndReadBack) {
+    TDB_TEST_BEGIN
+
+    // 4x as many pages as the buffer pool so we force evictions
+    std::vector<PageNumber> pids = CreateFile(GetBufferPoolSize() * 4);
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        ASSERT_NE(bufid, INVALID_BUFID);
+        ASSERT_EQ(g_bufman->GetPageNumber(bufid), pids[i]);
+        ASSERT_EQ(g_bufman->GetBuffer(bufid), frame);
+        *(uint64_t*)(frame + TagOffset) = (uint64_t) i + 1;
+        g_bufman->MarkDirty(bufid);
+    }
+
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        ASSERT_EQ(*(uint64_t*)(frame + TagOffset), (uint64_t) i + 1);
+        ASSERT_TRUE(((PageHeaderData*) frame)->IsVFileDataPage());
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestBufferManager, TestAllFramesPinned) {
+    TDB_TEST_BEGIN
+
+    std::vector<PageNumber> pids = CreateFile(GetBufferPoolSize() + 1);
+    std::vector<ScopedBufferId> bufids;
+    for (size_t i = 0; i < GetBufferPoolSize(); ++i) {
+        char *frame;
+        bufids.emplace_back(g_bufman->PinPage(pids[i], &frame));
+    }
+
+    char *frame;
+    ASSERT_REGULAR_ERROR(g_bufman->PinPage(pids.back(), &frame));
+
+    // unpinning any page should make the last one available
+    bufids.pop_back();
+    ScopedBufferId bufid;
+    ASSERT_NO_ERROR(bufid = g_bufman->PinPage(pids.back(), &frame));
+    ASSERT_EQ(g_bufman->GetPageNumber(bufid), pids.back());
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestBufferManager, TestTransparentHugePageFallback) {
+    TDB_TEST_BEGIN
+
+    // Restart with the pool on an aligned mapping with MADV_HUGEPAGE, as if
+    // MAP_HUGETLB were not available.
+    const size_t pool_size = GetBufferPoolSize();
+    bool old_huge_pages = absl::GetFlag(FLAGS_bufman_huge_pages);
+    absl::SetFlag(&FLAGS_bufman_huge_pages, true);
+    absl::SetFlag(&FLAGS_test_never_map_hugetlb, true);
+    g_bufman->Destroy();
+    g_bufman->Init(pool_size);
+    absl::SetFlag(&FLAGS_bufman_huge_pages, old_huge_pages);
+    absl::SetFlag(&FLAGS_test_never_map_hugetlb, false);
+
+    // The frames begin at a huge page boundary, and the pages survive
+    // eviction.
+    std::vector<PageNumber> pids = CreateFile(pool_size * 2);
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        uintptr_t frames_begin =
+            (uintptr_t) frame - (uintptr_t) bufid.Get() * PAGE_SIZE;
+        ASSERT_EQ(frames_begin % (2 * 1024 * 1024), 0u);
+        *(uint64_t*)(frame + TagOffset) = (uint64_t) i + 1;
+        g_bufman->MarkDirty(bufid);
+    }
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        ASSERT_EQ(*(uint64_t*)(frame + TagOffset), (uint64_t) i + 1);
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestBufferManager, TestBulkReadStrategyUsesPrivateRing) {
+    TDB_TEST_BEGIN
+
+    std::vector<PageNumber> pids = CreateFile(GetBufferPoolSize() * 4);
+    std::unique_ptr<BufferAccessStrategy> strategy =
+        BufferAccessStrategy::Create(BufferAccessStrategyType::BULKREAD);
+    ASSERT_EQ(strategy->GetRingSize(), GetBufferPoolSize() / 8);
+
+    // Make a working set of hot pages that have just been accessed.
+    std::vector<PageNumber> hot_pids(pids.end() - 8, pids.end());
+    absl::flat_hash_set<BufferId> hot_bufids;
+    for (int round = 0; round < 3; ++round) {
+        for (PageNumber pid : hot_pids) {
+            char *frame;
+            ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+            hot_bufids.insert(bufid);
+        }
+    }
+
+    // A scan through the strategy should only recycle the frames in its
+    // ring and never evict the hot pages. The first half of the file has
+    // long been evicted, so every page access there is a miss.
+    absl::flat_hash_set<BufferId> scan_bufids;
+    for (size_t i = 0; i < pids.size() / 2; ++i) {
+        char *frame;
+        ScopedBufferId bufid =
+            g_bufman->PinPage(pids[i], &frame, strategy.get());
+        ASSERT_TRUE(((PageHeaderData*) frame)->IsVFileDataPage());
+        scan_bufids.insert(bufid);
+    }
+    EXPECT_LE(scan_bufids.size(), strategy->GetRingSize());
+
+    for (size_t i = 0; i < hot_pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(hot_pids[i], &frame);
+        EXPECT_TRUE(hot_bufids.contains(bufid));
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestBufferManager, TestBulkWriteStrategyNeverWritesVictims) {
+    TDB_TEST_BEGIN
+
+    // The dirty frames of the ring are written by the background writer,
+    // never by the page misses of the bulk operation.
+    std::vector<PageNumber> pids = CreateFile(GetBufferPoolSize() * 4);
+    std::unique_ptr<BufferAccessStrategy> strategy =
+        BufferAccessStrategy::Create(BufferAccessStrategyType::BULKWRITE);
+    BufferManagerStats stats = g_bufman->GetStats();
+    const uint64_t writebacks = stats.m_pool.m_eviction_writebacks;
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid =
+            g_bufman->PinPage(pids[i], &frame, strategy.get());
+        *(uint64_t*)(frame + TagOffset) = (uint64_t) i + 1;
+        g_bufman->MarkDirty(bufid);
+    }
+    stats = g_bufman->GetStats();
+    EXPECT_EQ(stats.m_pool.m_eviction_writebacks, writebacks);
+    EXPECT_GT(stats.m_pool.m_background_writebacks, 0u);
+
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        ASSERT_EQ(*(uint64_t*)(frame + TagOffset), (uint64_t) i + 1);
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestBufferManager, TestCheckpointWritesAllDirtyPages) {
+    TDB_TEST_BEGIN
+
+    // Interleave the pages of two files so that the checkpoint has to sort
+    // them to find the runs of consecutive pages.
+    std::unique_ptr<File> f1 = g_fileman->Open(NEW_REGULAR_FID);
+    std::unique_ptr<File> f2 = g_fileman->Open(NEW_REGULAR_FID);
+    std::vector<PageNumber> pids;
+    pids.push_back(f1->GetFirstPageNumber());
+    pids.push_back(f2->GetFirstPageNumber());
+    for (size_t i = 0; i < GetBufferPoolSize() / 4; ++i) {
+        pids.push_back(f1->AllocatePage());
+        pids.push_back(f2->AllocatePage());
+    }
+
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        *(uint64_t*)(frame + TagOffset) = (uint64_t) i + 1;
+        g_bufman->MarkDirty(bufid);
+    }
+    ASSERT_NO_ERROR(g_bufman->Checkpoint());
+
+    unique_malloced_ptr buf = unique_aligned_alloc(512, PAGE_SIZE);
+    for (size_t i = 0; i < pids.size(); ++i) {
+        g_fileman->ReadPage(pids[i], (char*) buf.get());
+        ASSERT_EQ(*(uint64_t*)((char*) buf.get() + TagOffset),
+                  (uint64_t) i + 1);
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestBufferManager, TestCheckpointIsPaced) {
+    TDB_TEST_BEGIN
+
+    std::vector<PageNumber> pids = CreateFile(GetBufferPoolSize() / 2);
+    for (size_t i = 0; i < pids.size(); i += 2) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        *(uint64_t*)(frame + TagOffset) = (uint64_t) i + 1;
+        g_bufman->MarkDirty(bufid);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_NO_ERROR(g_bufman->Checkpoint(200));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_GE(elapsed, std::chrono::milliseconds(200));
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestBufferManager, TestSequentialScanWithReadAhead) {
+    TDB_TEST_BEGIN
+
+    std::vector<PageNumber> pids = CreateFile(GetBufferPoolSize() * 3);
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        *(uint64_t*)(frame + TagOffset) = (uint64_t) i + 1;
+        g_bufman->MarkDirty(bufid);
+    }
+
+    // Follow the page links twice while the prefetcher reads ahead of us.
+    // We should still see every page in order with the right content. The
+    // scan is slowed down a bit so that the prefetcher can keep ahead of it.
+    BufferManagerStats stats = g_bufman->GetStats();
+    uint64_t readahead_pages = stats.m_pool.m_readahead_pages;
+    uint64_t readahead_hits = stats.m_pool.m_readahead_hits;
+    for (int round = 0; round < 2; ++round) {
+        ReadAheadState readahead;
+        PageNumber pid = pids[0];
+        size_t i = 0;
+        while (pid != INVALID_PID) {
+            ASSERT_LT(i, pids.size());
+            ASSERT_EQ(pid, pids[i]);
+            char *frame;
+            ScopedBufferId bufid =
+                g_bufman->PinPage(pid, &frame, nullptr, &readahead);
+            ASSERT_EQ(*(uint64_t*)(frame + TagOffset), (uint64_t) i + 1);
+            pid = ((PageHeaderData*) frame)->GetNextPageNumber();
+            if (i == pids.size() / 2) {
+                EXPECT_GT(readahead.GetWindow(), 0u);
+            }
+            ++i;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        ASSERT_EQ(i, pids.size());
+    }
+    stats = g_bufman->GetStats();
+    EXPECT_GT(stats.m_pool.m_readahead_pages, readahead_pages);
+    EXPECT_GT(stats.m_pool.m_readahead_hits, readahead_hits);
+
+    // Two interleaved scans of the same file on this thread keep their own
+    // windows.
+    readahead_pages = stats.m_pool.m_readahead_pages;
+    readahead_hits = stats.m_pool.m_readahead_hits;
+    ReadAheadState readahead[2];
+    PageNumber pid[2] = {pids[0], pids[pids.size() / 2]};
+    for (size_t i = 0; i < pids.size() / 2; ++i) {
+        for (int j = 0; j < 2; ++j) {
+            char *frame;
+            ScopedBufferId bufid =
+                g_bufman->PinPage(pid[j], &frame, nullptr, &readahead[j]);
+            pid[j] = ((PageHeaderData*) frame)->GetNextPageNumber();
+            if (i == pids.size() / 4) {
+                EXPECT_GT(readahead[j].GetWindow(), 0u);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    stats = g_bufman->GetStats();
+    EXPECT_GT(stats.m_pool.m_readahead_pages, readahead_pages);
+    EXPECT_GT(stats.m_pool.m_readahead_hits, readahead_hits);
+
+    // A pin without a read-ahead state never reads ahead.
+    readahead_pages = stats.m_pool.m_readahead_pages;
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+    }
+    stats = g_bufman->GetStats();
+    EXPECT_EQ(stats.m_pool.m_readahead_pages, readahead_pages);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestBufferManager, TestResizeBufferPool) {
+    TDB_TEST_BEGIN
+
+    const size_t pool_size = GetBufferPoolSize();
+    ASSERT_GE(g_bufman->GetMaxPoolSize(), pool_size * 2);
+    std::vector<PageNumber> pids = CreateFile(pool_size * 2);
+
+    // Grow the pool so that twice as many pages can be pinned at once.
+    ASSERT_NO_ERROR(g_bufman->Resize(pool_size * 2));
+    ASSERT_EQ(g_bufman->GetPoolSize(), pool_size * 2);
+    {
+        std::vector<ScopedBufferId> bufids;
+        for (size_t i = 0; i < pids.size(); ++i) {
+            char *frame;
+            bufids.emplace_back(g_bufman->PinPage(pids[i], &frame));
+            *(uint64_t*)(frame + TagOffset) = (uint64_t) i + 1;
+            g_bufman->MarkDirty(bufids.back());
+        }
+    }
+
+    // Shrink it while a page in one of the drained frames is still pinned.
+    // The resize has to wait for it to be unpinned.
+    char *frame;
+    ScopedBufferId pinned;
+    for (size_t i = 0; i < pids.size(); ++i) {
+        pinned = g_bufman->PinPage(pids[i], &frame);
+        if (pinned.Get() >= pool_size / 2)
+            break;
+    }
+    ASSERT_GE(pinned.Get(), pool_size / 2);
+    std::thread unpinner([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        pinned.Reset();
+    });
+    // The dirty pages in the drained frames are written by the background
+    // writer.
+    const uint64_t writebacks =
+        g_bufman->GetStats().m_pool.m_eviction_writebacks;
+    ASSERT_NO_ERROR(g_bufman->Resize(pool_size / 2));
+    unpinner.join();
+    ASSERT_EQ(g_bufman->GetPoolSize(), pool_size / 2);
+    EXPECT_EQ(g_bufman->GetStats().m_pool.m_eviction_writebacks, writebacks);
+
+    // All the pages must have survived the shrink and only the remaining
+    // frames may be used.
+    for (size_t i = 0; i < pids.size(); ++i) {
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        ASSERT_LT(bufid.Get(), pool_size / 2);
+        ASSERT_EQ(*(uint64_t*)(frame + TagOffset), (uint64_t) i + 1);
+    }
+    {
+        std::vector<ScopedBufferId> bufids;
+        for (size_t i = 0; i < pool_size / 2; ++i) {
+            bufids.emplace_back(g_bufman->PinPage(pids[i], &frame));
+        }
+        ASSERT_REGULAR_ERROR(g_bufman->PinPage(pids.back(), &frame));
+    }
+
+    ASSERT_REGULAR_ERROR(g_bufman->Resize(0));
+    ASSERT_REGULAR_ERROR(g_bufman->Resize(g_bufman->GetMaxPoolSize() + 1));
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestBufferManager, TestDirtyVictimsWithoutBgWriter) {
+    TDB_TEST_BEGIN
+
+    // Restart without the background writer, so that the page misses have
+    // to write back the dirty victims by themselves.
+    const size_t pool_size = GetBufferPoolSize();
+    uint64_t old_delay = absl::GetFlag(FLAGS_bufman_bgwriter_delay_ms);
+    absl::SetFlag(&FLAGS_bufman_bgwriter_delay_ms, 0);
+    g_bufman->Destroy();
+    g_bufman->Init(pool_size);
+    absl::SetFlag(&FLAGS_bufman_bgwriter_delay_ms, old_delay);
+
+    std::vector<PageNumber> pids = CreateFile(pool_size * 4);
+    std::unique_ptr<BufferAccessStrategy> strategy =
+        BufferAccessStrategy::Create(BufferAccessStrategyType::BULKWRITE);
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame,
+            (i % 2) ? strategy.get() : nullptr);
+        *(uint64_t*)(frame + TagOffset) = (uint64_t) i + 1;
+        g_bufman->MarkDirty(bufid);
+    }
+    BufferManagerStats stats = g_bufman->GetStats();
+    EXPECT_GT(stats.m_pool.m_eviction_writebacks, 0u);
+    EXPECT_EQ(stats.m_pool.m_background_writebacks, 0u);
+
+    // Drain a pool full of dirty pages.
+    for (size_t i = pids.size() - pool_size; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        g_bufman->MarkDirty(bufid);
+    }
+    ASSERT_NO_ERROR(g_bufman->Resize(pool_size / 2));
+    ASSERT_EQ(g_bufman->GetPoolSize(), pool_size / 2);
+
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        ASSERT_LT(bufid.Get(), pool_size / 2);
+        ASSERT_EQ(*(uint64_t*)(frame + TagOffset), (uint64_t) i + 1);
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestBufferManager, TestWarmRestart) {
+    TDB_TEST_BEGIN
+
+    const size_t pool_size = GetBufferPoolSize();
+    std::vector<PageNumber> pids = CreateFile(pool_size * 2);
+
+    // Make a few pages hot so they stay in the buffer pool.
+    std::vector<PageNumber> resident_pids(pids.end() - pool_size / 2,
+                                          pids.end());
+    for (int round = 0; round < 3; ++round) {
+        for (PageNumber pid : resident_pids) {
+            char *frame;
+            ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+            ASSERT_TRUE(((PageHeaderData*) frame)->IsVFileDataPage());
+        }
+    }
+    for (PageNumber pid : resident_pids) {
+        ASSERT_TRUE(g_bufman->IsPageResident(pid));
+    }
+
+    std::string state_path = g_db->GetLastDBPath() + "/test_bufpool_state";
+    ASSERT_NO_ERROR(g_bufman->SaveResidentPages(state_path));
+    ASSERT_TRUE(regular_file_exists(state_path.c_str()));
+
+    // Restart the buffer manager with a cold cache.
+    g_bufman->Destroy();
+    g_bufman->Init(pool_size);
+    for (PageNumber pid : resident_pids) {
+        ASSERT_FALSE(g_bufman->IsPageResident(pid));
+    }
+
+    ASSERT_NO_ERROR(g_bufman->StartPrewarm(state_path));
+    g_bufman->WaitForPrewarm();
+    ASSERT_FALSE(regular_file_exists(state_path.c_str()));
+    for (PageNumber pid : resident_pids) {
+        EXPECT_TRUE(g_bufman->IsPageResident(pid));
+    }
+
+    // A missing state file just means a cold start.
+    ASSERT_NO_ERROR(g_bufman->StartPrewarm(state_path));
+    g_bufman->WaitForPrewarm();
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestBufferManager, TestSwizzledPageRef) {
+    TDB_TEST_BEGIN
+
+    std::vector<PageNumber> pids = CreateFile(GetBufferPoolSize() * 4);
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        *(uint64_t*)(frame + TagOffset) = (uint64_t) i + 1;
+        g_bufman->MarkDirty(bufid);
+    }
+
+    SwizzledPageRef ref(pids[0]);
+    ASSERT_FALSE(ref.IsSwizzled());
+    char *frame;
+    BufferId first_bufid;
+    {
+        ScopedBufferId bufid = g_bufman->PinPage(ref, &frame);
+        ASSERT_TRUE(ref.IsSwizzled());
+        ASSERT_EQ(ref.GetPageNumber(), pids[0]);
+        ASSERT_EQ(*(uint64_t*)(frame + TagOffset), (uint64_t) 1);
+        first_bufid = bufid;
+    }
+    {
+        // A swizzled pin lands in the same frame.
+        ScopedBufferId bufid = g_bufman->PinPage(ref, &frame);
+        ASSERT_EQ(bufid.Get(), first_bufid);
+        ASSERT_EQ(g_bufman->GetPageNumber(bufid), pids[0]);
+    }
+
+    // Evict the page by walking through the file through the links cached
+    // in the frames.
+    {
+        ScopedBufferId bufid = g_bufman->PinPage(pids[1], &frame);
+        size_t i = 1;
+        while (bufid.Get() != INVALID_BUFID) {
+            ASSERT_EQ(g_bufman->GetPageNumber(bufid), pids[i]);
+            ASSERT_EQ(*(uint64_t*)(frame + TagOffset), (uint64_t) i + 1);
+            bufid = g_bufman->PinNextPage(bufid, &frame);
+            ++i;
+        }
+        ASSERT_EQ(i, pids.size());
+    }
+    ASSERT_FALSE(g_bufman->IsPageResident(pids[0]));
+
+    // The stale reference still leads to the right page.
+    {
+        ScopedBufferId bufid = g_bufman->PinPage(ref, &frame);
+        ASSERT_EQ(g_bufman->GetPageNumber(bufid), pids[0]);
+        ASSERT_EQ(*(uint64_t*)(frame + TagOffset), (uint64_t) 1);
+        ASSERT_TRUE(ref.IsSwizzled());
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestBufferManager, TestStats) {
+    TDB_TEST_BEGIN
+
+    const size_t pool_size = GetBufferPoolSize();
+    std::vector<PageNumber> pids = CreateFile(pool_size * 2);
+    FileId fid;
+    {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[0], &frame);
+        fid = ((PageHeaderData*) frame)->GetFileId();
+    }
+    // The pages have been pinned when they were allocated, so only count
+    // the events from here on.
+    BufferManagerStats stats0 = g_bufman->GetStats();
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        g_bufman->MarkDirty(bufid);
+        g_bufman->AcquireFrameLatch(bufid, LatchMode::EX);
+        g_bufman->GetFrameLatch(bufid)->Release(LatchMode::EX);
+    }
+    {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids.back(), &frame);
+    }
+    g_bufman->Checkpoint();
+
+    BufferManagerStats stats = g_bufman->GetStats();
+    ASSERT_EQ(stats.m_pool_size, pool_size);
+    EXPECT_LE(stats.m_nresident, pool_size);
+    EXPECT_EQ(stats.m_ndirty, 0u);
+    EXPECT_EQ(stats.m_npinned, 0u);
+
+    // Every pin is either a hit or a miss, though the prefetcher may have
+    // turned some of the misses into hits.
+    const BufferCounters &pool = stats.m_pool;
+    const BufferCounters &pool0 = stats0.m_pool;
+    EXPECT_EQ(pool.m_hits + pool.m_misses - pool0.m_hits - pool0.m_misses,
+              pids.size() + 1);
+    EXPECT_GE(pool.m_hits - pool0.m_hits, 1u);
+    EXPECT_LE(pool.m_readahead_hits, pool.m_readahead_pages);
+    EXPECT_GE(pool.m_evictions - pool0.m_evictions, pids.size() - pool_size);
+    EXPECT_GE(pool.m_eviction_writebacks + pool.m_background_writebacks -
+              pool0.m_eviction_writebacks - pool0.m_background_writebacks,
+              pids.size());
+    EXPECT_EQ(pool.m_latch_waits, pool0.m_latch_waits);
+
+    auto find_file = [fid](const BufferManagerStats &stats)
+            -> const BufferCounters* {
+        for (const auto &p : stats.m_files) {
+            if (p.first == fid)
+                return &p.second;
+        }
+        return nullptr;
+    };
+    const BufferCounters *file = find_file(stats);
+    const BufferCounters *file0 = find_file(stats0);
+    ASSERT_NE(file, nullptr);
+    ASSERT_NE(file0, nullptr);
+    EXPECT_EQ(file->m_hits + file->m_misses - file0->m_hits -
+              file0->m_misses, pids.size() + 1);
+    EXPECT_GT(file->GetHitRatio(), 0.0);
+    EXPECT_LT(file->GetHitRatio(), 1.0);
+
+    // Dump the stats periodically after a restart.
+    uint64_t old_interval = absl::GetFlag(FLAGS_bufman_stats_dump_interval_ms);
+    absl::SetFlag(&FLAGS_bufman_stats_dump_interval_ms, 10);
+    g_bufman->Destroy();
+    g_bufman->Init(pool_size);
+    std::string stats_path = g_db->GetLastDBPath() + "/test_bufman_stats";
+    g_bufman->StartStatsDump(stats_path);
+    absl::SetFlag(&FLAGS_bufman_stats_dump_interval_ms, old_interval);
+    ASSERT_REGULAR_ERROR(g_bufman->StartStatsDump(stats_path));
+    {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[0], &frame);
+    }
+    for (int i = 0; i < 100 && !regular_file_exists(stats_path.c_str());
+         ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(regular_file_exists(stats_path.c_str()));
+
+    // The final dump happens when the buffer manager is destroyed.
+    g_bufman->Destroy();
+    g_bufman->Init(pool_size);
+    std::unique_ptr<FSFile> f(FSFile::Open(stats_path, false, false, false));
+    ASSERT_NE(f.get(), nullptr);
+    std::string text(f->Size(), '\0');
+    f->Read(&text[0], text.size(), 0);
+    f->Close();
+    EXPECT_NE(text.find(absl::StrFormat("pool_size %lu\n", pool_size)),
+              std::string::npos);
+    EXPECT_NE(text.find("misses 1\n"), std::string::npos);
+    EXPECT_NE(text.find(absl::StrFormat("[file %u]", fid)), std::string::npos);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestBufferManager, TestCompressedPageCache) {
+    TDB_TEST_BEGIN
+
+    const size_t pool_size = GetBufferPoolSize();
+    std::vector<PageNumber> pids = CreateFile(pool_size * 4);
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        *(uint64_t*)(frame + TagOffset) = (uint64_t) i + 1;
+        g_bufman->MarkDirty(bufid);
+    }
+    g_bufman->Checkpoint();
+
+    // Restart with a compressed page cache large enough for all the pages.
+    uint64_t old_size = absl::GetFlag(FLAGS_bufman_compressed_cache_size);
+    absl::SetFlag(&FLAGS_bufman_compressed_cache_size, pids.size() * 1024);
+    g_bufman->Destroy();
+    g_bufman->Init(pool_size);
+    absl::SetFlag(&FLAGS_bufman_compressed_cache_size, old_size);
+
+    for (int round = 0; round < 2; ++round) {
+        for (size_t i = 0; i < pids.size(); ++i) {
+            char *frame;
+            ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+            ASSERT_EQ(*(uint64_t*)(frame + TagOffset), (uint64_t) i + 1);
+            if (round == 1 && i % 2 == 0) {
+                // These must not be served from a stale copy later.
+                *(uint64_t*)(frame + TagOffset) = (uint64_t) i + 1000;
+                g_bufman->MarkDirty(bufid);
+            }
+        }
+    }
+
+    // The evicted pages of the first round are served by decompression in
+    // the second.
+    BufferManagerStats stats = g_bufman->GetStats();
+    EXPECT_GT(stats.m_ncompressed, 0u);
+    EXPECT_LE(stats.m_compressed_size, pids.size() * 1024);
+    EXPECT_GE(stats.m_pool.m_compressed_hits, pids.size() - pool_size);
+
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        ASSERT_EQ(*(uint64_t*)(frame + TagOffset),
+                  (uint64_t) i + ((i % 2 == 0) ? 1000 : 1));
+    }
+
+    // A cache too small for anything is just disabled in effect.
+    absl::SetFlag(&FLAGS_bufman_compressed_cache_size, 1);
+    g_bufman->Destroy();
+    g_bufman->Init(pool_size);
+    absl::SetFlag(&FLAGS_bufman_compressed_cache_size, old_size);
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pids[i], &frame);
+        ASSERT_EQ(*(uint64_t*)(frame + TagOffset),
+                  (uint64_t) i + ((i % 2 == 0) ? 1000 : 1));
+    }
+    EXPECT_EQ(g_bufman->GetStats().m_ncompressed, 0u);
+
+    TDB_TEST_END
+}
+
+}   // namespace taco
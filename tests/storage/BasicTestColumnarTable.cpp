@@ -0,0 +1,162 @@
+// Basic tests for ColumnarTable
+#include "base/TDBDBTest.h"
+
+#include <absl/strings/str_format.h>
+
+#include "catalog/CatCache.h"
+#include "catalog/systables.h"
+#include "storage/ColumnarTable.h"
+#include "storage/Table.h"
+
+namespace taco {
+
+class BasicTestColumnarTable: public TDBDBTest {
+protected:
+    size_t
+    GetBufferPoolSize() override {
+        return 64;
+    }
+
+    void
+    SetUp() override {
+        TDBDBTest::SetUp();
+        // (INT4 not null, VARCHAR(100), INT8)
+        g_db->CreateTable("columnar_table",
+                          {initoids::TYP_INT4, initoids::TYP_VARCHAR,
+                           initoids::TYP_INT8},
+                          {0, 100, 0}, {}, {false, true, true}, {},
+                          TABLAYOUT_COLUMNAR);
+        Oid tabid = g_catcache->FindTableByName("columnar_table");
+        ASSERT_NE(tabid, InvalidOid);
+        m_tabdesc = g_catcache->FindTableDesc(tabid);
+        ASSERT_NE(m_tabdesc.get(), nullptr);
+    }
+
+    void
+    TearDown() override {
+        m_tabdesc.reset();
+        TDBDBTest::TearDown();
+    }
+
+    //! the string field of the row with key \p key
+    static std::string
+    MakeString(int32_t key) {
+        return absl::StrFormat("str%0*d", (int)(key % 40), key);
+    }
+
+    /*!
+     * Appends the rows [begin, end) to \p table, where the string of a row
+     * is null if its key is a multiple of 5.
+     */
+    static void
+    AppendRows(ColumnarTable *table, int32_t begin, int32_t end,
+               uint32_t rowgroup_nrows) {
+        std::unique_ptr<ColumnarTable::Appender> appender =
+            table->StartAppend(rowgroup_nrows);
+        for (int32_t i = begin; i < end; ++i) {
+            std::string str = MakeString(i);
+            std::vector<Datum> data;
+            data.emplace_back(Datum::From(i));
+            if (i % 5 == 0)
+                data.emplace_back(Datum::FromNull());
+            else
+                data.emplace_back(Datum::FromCString(str.c_str()));
+            data.emplace_back(Datum::From((int64_t) i * 7));
+            appender->Append(data);
+        }
+        appender->Finish();
+    }
+
+    std::shared_ptr<const TableDesc> m_tabdesc;
+};
+
+TEST_F(BasicTestColumnarTable, TestAppendAndScan) {
+    TDB_TEST_BEGIN
+
+    std::unique_ptr<ColumnarTable> table = ColumnarTable::Create(m_tabdesc);
+    ASSERT_EQ(table->GetNumRowGroups(), 0u);
+    ColumnarTable::Scanner scanner = table->StartScan({0, 1, 2});
+    ASSERT_FALSE(scanner.Next());
+
+    const int32_t n = 50000;
+    AppendRows(table.get(), 0, n, 4096);
+    ASSERT_EQ(table->GetNumRows(), (uint64_t) n);
+    ASSERT_EQ(table->GetNumRowGroups(), (uint32_t)((n + 4095) / 4096));
+
+    // a new handle sees the same row groups, and the columns are returned
+    // in the order they are asked for
+    table = ColumnarTable::Create(m_tabdesc);
+    ASSERT_EQ(table->GetNumRows(), (uint64_t) n);
+    scanner = table->StartScan({2, 1, 0});
+    int32_t key = 0;
+    while (scanner.Next()) {
+        const ColumnarTable::ColumnVector &col2 = scanner.GetColumn(0);
+        const ColumnarTable::ColumnVector &col1 = scanner.GetColumn(1);
+        const ColumnarTable::ColumnVector &col0 = scanner.GetColumn(2);
+        uint32_t nrows = scanner.GetNumRows();
+        ASSERT_GT(nrows, 0u);
+        ASSERT_EQ(col0.GetNumRows(), nrows);
+        const int32_t *keys = (const int32_t*) col0.GetFixedlenValues();
+        const int64_t *vals = (const int64_t*) col2.GetFixedlenValues();
+        for (uint32_t i = 0; i < nrows; ++i, ++key) {
+            ASSERT_EQ(keys[i], key);
+            ASSERT_FALSE(col0.IsNull(i));
+            ASSERT_EQ(vals[i], (int64_t) key * 7);
+            ASSERT_EQ(col2.GetField(i).GetInt64(), (int64_t) key * 7);
+            if (key % 5 == 0) {
+                ASSERT_TRUE(col1.IsNull(i));
+                ASSERT_TRUE(col1.GetField(i).isnull());
+            } else {
+                ASSERT_FALSE(col1.IsNull(i));
+                ASSERT_EQ(col1.GetField(i).GetVarlenAsStringView(),
+                          MakeString(key));
+            }
+        }
+    }
+    ASSERT_EQ(key, n);
+    ASSERT_FALSE(scanner.Next());
+
+    // appending more rows adds row groups after the existing ones
+    AppendRows(table.get(), n, n + 100, 4096);
+    ASSERT_EQ(table->GetNumRows(), (uint64_t)(n + 100));
+    scanner = table->StartScan({0});
+    key = 0;
+    while (scanner.Next()) {
+        const int32_t *keys =
+            (const int32_t*) scanner.GetColumn(0).GetFixedlenValues();
+        for (uint32_t i = 0; i < scanner.GetNumRows(); ++i, ++key) {
+            ASSERT_EQ(keys[i], key);
+        }
+    }
+    ASSERT_EQ(key, n + 100);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestColumnarTable, TestErrors) {
+    TDB_TEST_BEGIN
+
+    std::unique_ptr<ColumnarTable> table = ColumnarTable::Create(m_tabdesc);
+    std::unique_ptr<ColumnarTable::Appender> appender = table->StartAppend();
+    std::vector<Datum> data;
+    data.emplace_back(Datum::FromNull());
+    data.emplace_back(Datum::FromNull());
+    data.emplace_back(Datum::FromNull());
+    EXPECT_REGULAR_ERROR(appender->Append(data));
+    data.pop_back();
+    EXPECT_REGULAR_ERROR(appender->Append(data));
+    appender->Finish();
+    ASSERT_EQ(table->GetNumRowGroups(), 0u);
+
+    EXPECT_REGULAR_ERROR(table->StartScan({3}));
+    EXPECT_REGULAR_ERROR(Table::Create(m_tabdesc));
+
+    g_db->CreateTable("row_table", {initoids::TYP_INT4});
+    Oid tabid = g_catcache->FindTableByName("row_table");
+    EXPECT_REGULAR_ERROR(
+        ColumnarTable::Create(g_catcache->FindTableDesc(tabid)));
+
+    TDB_TEST_END
+}
+
+}   // namespace taco
@@ -0,0 +1,291 @@
+// Basic tests for FileManager
+#include "base/TDBDBTest.h"
+
+#include <absl/strings/str_format.h>
+
+#include "storage/BufferManager.h"
+#include "storage/FileManager.h"
+#include "utils/fsutils.h"
+
+namespace taco {
+
+class BasicTestFileManager: public TDBDBTest {
+protected:
+    size_t
+    GetBufferPoolSize() override {
+        return 64;
+    }
+
+    /*!
+     * Destroys the buffer manager and the file manager and opens the data
+     * files again from the disk.
+     */
+    void
+    Reopen() {
+        g_bufman->Destroy();
+        g_fileman->Destroy();
+        g_bufman->Init(GetBufferPoolSize());
+        g_fileman->Init(g_db->GetLastDBPath(), false);
+    }
+
+    /*!
+     * Returns the page numbers of the data pages of \p f, following the
+     * next page links from the first page. Also checks the previous page
+     * links, the file ID in each page and the number of pages.
+     */
+    std::vector<PageNumber>
+    GetPages(File *f) {
+        std::vector<PageNumber> pids;
+        PageNumber prev_pid = INVALID_PID;
+        PageNumber pid = f->GetFirstPageNumber();
+        while (pid != INVALID_PID) {
+            char *frame;
+            ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+            const PageHeaderData *ph = (const PageHeaderData*) frame;
+            EXPECT_TRUE(ph->IsVFileDataPage());
+            EXPECT_EQ(ph->GetFileId(), f->GetFileId());
+            EXPECT_EQ(ph->GetPrevPageNumber(), prev_pid);
+            pids.push_back(pid);
+            prev_pid = pid;
+            pid = ph->GetNextPageNumber();
+        }
+        EXPECT_EQ(f->GetLastPageNumber(), prev_pid);
+        EXPECT_EQ(f->GetNumPages(), (PageNumber) pids.size());
+        return pids;
+    }
+
+    void
+    SetTag(PageNumber pid, uint64_t tag) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+        *(uint64_t*)(frame + TagOffset) = tag;
+        g_bufman->MarkDirty(bufid);
+    }
+
+    uint64_t
+    GetTag(PageNumber pid) {
+        char *frame;
+        ScopedBufferId bufid = g_bufman->PinPage(pid, &frame);
+        return *(uint64_t*)(frame + TagOffset);
+    }
+
+    static constexpr size_t TagOffset = 64;
+};
+
+TEST_F(BasicTestFileManager, TestFreePageReuse) {
+    TDB_TEST_BEGIN
+
+    std::unique_ptr<File> f = g_fileman->Open(NEW_REGULAR_FID);
+    ASSERT_NE(f.get(), nullptr);
+    std::vector<PageNumber> pids;
+    pids.push_back(f->GetFirstPageNumber());
+    for (size_t i = 1; i < 16; ++i) {
+        pids.push_back(f->AllocatePage());
+    }
+    ASSERT_EQ(GetPages(f.get()), pids);
+    PageNumber npages = g_fileman->GetNumPages();
+
+    // Free the first, a middle and the last page. The free list is LIFO.
+    ASSERT_NO_ERROR(f->FreePage(pids[0]));
+    ASSERT_NO_ERROR(f->FreePage(pids[7]));
+    ASSERT_NO_ERROR(f->FreePage(pids[15]));
+    std::vector<PageNumber> expected = pids;
+    expected.erase(expected.begin() + 15);
+    expected.erase(expected.begin() + 7);
+    expected.erase(expected.begin());
+    ASSERT_EQ(GetPages(f.get()), expected);
+
+    // A page that is no longer in the file can't be freed again.
+    EXPECT_REGULAR_ERROR(f->FreePage(pids[7]));
+
+    // The freed pages are reused before the data files are extended, and a
+    // reused page is zero filled.
+    SetTag(pids[0], 0xdeadbeef);
+    for (size_t i : {15, 7, 0}) {
+        PageNumber pid = f->AllocatePage();
+        EXPECT_EQ(pid, pids[i]);
+        EXPECT_EQ(GetTag(pid), 0u);
+        expected.push_back(pid);
+    }
+    EXPECT_EQ(g_fileman->GetNumPages(), npages);
+    ASSERT_EQ(GetPages(f.get()), expected);
+
+    // The pages of a removed file are reused by the next file, including
+    // its meta page.
+    FileId fid = f->GetFileId();
+    f->Close();
+    ASSERT_NO_ERROR(g_fileman->RemoveFile(fid));
+    EXPECT_EQ(g_fileman->Open(fid).get(), nullptr);
+    std::unique_ptr<File> f2 = g_fileman->Open(NEW_REGULAR_FID);
+    ASSERT_NE(f2.get(), nullptr);
+    EXPECT_NE(f2->GetFileId(), fid);
+    for (size_t i = 0; i < 15; ++i) {
+        f2->AllocatePage();
+    }
+    EXPECT_EQ(g_fileman->GetNumPages(), npages);
+    EXPECT_EQ(GetPages(f2.get()).size(), 16u);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestFileManager, TestFreeOnlyPage) {
+    TDB_TEST_BEGIN
+
+    std::unique_ptr<File> f = g_fileman->Open(NEW_REGULAR_FID);
+    ASSERT_NE(f.get(), nullptr);
+    PageNumber pid = f->GetFirstPageNumber();
+    EXPECT_REGULAR_ERROR(f->FreePage(pid));
+    EXPECT_EQ(f->GetNumPages(), 1u);
+    EXPECT_EQ(f->GetFirstPageNumber(), pid);
+    EXPECT_EQ(f->GetLastPageNumber(), pid);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestFileManager, TestNewPagesAcrossSegments) {
+    TDB_TEST_BEGIN
+
+    std::unique_ptr<File> f = g_fileman->Open(NEW_REGULAR_FID);
+    ASSERT_NE(f.get(), nullptr);
+    PageNumber first_pid = f->GetFirstPageNumber();
+
+    // Reserve the rest of the first segment except for a few pages, which
+    // are never written and just leaked.
+    constexpr PageNumber NumPagesBeforeBoundary = 4;
+    PageNumber npages = g_fileman->GetNumPages();
+    ASSERT_LT(npages, DataFileNumPages - NumPagesBeforeBoundary);
+    f->ReserveNewPages(DataFileNumPages - NumPagesBeforeBoundary - npages);
+    ASSERT_EQ(g_fileman->GetNumPages(),
+              DataFileNumPages - NumPagesBeforeBoundary);
+    std::string seg1_path = g_db->GetLastDBPath() + "/main.1";
+    EXPECT_FALSE(regular_file_exists(seg1_path.c_str()));
+
+    // A run of new pages that crosses into the second segment.
+    constexpr PageNumber RunSize = 3 * NumPagesBeforeBoundary;
+    PageNumber run1 = f->ReserveNewPages(RunSize);
+    ASSERT_EQ(run1, DataFileNumPages - NumPagesBeforeBoundary);
+    ASSERT_EQ(g_fileman->GetNumPages(), run1 + RunSize);
+    EXPECT_TRUE(regular_file_exists(seg1_path.c_str()));
+
+    unique_malloced_ptr buf =
+        unique_aligned_alloc(512, (size_t) RunSize * PAGE_SIZE);
+    memset(buf.get(), 0, (size_t) RunSize * PAGE_SIZE);
+    for (PageNumber i = 0; i < RunSize; ++i) {
+        *(uint64_t*)((char*) buf.get() + (size_t) i * PAGE_SIZE +
+                     TagOffset) = (uint64_t) run1 + i;
+    }
+    ASSERT_NO_ERROR(f->WriteNewPages(run1, (char*) buf.get(), RunSize));
+
+    // A second run, of which only a part is appended and the rest is
+    // returned to the free list.
+    PageNumber run2 = f->ReserveNewPages(RunSize);
+    ASSERT_EQ(run2, run1 + RunSize);
+    for (PageNumber i = 0; i < RunSize; ++i) {
+        *(uint64_t*)((char*) buf.get() + (size_t) i * PAGE_SIZE +
+                     TagOffset) = (uint64_t) run2 + i;
+    }
+    ASSERT_NO_ERROR(f->WriteNewPages(run2, (char*) buf.get(), RunSize / 2));
+    ASSERT_NO_ERROR(f->AppendNewPages({{run1, RunSize},
+                                       {run2, RunSize / 2}}));
+    ASSERT_NO_ERROR(f->FreeNewPages(run2 + RunSize / 2,
+                                    RunSize - RunSize / 2));
+
+    std::vector<PageNumber> expected;
+    expected.push_back(first_pid);
+    for (PageNumber i = 0; i < RunSize; ++i) {
+        expected.push_back(run1 + i);
+    }
+    for (PageNumber i = 0; i < RunSize / 2; ++i) {
+        expected.push_back(run2 + i);
+    }
+    ASSERT_EQ(GetPages(f.get()), expected);
+    for (size_t i = 1; i < expected.size(); ++i) {
+        EXPECT_EQ(GetTag(expected[i]), (uint64_t) expected[i]);
+    }
+
+    // The freed new pages are reused without extending the data files.
+    npages = g_fileman->GetNumPages();
+    for (PageNumber i = RunSize / 2; i < RunSize; ++i) {
+        PageNumber pid = f->AllocatePage();
+        EXPECT_GE(pid, run2 + RunSize / 2);
+        EXPECT_LT(pid, run2 + RunSize);
+        EXPECT_EQ(GetTag(pid), 0u);
+    }
+    EXPECT_EQ(g_fileman->GetNumPages(), npages);
+    EXPECT_EQ(f->AllocatePage(), npages);
+
+    // Both segments are found again after a restart.
+    FileId fid = f->GetFileId();
+    f->Close();
+    Reopen();
+    f = g_fileman->Open(fid);
+    ASSERT_NE(f.get(), nullptr);
+    std::vector<PageNumber> pids = GetPages(f.get());
+    ASSERT_EQ(pids.size(), expected.size() + RunSize / 2 + 1);
+    for (size_t i = 1; i < expected.size(); ++i) {
+        EXPECT_EQ(pids[i], expected[i]);
+        EXPECT_EQ(GetTag(pids[i]), (uint64_t) expected[i]);
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestFileManager, TestPersistence) {
+    TDB_TEST_BEGIN
+
+    // Enough files for more than one file directory page.
+    constexpr size_t NumDirEntries =
+        (PAGE_SIZE - sizeof(PageHeaderData)) / sizeof(PageNumber);
+    constexpr size_t NumFiles = NumDirEntries + 16;
+    std::vector<FileId> fids;
+    std::vector<std::vector<PageNumber>> file_pids;
+    for (size_t i = 0; i < NumFiles; ++i) {
+        std::unique_ptr<File> f = g_fileman->Open(NEW_REGULAR_FID);
+        ASSERT_NE(f.get(), nullptr);
+        fids.push_back(f->GetFileId());
+        file_pids.emplace_back(1, f->GetFirstPageNumber());
+        if (i % 64 == 0) {
+            for (size_t j = 0; j < 8; ++j) {
+                file_pids.back().push_back(f->AllocatePage());
+            }
+        }
+        for (PageNumber pid : file_pids.back()) {
+            SetTag(pid, ((uint64_t) fids.back() << 32) | pid);
+        }
+    }
+
+    // Leave a freed page on the free list and remove a file.
+    {
+        std::unique_ptr<File> f = g_fileman->Open(fids[0]);
+        ASSERT_NO_ERROR(f->FreePage(file_pids[0][4]));
+        file_pids[0].erase(file_pids[0].begin() + 4);
+    }
+    ASSERT_NO_ERROR(g_fileman->RemoveFile(fids[1]));
+    PageNumber npages = g_fileman->GetNumPages();
+
+    Reopen();
+    EXPECT_EQ(g_fileman->GetNumPages(), npages);
+    EXPECT_EQ(g_fileman->Open(fids[1]).get(), nullptr);
+    for (size_t i = 0; i < NumFiles; ++i) {
+        if (i == 1)
+            continue;
+        std::unique_ptr<File> f = g_fileman->Open(fids[i]);
+        ASSERT_NE(f.get(), nullptr) << "file " << fids[i] << " is gone";
+        ASSERT_EQ(GetPages(f.get()), file_pids[i]);
+        for (PageNumber pid : file_pids[i]) {
+            EXPECT_EQ(GetTag(pid), ((uint64_t) fids[i] << 32) | pid);
+        }
+    }
+
+    // The free list and the next file ID survive the restart too: a new
+    // file gets a fresh file ID and reuses the three freed pages.
+    std::unique_ptr<File> f = g_fileman->Open(NEW_REGULAR_FID);
+    ASSERT_NE(f.get(), nullptr);
+    EXPECT_GT(f->GetFileId(), fids.back());
+    f->AllocatePage();
+    EXPECT_EQ(g_fileman->GetNumPages(), npages);
+
+    TDB_TEST_END
+}
+
+}   // namespace taco
@@ -0,0 +1,175 @@
+// Basic tests for FixedlenDataPage
+#include "base/TDBNonDBTest.h"
+
+#include <random>
+
+#include "storage/FixedlenDataPage.h"
+#include "storage/VarlenDataPage.h"
+
+namespace taco {
+
+class BasicTestFixedlenDataPage: public TDBNonDBTest {
+protected:
+    void
+    SetUp() override {
+        TDBNonDBTest::SetUp();
+        m_page_mem = unique_aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+        m_page = (char*) m_page_mem.get();
+        memset(m_page, 0, PAGE_SIZE);
+    }
+
+    static void
+    FillRecord(std::vector<char> &rec, uint64_t key) {
+        for (size_t i = 0; i < rec.size(); ++i) {
+            rec[i] = (char)(key * 131 + i);
+        }
+    }
+
+    static void
+    CheckRecord(const FixedlenDataPage &dp, SlotId sid, uint64_t key) {
+        std::vector<char> rec(dp.GetRecordLength());
+        FillRecord(rec, key);
+        FieldOffset reclen;
+        const char *buf = dp.GetRecordBuf(sid, &reclen);
+        ASSERT_NE(buf, nullptr);
+        ASSERT_EQ((uintptr_t) buf % MAXALIGN_OF, 0u);
+        ASSERT_EQ(reclen, dp.GetRecordLength());
+        ASSERT_EQ(memcmp(buf, rec.data(), reclen), 0);
+    }
+
+    unique_malloced_ptr m_page_mem;
+    char *m_page;
+};
+
+TEST_F(BasicTestFixedlenDataPage, TestCapacity) {
+    TDB_TEST_BEGIN
+
+    for (FieldOffset reclen = 8; reclen <= 512; reclen += 8) {
+        SlotId n = FixedlenDataPage::ComputeCapacity(reclen);
+        ASSERT_GT(n, 0);
+        FixedlenDataPage::Initialize(m_page, reclen);
+        FixedlenDataPage dp(m_page);
+        ASSERT_EQ(dp.GetMaxSlotId(), n);
+        std::vector<char> rec(reclen);
+        for (SlotId i = 0; i < n; ++i) {
+            FillRecord(rec, i);
+            Record r(rec.data(), reclen);
+            ASSERT_TRUE(dp.InsertRecord(r));
+            ASSERT_EQ(r.GetRecordId().sid, i + 1);
+        }
+        Record r(rec.data(), reclen);
+        ASSERT_FALSE(dp.InsertRecord(r));
+        for (SlotId sid = 1; sid <= n; ++sid) {
+            CheckRecord(dp, sid, sid - 1);
+        }
+        // the records do not overlap with the bitmap or the end of the page
+        ASSERT_LE(dp.GetRecordBuf(n) + reclen, m_page + PAGE_SIZE);
+
+        // denser than a slotted page
+        if (reclen <= 64) {
+            ASSERT_GT((size_t) n, (PAGE_SIZE - 64) /
+                      (reclen + sizeof(VarlenDataPageSlot)));
+        }
+    }
+
+    ASSERT_EQ(FixedlenDataPage::ComputeCapacity(PAGE_SIZE), 0);
+    ASSERT_REGULAR_ERROR(FixedlenDataPage::Initialize(m_page, PAGE_SIZE));
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestFixedlenDataPage, TestEraseAndReuse) {
+    TDB_TEST_BEGIN
+
+    const FieldOffset reclen = 16;
+    FixedlenDataPage::Initialize(m_page, reclen);
+    FixedlenDataPage dp(m_page);
+    SlotId n = dp.GetMaxSlotId();
+    ASSERT_GT(n, 128);
+    std::vector<char> rec(reclen);
+    for (SlotId i = 0; i < n; ++i) {
+        FillRecord(rec, i);
+        Record r(rec.data(), reclen);
+        ASSERT_TRUE(dp.InsertRecord(r));
+    }
+
+    // erase a random subset and scan the remaining ones
+    std::mt19937 rng(0x5678);
+    std::vector<bool> occupied(n + 1, true);
+    for (SlotId sid = 1; sid <= n; ++sid) {
+        if (rng() % 3 == 0) {
+            ASSERT_TRUE(dp.EraseRecord(sid));
+            ASSERT_FALSE(dp.EraseRecord(sid));
+            occupied[sid] = false;
+        }
+    }
+    // the last slot is free, which tests the end of the bitmap
+    if (occupied[n]) {
+        ASSERT_TRUE(dp.EraseRecord(n));
+        occupied[n] = false;
+    }
+
+    SlotId cnt = 0;
+    SlotId prev = INVALID_SID;
+    for (SlotId sid = dp.GetNextOccupiedSlot(INVALID_SID); sid != INVALID_SID;
+         sid = dp.GetNextOccupiedSlot(sid)) {
+        ASSERT_GT(sid, prev);
+        for (SlotId s = prev + 1; s < sid; ++s) {
+            ASSERT_FALSE(occupied[s]);
+            ASSERT_FALSE(dp.IsOccupied(s));
+        }
+        ASSERT_TRUE(occupied[sid]);
+        CheckRecord(dp, sid, sid - 1);
+        prev = sid;
+        ++cnt;
+    }
+    ASSERT_EQ(cnt, dp.GetRecordCount());
+
+    // insertions fill the lowest free slots first
+    std::vector<SlotId> free_sids;
+    for (SlotId sid = 1; sid <= n; ++sid) {
+        if (!occupied[sid])
+            free_sids.push_back(sid);
+    }
+    for (SlotId sid : free_sids) {
+        FillRecord(rec, sid - 1);
+        Record r(rec.data(), reclen);
+        ASSERT_TRUE(dp.InsertRecord(r));
+        ASSERT_EQ(r.GetRecordId().sid, sid);
+    }
+    ASSERT_EQ(dp.GetRecordCount(), n);
+    ASSERT_EQ(dp.ComputeFreeSpace(), 0);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestFixedlenDataPage, TestUpdate) {
+    TDB_TEST_BEGIN
+
+    const FieldOffset reclen = 24;
+    FixedlenDataPage::Initialize(m_page, reclen);
+    FixedlenDataPage dp(m_page);
+    std::vector<char> rec(reclen);
+    for (SlotId i = 0; i < 10; ++i) {
+        FillRecord(rec, i);
+        Record r(rec.data(), reclen);
+        ASSERT_TRUE(dp.InsertRecord(r));
+    }
+
+    FillRecord(rec, 100);
+    Record r(rec.data(), reclen);
+    ASSERT_TRUE(dp.UpdateRecord(5, r));
+    ASSERT_EQ(r.GetRecordId().sid, 5);
+    CheckRecord(dp, 5, 100);
+    CheckRecord(dp, 4, 3);
+    CheckRecord(dp, 6, 5);
+
+    Record short_rec(rec.data(), reclen - 8);
+    ASSERT_REGULAR_ERROR(dp.UpdateRecord(5, short_rec));
+    ASSERT_REGULAR_ERROR(dp.InsertRecord(short_rec));
+    ASSERT_REGULAR_ERROR(dp.UpdateRecord(11, r));
+
+    TDB_TEST_END
+}
+
+}   // namespace taco
@@ -0,0 +1,90 @@
+// Basic tests for FreeSpaceMap
+#include "base/TDBDBTest.h"
+
+#include "storage/BufferManager.h"
+#include "storage/FreeSpaceMap.h"
+
+namespace taco {
+
+class BasicTestFreeSpaceMap: public TDBDBTest {
+protected:
+    size_t
+    GetBufferPoolSize() override {
+        return 64;
+    }
+};
+
+TEST_F(BasicTestFreeSpaceMap, TestCategories) {
+    TDB_TEST_BEGIN
+
+    const size_t step = FreeSpaceMap::CategoryStep;
+    ASSERT_EQ(FreeSpaceMap::ComputeCategory(0), 0);
+    ASSERT_EQ(FreeSpaceMap::ComputeCategory(step - 1), 0);
+    ASSERT_EQ(FreeSpaceMap::ComputeCategory(step), 1);
+    ASSERT_EQ(FreeSpaceMap::ComputeCategory(PAGE_SIZE),
+              FreeSpaceMap::MaxCategory);
+    ASSERT_EQ(FreeSpaceMap::ComputeMinCategory(1), 1);
+    ASSERT_EQ(FreeSpaceMap::ComputeMinCategory(step), 1);
+    ASSERT_EQ(FreeSpaceMap::ComputeMinCategory(step + 1), 2);
+    ASSERT_EQ(FreeSpaceMap::ComputeMinCategory(PAGE_SIZE),
+              FreeSpaceMap::MaxCategory);
+
+    // any page in the minimum category has enough space
+    for (size_t needed = 1; needed < PAGE_SIZE - step; ++needed) {
+        uint8_t cat = FreeSpaceMap::ComputeMinCategory(needed);
+        ASSERT_GE(cat * step, needed);
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestFreeSpaceMap, TestAddSearchUpdate) {
+    TDB_TEST_BEGIN
+
+    FileId fid = FreeSpaceMap::Create();
+    std::unique_ptr<FreeSpaceMap> fsm(new FreeSpaceMap(fid));
+    ASSERT_EQ(fsm->GetNumEntries(), 0u);
+    uint32_t idx;
+    ASSERT_EQ(fsm->Search(0, 0, &idx), INVALID_PID);
+
+    // more entries than fit on two map pages
+    const uint32_t n = (uint32_t) FreeSpaceMap::EntriesPerPage * 2 + 100;
+    for (uint32_t i = 0; i < n; ++i) {
+        // fake page numbers, which the map does not interpret
+        ASSERT_EQ(fsm->AddPage(1000 + i, (uint8_t)(i % 8)), i);
+    }
+    ASSERT_EQ(fsm->GetNumEntries(), n);
+
+    // the entries are found in order from the starting entry
+    ASSERT_EQ(fsm->Search(7, 0, &idx), 1007u);
+    ASSERT_EQ(idx, 7u);
+    ASSERT_EQ(fsm->Search(7, 8, &idx), 1015u);
+    ASSERT_EQ(idx, 15u);
+    ASSERT_EQ(fsm->Search(0, n - 1, &idx), 1000 + n - 1);
+    ASSERT_EQ(fsm->Search(8, 0, &idx), INVALID_PID);
+
+    // a single entry in a high category is found from any place, wrapping
+    // around at the end
+    uint32_t special = (uint32_t) FreeSpaceMap::EntriesPerPage + 5;
+    fsm->UpdateCategory(special, FreeSpaceMap::MaxCategory);
+    ASSERT_EQ(fsm->GetCategory(special), FreeSpaceMap::MaxCategory);
+    for (uint32_t start : {0u, special, special + 1, n - 1, n + 12345}) {
+        ASSERT_EQ(fsm->Search(FreeSpaceMap::MaxCategory, start, &idx),
+                  1000 + special);
+        ASSERT_EQ(idx, special);
+    }
+    fsm->UpdateCategory(special, 0);
+    ASSERT_EQ(fsm->Search(FreeSpaceMap::MaxCategory, 0, &idx), INVALID_PID);
+    ASSERT_EQ(fsm->GetCategory(special - 1), (special - 1) % 8);
+
+    // the map persists in its file
+    fsm.reset(new FreeSpaceMap(fid));
+    ASSERT_EQ(fsm->GetNumEntries(), n);
+    for (uint32_t i = 0; i < n; i += 97) {
+        ASSERT_EQ(fsm->GetCategory(i), (i == special) ? 0 : i % 8);
+    }
+
+    TDB_TEST_END
+}
+
+}   // namespace taco
@@ -0,0 +1,251 @@
+// Basic tests for PaxDataPage
+#include "base/TDBDBTest.h"
+
+#include <random>
+
+#include <absl/strings/str_format.h>
+
+#include "catalog/systables.h"
+#include "storage/PaxDataPage.h"
+
+namespace taco {
+
+class BasicTestPaxDataPage: public TDBDBTest {
+protected:
+    void
+    SetUp() override {
+        TDBDBTest::SetUp();
+        m_page_mem = unique_aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+        m_page = (char*) m_page_mem.get();
+        memset(m_page, 0, PAGE_SIZE);
+
+        // (INT4 not null, VARCHAR(200), INT8)
+        m_schema.reset(Schema::Create(
+            {initoids::TYP_INT4, initoids::TYP_VARCHAR, initoids::TYP_INT8},
+            {0, 200, 0}, {false, true, true}));
+        m_schema->ComputeLayout();
+    }
+
+    void
+    TearDown() override {
+        m_schema.reset();
+        TDBDBTest::TearDown();
+    }
+
+    //! the string field of the record with key \p key
+    static std::string
+    MakeString(int32_t key, size_t len) {
+        return absl::StrFormat("%0*d", (int) len, key);
+    }
+
+    /*!
+     * Returns the payload of the record with key \p key, whose string is of
+     * length \p len and whose fields are null if \p key is a multiple of 7.
+     */
+    maxaligned_char_buf
+    MakePayload(int32_t key, size_t len) {
+        std::string str = MakeString(key, len);
+        std::vector<Datum> data;
+        data.emplace_back(Datum::From(key));
+        if (key % 7 == 0) {
+            data.emplace_back(Datum::FromNull());
+            data.emplace_back(Datum::FromNull());
+        } else {
+            data.emplace_back(Datum::FromCString(str.c_str()));
+            data.emplace_back(Datum::From((int64_t) key * 5));
+        }
+        maxaligned_char_buf buf;
+        m_schema->WritePayloadToBuffer(data, buf);
+        return buf;
+    }
+
+    void
+    CheckRecord(const PaxDataPage &dp, SlotId sid, int32_t key, size_t len) {
+        ASSERT_TRUE(dp.IsOccupied(sid));
+        ASSERT_EQ(dp.GetField(sid, 0).GetInt32(), key);
+        maxaligned_char_buf buf;
+        ASSERT_TRUE(dp.GetRecord(sid, buf));
+        ASSERT_EQ(m_schema->GetField(0, buf.data()).GetInt32(), key);
+        if (key % 7 == 0) {
+            ASSERT_TRUE(dp.FieldIsNull(sid, 1));
+            ASSERT_TRUE(dp.FieldIsNull(sid, 2));
+            ASSERT_TRUE(dp.GetField(sid, 1).isnull());
+            ASSERT_TRUE(m_schema->FieldIsNull(1, buf.data()));
+            ASSERT_TRUE(m_schema->FieldIsNull(2, buf.data()));
+        } else {
+            std::string str = MakeString(key, len);
+            ASSERT_FALSE(dp.FieldIsNull(sid, 1));
+            ASSERT_EQ(dp.GetField(sid, 1).GetVarlenAsStringView(), str);
+            ASSERT_EQ(dp.GetField(sid, 2).GetInt64(), (int64_t) key * 5);
+            ASSERT_EQ(m_schema->GetField(1, buf.data())
+                        .GetVarlenAsStringView(), str);
+            ASSERT_EQ(m_schema->GetField(2, buf.data()).GetInt64(),
+                      (int64_t) key * 5);
+        }
+    }
+
+    unique_malloced_ptr m_page_mem;
+    char *m_page;
+    std::unique_ptr<Schema> m_schema;
+};
+
+TEST_F(BasicTestPaxDataPage, TestInsertUntilFull) {
+    TDB_TEST_BEGIN
+
+    SlotId n = PaxDataPage::ComputeCapacity(m_schema.get());
+    ASSERT_GT(n, 0);
+    PaxDataPage::Initialize(m_page, m_schema.get());
+    PaxDataPage dp(m_page, m_schema.get());
+    ASSERT_EQ(dp.GetMaxSlotId(), n);
+    ASSERT_EQ(dp.GetRecordCount(), 0);
+
+    // short strings fill up all the slots
+    for (int32_t i = 0; i < (int32_t) n; ++i) {
+        maxaligned_char_buf buf = MakePayload(i, 4);
+        Record rec(buf);
+        ASSERT_TRUE(dp.InsertRecord(rec));
+        ASSERT_EQ(rec.GetRecordId().sid, i + 1);
+    }
+    maxaligned_char_buf buf = MakePayload(1, 4);
+    Record rec(buf);
+    ASSERT_FALSE(dp.InsertRecord(rec));
+    ASSERT_EQ(dp.ComputeFreeSpace(), 0);
+    for (SlotId sid = 1; sid <= n; ++sid) {
+        CheckRecord(dp, sid, sid - 1, 4);
+    }
+
+    // the fixed-length column is a dense array
+    const int32_t *col = (const int32_t*) dp.GetFixedlenColumn(0);
+    for (SlotId i = 0; i < n; ++i) {
+        ASSERT_EQ(col[i], (int32_t) i);
+    }
+
+    // Long strings fill up the heap before the slots, and the free space
+    // tells exactly whether the next one fits.
+    memset(m_page, 0, PAGE_SIZE);
+    PaxDataPage::Initialize(m_page, m_schema.get());
+    int32_t cnt = 0;
+    for (;;) {
+        maxaligned_char_buf buf = MakePayload(cnt + 1, 200);
+        Record rec(buf);
+        bool fits = PaxDataPage::ComputeSpaceNeeded(m_schema.get(),
+                                                    buf.data()) <=
+                    (size_t) dp.ComputeFreeSpace();
+        bool inserted = dp.InsertRecord(rec);
+        ASSERT_EQ(inserted, fits);
+        if (!inserted)
+            break;
+        ++cnt;
+    }
+    ASSERT_GT(cnt, 0);
+    ASSERT_LT(cnt, (int32_t) n);
+    for (int32_t i = 0; i < cnt; ++i) {
+        CheckRecord(dp, i + 1, i + 1, 200);
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestPaxDataPage, TestEraseAndCompact) {
+    TDB_TEST_BEGIN
+
+    PaxDataPage::Initialize(m_page, m_schema.get());
+    PaxDataPage dp(m_page, m_schema.get());
+    std::vector<size_t> lens;
+    for (int32_t i = 0;; ++i) {
+        size_t len = 20 + i % 50;
+        maxaligned_char_buf buf = MakePayload(i, len);
+        Record rec(buf);
+        if (!dp.InsertRecord(rec))
+            break;
+        lens.push_back(len);
+    }
+    SlotId n = (SlotId) lens.size();
+    ASSERT_GT(n, 8);
+
+    std::mt19937 rng(0x1357);
+    std::vector<bool> occupied(n + 1, true);
+    for (SlotId sid = 1; sid <= n; ++sid) {
+        if (rng() % 2 == 0) {
+            ASSERT_TRUE(dp.EraseRecord(sid));
+            ASSERT_FALSE(dp.EraseRecord(sid));
+            occupied[sid] = false;
+        }
+    }
+
+    SlotId cnt = 0;
+    for (SlotId sid = dp.GetNextOccupiedSlot(INVALID_SID); sid != INVALID_SID;
+         sid = dp.GetNextOccupiedSlot(sid)) {
+        ASSERT_TRUE(occupied[sid]);
+        CheckRecord(dp, sid, sid - 1, lens[sid - 1]);
+        ++cnt;
+    }
+    ASSERT_EQ(cnt, dp.GetRecordCount());
+
+    // the new records need the space of the erased values
+    for (SlotId sid = 1; sid <= n; ++sid) {
+        if (occupied[sid])
+            continue;
+        maxaligned_char_buf buf = MakePayload(sid - 1, lens[sid - 1]);
+        Record rec(buf);
+        ASSERT_LE(PaxDataPage::ComputeSpaceNeeded(m_schema.get(), buf.data()),
+                  (size_t) dp.ComputeFreeSpace());
+        ASSERT_TRUE(dp.InsertRecord(rec));
+        ASSERT_EQ(rec.GetRecordId().sid, sid);
+    }
+    for (SlotId sid = 1; sid <= n; ++sid) {
+        CheckRecord(dp, sid, sid - 1, lens[sid - 1]);
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestPaxDataPage, TestUpdate) {
+    TDB_TEST_BEGIN
+
+    PaxDataPage::Initialize(m_page, m_schema.get());
+    PaxDataPage dp(m_page, m_schema.get());
+    SlotId n = 0;
+    for (int32_t i = 1;; ++i) {
+        maxaligned_char_buf buf = MakePayload(i, 60);
+        Record rec(buf);
+        if (!dp.InsertRecord(rec))
+            break;
+        ++n;
+    }
+    ASSERT_GT(n, 2);
+
+    // shrinking the strings always succeeds
+    for (SlotId sid = 1; sid <= n; ++sid) {
+        maxaligned_char_buf buf = MakePayload(sid + 1000, 10);
+        Record rec(buf);
+        ASSERT_TRUE(dp.UpdateRecord(sid, rec));
+        ASSERT_EQ(rec.GetRecordId().sid, sid);
+    }
+
+    // growing one string reuses the freed space
+    maxaligned_char_buf buf = MakePayload(1001, 150);
+    Record rec(buf);
+    ASSERT_TRUE(dp.UpdateRecord(1, rec));
+    CheckRecord(dp, 1, 1001, 150);
+    for (SlotId sid = 2; sid <= n; ++sid) {
+        CheckRecord(dp, sid, sid + 1000, 10);
+    }
+
+    // a failed update leaves the page unchanged
+    for (SlotId sid = 2; sid <= n; ++sid) {
+        maxaligned_char_buf buf = MakePayload(sid + 2000, 200);
+        Record rec(buf);
+        if (!dp.UpdateRecord(sid, rec)) {
+            CheckRecord(dp, sid, sid + 1000, 10);
+            break;
+        }
+        CheckRecord(dp, sid, sid + 2000, 200);
+        ASSERT_LT(sid, n);
+    }
+    CheckRecord(dp, 1, 1001, 150);
+
+    TDB_TEST_END
+}
+
+}   // namespace taco
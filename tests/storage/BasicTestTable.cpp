@@ -0,0 +1,1156 @@
+// Basic tests for Table
+#include "base/TDBDBTest.h"
+
+#include <chrono>
+#include <thread>
+
+#include <absl/container/flat_hash_map.h>
+#include <absl/container/flat_hash_set.h>
+#include <absl/strings/str_format.h>
+
+#include "catalog/CatCache.h"
+#include "catalog/systables.h"
+#include "storage/FileManager.h"
+#include "storage/Table.h"
+#include "storage/ZoneMap.h"
+
+namespace taco {
+
+class BasicTestTable: public TDBDBTest {
+protected:
+    size_t
+    GetBufferPoolSize() override {
+        return 64;
+    }
+
+    void
+    SetUp() override {
+        TDBDBTest::SetUp();
+        g_db->CreateTable("test_table",
+                          {initoids::TYP_INT4, initoids::TYP_VARCHAR},
+                          {0, 400});
+        Oid tabid = g_catcache->FindTableByName("test_table");
+        ASSERT_NE(tabid, InvalidOid);
+        m_tabdesc = g_catcache->FindTableDesc(tabid);
+        ASSERT_NE(m_tabdesc.get(), nullptr);
+    }
+
+    void
+    TearDown() override {
+        m_tabdesc.reset();
+        TDBDBTest::TearDown();
+    }
+
+    //! the string field of the record with key \p key
+    static std::string
+    MakeString(int32_t key, size_t len) {
+        return absl::StrFormat("%0*d", (int) len, key);
+    }
+
+    maxaligned_char_buf
+    MakePayload(int32_t key, const std::string &str) {
+        std::vector<Datum> data;
+        data.emplace_back(Datum::From(key));
+        data.emplace_back(Datum::FromCString(str.c_str()));
+        maxaligned_char_buf buf;
+        m_tabdesc->GetSchema()->WritePayloadToBuffer(data, buf);
+        return buf;
+    }
+
+    /*!
+     * Inserts a record `(key, MakeString(key, len))' into \p table and
+     * returns its record ID.
+     */
+    RecordId
+    InsertRecord(Table *table, int32_t key, size_t len) {
+        maxaligned_char_buf buf = MakePayload(key, MakeString(key, len));
+        Record rec(buf);
+        table->InsertRecord(rec);
+        return rec.GetRecordId();
+    }
+
+    /*!
+     * Scans \p table and returns the string field of each record by key,
+     * checking that the records are returned in the record ID order unless
+     * \p check_order is false, e.g., if a vacuum may have freed pages that
+     * were reused at the end of the file.
+     */
+    absl::flat_hash_map<int32_t, std::string>
+    ScanTable(Table *table, bool check_order = true) {
+        absl::flat_hash_map<int32_t, std::string> res;
+        Table::Iterator iter = table->StartScan();
+        RecordId prev_rid;
+        prev_rid.SetInvalid();
+        while (iter.Next()) {
+            const Record &rec = iter.GetCurrentRecord();
+            EXPECT_TRUE(rec.IsValid());
+            EXPECT_TRUE(!check_order || !prev_rid.IsValid() ||
+                        prev_rid < rec.GetRecordId());
+            prev_rid = rec.GetRecordId();
+            const Schema *sch = m_tabdesc->GetSchema();
+            int32_t key = sch->GetField(0, rec.GetData()).GetInt32();
+            absl::string_view str =
+                sch->GetField(1, rec.GetData()).GetVarlenAsStringView();
+            EXPECT_TRUE(res.emplace(key, std::string(str)).second);
+        }
+        EXPECT_FALSE(iter.IsAtValidRecord());
+        EXPECT_FALSE(iter.Next());
+        return res;
+    }
+
+    //! Same as ScanTable() but reads the fields with Iterator::GetField().
+    absl::flat_hash_map<int32_t, std::string>
+    ScanFields(Table *table) {
+        absl::flat_hash_map<int32_t, std::string> res;
+        Table::Iterator iter = table->StartScan();
+        while (iter.Next()) {
+            EXPECT_TRUE(iter.IsAtValidRecord());
+            int32_t key = iter.GetField(0).GetInt32();
+            absl::string_view str = iter.GetField(1).GetVarlenAsStringView();
+            EXPECT_TRUE(res.emplace(key, std::string(str)).second);
+        }
+        EXPECT_FALSE(iter.IsAtValidRecord());
+        return res;
+    }
+
+    std::shared_ptr<const TableDesc> m_tabdesc;
+};
+
+TEST_F(BasicTestTable, TestInsertAndScan) {
+    TDB_TEST_BEGIN
+
+    std::unique_ptr<Table> table = Table::Create(m_tabdesc);
+    ASSERT_TRUE(ScanTable(table.get()).empty());
+
+    // enough records to span many more pages than the buffer pool size
+    const int32_t n = 20000;
+    absl::flat_hash_map<int32_t, std::string> expected;
+    for (int32_t i = 0; i < n; ++i) {
+        size_t len = 1 + i % 97;
+        RecordId rid = InsertRecord(table.get(), i, len);
+        ASSERT_TRUE(rid.IsValid());
+        expected.emplace(i, MakeString(i, len));
+    }
+    ASSERT_EQ(ScanTable(table.get()), expected);
+
+    // a new handle sees the same records
+    table = Table::Create(m_tabdesc);
+    ASSERT_EQ(ScanTable(table.get()), expected);
+    ASSERT_EQ(ScanFields(table.get()), expected);
+
+    // A record that does not fit on a page is inserted with its long value
+    // moved out of line.
+    maxaligned_char_buf buf = MakePayload(0, std::string(PAGE_SIZE, 'x'));
+    Record rec(buf);
+    ASSERT_NO_ERROR(table->InsertRecord(rec));
+    {
+        Table::Iterator iter = table->StartScanFrom(rec.GetRecordId());
+        ASSERT_TRUE(iter.Next());
+        ASSERT_EQ(table->GetField(1, iter.GetCurrentRecord().GetData())
+                    .GetVarlenAsStringView(),
+                  std::string(PAGE_SIZE, 'x'));
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestTable, TestEraseAndUpdate) {
+    TDB_TEST_BEGIN
+
+    std::unique_ptr<Table> table = Table::Create(m_tabdesc);
+    const int32_t n = 5000;
+    std::vector<RecordId> rids;
+    absl::flat_hash_map<int32_t, std::string> expected;
+    for (int32_t i = 0; i < n; ++i) {
+        rids.push_back(InsertRecord(table.get(), i, 10));
+        expected.emplace(i, MakeString(i, 10));
+    }
+
+    for (int32_t i = 0; i < n; i += 3) {
+        table->EraseRecord(rids[i]);
+        expected.erase(i);
+    }
+    EXPECT_REGULAR_ERROR(table->EraseRecord(rids[0]));
+    ASSERT_EQ(ScanTable(table.get()), expected);
+
+    // Grow some of the records so that not all of them fit on the same
+    // page, and shrink the others.
+    for (int32_t i = 1; i < n; i += 3) {
+        size_t len = (i % 2) ? 300 : 2;
+        std::string str = MakeString(i, len);
+        maxaligned_char_buf buf = MakePayload(i, str);
+        Record rec(buf);
+        table->UpdateRecord(rids[i], rec);
+        ASSERT_TRUE(rec.GetRecordId().IsValid());
+        if (len < 10) {
+            ASSERT_EQ(rec.GetRecordId(), rids[i]);
+        }
+        rids[i] = rec.GetRecordId();
+        expected[i] = str;
+    }
+    ASSERT_EQ(ScanTable(table.get()), expected);
+
+    // the inserts reuse the free space
+    for (int32_t i = n; i < n + 100; ++i) {
+        InsertRecord(table.get(), i, 10);
+        expected.emplace(i, MakeString(i, 10));
+    }
+    ASSERT_EQ(ScanTable(table.get()), expected);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestTable, TestScanFrom) {
+    TDB_TEST_BEGIN
+
+    std::unique_ptr<Table> table = Table::Create(m_tabdesc);
+    const int32_t n = 2000;
+    std::vector<RecordId> rids;
+    for (int32_t i = 0; i < n; ++i) {
+        rids.push_back(InsertRecord(table.get(), i, 50));
+    }
+
+    for (int32_t start : {0, 1, 777, n - 1}) {
+        Table::Iterator iter = table->StartScanFrom(rids[start]);
+        int32_t i = start;
+        while (iter.Next()) {
+            ASSERT_LT(i, n);
+            ASSERT_EQ(iter.GetCurrentRecordId(), rids[i]);
+            ++i;
+        }
+        ASSERT_EQ(i, n);
+    }
+
+    // ending a scan early releases the pin
+    Table::Iterator iter = table->StartScan();
+    ASSERT_TRUE(iter.Next());
+    iter.EndScan();
+    ASSERT_FALSE(iter.IsAtValidRecord());
+    ASSERT_FALSE(iter.Next());
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestTable, TestConcurrentInserts) {
+    TDB_TEST_BEGIN
+
+    std::unique_ptr<Table> table = Table::Create(m_tabdesc);
+    const int32_t nthreads = 4;
+    const int32_t n = 5000;
+    std::vector<std::thread> threads;
+    std::vector<std::string> errors(nthreads);
+    for (int32_t t = 0; t < nthreads; ++t) {
+        threads.emplace_back([&, t]() {
+            try {
+                for (int32_t i = t * n; i < (t + 1) * n; ++i) {
+                    InsertRecord(table.get(), i, 40);
+                }
+            } catch (const TDBError &e) {
+                errors[t] = e.GetMessage();
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (const std::string &error : errors) {
+        ASSERT_EQ(error, "");
+    }
+
+    absl::flat_hash_map<int32_t, std::string> expected;
+    for (int32_t i = 0; i < n * nthreads; ++i) {
+        expected.emplace(i, MakeString(i, 40));
+    }
+    ASSERT_EQ(ScanTable(table.get()), expected);
+
+    // The pages are mostly full: each record takes 56 bytes plus a slot.
+    std::unique_ptr<File> f =
+        g_fileman->Open(m_tabdesc->GetTableEntry()->tabfid());
+    size_t min_npages = n * nthreads * 60 / PAGE_SIZE;
+    ASSERT_LE(f->GetNumPages(), min_npages * 11 / 10 + nthreads);
+
+    // The erased space is reused by later insertions rather than new
+    // pages.
+    Table::Iterator iter = table->StartScan();
+    std::vector<RecordId> rids;
+    while (iter.Next()) {
+        rids.push_back(iter.GetCurrentRecordId());
+    }
+    iter.EndScan();
+    for (size_t i = 0; i < rids.size(); i += 2) {
+        table->EraseRecord(rids[i]);
+    }
+    PageNumber npages = f->GetNumPages();
+    for (int32_t i = 0; i < n; ++i) {
+        InsertRecord(table.get(), n * nthreads + i, 40);
+    }
+    ASSERT_EQ(f->GetNumPages(), npages);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestTable, TestParallelScan) {
+    TDB_TEST_BEGIN
+
+    std::unique_ptr<Table> table = Table::Create(m_tabdesc);
+    absl::flat_hash_map<int32_t, std::string> expected;
+    const int32_t n = 20000;
+    for (int32_t i = 0; i < n; ++i) {
+        size_t len = 1 + i % 97;
+        InsertRecord(table.get(), i, len);
+        expected.emplace(i, MakeString(i, len));
+    }
+
+    // an aborted bulk load leaves removed entries in the free-space map
+    std::unique_ptr<Table::BulkLoader> loader = table->StartBulkLoad(4);
+    for (int32_t i = 0; i < 1000; ++i) {
+        maxaligned_char_buf buf = MakePayload(i, MakeString(i, 100));
+        loader->InsertRecord(Record(buf));
+    }
+    loader.reset();
+    for (int32_t i = n; i < n + 2000; ++i) {
+        InsertRecord(table.get(), i, 100);
+        expected.emplace(i, MakeString(i, 100));
+    }
+
+    for (uint32_t morsel_npages : {1u, 3u, 64u}) {
+        const size_t nthreads = 4;
+        std::unique_ptr<Table::ParallelScan> scan =
+            table->StartParallelScan(morsel_npages);
+        std::vector<std::vector<std::pair<int32_t, std::string>>>
+            results(nthreads);
+        std::vector<std::string> errors(nthreads);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < nthreads; ++t) {
+            threads.emplace_back([&, t]() {
+                try {
+                    const Schema *sch = m_tabdesc->GetSchema();
+                    Table::Iterator iter;
+                    while (scan->NextMorsel(&iter)) {
+                        while (iter.Next()) {
+                            const char *payload =
+                                iter.GetCurrentRecord().GetData();
+                            results[t].emplace_back(
+                                sch->GetField(0, payload).GetInt32(),
+                                std::string(sch->GetField(1, payload)
+                                            .GetVarlenAsStringView()));
+                        }
+                    }
+                } catch (const TDBError &e) {
+                    errors[t] = e.GetMessage();
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        for (const std::string &error : errors) {
+            ASSERT_EQ(error, "");
+        }
+
+        absl::flat_hash_map<int32_t, std::string> res;
+        for (auto &result : results) {
+            for (auto &p : result) {
+                ASSERT_TRUE(res.emplace(p.first, std::move(p.second)).second);
+            }
+        }
+        ASSERT_EQ(res, expected);
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestTable, TestBulkLoad) {
+    TDB_TEST_BEGIN
+
+    std::unique_ptr<Table> table = Table::Create(m_tabdesc);
+    absl::flat_hash_map<int32_t, std::string> expected;
+    InsertRecord(table.get(), -1, 10);
+    expected.emplace(-1, MakeString(-1, 10));
+
+    // An aborted load leaves the table unchanged and frees its pages.
+    std::unique_ptr<File> f =
+        g_fileman->Open(m_tabdesc->GetTableEntry()->tabfid());
+    PageNumber npages = f->GetNumPages();
+    std::unique_ptr<Table::BulkLoader> loader = table->StartBulkLoad(4);
+    for (int32_t i = 0; i < 1000; ++i) {
+        std::vector<Datum> data;
+        data.emplace_back(Datum::From(i));
+        data.emplace_back(Datum::FromCString(MakeString(i, 100).c_str()));
+        loader->Insert(data);
+    }
+    loader.reset();
+    ASSERT_EQ(f->GetNumPages(), npages);
+    ASSERT_EQ(ScanTable(table.get()), expected);
+
+    // The buffer is flushed many times, so the pages are in many runs.
+    const int32_t n = 20000;
+    loader = table->StartBulkLoad(4);
+    for (int32_t i = 0; i < n; ++i) {
+        size_t len = 1 + i % 97;
+        std::string str = MakeString(i, len);
+        if (i % 2 == 0) {
+            std::vector<Datum> data;
+            data.emplace_back(Datum::From(i));
+            data.emplace_back(Datum::FromCString(str.c_str()));
+            loader->Insert(data);
+        } else {
+            maxaligned_char_buf buf = MakePayload(i, str);
+            loader->InsertRecord(Record(buf));
+        }
+        expected.emplace(i, std::move(str));
+    }
+    loader->Finish();
+    loader.reset();
+    ASSERT_GT(f->GetNumPages(), npages + 4);
+    ASSERT_EQ(ScanTable(table.get()), expected);
+
+    // The loaded pages are in the free-space map: the erased space is
+    // reused by later insertions rather than new pages.
+    Table::Iterator iter = table->StartScan();
+    std::vector<std::pair<RecordId, int32_t>> recs;
+    while (iter.Next()) {
+        int32_t key = m_tabdesc->GetSchema()->GetField(
+            0, iter.GetCurrentRecord().GetData()).GetInt32();
+        recs.emplace_back(iter.GetCurrentRecordId(), key);
+    }
+    iter.EndScan();
+    for (size_t i = 0; i < recs.size(); i += 2) {
+        table->EraseRecord(recs[i].first);
+        expected.erase(recs[i].second);
+    }
+    npages = f->GetNumPages();
+    for (int32_t i = n; i < n + 5000; ++i) {
+        InsertRecord(table.get(), i, 40);
+        expected.emplace(i, MakeString(i, 40));
+    }
+    ASSERT_EQ(f->GetNumPages(), npages);
+
+    // a new handle sees the same records
+    table = Table::Create(m_tabdesc);
+    ASSERT_EQ(ScanTable(table.get()), expected);
+
+    // a record that does not fit on a page
+    loader = table->StartBulkLoad();
+    maxaligned_char_buf buf = MakePayload(0, std::string(PAGE_SIZE, 'x'));
+    EXPECT_REGULAR_ERROR(loader->InsertRecord(Record(buf)));
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestTable, TestBulkLoadBatch) {
+    TDB_TEST_BEGIN
+
+    std::unique_ptr<Table> table = Table::Create(m_tabdesc);
+    absl::flat_hash_map<int32_t, std::string> expected;
+    BatchPayloadEncoder encoder(m_tabdesc->GetSchema());
+    std::unique_ptr<Table::BulkLoader> loader = table->StartBulkLoad(4);
+    const uint32_t nrows = 500;
+    for (int32_t first_key = 0; first_key < 10000; first_key += nrows) {
+        std::vector<int32_t> keys;
+        std::string strs;
+        std::vector<uint32_t> ends;
+        for (int32_t key = first_key; key < first_key + (int32_t) nrows;
+                ++key) {
+            std::string str = MakeString(key, 1 + key % 97);
+            keys.push_back(key);
+            strs += str;
+            ends.push_back(strs.size());
+            expected.emplace(key, std::move(str));
+        }
+        BatchColumn columns[2] = {
+            {(const char*) keys.data(), nullptr, nullptr},
+            {strs.data(), ends.data(), nullptr}
+        };
+        encoder.Clear();
+        encoder.Append(columns, nrows);
+        loader->InsertBatch(encoder);
+    }
+    loader->Finish();
+    loader.reset();
+    ASSERT_EQ(ScanTable(table.get()), expected);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestTable, TestBatchScan) {
+    TDB_TEST_BEGIN
+
+    g_db->CreateTable("pax_table",
+                      {initoids::TYP_INT4, initoids::TYP_VARCHAR},
+                      {0, 400}, {}, {}, {}, TABLAYOUT_PAX);
+    Oid tabid = g_catcache->FindTableByName("pax_table");
+    ASSERT_NE(tabid, InvalidOid);
+    std::shared_ptr<const TableDesc> pax_tabdesc =
+        g_catcache->FindTableDesc(tabid);
+
+    // The helpers use the schema of m_tabdesc, which is the same.
+    const Schema *sch = m_tabdesc->GetSchema();
+    for (const auto &tabdesc : {m_tabdesc, pax_tabdesc}) {
+        std::unique_ptr<Table> table = Table::Create(tabdesc);
+        Table::RecordBatch batch(100);
+        Table::Iterator iter = table->StartScan();
+        ASSERT_EQ(iter.NextBatch(&batch), 0u);
+
+        const int32_t n = 5000;
+        std::vector<RecordId> rids;
+        for (int32_t i = 0; i < n; ++i) {
+            rids.push_back(InsertRecord(table.get(), i, 1 + i % 50));
+        }
+        for (int32_t i = 0; i < n; i += 3) {
+            table->EraseRecord(rids[i]);
+        }
+
+        // All the records in a batch stay valid, while the batches span
+        // many pages.
+        iter = table->StartScan();
+        int32_t i = 1;
+        size_t nrecs;
+        while ((nrecs = iter.NextBatch(&batch)) > 0) {
+            ASSERT_EQ(batch.GetNumRecords(), nrecs);
+            ASSERT_LE(nrecs, batch.GetCapacity());
+            for (size_t j = 0; j < nrecs; ++j) {
+                ASSERT_LT(i, n);
+                const Record &rec = batch.GetRecord(j);
+                ASSERT_EQ(rec.GetRecordId(), rids[i]);
+                ASSERT_EQ(sch->GetField(0, rec.GetData()).GetInt32(), i);
+                ASSERT_EQ(sch->GetField(1, rec.GetData())
+                            .GetVarlenAsStringView(),
+                          MakeString(i, 1 + i % 50));
+                i += (i % 3 == 1) ? 1 : 2;
+            }
+            ASSERT_FALSE(iter.IsAtValidRecord());
+        }
+        ASSERT_EQ(i, n);
+        ASSERT_EQ(batch.GetNumRecords(), 0u);
+        ASSERT_FALSE(iter.Next());
+
+        // Next() continues after the last record of a batch.
+        iter = table->StartScan();
+        ASSERT_EQ(iter.NextBatch(&batch), 100u);
+        ASSERT_TRUE(iter.Next());
+        ASSERT_EQ(iter.GetCurrentRecordId(), rids[151]);
+        ASSERT_EQ(iter.NextBatch(&batch), 100u);
+        ASSERT_EQ(batch.GetRecord(0).GetRecordId(), rids[152]);
+        batch.Clear();
+        iter.EndScan();
+
+        // The batch pins the page the iterator stopped on by itself, so its
+        // records outlive the scan.
+        size_t npinned = g_bufman->GetStats().m_npinned;
+        iter = table->StartScan();
+        ASSERT_EQ(iter.NextBatch(&batch), 100u);
+        iter.EndScan();
+        absl::flat_hash_set<PageNumber> pids;
+        for (size_t j = 0; j < batch.GetNumRecords(); ++j) {
+            pids.insert(batch.GetRecord(j).GetRecordId().pid);
+        }
+        EXPECT_EQ(g_bufman->GetStats().m_npinned, npinned + pids.size());
+        EXPECT_EQ(sch->GetField(0, batch.GetRecord(99).GetData()).GetInt32(),
+                  149);
+        batch.Clear();
+        EXPECT_EQ(g_bufman->GetStats().m_npinned, npinned);
+    }
+
+    EXPECT_REGULAR_ERROR(Table::RecordBatch(0));
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestTable, TestToast) {
+    TDB_TEST_BEGIN
+
+    // (INT4, VARCHAR(100000), VARCHAR(100000))
+    for (uint8_t tablayout : {TABLAYOUT_ROW, TABLAYOUT_PAX}) {
+        std::string tabname = absl::StrFormat("toast_table_%d", tablayout);
+        g_db->CreateTable(tabname,
+                          {initoids::TYP_INT4, initoids::TYP_VARCHAR,
+                           initoids::TYP_VARCHAR},
+                          {0, 100000, 100000}, {}, {false, true, true}, {},
+                          tablayout);
+        Oid tabid = g_catcache->FindTableByName(tabname);
+        ASSERT_NE(tabid, InvalidOid);
+        std::shared_ptr<const TableDesc> tabdesc =
+            g_catcache->FindTableDesc(tabid);
+        const Schema *sch = tabdesc->GetSchema();
+        std::unique_ptr<Table> table = Table::Create(tabdesc);
+
+        // The lengths of the two strings of each record, where a record
+        // with two 1000-byte strings only has one of them moved out of
+        // line.
+        const std::vector<std::pair<size_t, size_t>> lens = {
+            {10, 20}, {1000, 1000}, {50000, 5}, {0, 30000}, {3000, 4000},
+        };
+        auto make_str = [](int32_t key, FieldId field_id, size_t len) {
+            std::string str(len, (char)('a' + (key + field_id) % 26));
+            if (len > 0)
+                str[len / 2] = (char)('0' + key % 10);
+            return str;
+        };
+        auto make_data = [&](int32_t key, std::vector<std::string> &strs) {
+            std::vector<Datum> data;
+            data.emplace_back(Datum::From(key));
+            for (FieldId i = 1; i <= 2; ++i) {
+                strs.emplace_back(make_str(key, i, (i == 1) ?
+                                  lens[key % lens.size()].first :
+                                  lens[key % lens.size()].second));
+                if (key % 7 == 6)
+                    data.emplace_back(Datum::FromNull());
+                else
+                    data.emplace_back(Datum::FromVarlenAsStringView(
+                        strs.back()));
+            }
+            return data;
+        };
+
+        const int32_t n = 100;
+        std::vector<RecordId> rids;
+        for (int32_t key = 0; key < n; ++key) {
+            std::vector<std::string> strs;
+            rids.push_back(table->Insert(make_data(key, strs)));
+        }
+        std::unique_ptr<Table::BulkLoader> loader = table->StartBulkLoad(4);
+        for (int32_t key = n; key < 2 * n; ++key) {
+            std::vector<std::string> strs;
+            loader->Insert(make_data(key, strs));
+        }
+        loader->Finish();
+        loader.reset();
+
+        // Erases and updates some of the records, where an update either
+        // keeps the out-of-line values of the old record by copying it with
+        // a new key, or replaces them with nulls.
+        for (int32_t key = 0; key < n; key += 5) {
+            table->EraseRecord(rids[key]);
+        }
+        for (int32_t key = 1; key < n; key += 5) {
+            maxaligned_char_buf buf;
+            if (key % 10 == 1) {
+                Table::Iterator iter = table->StartScanFrom(rids[key]);
+                ASSERT_TRUE(iter.Next());
+                const Record &rec = iter.GetCurrentRecord();
+                buf.assign(rec.GetData(), rec.GetData() + rec.GetLength());
+                iter.EndScan();
+                int32_t newkey = key + 2 * n;
+                memcpy(buf.data() + sch->GetOffsetAndLength(0, buf.data())
+                                        .first,
+                       &newkey, sizeof(int32_t));
+            } else {
+                std::vector<Datum> data;
+                data.emplace_back(Datum::From(key + 2 * n));
+                data.emplace_back(Datum::FromNull());
+                data.emplace_back(Datum::FromNull());
+                sch->WritePayloadToBuffer(data, buf);
+            }
+            Record rec(buf);
+            table->UpdateRecord(rids[key], rec);
+        }
+
+        // An update with an encoded record longer than ToastThreshold moves
+        // its long values out of line as Insert() does.
+        for (int32_t key = 4; key < n; key += 5) {
+            std::vector<std::string> strs;
+            std::vector<Datum> data = make_data(key, strs);
+            data[0] = Datum::From(key + 2 * n);
+            maxaligned_char_buf buf;
+            sch->WritePayloadToBuffer(data, buf);
+            Record rec(buf);
+            table->UpdateRecord(rids[key], rec);
+            ASSERT_EQ(rec.GetData(), buf.data());
+        }
+
+        table = Table::Create(tabdesc);
+        Table::Iterator iter = table->StartScan();
+        int32_t nrecs = 0;
+        while (iter.Next()) {
+            const Record &rec = iter.GetCurrentRecord();
+            ASSERT_LE(rec.GetLength(), Table::ToastThreshold);
+            int32_t key = sch->GetField(0, rec.GetData()).GetInt32();
+            int32_t orig_key = (key >= 2 * n) ? key - 2 * n : key;
+            ASSERT_FALSE(orig_key < n && orig_key % 5 == 0);
+            std::vector<std::string> strs;
+            std::vector<Datum> expected = make_data(orig_key, strs);
+            for (FieldId i = 1; i <= 2; ++i) {
+                Datum d = table->GetField(i, rec.GetData());
+                if (key >= 2 * n && orig_key % 10 == 6) {
+                    ASSERT_TRUE(d.isnull());
+                    continue;
+                }
+                ASSERT_EQ(d.isnull(), expected[i].isnull());
+                if (d.isnull())
+                    continue;
+                ASSERT_EQ(d.GetVarlenAsStringView(),
+                          expected[i].GetVarlenAsStringView());
+                ASSERT_EQ(sch->FieldIsExternal(i, rec.GetData()),
+                          strs[i - 1].size() > 1000 ||
+                          (strs[i - 1].size() == 1000 && i == 1));
+                if (sch->FieldIsExternal(i, rec.GetData())) {
+                    EXPECT_REGULAR_ERROR(sch->GetField(i, rec.GetData()));
+                }
+            }
+            ++nrecs;
+        }
+        ASSERT_EQ(nrecs, 2 * n - n / 5);
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestTable, TestFixedlenTable) {
+    TDB_TEST_BEGIN
+
+    ASSERT_TRUE(m_tabdesc->GetTableEntry()->tabisvarlen());
+    g_db->CreateTable("fixedlen_table",
+                      {initoids::TYP_INT4, initoids::TYP_INT8},
+                      {}, {}, {false, false});
+    Oid tabid = g_catcache->FindTableByName("fixedlen_table");
+    ASSERT_NE(tabid, InvalidOid);
+    std::shared_ptr<const TableDesc> tabdesc =
+        g_catcache->FindTableDesc(tabid);
+    ASSERT_FALSE(tabdesc->GetTableEntry()->tabisvarlen());
+    const Schema *sch = tabdesc->GetSchema();
+    ASSERT_EQ(sch->GetFixedRecordLength(), 16);
+
+    std::unique_ptr<Table> table = Table::Create(tabdesc);
+    const int32_t n = 20000;
+    std::vector<RecordId> rids;
+    for (int32_t i = 0; i < n; ++i) {
+        std::vector<Datum> data;
+        data.emplace_back(Datum::From(i));
+        data.emplace_back(Datum::From((int64_t) i * 3));
+        maxaligned_char_buf buf;
+        sch->WritePayloadToBuffer(data, buf);
+        Record rec(buf);
+        table->InsertRecord(rec);
+        rids.push_back(rec.GetRecordId());
+    }
+    for (int32_t i = 0; i < n; i += 2) {
+        table->EraseRecord(rids[i]);
+    }
+
+    Table::Iterator iter = table->StartScan();
+    int32_t i = 1;
+    while (iter.Next()) {
+        ASSERT_LT(i, n);
+        ASSERT_EQ(iter.GetCurrentRecordId(), rids[i]);
+        const char *payload = iter.GetCurrentRecord().GetData();
+        ASSERT_EQ(sch->GetField(0, payload).GetInt32(), i);
+        ASSERT_EQ(sch->GetField(1, payload).GetInt64(), (int64_t) i * 3);
+        i += 2;
+    }
+    ASSERT_EQ(i, n + 1);
+
+    // a record of the wrong length
+    maxaligned_char_buf buf(24);
+    Record rec(buf);
+    EXPECT_REGULAR_ERROR(table->InsertRecord(rec));
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestTable, TestPaxTable) {
+    TDB_TEST_BEGIN
+
+    g_db->CreateTable("pax_table",
+                      {initoids::TYP_INT4, initoids::TYP_VARCHAR},
+                      {0, 400}, {}, {}, {}, TABLAYOUT_PAX);
+    Oid tabid = g_catcache->FindTableByName("pax_table");
+    ASSERT_NE(tabid, InvalidOid);
+    std::shared_ptr<const TableDesc> tabdesc =
+        g_catcache->FindTableDesc(tabid);
+    ASSERT_EQ(tabdesc->GetTableEntry()->tablayout(), TABLAYOUT_PAX);
+    ASSERT_EQ(m_tabdesc->GetTableEntry()->tablayout(), TABLAYOUT_ROW);
+
+    // The helpers use the schema of m_tabdesc, which is the same.
+    std::unique_ptr<Table> table = Table::Create(tabdesc);
+    const int32_t n = 10000;
+    std::vector<RecordId> rids;
+    absl::flat_hash_map<int32_t, std::string> expected;
+    for (int32_t i = 0; i < n; ++i) {
+        size_t len = 1 + i % 97;
+        rids.push_back(InsertRecord(table.get(), i, len));
+        expected.emplace(i, MakeString(i, len));
+    }
+    ASSERT_EQ(ScanTable(table.get()), expected);
+
+    for (int32_t i = 0; i < n; i += 3) {
+        table->EraseRecord(rids[i]);
+        expected.erase(i);
+    }
+    for (int32_t i = 1; i < n; i += 3) {
+        maxaligned_char_buf buf = MakePayload(i, MakeString(i, 300));
+        Record rec(buf);
+        table->UpdateRecord(rids[i], rec);
+        expected[i] = MakeString(i, 300);
+    }
+    ASSERT_EQ(ScanTable(table.get()), expected);
+
+    std::unique_ptr<Table::BulkLoader> loader = table->StartBulkLoad(16);
+    for (int32_t i = n; i < 2 * n; ++i) {
+        std::vector<Datum> data;
+        data.emplace_back(Datum::From(i));
+        std::string str = MakeString(i, 20);
+        data.emplace_back(Datum::FromCString(str.c_str()));
+        loader->Insert(data);
+        expected.emplace(i, str);
+    }
+    loader->Finish();
+    table = Table::Create(tabdesc);
+    ASSERT_EQ(ScanTable(table.get()), expected);
+
+    // The fields are read from the minipages without the records, which are
+    // still reconstructed when asked for afterwards.
+    ASSERT_EQ(ScanFields(table.get()), expected);
+    {
+        Table::Iterator iter = table->StartScanFrom(rids[1]);
+        ASSERT_TRUE(iter.Next());
+        ASSERT_EQ(iter.GetField(0).GetInt32(), 1);
+        const Record &rec = iter.GetCurrentRecord();
+        ASSERT_EQ(rec.GetRecordId(), rids[1]);
+        ASSERT_EQ(m_tabdesc->GetSchema()->GetField(0, rec.GetData())
+                    .GetInt32(), 1);
+        ASSERT_EQ(iter.GetField(1).GetVarlenAsStringView(),
+                  MakeString(1, 300));
+    }
+
+    // A record that does not fit on a page is inserted with its long value
+    // moved out of line.
+    maxaligned_char_buf buf = MakePayload(0, std::string(PAGE_SIZE, 'x'));
+    Record rec(buf);
+    ASSERT_NO_ERROR(table->InsertRecord(rec));
+    {
+        Table::Iterator iter = table->StartScanFrom(rec.GetRecordId());
+        ASSERT_TRUE(iter.Next());
+        ASSERT_EQ(table->GetField(1, iter.GetCurrentRecord().GetData())
+                    .GetVarlenAsStringView(),
+                  std::string(PAGE_SIZE, 'x'));
+        ASSERT_EQ(iter.GetField(1).GetVarlenAsStringView(),
+                  std::string(PAGE_SIZE, 'x'));
+    }
+
+    // The records of a PAX table with a payload codec are moved in and out
+    // of the minipages through the codec.
+    g_db->CreateTable("pax_codec_table",
+                      {initoids::TYP_INT4, initoids::TYP_VARCHAR},
+                      {0, 400}, {}, {false, true}, {}, TABLAYOUT_PAX);
+    tabid = g_catcache->FindTableByName("pax_codec_table");
+    ASSERT_NE(tabid, InvalidOid);
+    std::shared_ptr<const TableDesc> codec_tabdesc =
+        g_catcache->FindTableDesc(tabid);
+    ASSERT_NE(codec_tabdesc->GetPayloadCodec(), nullptr);
+    const Schema *codec_sch = codec_tabdesc->GetSchema();
+    table = Table::Create(codec_tabdesc);
+    for (int32_t i = 0; i < n; ++i) {
+        std::string str = MakeString(i, 1 + i % 97);
+        std::vector<Datum> data;
+        data.emplace_back(Datum::From(i));
+        data.emplace_back((i % 5 == 0) ? Datum::FromNull() :
+                          Datum::FromCString(str.c_str()));
+        table->Insert(data);
+    }
+    Table::Iterator iter = table->StartScan();
+    int32_t i = 0;
+    while (iter.Next()) {
+        const Record &rec = iter.GetCurrentRecord();
+        ASSERT_EQ(codec_sch->GetField(0, rec.GetData()).GetInt32(), i);
+        Datum str = codec_sch->GetField(1, rec.GetData());
+        ASSERT_EQ(str.isnull(), i % 5 == 0);
+        if (!str.isnull()) {
+            ASSERT_EQ(str.GetVarlenAsStringView(), MakeString(i, 1 + i % 97));
+        }
+        ++i;
+    }
+    ASSERT_EQ(i, n);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestTable, TestRangeScan) {
+    TDB_TEST_BEGIN
+
+    // The keys are inserted in increasing order, so most of the page groups
+    // do not overlap with a small key range.
+    std::unique_ptr<Table> table = Table::Create(m_tabdesc);
+    const int32_t n = 20000;
+    for (int32_t i = 0; i < n; ++i) {
+        InsertRecord(table.get(), i, 100);
+    }
+    std::unique_ptr<Table::BulkLoader> loader = table->StartBulkLoad(16);
+    for (int32_t i = n; i < 2 * n; ++i) {
+        std::vector<Datum> data;
+        data.emplace_back(Datum::From(i));
+        data.emplace_back(Datum::FromCString(MakeString(i, 100).c_str()));
+        loader->Insert(data);
+    }
+    loader->Finish();
+    loader.reset();
+
+    // a new handle reads the zones from the zone map
+    table = Table::Create(m_tabdesc);
+    const Schema *sch = m_tabdesc->GetSchema();
+    auto scan_keys = [&](FieldId field_id, const Datum &lo, const Datum &hi,
+                         uint32_t *p_nskipped) {
+        std::vector<int32_t> keys;
+        std::unique_ptr<Table::RangeScan> scan =
+            table->StartRangeScan(field_id, lo, hi);
+        while (scan->Next()) {
+            keys.push_back(sch->GetField(
+                0, scan->GetCurrentRecord().GetData()).GetInt32());
+        }
+        EXPECT_FALSE(scan->Next());
+        *p_nskipped = scan->GetNumSkippedGroups();
+        return keys;
+    };
+    auto make_range = [](int32_t begin, int32_t end) {
+        std::vector<int32_t> keys;
+        for (int32_t i = begin; i < end; ++i)
+            keys.push_back(i);
+        return keys;
+    };
+
+    uint32_t nskipped;
+    ASSERT_EQ(scan_keys(0, Datum::From((int32_t) 5000),
+                        Datum::From((int32_t) 5999), &nskipped),
+              make_range(5000, 6000));
+    ASSERT_GT(nskipped, 0u);
+    ASSERT_EQ(scan_keys(0, Datum::From(n + 100), Datum::From(n + 199),
+                        &nskipped),
+              make_range(n + 100, n + 200));
+    ASSERT_GT(nskipped, 0u);
+    ASSERT_EQ(scan_keys(0, Datum::FromNull(), Datum::From((int32_t) 99),
+                        &nskipped),
+              make_range(0, 100));
+    ASSERT_GT(nskipped, 0u);
+    ASSERT_EQ(scan_keys(0, Datum::From(2 * n), Datum::FromNull(),
+                        &nskipped),
+              std::vector<int32_t>());
+
+    // An erased record is no longer returned, while its zone stays.
+    Table::Iterator iter = table->StartScan();
+    ASSERT_TRUE(iter.Next());
+    RecordId rid = iter.GetCurrentRecordId();
+    iter.EndScan();
+    table->EraseRecord(rid);
+    ASSERT_EQ(scan_keys(0, Datum::From((int32_t) 0),
+                        Datum::From((int32_t) 9), &nskipped),
+              make_range(1, 10));
+
+    // a field without a zone is still filtered
+    std::string lo = MakeString(300, 100);
+    std::string hi = MakeString(309, 100);
+    ASSERT_EQ(scan_keys(1, Datum::FromCString(lo.c_str()),
+                        Datum::FromCString(hi.c_str()), &nskipped),
+              make_range(300, 310));
+    ASSERT_EQ(nskipped, 0u);
+
+    EXPECT_REGULAR_ERROR(
+        table->StartRangeScan(2, Datum::FromNull(), Datum::FromNull()));
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestTable, TestZoneMapProbeDoesNotAllocate) {
+    TDB_TEST_BEGIN
+
+    // Probing a group past the end of the map neither allocates map pages
+    // nor skips the group.
+    FileId fid = ZoneMap::Create();
+    ZoneMap zonemap(fid, m_tabdesc->GetSchema());
+    ASSERT_TRUE(zonemap.HasZone(0));
+    std::unique_ptr<File> file = g_fileman->Open(fid);
+    PageNumber npages = file->GetNumPages();
+    EXPECT_TRUE(zonemap.GroupMayMatch(100000, 0, Datum::From((int32_t) 0),
+                                      Datum::From((int32_t) 9)));
+    EXPECT_EQ(file->GetNumPages(), npages);
+
+    // The zones of an existing group are still checked.
+    ColumnZone zone;
+    memset(&zone, 0, sizeof(zone));
+    std::vector<Datum> data;
+    data.emplace_back(Datum::From((int32_t) 100));
+    data.emplace_back(Datum::FromCString("a"));
+    maxaligned_char_buf buf;
+    m_tabdesc->GetSchema()->WritePayloadToBuffer(data, buf);
+    zonemap.AddToZones(&zone, buf.data());
+    zonemap.Merge(0, &zone);
+    EXPECT_FALSE(zonemap.GroupMayMatch(0, 0, Datum::From((int32_t) 0),
+                                       Datum::From((int32_t) 9)));
+    EXPECT_TRUE(zonemap.GroupMayMatch(0, 0, Datum::From((int32_t) 0),
+                                      Datum::From((int32_t) 100)));
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestTable, TestVacuum) {
+    TDB_TEST_BEGIN
+
+    g_db->CreateTable("pax_table",
+                      {initoids::TYP_INT4, initoids::TYP_VARCHAR},
+                      {0, 400}, {}, {}, {}, TABLAYOUT_PAX);
+    Oid tabid = g_catcache->FindTableByName("pax_table");
+    ASSERT_NE(tabid, InvalidOid);
+
+    // The helpers use the schema of m_tabdesc, which is the same.
+    for (std::shared_ptr<const TableDesc> tabdesc :
+            {m_tabdesc, g_catcache->FindTableDesc(tabid)}) {
+        std::unique_ptr<Table> table = Table::Create(tabdesc);
+        const int32_t n = 10000;
+        std::vector<RecordId> rids;
+        absl::flat_hash_map<int32_t, std::string> expected;
+        for (int32_t i = 0; i < n; ++i) {
+            size_t len = 1 + i % 97;
+            rids.push_back(InsertRecord(table.get(), i, len));
+            expected.emplace(i, MakeString(i, len));
+        }
+
+        // The first half of the pages become empty, and the others have
+        // holes.
+        for (int32_t i = 0; i < n; ++i) {
+            if (i < n / 2 || i % 3 == 0) {
+                table->EraseRecord(rids[i]);
+                expected.erase(i);
+            }
+        }
+        std::unique_ptr<File> f =
+            g_fileman->Open(tabdesc->GetTableEntry()->tabfid());
+        PageNumber npages = f->GetNumPages();
+
+        // vacuum while another thread keeps inserting
+        const size_t nthreads = 4;
+        std::unique_ptr<Table::ParallelVacuum> vacuum =
+            table->StartVacuum(4);
+        std::vector<std::string> errors(nthreads + 1);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < nthreads; ++t) {
+            threads.emplace_back([&, t]() {
+                try {
+                    while (vacuum->VacuumNextMorsel());
+                } catch (const TDBError &e) {
+                    errors[t] = e.GetMessage();
+                }
+            });
+        }
+        threads.emplace_back([&]() {
+            try {
+                for (int32_t i = n; i < n + 2000; ++i) {
+                    InsertRecord(table.get(), i, 40);
+                }
+            } catch (const TDBError &e) {
+                errors[nthreads] = e.GetMessage();
+            }
+        });
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        for (const std::string &error : errors) {
+            ASSERT_EQ(error, "");
+        }
+        for (int32_t i = n; i < n + 2000; ++i) {
+            expected.emplace(i, MakeString(i, 40));
+        }
+        ASSERT_GT(vacuum->GetNumFreedPages(), 0u);
+        ASSERT_GT(vacuum->GetNumCompactedPages(), 0u);
+        ASSERT_LT(f->GetNumPages(), npages);
+        ASSERT_EQ(ScanTable(table.get(), false), expected);
+
+        // Nothing is left to reclaim, and the budget spreads the visits
+        // out over time.
+        const uint32_t max_pages_per_sec = 1000;
+        vacuum = table->StartVacuum(8, max_pages_per_sec);
+        auto start = std::chrono::steady_clock::now();
+        while (vacuum->VacuumNextMorsel());
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        ASSERT_GT(vacuum->GetNumVisitedPages(), 1u);
+        EXPECT_GE(elapsed, std::chrono::milliseconds(
+            (vacuum->GetNumVisitedPages() - 1) * 1000 / max_pages_per_sec));
+        ASSERT_EQ(vacuum->GetNumFreedPages(), 0u);
+        ASSERT_EQ(vacuum->GetNumCompactedPages(), 0u);
+
+        // the freed pages are no longer in the table
+        table = Table::Create(tabdesc);
+        ASSERT_EQ(ScanTable(table.get(), false), expected);
+    }
+
+    TDB_TEST_END
+}
+
+
+TEST_F(BasicTestTable, TestVacuumWithInsertsReusingFreedPages) {
+    TDB_TEST_BEGIN
+
+    std::unique_ptr<Table> table = Table::Create(m_tabdesc);
+    const int32_t n = 10000;
+    std::vector<RecordId> rids;
+    absl::flat_hash_map<int32_t, std::string> expected;
+    for (int32_t i = 0; i < n; ++i) {
+        rids.push_back(InsertRecord(table.get(), i, 300));
+    }
+
+    // Empty every other page, so that the vacuum frees pages all over the
+    // table while the inserters keep allocating new ones, which are mostly
+    // the pages it has just freed. The inserters may also still hold
+    // insertion hints or search results of the pages being freed.
+    for (int32_t i = 0; i < n; ++i) {
+        if (rids[i].pid % 2 == 0) {
+            table->EraseRecord(rids[i]);
+        } else {
+            expected.emplace(i, MakeString(i, 300));
+        }
+    }
+    PageNumber npages = g_fileman->GetNumPages();
+    std::unique_ptr<File> f =
+        g_fileman->Open(m_tabdesc->GetTableEntry()->tabfid());
+    PageNumber table_npages = f->GetNumPages();
+
+    const size_t nvacuum_threads = 2;
+    const size_t ninsert_threads = 4;
+    const int32_t ninserts = 1000;
+    std::unique_ptr<Table::ParallelVacuum> vacuum = table->StartVacuum(1);
+    std::vector<std::string> errors(nvacuum_threads + ninsert_threads);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nvacuum_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            try {
+                while (vacuum->VacuumNextMorsel());
+            } catch (const TDBError &e) {
+                errors[t] = e.GetMessage();
+            }
+        });
+    }
+    for (size_t t = 0; t < ninsert_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            try {
+                for (int32_t i = 0; i < ninserts; ++i) {
+                    InsertRecord(table.get(),
+                                 n + (int32_t) t * ninserts + i, 400);
+                }
+            } catch (const TDBError &e) {
+                errors[nvacuum_threads + t] = e.GetMessage();
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (const std::string &error : errors) {
+        ASSERT_EQ(error, "");
+    }
+    for (int32_t i = n; i < n + (int32_t) ninsert_threads * ninserts; ++i) {
+        expected.emplace(i, MakeString(i, 400));
+    }
+    ASSERT_GT(vacuum->GetNumFreedPages(), 0u);
+    ASSERT_EQ(ScanTable(table.get(), false), expected);
+
+    // Some of the new table pages are freed ones rather than new pages at
+    // the end of the data files.
+    PageNumber nallocated =
+        f->GetNumPages() + vacuum->GetNumFreedPages() - table_npages;
+    EXPECT_LT(g_fileman->GetNumPages() - npages, nallocated);
+
+    table = Table::Create(m_tabdesc);
+    ASSERT_EQ(ScanTable(table.get(), false), expected);
+
+    TDB_TEST_END
+}
+
+}   // namespace taco
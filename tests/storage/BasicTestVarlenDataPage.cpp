@@ -0,0 +1,193 @@
+// Basic tests for VarlenDataPage
+#include "base/TDBNonDBTest.h"
+
+#include <random>
+
+#include "storage/VarlenDataPage.h"
+
+namespace taco {
+
+class BasicTestVarlenDataPage: public TDBNonDBTest {
+protected:
+    void
+    SetUp() override {
+        TDBNonDBTest::SetUp();
+        m_page_mem = unique_aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+        m_page = (char*) m_page_mem.get();
+        memset(m_page, 0, PAGE_SIZE);
+        VarlenDataPage::Initialize(m_page);
+    }
+
+    /*!
+     * Returns the content of a test record of length \p len for \p key.
+     */
+    static std::string
+    MakeRecord(size_t key, FieldOffset len) {
+        std::string rec(len, '\0');
+        for (FieldOffset i = 0; i < len; ++i) {
+            rec[i] = (char)(key * 31 + i);
+        }
+        return rec;
+    }
+
+    static void
+    CheckRecord(const VarlenDataPage &dp, SlotId sid, const std::string &rec) {
+        FieldOffset reclen;
+        const char *buf = dp.GetRecordBuf(sid, &reclen);
+        ASSERT_NE(buf, nullptr);
+        ASSERT_EQ((uintptr_t) buf % MAXALIGN_OF, 0u);
+        ASSERT_EQ((size_t) reclen, rec.size());
+        ASSERT_EQ(memcmp(buf, rec.data(), reclen), 0);
+    }
+
+    unique_malloced_ptr m_page_mem;
+    char *m_page;
+};
+
+TEST_F(BasicTestVarlenDataPage, TestInsertUntilFull) {
+    TDB_TEST_BEGIN
+
+    VarlenDataPage dp(m_page);
+    ASSERT_EQ(dp.GetRecordCount(), 0);
+    ASSERT_LT(dp.GetMaxSlotId(), dp.GetMinSlotId());
+
+    std::mt19937 rng(0x4321);
+    std::vector<std::string> recs;
+    for (;;) {
+        std::string rec = MakeRecord(recs.size(), 1 + rng() % 100);
+        Record r(rec.data(), (FieldOffset) rec.size());
+        if (!dp.InsertRecord(r))
+            break;
+        recs.emplace_back(std::move(rec));
+        ASSERT_EQ(r.GetRecordId().sid, (SlotId) recs.size());
+    }
+    ASSERT_GT(recs.size(), (size_t) PAGE_SIZE / 120);
+    ASSERT_EQ(dp.GetRecordCount(), (SlotId) recs.size());
+    ASSERT_EQ(dp.GetMaxSlotId(), (SlotId) recs.size());
+    for (SlotId sid = dp.GetMinSlotId(); sid <= dp.GetMaxSlotId(); ++sid) {
+        ASSERT_TRUE(dp.IsOccupied(sid));
+        CheckRecord(dp, sid, recs[sid - 1]);
+    }
+    ASSERT_FALSE(dp.IsOccupied(dp.GetMaxSlotId() + 1));
+
+    // the longest record fits on an empty page
+    VarlenDataPage::Initialize(m_page);
+    std::string rec = MakeRecord(0, VarlenDataPage::ComputeMaxRecordLength());
+    Record r(rec.data(), (FieldOffset) rec.size());
+    ASSERT_TRUE(dp.InsertRecord(r));
+    CheckRecord(dp, r.GetRecordId().sid, rec);
+    ASSERT_LT(dp.ComputeFreeSpace(), (FieldOffset) MAXALIGN_OF);
+    Record r2(rec.data(), 1);
+    ASSERT_FALSE(dp.InsertRecord(r2));
+
+    // a record longer than that is never inserted
+    VarlenDataPage::Initialize(m_page);
+    rec.push_back('x');
+    Record r3(rec.data(), (FieldOffset) rec.size());
+    ASSERT_REGULAR_ERROR(dp.InsertRecord(r3));
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestVarlenDataPage, TestEraseAndCompact) {
+    TDB_TEST_BEGIN
+
+    VarlenDataPage dp(m_page);
+    std::vector<std::string> recs;
+    for (;;) {
+        std::string rec = MakeRecord(recs.size(), 40);
+        Record r(rec.data(), (FieldOffset) rec.size());
+        if (!dp.InsertRecord(r))
+            break;
+        recs.emplace_back(std::move(rec));
+    }
+    SlotId nslots = dp.GetMaxSlotId();
+
+    // Erase every other record. None of the freed space is contiguous
+    // except for the lowest record, so a long record needs a compaction.
+    for (SlotId sid = 1; sid <= nslots; sid += 2) {
+        ASSERT_TRUE(dp.EraseRecord(sid));
+        recs[sid - 1].clear();
+    }
+    ASSERT_FALSE(dp.EraseRecord(1));
+    ASSERT_EQ(dp.GetRecordCount(), nslots / 2);
+
+    std::string rec = MakeRecord(1000, 200);
+    Record r(rec.data(), (FieldOffset) rec.size());
+    ASSERT_TRUE(dp.InsertRecord(r));
+    // the first free slot is reused
+    ASSERT_EQ(r.GetRecordId().sid, 1);
+    recs[0] = rec;
+
+    for (SlotId sid = 1; sid <= nslots; ++sid) {
+        if (recs[sid - 1].empty()) {
+            ASSERT_FALSE(dp.IsOccupied(sid));
+        } else {
+            CheckRecord(dp, sid, recs[sid - 1]);
+        }
+    }
+
+    // Erasing the records at the end of the slot array shrinks it.
+    VarlenDataPage::Initialize(m_page);
+    for (size_t i = 0; i < 3; ++i) {
+        std::string rec2 = MakeRecord(i, 16);
+        Record r2(rec2.data(), (FieldOffset) rec2.size());
+        ASSERT_TRUE(dp.InsertRecord(r2));
+    }
+    FieldOffset free_space = dp.ComputeFreeSpace();
+    ASSERT_TRUE(dp.EraseRecord(2));
+    ASSERT_EQ(dp.GetMaxSlotId(), 3);
+    ASSERT_TRUE(dp.EraseRecord(3));
+    ASSERT_EQ(dp.GetMaxSlotId(), 1);
+    ASSERT_EQ(dp.ComputeFreeSpace(),
+              free_space + 32 + 2 * (FieldOffset) sizeof(VarlenDataPageSlot));
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestVarlenDataPage, TestUpdate) {
+    TDB_TEST_BEGIN
+
+    VarlenDataPage dp(m_page);
+    std::vector<std::string> recs;
+    for (;;) {
+        std::string rec = MakeRecord(recs.size(), 64);
+        Record r(rec.data(), (FieldOffset) rec.size());
+        if (!dp.InsertRecord(r))
+            break;
+        recs.emplace_back(std::move(rec));
+    }
+    SlotId nslots = dp.GetMaxSlotId();
+
+    // shrink every record in place
+    for (SlotId sid = 1; sid <= nslots; ++sid) {
+        recs[sid - 1] = MakeRecord(sid + 100, 20);
+        Record r(recs[sid - 1].data(), (FieldOffset) recs[sid - 1].size());
+        ASSERT_TRUE(dp.UpdateRecord(sid, r));
+        ASSERT_EQ(r.GetRecordId().sid, sid);
+    }
+
+    // The freed space is now enough for growing a few records to a size
+    // that needs compaction.
+    size_t ngrown = 0;
+    for (SlotId sid = 1; sid <= nslots; ++sid) {
+        std::string rec = MakeRecord(sid + 200, 300);
+        Record r(rec.data(), (FieldOffset) rec.size());
+        FieldOffset free_space = dp.ComputeFreeSpace();
+        bool fits = free_space + 24 >= 304;
+        ASSERT_EQ(dp.UpdateRecord(sid, r), fits);
+        if (fits) {
+            recs[sid - 1] = std::move(rec);
+            ++ngrown;
+        }
+    }
+    ASSERT_GT(ngrown, 0u);
+    ASSERT_LT(ngrown, (size_t) nslots);
+    for (SlotId sid = 1; sid <= nslots; ++sid) {
+        CheckRecord(dp, sid, recs[sid - 1]);
+    }
+
+    TDB_TEST_END
+}
+
+}   // namespace taco
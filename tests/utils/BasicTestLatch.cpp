@@ -0,0 +1,217 @@
+// Basic tests for Latch
+#include "base/TDBNonDBTest.h"
+
+#include <thread>
+#include <vector>
+
+#include "utils/Latch.h"
+
+namespace taco {
+
+using BasicTestLatch = TDBNonDBTest;
+
+TEST_F(BasicTestLatch, TestTryAcquire) {
+    TDB_TEST_BEGIN
+
+    Latch latch;
+    ASSERT_TRUE(latch.TryAcquire(LatchMode::SH));
+    ASSERT_TRUE(latch.TryAcquire(LatchMode::SH));
+    ASSERT_EQ(latch.GetNumSharedHolders(), 2u);
+    ASSERT_FALSE(latch.TryAcquire(LatchMode::EX));
+    latch.Release(LatchMode::SH);
+    latch.Release(LatchMode::SH);
+
+    ASSERT_TRUE(latch.TryAcquire(LatchMode::EX));
+    ASSERT_TRUE(latch.IsHeldExclusive());
+    ASSERT_FALSE(latch.TryAcquire(LatchMode::EX));
+    ASSERT_FALSE(latch.TryAcquire(LatchMode::SH));
+    latch.Release(LatchMode::EX);
+    ASSERT_FALSE(latch.IsHeldExclusive());
+    ASSERT_EQ(latch.GetNumSharedHolders(), 0u);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestLatch, TestUpgradeAndDowngrade) {
+    TDB_TEST_BEGIN
+
+    Latch latch;
+    latch.Acquire(LatchMode::SH);
+    latch.Acquire(LatchMode::SH);
+    // can't upgrade with another shared holder
+    ASSERT_FALSE(latch.TryUpgrade());
+    latch.Release(LatchMode::SH);
+    ASSERT_TRUE(latch.TryUpgrade());
+    ASSERT_TRUE(latch.IsHeldExclusive());
+    ASSERT_FALSE(latch.TryAcquire(LatchMode::SH));
+
+    latch.Downgrade();
+    ASSERT_FALSE(latch.IsHeldExclusive());
+    ASSERT_EQ(latch.GetNumSharedHolders(), 1u);
+    ASSERT_TRUE(latch.TryAcquire(LatchMode::SH));
+    latch.Release(LatchMode::SH);
+    latch.Release(LatchMode::SH);
+    ASSERT_TRUE(latch.TryAcquire(LatchMode::EX));
+    latch.Release(LatchMode::EX);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestLatch, TestConcurrentReadersAndWriters) {
+    TDB_TEST_BEGIN
+
+    const int nwriters = 4;
+    const int nreaders = 4;
+    const int niters = 20000;
+    Latch latch;
+    // The writers keep both counters equal under the exclusive latch.
+    uint64_t a = 0, b = 0;
+    std::atomic<bool> inconsistent(false);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nwriters; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < niters; ++j) {
+                latch.Acquire(LatchMode::EX);
+                ++a;
+                ++b;
+                latch.Release(LatchMode::EX);
+            }
+        });
+    }
+    for (int i = 0; i < nreaders; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < niters; ++j) {
+                latch.Acquire(LatchMode::SH);
+                if (a != b)
+                    inconsistent.store(true);
+                latch.Release(LatchMode::SH);
+            }
+        });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    EXPECT_FALSE(inconsistent.load());
+    EXPECT_EQ(a, (uint64_t) nwriters * niters);
+    EXPECT_EQ(b, (uint64_t) nwriters * niters);
+    EXPECT_FALSE(latch.IsHeldExclusive());
+    EXPECT_EQ(latch.GetNumSharedHolders(), 0u);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestLatch, TestWriterIsNotStarved) {
+    TDB_TEST_BEGIN
+
+    Latch latch;
+    std::atomic<bool> writer_done(false);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&]() {
+            // Keep the latch always held by some reader.
+            while (!writer_done.load()) {
+                latch.Acquire(LatchMode::SH);
+                std::this_thread::yield();
+                latch.Release(LatchMode::SH);
+            }
+        });
+    }
+
+    latch.Acquire(LatchMode::EX);
+    ASSERT_EQ(latch.GetNumSharedHolders(), 0u);
+    latch.Release(LatchMode::EX);
+    writer_done.store(true);
+    for (std::thread &t : readers) {
+        t.join();
+    }
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestLatch, TestOptimisticRead) {
+    TDB_TEST_BEGIN
+
+    Latch latch;
+    uint32_t version;
+    ASSERT_TRUE(latch.TryBeginOptimisticRead(version));
+    ASSERT_TRUE(latch.ValidateOptimisticRead(version));
+
+    // Shared holders never invalidate an optimistic read.
+    latch.Acquire(LatchMode::SH);
+    ASSERT_TRUE(latch.ValidateOptimisticRead(version));
+    uint32_t version2;
+    ASSERT_TRUE(latch.TryBeginOptimisticRead(version2));
+    ASSERT_EQ(version, version2);
+    latch.Release(LatchMode::SH);
+
+    latch.Acquire(LatchMode::EX);
+    ASSERT_FALSE(latch.ValidateOptimisticRead(version));
+    ASSERT_FALSE(latch.TryBeginOptimisticRead(version2));
+    latch.Release(LatchMode::EX);
+    ASSERT_FALSE(latch.ValidateOptimisticRead(version));
+    ASSERT_TRUE(latch.TryBeginOptimisticRead(version2));
+    ASSERT_NE(version, version2);
+
+    // So do an upgrade and a downgrade.
+    latch.Acquire(LatchMode::SH);
+    ASSERT_TRUE(latch.TryUpgrade());
+    ASSERT_FALSE(latch.TryBeginOptimisticRead(version));
+    latch.Downgrade();
+    ASSERT_FALSE(latch.ValidateOptimisticRead(version2));
+    ASSERT_TRUE(latch.TryBeginOptimisticRead(version));
+    latch.Release(LatchMode::SH);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestLatch, TestConcurrentOptimisticReaders) {
+    TDB_TEST_BEGIN
+
+    const int nwriters = 2;
+    const int nreaders = 4;
+    const int niters = 20000;
+    Latch latch;
+    std::atomic<uint64_t> a(0), b(0);
+    std::atomic<bool> inconsistent(false);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nwriters; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < niters; ++j) {
+                latch.Acquire(LatchMode::EX);
+                a.store(a.load(memory_order_relaxed) + 1,
+                        memory_order_relaxed);
+                b.store(b.load(memory_order_relaxed) + 1,
+                        memory_order_relaxed);
+                latch.Release(LatchMode::EX);
+            }
+        });
+    }
+    for (int i = 0; i < nreaders; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < niters; ++j) {
+                uint64_t x, y;
+                latch.ReadOptimistically([&]() {
+                    x = a.load(memory_order_relaxed);
+                    y = b.load(memory_order_relaxed);
+                });
+                if (x != y)
+                    inconsistent.store(true);
+            }
+        });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    EXPECT_FALSE(inconsistent.load());
+    EXPECT_EQ(a.load(), (uint64_t) nwriters * niters);
+    EXPECT_FALSE(latch.IsHeldExclusive());
+    EXPECT_EQ(latch.GetNumSharedHolders(), 0u);
+
+    TDB_TEST_END
+}
+
+}   // namespace taco
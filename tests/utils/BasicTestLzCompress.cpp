@@ -0,0 +1,104 @@
+// Basic tests for lz_compress() and lz_decompress()
+#include "base/TDBNonDBTest.h"
+
+#include <random>
+#include <vector>
+
+#include "utils/lzcompress.h"
+
+namespace taco {
+
+using BasicTestLzCompress = TDBNonDBTest;
+
+static void
+CheckRoundTrip(const std::vector<char> &data) {
+    std::vector<char> cbuf(data.size() + data.size() / 64 + 16);
+    size_t csize = lz_compress(data.data(), data.size(), cbuf.data(),
+                               cbuf.size());
+    ASSERT_GT(csize, 0u);
+    std::vector<char> dbuf(data.size());
+    ASSERT_TRUE(lz_decompress(cbuf.data(), csize, dbuf.data(), dbuf.size()));
+    ASSERT_EQ(dbuf, data);
+}
+
+TEST_F(BasicTestLzCompress, TestRoundTrip) {
+    TDB_TEST_BEGIN
+
+    std::mt19937 rng(0x1234);
+    for (size_t n = 0; n < 32; ++n) {
+        std::vector<char> data(n);
+        for (char &c : data) {
+            c = (char) (rng() % 3);
+        }
+        CheckRoundTrip(data);
+    }
+
+    // a page with a few records and a lot of free space
+    std::vector<char> page(PAGE_SIZE, 0);
+    for (size_t off = PAGE_SIZE - 100; off > 200; off -= 100) {
+        for (size_t i = 0; i < 60; ++i) {
+            page[off + i] = (char)('a' + (i + off / 100) % 26);
+        }
+    }
+    CheckRoundTrip(page);
+
+    // long runs and matches that overlap with themselves
+    std::vector<char> runs;
+    for (int i = 0; i < 100; ++i) {
+        runs.insert(runs.end(), (size_t) rng() % 1000, (char) i);
+        runs.push_back('x');
+        runs.push_back('y');
+    }
+    CheckRoundTrip(runs);
+
+    std::vector<char> random_bytes(PAGE_SIZE);
+    for (char &c : random_bytes) {
+        c = (char) rng();
+    }
+    CheckRoundTrip(random_bytes);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestLzCompress, TestCompressionRatio) {
+    TDB_TEST_BEGIN
+
+    std::vector<char> zeros(PAGE_SIZE, 0);
+    char cbuf[PAGE_SIZE];
+    size_t csize = lz_compress(zeros.data(), zeros.size(), cbuf, PAGE_SIZE);
+    ASSERT_GT(csize, 0u);
+    EXPECT_LT(csize, 64u);
+
+    // Random bytes don't compress, so they don't fit in the same size.
+    std::mt19937 rng(0x5678);
+    std::vector<char> random_bytes(PAGE_SIZE);
+    for (char &c : random_bytes) {
+        c = (char) rng();
+    }
+    EXPECT_EQ(lz_compress(random_bytes.data(), random_bytes.size(), cbuf,
+                          PAGE_SIZE), 0u);
+
+    TDB_TEST_END
+}
+
+TEST_F(BasicTestLzCompress, TestCorruptedInput) {
+    TDB_TEST_BEGIN
+
+    std::vector<char> page(PAGE_SIZE);
+    for (size_t i = 0; i < page.size(); ++i) {
+        page[i] = (char)(i % 37);
+    }
+    char cbuf[PAGE_SIZE];
+    size_t csize = lz_compress(page.data(), page.size(), cbuf, PAGE_SIZE);
+    ASSERT_GT(csize, 0u);
+
+    std::vector<char> dbuf(PAGE_SIZE);
+    EXPECT_FALSE(lz_decompress(cbuf, csize - 1, dbuf.data(), dbuf.size()));
+    EXPECT_FALSE(lz_decompress(cbuf, csize, dbuf.data(), dbuf.size() - 1));
+    EXPECT_FALSE(lz_decompress(cbuf, csize, dbuf.data(), dbuf.size() + 1));
+    EXPECT_TRUE(lz_decompress(cbuf, csize, dbuf.data(), dbuf.size()));
+
+    TDB_TEST_END
+}
+
+}   // namespace taco